@@ -0,0 +1,416 @@
+/* ============================================================================
+ * Allocation accounting.
+ *
+ * Everything the bot allocates goes through xmalloc(), xrealloc() and
+ * xfree(): sds strings via sdsalloc.h, cJSON trees via the hooks set by
+ * startBot(), and the rest of the code directly. With --memory-accounting
+ * every block gets a header with its size and the subsystem that made it,
+ * that is the role of the allocating thread (polling loop, request
+ * threads, pipeline stages, ...), so the bytes and blocks allocated and
+ * still live are known per subsystem. They are kept in stats counters, so
+ * --metrics-port exports them too. A canary after every block catches
+ * writes past its end, like those following a realloc() too small for
+ * what is stored.
+ *
+ * Buffers of the pool (pool.c) and the items of the stats registry are
+ * aligned blocks, accounted the same way. A buffer the pool caches is
+ * charged to the "pool" subsystem until it is handed out again.
+ *
+ * The most memory held at once by every request is tracked too: a request
+ * charges the allocations of every thread working for it, that is attached
+ * to its slow log trace, so the frames of its screenshots count. On SIGINT
+ * or SIGTERM the largest blocks still allocated are reported, with a
+ * preview of their contents, before the process exits.
+ *
+ * The header changes the layout of every block, so accounting must be
+ * enabled before the first allocation, and stays on.
+ * ==========================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "alloc.h"
+#include "stats.h"
+
+#define ALLOC_MAGIC 0xa110c8edU
+
+/* Written after every block, checked when it is freed. */
+static const unsigned char Canary[8] = {0xde,0xad,0xbe,0xef,0xfe,0xed,0xfa,0xce};
+
+/* Right before every block, as aligned as malloc() results must be. */
+typedef union AllocHeader {
+    struct {
+        size_t size;            /* Size asked by the caller. */
+        union AllocHeader *prev, *next; /* Blocks of the same subsystem. */
+        uint16_t subsystem;     /* Index in Subsystems. */
+        uint16_t offset;        /* Of the block from what malloc() returned. */
+        uint32_t magic;         /* ALLOC_MAGIC while allocated. */
+    } h;
+    max_align_t align;
+} AllocHeader;
+
+typedef struct AllocSubsystem {
+    char name[STATS_NAME_LEN];
+    StatsCounter *live_bytes;   /* Gauges. */
+    StatsCounter *live_blocks;
+    StatsCounter *allocs;       /* Counters, reallocations included. */
+    StatsCounter *bytes;
+    pthread_mutex_t lock;       /* Protects 'blocks'. */
+    AllocHeader *blocks;        /* Live blocks, for the leak report. */
+} AllocSubsystem;
+
+/* A block still allocated at exit, as shown by the leak report. */
+typedef struct AllocLeak {
+    size_t size;
+    int subsystem;
+    char preview[ALLOC_PREVIEW_LEN+1];
+} AllocLeak;
+
+static int Enabled = 0;
+static AllocSubsystem Subsystems[ALLOC_MAX_SUBSYSTEMS];
+static _Atomic int NumSubsystems = 0;
+static pthread_mutex_t SubsystemLock = PTHREAD_MUTEX_INITIALIZER;
+static StatsCounter *Overflows = NULL;
+static int SignalPipe[2];               /* Signals to the report thread. */
+
+/* Peak memory of the requests, in bytes. */
+static _Atomic int64_t PeakLast = 0, PeakMax = 0, PeakSum = 0, PeakCount = 0;
+
+static _Thread_local int Subsystem = 0;
+static _Thread_local AllocRequest *Request = NULL;
+
+/* Return the index of the subsystem with the specified name, adding it
+ * if needed. When the table is full the first subsystem is used. */
+static int subsystem_index(const char *name) {
+    pthread_mutex_lock(&SubsystemLock);
+    int n = atomic_load(&NumSubsystems), j = 0;
+    while (j < n && strcmp(Subsystems[j].name, name) != 0) j++;
+    if (j == n && n < ALLOC_MAX_SUBSYSTEMS) {
+        AllocSubsystem *s = &Subsystems[n];
+        char counter[STATS_NAME_LEN];
+        snprintf(s->name, sizeof(s->name), "%s", name);
+        snprintf(counter, sizeof(counter), "memory_live_bytes{subsystem=\"%s\"}", name);
+        s->live_bytes = statsCounter(counter);
+        snprintf(counter, sizeof(counter), "memory_live_blocks{subsystem=\"%s\"}", name);
+        s->live_blocks = statsCounter(counter);
+        snprintf(counter, sizeof(counter), "memory_allocs_total{subsystem=\"%s\"}", name);
+        s->allocs = statsCounter(counter);
+        snprintf(counter, sizeof(counter), "memory_allocated_bytes_total{subsystem=\"%s\"}", name);
+        s->bytes = statsCounter(counter);
+        atomic_store(&NumSubsystems, n+1);
+    } else if (j == n) {
+        j = 0;
+    }
+    pthread_mutex_unlock(&SubsystemLock);
+    return j;
+}
+
+/* Account 'bytes' more held by the subsystem, and by the request served by
+ * the calling thread. Negative when memory is released. */
+static void account(uint32_t subsystem, int64_t bytes, int64_t blocks) {
+    AllocSubsystem *s = &Subsystems[subsystem];
+    statsAdd(s->live_bytes, bytes);
+    statsAdd(s->live_blocks, blocks);
+    AllocRequest *r = Request;
+    if (r) {
+        int64_t live = atomic_fetch_add(&r->live, bytes) + bytes;
+        int64_t peak = atomic_load(&r->peak);
+        while (live > peak && !atomic_compare_exchange_weak(&r->peak, &peak, live));
+    }
+}
+
+/* Add the block to the list of its subsystem. */
+static void link_block(AllocHeader *hdr) {
+    AllocSubsystem *s = &Subsystems[hdr->h.subsystem];
+    pthread_mutex_lock(&s->lock);
+    hdr->h.prev = NULL;
+    hdr->h.next = s->blocks;
+    if (s->blocks) s->blocks->h.prev = hdr;
+    s->blocks = hdr;
+    pthread_mutex_unlock(&s->lock);
+}
+
+static void unlink_block(AllocHeader *hdr) {
+    AllocSubsystem *s = &Subsystems[hdr->h.subsystem];
+    pthread_mutex_lock(&s->lock);
+    if (hdr->h.prev) hdr->h.prev->h.next = hdr->h.next;
+    else s->blocks = hdr->h.next;
+    if (hdr->h.next) hdr->h.next->h.prev = hdr->h.prev;
+    pthread_mutex_unlock(&s->lock);
+}
+
+/* Return the header of a block, checking that it was allocated here and
+ * that nothing was written past its end. */
+static AllocHeader *block_header(void *ptr) {
+    AllocHeader *hdr = (AllocHeader *)ptr - 1;
+    if (hdr->h.magic != ALLOC_MAGIC) {
+        fprintf(stderr, "Block %p was not allocated by xmalloc(), or was "
+                        "already freed.\n", ptr);
+        abort();
+    }
+    if (memcmp((unsigned char *)ptr + hdr->h.size, Canary, sizeof(Canary)) != 0) {
+        statsAdd(Overflows, 1);
+        fprintf(stderr, "Write past the end of a %zu bytes block of %s.\n",
+                hdr->h.size, Subsystems[hdr->h.subsystem].name);
+    }
+    return hdr;
+}
+
+/* Set the header and the canary of a block of 'size' bytes, 'offset'
+ * bytes after the start of the allocation, and add it to the list of its
+ * subsystem. */
+static void *init_block(void *base, size_t offset, size_t size, uint32_t subsystem) {
+    unsigned char *p = (unsigned char *)base + offset;
+    AllocHeader *hdr = (AllocHeader *)p - 1;
+    hdr->h.size = size;
+    hdr->h.subsystem = subsystem;
+    hdr->h.offset = offset;
+    hdr->h.magic = ALLOC_MAGIC;
+    memcpy(p + size, Canary, sizeof(Canary));
+    link_block(hdr);
+    statsAdd(Subsystems[subsystem].allocs, 1);
+    statsAdd(Subsystems[subsystem].bytes, size);
+    return p;
+}
+
+/* Like malloc(), for xmalloc() when accounting is enabled. */
+void *allocMalloc(size_t size) {
+    AllocHeader *hdr = malloc(sizeof(*hdr) + size + sizeof(Canary));
+    if (!hdr) return NULL;
+    account(Subsystem, size, 1);
+    return init_block(hdr, sizeof(*hdr), size, Subsystem);
+}
+
+/* Like aligned_alloc(), for xalignedalloc() when accounting is enabled.
+ * 'alignment' must be a power of two. */
+void *allocAligned(size_t alignment, size_t size) {
+    size_t offset = sizeof(AllocHeader);
+    if (alignment > offset) offset = alignment;
+    /* The size must be a multiple of the alignment. */
+    size_t total = offset + size + sizeof(Canary);
+    total = (total + alignment - 1) / alignment * alignment;
+    void *base = aligned_alloc(alignment, total);
+    if (!base) return NULL;
+    account(Subsystem, size, 1);
+    return init_block(base, offset, size, Subsystem);
+}
+
+/* Like realloc(), for xrealloc() when accounting is enabled. The block
+ * stays charged to the subsystem that allocated it. Aligned blocks can't
+ * be reallocated. */
+void *allocRealloc(void *ptr, size_t size) {
+    if (!ptr) return allocMalloc(size);
+    AllocHeader *hdr = block_header(ptr);
+    if (hdr->h.offset != sizeof(*hdr)) {
+        fprintf(stderr, "Block %p is aligned, it can't be reallocated.\n", ptr);
+        abort();
+    }
+    size_t oldsize = hdr->h.size;
+    uint32_t subsystem = hdr->h.subsystem;
+    unlink_block(hdr);
+    AllocHeader *newhdr = realloc(hdr, sizeof(*hdr) + size + sizeof(Canary));
+    if (!newhdr) {
+        link_block(hdr);
+        return NULL;
+    }
+    account(subsystem, (int64_t)size - (int64_t)oldsize, 0);
+    return init_block(newhdr, sizeof(*newhdr), size, subsystem);
+}
+
+/* Like free(), for xfree() when accounting is enabled. */
+void allocFree(void *ptr) {
+    if (!ptr) return;
+    AllocHeader *hdr = block_header(ptr);
+    unlink_block(hdr);
+    account(hdr->h.subsystem, -(int64_t)hdr->h.size, -1);
+    hdr->h.magic = 0;
+    free((unsigned char *)ptr - hdr->h.offset);
+}
+
+/* Charge a live block to the named subsystem, or to the calling thread and
+ * its request if 'name' is NULL, as if it was freed and allocated again.
+ * For buffers that are cached and handed out again. */
+void allocCharge(void *ptr, const char *name) {
+    if (!Enabled || !ptr) return;
+    AllocHeader *hdr = block_header(ptr);
+    int subsystem = name ? subsystem_index(name) : Subsystem;
+    AllocRequest *r = Request;
+    unlink_block(hdr);
+    /* A block going to a cache is released by the request, a block coming
+     * from it is taken by the request. */
+    Request = name ? r : NULL;
+    account(hdr->h.subsystem, -(int64_t)hdr->h.size, -1);
+    hdr->h.subsystem = subsystem;
+    Request = name ? NULL : r;
+    account(subsystem, hdr->h.size, 1);
+    Request = r;
+    link_block(hdr);
+}
+
+/* Return true if allocations are accounted. */
+int allocEnabled(void) {
+    return Enabled;
+}
+
+/* Charge the allocations of the calling thread to the named subsystem.
+ * 'name' should say what the thread does, like "request". */
+void allocSetSubsystem(const char *name) {
+    if (Enabled) Subsystem = subsystem_index(name);
+}
+
+/* Charge the allocations of the calling thread to the request 'r' too,
+ * or to no request if NULL. 'r' must be zeroed before the first thread
+ * attaches it. */
+void allocRequestAttach(AllocRequest *r) {
+    if (Enabled) Request = r;
+}
+
+/* Add the peak memory of the request to the statistics, once no thread
+ * works for it anymore. */
+void allocRequestEnd(AllocRequest *r) {
+    if (!Enabled) return;
+    int64_t peak = atomic_load(&r->peak);
+    int64_t max = atomic_load(&PeakMax);
+    while (peak > max && !atomic_compare_exchange_weak(&PeakMax, &max, peak));
+    atomic_store(&PeakLast, peak);
+    atomic_fetch_add(&PeakSum, peak);
+    atomic_fetch_add(&PeakCount, 1);
+}
+
+/* Append a size in bytes, KB or MB, whichever reads best. */
+static sds cat_size(sds s, int64_t bytes) {
+    if (bytes < 1024 && bytes > -1024) return sdscatprintf(s, "%lld B", (long long)bytes);
+    if (bytes < 1024*1024 && bytes > -1024*1024) return sdscatprintf(s, "%.1f KB", bytes / 1024.0);
+    return sdscatprintf(s, "%.1f MB", bytes / (1024.0*1024));
+}
+
+/* Return a report of the memory live and allocated by every subsystem,
+ * and of the peak memory of the requests. */
+sds allocInfo(void) {
+    if (!Enabled) return sdsnew("Allocation accounting is off, start with "
+                                "--memory-accounting to enable it.");
+
+    int n = atomic_load(&NumSubsystems);
+    int64_t bytes = 0, blocks = 0;
+    sds body = sdsempty();
+    for (int j = 0; j < n; j++) {
+        AllocSubsystem *s = &Subsystems[j];
+        int64_t b = atomic_load(&s->live_bytes->value);
+        int64_t k = atomic_load(&s->live_blocks->value);
+        bytes += b;
+        blocks += k;
+        body = cat_size(sdscatprintf(body, "%s: ", s->name), b);
+        body = sdscatprintf(body, " in %lld blocks, %lld allocations, ",
+                            (long long)k, (long long)atomic_load(&s->allocs->value));
+        body = sdscat(cat_size(body, atomic_load(&s->bytes->value)), " allocated\n");
+    }
+
+    sds info = cat_size(sdsnew("Live: "), bytes);
+    info = sdscatprintf(info, " in %lld blocks\n", (long long)blocks);
+    info = sdscatsds(info, body);
+    sdsfree(body);
+    int64_t count = atomic_load(&PeakCount);
+    if (count) {
+        info = cat_size(sdscat(info, "Request peak: last "), atomic_load(&PeakLast));
+        info = cat_size(sdscat(info, ", max "), atomic_load(&PeakMax));
+        info = cat_size(sdscat(info, ", avg "), atomic_load(&PeakSum) / count);
+        info = sdscatprintf(info, ", %lld requests\n", (long long)count);
+    }
+    info = sdscatprintf(info, "Writes past the end: %lld",
+                        (long long)atomic_load(&Overflows->value));
+    return info;
+}
+
+/* ============================================================================
+ * Leak report
+ * ==========================================================================*/
+
+/* Signal handler: only wake up the report thread, that can allocate. */
+static void on_signal(int sig) {
+    unsigned char c = sig;
+    if (write(SignalPipe[1], &c, 1) != 1) _exit(1);
+}
+
+/* Copy the first bytes of the block, with the non printable ones as dots.
+ * sds strings show their header first. */
+static void preview_block(AllocHeader *hdr, char *dst) {
+    const unsigned char *p = (const unsigned char *)(hdr + 1);
+    size_t len = hdr->h.size < ALLOC_PREVIEW_LEN ? hdr->h.size : ALLOC_PREVIEW_LEN;
+    for (size_t j = 0; j < len; j++)
+        dst[j] = p[j] >= 32 && p[j] < 127 ? p[j] : '.';
+    dst[len] = '\0';
+}
+
+/* Fill 'leaks' with the 'max' largest live blocks, the largest first.
+ * Returns how many were found. Nothing is allocated while the lists are
+ * locked, since allocating would lock them again. */
+static int largest_blocks(AllocLeak *leaks, int max) {
+    int count = 0;
+    int n = atomic_load(&NumSubsystems);
+    for (int j = 0; j < n; j++) {
+        AllocSubsystem *s = &Subsystems[j];
+        pthread_mutex_lock(&s->lock);
+        for (AllocHeader *hdr = s->blocks; hdr; hdr = hdr->h.next) {
+            if (count == max && hdr->h.size <= leaks[count-1].size) continue;
+            int k = count < max ? count++ : max-1;
+            while (k > 0 && leaks[k-1].size < hdr->h.size) {
+                leaks[k] = leaks[k-1];
+                k--;
+            }
+            leaks[k].size = hdr->h.size;
+            leaks[k].subsystem = j;
+            preview_block(hdr, leaks[k].preview);
+        }
+        pthread_mutex_unlock(&s->lock);
+    }
+    return count;
+}
+
+static void *report_main(void *arg) {
+    (void)arg;
+    unsigned char sig;
+    while (read(SignalPipe[0], &sig, 1) != 1);
+    static AllocLeak leaks[ALLOC_REPORT_BLOCKS];
+    int count = largest_blocks(leaks, ALLOC_REPORT_BLOCKS);
+    sds info = allocInfo();
+    fprintf(stderr, "\nMemory still allocated at exit:\n%s\n", info);
+    if (count) fprintf(stderr, "Largest blocks:\n");
+    for (int j = 0; j < count; j++) {
+        fprintf(stderr, "  %zu bytes of %s: %s\n", leaks[j].size,
+                Subsystems[leaks[j].subsystem].name, leaks[j].preview);
+    }
+    sdsfree(info);
+    signal(sig, SIG_DFL);
+    raise(sig);
+    return NULL;
+}
+
+/* Account every allocation from now on. Must be called before anything
+ * is allocated with xmalloc(). Calling it again does nothing. */
+void allocEnable(void) {
+    if (Enabled) return;
+    for (int j = 0; j < ALLOC_MAX_SUBSYSTEMS; j++)
+        pthread_mutex_init(&Subsystems[j].lock, NULL);
+    /* The counters of the first subsystem can't be charged to it, as it
+     * doesn't exist yet. Counters are never freed, so they can be left
+     * out of the accounting. */
+    Subsystem = subsystem_index("main");
+    Overflows = statsCounter("memory_overflows_total");
+    Enabled = 1;
+
+    pthread_t tid;
+    if (pipe(SignalPipe) == -1 ||
+        pthread_create(&tid, NULL, report_main, NULL) != 0)
+    {
+        fprintf(stderr, "Can't set up the leak report at exit.\n");
+        return;
+    }
+    pthread_detach(tid);
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+}
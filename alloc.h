@@ -0,0 +1,32 @@
+#ifndef ALLOC_H
+#define ALLOC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "sds.h"
+
+#define ALLOC_MAX_SUBSYSTEMS 16     /* Names given with allocSetSubsystem(). */
+#define ALLOC_REPORT_BLOCKS 20      /* Blocks listed by the leak report. */
+#define ALLOC_PREVIEW_LEN 32        /* Bytes of a block shown in the report. */
+
+/* Memory held by a request, shared by the threads working for it. */
+typedef struct AllocRequest {
+    _Atomic int64_t live;
+    _Atomic int64_t peak;
+} AllocRequest;
+
+void allocEnable(void);
+int allocEnabled(void);
+void *allocMalloc(size_t size);
+void *allocAligned(size_t alignment, size_t size);
+void *allocRealloc(void *ptr, size_t size);
+void allocFree(void *ptr);
+void allocCharge(void *ptr, const char *name);
+void allocSetSubsystem(const char *name);
+void allocRequestAttach(AllocRequest *r);
+void allocRequestEnd(AllocRequest *r);
+sds allocInfo(void);
+
+#endif
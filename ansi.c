@@ -0,0 +1,124 @@
+/* ============================================================================
+ * Plain text from terminal output.
+ *
+ * Streaming the output of a session as text means dropping the escape
+ * sequences programs use for colors, cursor movement and titles. Unlike
+ * the emulator (vt.c) the filter keeps no screen: it is a small state
+ * machine that copies the runs of printable bytes as they are, so it is
+ * cheap enough to run on everything a session writes.
+ * ==========================================================================*/
+
+#include <stdint.h>
+
+#include "ansi.h"
+
+/* Filter states. */
+#define ANSI_GROUND 0
+#define ANSI_ESC 1          /* After ESC, or ESC and intermediate bytes. */
+#define ANSI_CSI 2          /* Control sequence, up to its final byte. */
+#define ANSI_OSC 3          /* OSC string, ends with BEL or ESC \. */
+#define ANSI_STRING 4       /* DCS, SOS, PM or APC string, ends with ESC \. */
+#define ANSI_STRING_ESC 5   /* ESC inside a string. */
+
+#define ANSI_REPLACEMENT "\xef\xbf\xbd"   /* U+FFFD as UTF-8. */
+
+/* Return true if the UTF-8 sequence 'u' of 'len' bytes, with a valid lead
+ * byte and continuation bytes, encodes a character: it is not longer than
+ * needed, and not a surrogate or past U+10FFFF. */
+static int utf8_valid(const unsigned char *u, int len) {
+    static const uint32_t min[] = {0, 0, 0x80, 0x800, 0x10000};
+    uint32_t c = u[0] & (0x7f >> len);
+    for (int j = 1; j < len; j++) c = (c << 6) | (u[j] & 0x3f);
+    return c >= min[len] && c <= 0x10ffff && (c < 0xd800 || c > 0xdfff);
+}
+
+/* Append the replacement character to 's' in place of invalid UTF-8, with
+ * 'dst' the end of the text filtered so far. Keeps room for the 'left'
+ * bytes still to filter, and updates 'dst'. Returns the new string. */
+static sds append_replacement(sds s, char **dst, size_t left) {
+    sdsIncrLen(s, *dst - (s + sdslen(s)));
+    s = sdscatlen(s, ANSI_REPLACEMENT, 3);
+    s = sdsMakeRoomFor(s, left + ANSI_UTF8_MAX);
+    *dst = s + sdslen(s);
+    return s;
+}
+
+/* Append to 's' the text in 'buf' without escape sequences and control
+ * characters, except newline, carriage return, tab and backspace, that
+ * are left to the caller. Invalid UTF-8 becomes U+FFFD, so the text can
+ * be sent as it is to APIs that reject it. Returns the new string. */
+sds ansiStrip(AnsiStrip *st, sds s, const char *buf, size_t len) {
+    /* A character split across calls is copied once complete. */
+    s = sdsMakeRoomFor(s, len + ANSI_UTF8_MAX);
+    char *dst = s + sdslen(s);
+    const unsigned char *p = (const unsigned char *)buf, *end = p + len;
+    int state = st->state;
+
+    while (p < end) {
+        unsigned char c = *p++;
+        if (st->utf8_need) {
+            if ((c & 0xc0) == 0x80) {
+                st->utf8[st->utf8_len++] = c;
+                if (st->utf8_len < st->utf8_need) continue;
+                if (utf8_valid(st->utf8, st->utf8_len)) {
+                    for (int j = 0; j < st->utf8_len; j++) *dst++ = st->utf8[j];
+                } else {
+                    s = append_replacement(s, &dst, end - p);
+                }
+                st->utf8_need = 0;
+                continue;
+            }
+            /* Truncated character: 'c' is handled on its own. */
+            s = append_replacement(s, &dst, end - p + 1);
+            st->utf8_need = 0;
+        }
+        switch (state) {
+        case ANSI_GROUND:
+            if (c >= 0x20 && c < 0x7f) {
+                /* Copy the whole ASCII run at once. */
+                *dst++ = c;
+                while (p < end && *p >= 0x20 && *p < 0x7f) *dst++ = *p++;
+            } else if (c >= 0xc2 && c <= 0xf4) {
+                /* Lead bytes: C0, C1 and F5 to FF can only start
+                 * encodings that are too long or past U+10FFFF. */
+                st->utf8[0] = c;
+                st->utf8_len = 1;
+                st->utf8_need = c >= 0xf0 ? 4 : (c >= 0xe0 ? 3 : 2);
+            } else if (c >= 0x80) {
+                s = append_replacement(s, &dst, end - p);
+            } else if (c == '\n' || c == '\r' || c == '\t' || c == '\b') {
+                *dst++ = c;
+            } else if (c == 0x1b) {
+                state = ANSI_ESC;
+            }
+            break;
+        case ANSI_ESC:
+            if (c == '[') state = ANSI_CSI;
+            else if (c == ']') state = ANSI_OSC;
+            else if (c == 'P' || c == 'X' || c == '^' || c == '_') state = ANSI_STRING;
+            else if (c < 0x20 || c > 0x2f) state = ANSI_GROUND;
+            break;
+        case ANSI_CSI:
+            if (c >= 0x40 && c <= 0x7e) state = ANSI_GROUND;
+            break;
+        case ANSI_OSC:
+            if (c == 0x07) state = ANSI_GROUND;
+            else if (c == 0x1b) state = ANSI_STRING_ESC;
+            break;
+        case ANSI_STRING:
+            if (c == 0x1b) state = ANSI_STRING_ESC;
+            break;
+        case ANSI_STRING_ESC:
+            /* ESC \ ends the string, anything else starts a new sequence. */
+            if (c == '\\') state = ANSI_GROUND;
+            else {
+                state = ANSI_ESC;
+                p--;
+            }
+            break;
+        }
+    }
+    st->state = state;
+    sdsIncrLen(s, dst - (s + sdslen(s)));
+    return s;
+}
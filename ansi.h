@@ -0,0 +1,22 @@
+#ifndef ANSI_H
+#define ANSI_H
+
+#include <stddef.h>
+
+#include "sds.h"
+
+#define ANSI_UTF8_MAX 4     /* Bytes of the longest UTF-8 character. */
+
+/* State of the filter between calls, so that sequences and UTF-8
+ * characters can be split across reads. Zero initialized is the start
+ * state. */
+typedef struct AnsiStrip {
+    int state;
+    unsigned char utf8[ANSI_UTF8_MAX]; /* UTF-8 character being checked. */
+    int utf8_len;               /* Bytes of it received so far. */
+    int utf8_need;              /* Its length, 0 if none is pending. */
+} AnsiStrip;
+
+sds ansiStrip(AnsiStrip *st, sds s, const char *buf, size_t len);
+
+#endif
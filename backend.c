@@ -0,0 +1,111 @@
+/* ============================================================================
+ * Backends registry.
+ *
+ * The bot talks to terminals only through the Backend interface, so that
+ * the same request path works with macOS windows or with shells running
+ * in our own pseudo terminals. Every implementation is listed here, the
+ * first one is the default of the platform.
+ * ==========================================================================*/
+
+#if defined(__linux__)
+#define _GNU_SOURCE
+#endif
+
+#include <stddef.h>
+#include <string.h>
+#include <strings.h>
+
+#include "backend.h"
+
+extern Backend MacOSBackend;
+extern Backend PtyBackend;
+extern Backend TmuxBackend;
+extern Backend VncBackend;
+#ifdef HAVE_X11
+extern Backend X11Backend;
+#endif
+
+static Backend *Backends[] = {
+#ifdef __APPLE__
+    &MacOSBackend,
+#endif
+    &PtyBackend,
+    &TmuxBackend,
+#ifdef HAVE_X11
+    &X11Backend,
+#endif
+    &VncBackend,
+    NULL
+};
+
+/* Return the backend with the given name, or NULL if there is none. */
+Backend *backendByName(const char *name) {
+    for (int j = 0; Backends[j]; j++) {
+        if (strcasecmp(Backends[j]->name, name) == 0) return Backends[j];
+    }
+    return NULL;
+}
+
+Backend *backendDefault(void) {
+    return Backends[0];
+}
+
+/* Known terminal applications: names on macOS, WM_CLASS names on X11. */
+static const char *TerminalApps[] = {
+    "Terminal", "iTerm2", "iTerm", "Ghostty", "kitty", "Alacritty",
+    "Hyper", "Warp", "WezTerm", "Tabby", "XTerm", "URxvt", "Konsole",
+    "Tilix", "Terminator", "st-256color", NULL
+};
+
+/* Return true if the application name is a known terminal. */
+int backendIsTerminal(const char *name) {
+    if (!name) return 0;
+    for (int i = 0; TerminalApps[i]; i++) {
+        if (strcasestr(name, TerminalApps[i])) return 1;
+    }
+    return 0;
+}
+
+/* Write to 'buf', that must have room for BACKEND_KEY_MAX bytes, the
+ * bytes a terminal sends for the key. Returns the number of bytes. */
+int backendKeyBytes(int key, uint32_t ch, int mods, unsigned char *buf) {
+    int len = 0;
+
+    if (mods & MOD_ALT) buf[len++] = 0x1b;
+    if (key == KEY_RETURN) {
+        buf[len++] = '\r';
+    } else if (key == KEY_TAB) {
+        buf[len++] = '\t';
+    } else if (key == KEY_ESCAPE) {
+        buf[len++] = 0x1b;
+    } else if ((mods & MOD_CTRL) && ch >= '@' && ch <= 'z') {
+        buf[len++] = ch & 0x1f;
+    } else if ((mods & MOD_CTRL) && ch == '?') {
+        buf[len++] = 0x7f;
+    } else if (ch < 0x80) {
+        buf[len++] = ch;
+    } else if (ch < 0x800) {
+        buf[len++] = 0xC0 | (ch >> 6);
+        buf[len++] = 0x80 | (ch & 0x3F);
+    } else if (ch < 0x10000) {
+        buf[len++] = 0xE0 | (ch >> 12);
+        buf[len++] = 0x80 | ((ch >> 6) & 0x3F);
+        buf[len++] = 0x80 | (ch & 0x3F);
+    } else {
+        buf[len++] = 0xF0 | (ch >> 18);
+        buf[len++] = 0x80 | ((ch >> 12) & 0x3F);
+        buf[len++] = 0x80 | ((ch >> 6) & 0x3F);
+        buf[len++] = 0x80 | (ch & 0x3F);
+    }
+    return len;
+}
+
+/* Return the names of the available backends, for error messages. */
+sds backendNames(void) {
+    sds names = sdsempty();
+    for (int j = 0; Backends[j]; j++) {
+        if (j) names = sdscat(names, ", ");
+        names = sdscat(names, Backends[j]->name);
+    }
+    return names;
+}
@@ -0,0 +1,87 @@
+#ifndef BACKEND_H
+#define BACKEND_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "sds.h"
+#include "frame.h"
+
+/* Keys for Backend.key(). */
+#define KEY_CHAR    0       /* The character passed as 'ch'. */
+#define KEY_RETURN  1
+#define KEY_TAB     2
+#define KEY_ESCAPE  3
+
+/* Modifiers for Backend.key(). */
+#define MOD_CTRL    (1<<0)
+#define MOD_ALT     (1<<1)
+#define MOD_CMD     (1<<2)
+
+#define BACKEND_KEY_MAX 8    /* Bytes of a key for backendKeyBytes(). */
+
+/* A terminal session the bot can connect to: a terminal window on macOS,
+ * a shell running in a pseudo terminal with the pty backend. */
+typedef struct Session {
+    uint32_t id;            /* Backend specific ID, e.g. the window ID. */
+    pid_t pid;              /* Process owning the session. */
+    char owner[128];        /* Application name, for display. */
+    char title[256];        /* Window title, for display. */
+} Session;
+
+/* A backend implements sessions on a given platform. Except for init(),
+ * list() and spawn(), methods are also called by the screenshot threads,
+ * so they must be thread safe. Methods a backend can't implement are
+ * NULL. */
+typedef struct Backend {
+    const char *name;
+    /* Initialize the backend. 'arg' is what follows the name in
+     * --backend name:arg, like the server to connect to, or NULL.
+     * Returns 0 on success, -1 on error. */
+    int (*init)(const char *arg);
+    /* Return the available sessions, setting '*count'. If 'all' is false,
+     * only terminals are listed. The array must be freed with free(). */
+    Session *(*list)(int all, int *count);
+    /* Start a new session running 'cmd', or the user shell if NULL.
+     * Returns 0 on success, -1 on error. */
+    int (*spawn)(const char *cmd);
+    /* Return true if the session still exists. May update s->id if the
+     * session moved, like a window replaced by another tab of the same
+     * application. */
+    int (*alive)(Session *s);
+    /* Capture the session, or only 'region' (x, y, width, height in
+     * percent of the session size) if not NULL. Returns NULL on error. */
+    Frame *(*capture)(uint32_t id, const double *region);
+    /* Return a number that changes whenever the screen of the session
+     * may have changed, so an unchanged session is not captured again.
+     * Returns 0 if unknown, like for a session not captured yet. */
+    uint64_t (*generation)(uint32_t id);
+    /* Prepare the session to receive keystrokes. */
+    void (*focus)(const Session *s);
+    /* Type a key: KEY_CHAR types the Unicode character 'ch'. */
+    void (*key)(const Session *s, int key, uint32_t ch, int mods);
+    /* Return the text visible in the session, or NULL if unavailable. */
+    sds (*text)(const Session *s);
+    /* Search the output of the session, scrollback included, returning
+     * the lines containing 'pattern' with some context, or NULL if
+     * unavailable. */
+    sds (*grep)(const Session *s, const char *pattern);
+    /* Return page 'page' of the output: 0 is the screen, 1 the screenful
+     * above it, and so on. Sets '*pages' to the number of pages. Returns
+     * NULL if unavailable. */
+    sds (*page)(const Session *s, int page, int *pages);
+    /* Start collecting the output of the session as plain text, or stop
+     * if 'on' is false. Returns 0 on success, -1 on error. */
+    int (*follow)(const Session *s, int on);
+    /* Return the output collected since the last call, or NULL if the
+     * session is not followed. */
+    sds (*output)(const Session *s);
+} Backend;
+
+Backend *backendByName(const char *name);
+Backend *backendDefault(void);
+sds backendNames(void);
+int backendIsTerminal(const char *name);
+int backendKeyBytes(int key, uint32_t ch, int mods, unsigned char *buf);
+
+#endif
@@ -0,0 +1,576 @@
+/* ============================================================================
+ * macOS backend: terminal application windows.
+ *
+ * Windows are enumerated and captured with Core Graphics, keystrokes are
+ * posted as keyboard events to the owning process, and the visible text
+ * is read through the Accessibility API.
+ * ==========================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <CoreGraphics/CoreGraphics.h>
+#include <CoreFoundation/CoreFoundation.h>
+#include <ApplicationServices/ApplicationServices.h>
+
+#include "backend.h"
+#include "scrollback.h"
+
+#define kVK_Return    0x24
+#define kVK_Tab       0x30
+#define kVK_Escape    0x35
+
+#define TEXT_SEARCH_DEPTH 8     /* Max depth of the AX text area search. */
+
+/* Private API to get CGWindowID from AXUIElement. */
+extern AXError _AXUIElementGetWindow(AXUIElementRef element, CGWindowID *wid);
+
+/* ============================================================================
+ * Window Functions
+ * ========================================================================= */
+
+/* Return the on screen windows, only terminals unless 'all' is true. */
+static Session *macos_list(int all, int *count) {
+    *count = 0;
+    CFArrayRef list = CGWindowListCopyWindowInfo(
+        kCGWindowListOptionOnScreenOnly | kCGWindowListExcludeDesktopElements,
+        kCGNullWindowID
+    );
+    if (!list) return NULL;
+
+    CFIndex n = CFArrayGetCount(list);
+
+    /* Allocate maximum possible size. */
+    Session *sessions = malloc((n ? n : 1) * sizeof(Session));
+    if (!sessions) {
+        CFRelease(list);
+        return NULL;
+    }
+
+    for (CFIndex i = 0; i < n; i++) {
+        CFDictionaryRef info = CFArrayGetValueAtIndex(list, i);
+
+        /* Get owner name. */
+        CFStringRef owner_ref = CFDictionaryGetValue(info, kCGWindowOwnerName);
+        if (!owner_ref) continue;
+
+        char owner[128];
+        if (!CFStringGetCString(owner_ref, owner, sizeof(owner), kCFStringEncodingUTF8))
+            continue;
+
+        /* Filter to terminals only unless in danger mode. */
+        if (!all && !backendIsTerminal(owner)) continue;
+
+        /* Get window ID and PID. */
+        CFNumberRef wid_ref = CFDictionaryGetValue(info, kCGWindowNumber);
+        CFNumberRef pid_ref = CFDictionaryGetValue(info, kCGWindowOwnerPID);
+        if (!wid_ref || !pid_ref) continue;
+
+        CGWindowID wid;
+        pid_t pid;
+        CFNumberGetValue(wid_ref, kCGWindowIDCFNumberType, &wid);
+        CFNumberGetValue(pid_ref, kCFNumberIntType, &pid);
+
+        /* Only layer 0. */
+        CFNumberRef layer_ref = CFDictionaryGetValue(info, kCGWindowLayer);
+        int layer = 0;
+        if (layer_ref) CFNumberGetValue(layer_ref, kCFNumberIntType, &layer);
+        if (layer != 0) continue;
+
+        /* Must have reasonable size. */
+        CFDictionaryRef bounds_dict = CFDictionaryGetValue(info, kCGWindowBounds);
+        if (!bounds_dict) continue;
+
+        CGRect bounds;
+        CGRectMakeWithDictionaryRepresentation(bounds_dict, &bounds);
+        if (bounds.size.width <= 50 || bounds.size.height <= 50) continue;
+
+        /* Get window title. */
+        CFStringRef title_ref = CFDictionaryGetValue(info, kCGWindowName);
+        char title[256] = "";
+        if (title_ref)
+            CFStringGetCString(title_ref, title, sizeof(title), kCFStringEncodingUTF8);
+
+        /* Add to list. */
+        Session *s = &sessions[(*count)++];
+        s->id = wid;
+        s->pid = pid;
+        strncpy(s->owner, owner, sizeof(s->owner) - 1);
+        s->owner[sizeof(s->owner) - 1] = '\0';
+        strncpy(s->title, title, sizeof(s->title) - 1);
+        s->title[sizeof(s->title) - 1] = '\0';
+    }
+
+    CFRelease(list);
+    return sessions;
+}
+
+/* Check if the window still exists on screen. If the exact window ID is
+ * gone but the same PID still has an on-screen window (tab switch),
+ * update the session to the new window. */
+static int macos_alive(Session *s) {
+    CFArrayRef list = CGWindowListCopyWindowInfo(
+        kCGWindowListOptionOnScreenOnly | kCGWindowListExcludeDesktopElements,
+        kCGNullWindowID
+    );
+    if (!list) return 0;
+
+    int found = 0;
+    CGWindowID fallback_wid = 0;
+    CFIndex count = CFArrayGetCount(list);
+    for (CFIndex i = 0; i < count; i++) {
+        CFDictionaryRef info = CFArrayGetValueAtIndex(list, i);
+        CFNumberRef wid_ref = CFDictionaryGetValue(info, kCGWindowNumber);
+        CFNumberRef pid_ref = CFDictionaryGetValue(info, kCGWindowOwnerPID);
+        if (!wid_ref || !pid_ref) continue;
+
+        CGWindowID wid;
+        pid_t pid;
+        CFNumberGetValue(wid_ref, kCGWindowIDCFNumberType, &wid);
+        CFNumberGetValue(pid_ref, kCFNumberIntType, &pid);
+
+        if (wid == s->id) {
+            found = 1;
+            break;
+        }
+
+        /* Track a fallback: another on-screen window from the same PID. */
+        if (pid == s->pid && !fallback_wid) {
+            CFNumberRef layer_ref = CFDictionaryGetValue(info, kCGWindowLayer);
+            int layer = 0;
+            if (layer_ref) CFNumberGetValue(layer_ref, kCFNumberIntType, &layer);
+            if (layer == 0) fallback_wid = wid;
+        }
+    }
+
+    /* Window gone but same app has another window — likely a tab switch. */
+    if (!found && fallback_wid) {
+        s->id = fallback_wid;
+        found = 1;
+    }
+
+    CFRelease(list);
+    return found;
+}
+
+/* ============================================================================
+ * Screenshot Functions
+ * ========================================================================= */
+
+static CGImageRef capture_window(CGWindowID wid) {
+    return CGWindowListCreateImage(CGRectNull, kCGWindowListOptionIncludingWindow, wid,
+        kCGWindowImageBoundsIgnoreFraming | kCGWindowImageNominalResolution);
+}
+
+/* Get the on screen bounds of the window. Returns 0 on success. */
+static int window_bounds(CGWindowID wid, CGRect *bounds) {
+    CFArrayRef list = CGWindowListCopyWindowInfo(kCGWindowListOptionIncludingWindow, wid);
+    if (!list) return -1;
+
+    int ret = -1;
+    if (CFArrayGetCount(list) > 0) {
+        CFDictionaryRef info = CFArrayGetValueAtIndex(list, 0);
+        CFDictionaryRef dict = CFDictionaryGetValue(info, kCGWindowBounds);
+        if (dict && CGRectMakeWithDictionaryRepresentation(dict, bounds)) ret = 0;
+    }
+    CFRelease(list);
+    return ret;
+}
+
+/* Capture only a region of the window, expressed as percentages of the
+ * window size. The region is cropped by the window server itself, so we
+ * don't pay for drawing and converting the rest of the window. */
+static CGImageRef capture_window_region(CGWindowID wid, const double *region) {
+    CGRect b;
+    if (window_bounds(wid, &b) != 0) return NULL;
+    CGRect rect = CGRectMake(b.origin.x + b.size.width * region[0] / 100,
+                             b.origin.y + b.size.height * region[1] / 100,
+                             b.size.width * region[2] / 100,
+                             b.size.height * region[3] / 100);
+    return CGWindowListCreateImage(rect, kCGWindowListOptionIncludingWindow, wid,
+        kCGWindowImageNominalResolution);
+}
+
+/* Draw the captured image into a BGRA frame, so that we can encode it
+ * ourselves instead of relying on the ImageIO generic PNG encoder. */
+static Frame *frame_from_image(CGImageRef img) {
+    Frame *f = frameCreate(CGImageGetWidth(img), CGImageGetHeight(img));
+    CGColorSpaceRef cs = CGColorSpaceCreateWithName(kCGColorSpaceSRGB);
+    CGContextRef ctx = CGBitmapContextCreate(f->pixels, f->width, f->height,
+        8, f->stride, cs, kCGImageAlphaPremultipliedFirst | kCGBitmapByteOrder32Little);
+    CGColorSpaceRelease(cs);
+    if (!ctx) {
+        frameFree(f);
+        return NULL;
+    }
+    CGContextSetBlendMode(ctx, kCGBlendModeCopy);
+    CGContextDrawImage(ctx, CGRectMake(0, 0, f->width, f->height), img);
+    CGContextRelease(ctx);
+    return f;
+}
+
+static Frame *macos_capture(uint32_t id, const double *region) {
+    CGImageRef img = region ? capture_window_region(id, region) : capture_window(id);
+    if (!img) return NULL;
+    Frame *f = frame_from_image(img);
+    CGImageRelease(img);
+    return f;
+}
+
+/* ============================================================================
+ * Keystroke Functions
+ * ========================================================================= */
+
+/* Bring app to front. */
+static int bring_to_front(pid_t pid) {
+    ProcessSerialNumber psn;
+    if (GetProcessForPID(pid, &psn) != noErr) return -1;
+    if (SetFrontProcessWithOptions(&psn, kSetFrontProcessFrontWindowOnly) != noErr) return -1;
+    usleep(100000);
+    return 0;
+}
+
+/* Return the Accessibility element of the window matching CGWindowID, or
+ * NULL if not found. The caller must release it. */
+static AXUIElementRef copy_ax_window(pid_t pid, CGWindowID target_wid) {
+    AXUIElementRef app = AXUIElementCreateApplication(pid);
+    if (!app) return NULL;
+
+    CFArrayRef windows = NULL;
+    AXUIElementCopyAttributeValue(app, kAXWindowsAttribute, (CFTypeRef *)&windows);
+    CFRelease(app);
+
+    if (!windows) return NULL;
+
+    AXUIElementRef found = NULL;
+    CFIndex count = CFArrayGetCount(windows);
+    for (CFIndex i = 0; i < count; i++) {
+        AXUIElementRef win = (AXUIElementRef)CFArrayGetValueAtIndex(windows, i);
+
+        CGWindowID wid = 0;
+        if (_AXUIElementGetWindow(win, &wid) == kAXErrorSuccess) {
+            if (wid == target_wid) {
+                found = (AXUIElementRef)CFRetain(win);
+                break;
+            }
+        }
+    }
+
+    CFRelease(windows);
+    return found;
+}
+
+/* Raise the specific window by matching CGWindowID via Accessibility API,
+ * and bring its application to front. */
+static void macos_focus(const Session *s) {
+    AXUIElementRef win = copy_ax_window(s->pid, s->id);
+    if (win) {
+        AXUIElementPerformAction(win, kAXRaiseAction);
+        CFRelease(win);
+    }
+    bring_to_front(s->pid);
+}
+
+/* Map ASCII character to macOS virtual keycode (US keyboard layout). */
+static CGKeyCode keycode_for_char(uint32_t c) {
+    /* Letters a-z (same codes for upper/lowercase). */
+    static const CGKeyCode letter_map[26] = {
+        0x00,0x0B,0x08,0x02,0x0E,0x03,0x05,0x04,0x22,0x26, /* a-j */
+        0x28,0x25,0x2E,0x2D,0x1F,0x23,0x0C,0x0F,0x01,0x11, /* k-t */
+        0x20,0x09,0x0D,0x07,0x10,0x06                       /* u-z */
+    };
+    /* Digits 0-9. */
+    static const CGKeyCode digit_map[10] = {
+        0x1D,0x12,0x13,0x14,0x15,0x17,0x16,0x1A,0x1C,0x19  /* 0-9 */
+    };
+    /* Punctuation / symbols. */
+    if (c >= 'a' && c <= 'z') return letter_map[c - 'a'];
+    if (c >= 'A' && c <= 'Z') return letter_map[c - 'A'];
+    if (c >= '0' && c <= '9') return digit_map[c - '0'];
+    switch (c) {
+        case '-':  return 0x1B;  case '=':  return 0x18;
+        case '[':  return 0x21;  case ']':  return 0x1E;
+        case '\\': return 0x2A;  case ';':  return 0x29;
+        case '\'': return 0x27;  case ',':  return 0x2B;
+        case '.':  return 0x2F;  case '/':  return 0x2C;
+        case '`':  return 0x32;  case ' ':  return 0x31;
+    }
+    return 0xFFFF; /* Unknown. */
+}
+
+static void macos_key(const Session *s, int key, uint32_t ch, int mods) {
+    CGKeyCode keycode = 0;
+    if (key == KEY_RETURN) keycode = kVK_Return;
+    else if (key == KEY_TAB) keycode = kVK_Tab;
+    else if (key == KEY_ESCAPE) keycode = kVK_Escape;
+    if (key != KEY_CHAR) ch = 0;
+
+    /* When modifiers are active and we have a character, use the
+     * correct virtual keycode so the system sends the right combo. */
+    int mapped_keycode = 0;
+    if (ch && mods) {
+        CGKeyCode mapped = keycode_for_char(ch);
+        if (mapped != 0xFFFF) {
+            keycode = mapped;
+            mapped_keycode = 1;
+        }
+    }
+
+    CGEventRef down = CGEventCreateKeyboardEvent(NULL, keycode, true);
+    CGEventRef up = CGEventCreateKeyboardEvent(NULL, keycode, false);
+    if (!down || !up) {
+        if (down) CFRelease(down);
+        if (up) CFRelease(up);
+        return;
+    }
+
+    CGEventFlags flags = 0;
+    if (mods & MOD_CTRL) flags |= kCGEventFlagMaskControl;
+    if (mods & MOD_ALT)  flags |= kCGEventFlagMaskAlternate;
+    if (mods & MOD_CMD)  flags |= kCGEventFlagMaskCommand;
+
+    if (flags) {
+        CGEventSetFlags(down, flags);
+        CGEventSetFlags(up, flags);
+    }
+
+    /* When we have a mapped keycode with modifiers, let the system
+     * derive the character from keycode + flags. Otherwise set it, as
+     * a surrogate pair outside the BMP. */
+    if (ch && !mapped_keycode) {
+        UniChar u[2];
+        int len = 1;
+        if (ch > 0xFFFF) {
+            ch -= 0x10000;
+            u[0] = 0xD800 + (ch >> 10);
+            u[1] = 0xDC00 + (ch & 0x3FF);
+            len = 2;
+        } else {
+            u[0] = ch;
+        }
+        CGEventKeyboardSetUnicodeString(down, len, u);
+        CGEventKeyboardSetUnicodeString(up, len, u);
+    }
+
+    CGEventPostToPid(s->pid, down);
+    usleep(1000);
+    CGEventPostToPid(s->pid, up);
+    usleep(5000);
+
+    CFRelease(down);
+    CFRelease(up);
+}
+
+/* ============================================================================
+ * Text Functions
+ * ========================================================================= */
+
+/* Terminal apps expose their screen to the Accessibility API as a text
+ * area, so we can read the visible text without any screenshot. */
+
+/* Return a new sds string with the UTF-8 content of 'str'. */
+static sds sds_from_cfstring(CFStringRef str) {
+    CFIndex len = CFStringGetLength(str);
+    CFIndex max = CFStringGetMaximumSizeForEncoding(len, kCFStringEncodingUTF8) + 1;
+    sds s = sdsnewlen(NULL, max);
+    if (!CFStringGetCString(str, s, max, kCFStringEncodingUTF8)) s[0] = '\0';
+    sdsupdatelen(s);
+    return s;
+}
+
+/* Depth first search of the first text area under 'elem'. Returns a
+ * retained element, or NULL. */
+static AXUIElementRef copy_ax_text_area(AXUIElementRef elem, int depth) {
+    CFStringRef role = NULL;
+    AXUIElementCopyAttributeValue(elem, kAXRoleAttribute, (CFTypeRef *)&role);
+    if (role) {
+        int match = CFStringCompare(role, kAXTextAreaRole, 0) == kCFCompareEqualTo;
+        CFRelease(role);
+        if (match) return (AXUIElementRef)CFRetain(elem);
+    }
+    if (depth == 0) return NULL;
+
+    CFArrayRef children = NULL;
+    AXUIElementCopyAttributeValue(elem, kAXChildrenAttribute, (CFTypeRef *)&children);
+    if (!children) return NULL;
+    AXUIElementRef found = NULL;
+    CFIndex count = CFArrayGetCount(children);
+    for (CFIndex i = 0; i < count && !found; i++) {
+        AXUIElementRef child = (AXUIElementRef)CFArrayGetValueAtIndex(children, i);
+        found = copy_ax_text_area(child, depth-1);
+    }
+    CFRelease(children);
+    return found;
+}
+
+/* Return the retained text area of the session window, or NULL. */
+static AXUIElementRef copy_session_text_area(const Session *s) {
+    AXUIElementRef win = copy_ax_window(s->pid, s->id);
+    if (!win) return NULL;
+    AXUIElementRef area = copy_ax_text_area(win, TEXT_SEARCH_DEPTH);
+    CFRelease(win);
+    return area;
+}
+
+/* Return the text visible in the window, or NULL if the window doesn't
+ * expose it. We ask for the visible character range only, since the text
+ * area value may hold the whole scrollback. */
+static sds macos_text(const Session *s) {
+    AXUIElementRef area = copy_session_text_area(s);
+    if (!area) return NULL;
+
+    CFTypeRef str = NULL;
+    AXValueRef range = NULL;
+    AXUIElementCopyAttributeValue(area, kAXVisibleCharacterRangeAttribute,
+                                  (CFTypeRef *)&range);
+    if (range) {
+        AXUIElementCopyParameterizedAttributeValue(area,
+            kAXStringForRangeParameterizedAttribute, range, &str);
+        CFRelease(range);
+    }
+    if (!str) AXUIElementCopyAttributeValue(area, kAXValueAttribute, &str);
+    CFRelease(area);
+    if (!str) return NULL;
+
+    sds text = NULL;
+    if (CFGetTypeID(str) == CFStringGetTypeID()) text = sds_from_cfstring((CFStringRef)str);
+    CFRelease(str);
+    return text;
+}
+
+/* The text area value holds the scrollback followed by the screen. To
+ * search or page it, it is loaded in a scrollback, capped like the ones of
+ * the emulated sessions, with the lines of the visible range as the
+ * screen. Loading a long scrollback is slow, and paging asks for the same
+ * text again and again: the last one loaded is kept until the value of
+ * the text area changes, or another window is asked for. */
+typedef struct MacHistory {
+    uint32_t wid;               /* Window, 0 if nothing is loaded. */
+    CFStringRef value;          /* Text area value loaded. */
+    CFRange visible;            /* Its visible range, length -1 if unknown. */
+    Scrollback *sb;             /* Lines above the screen. */
+    sds *screen;                /* Lines of the screen. */
+    int rows;
+} MacHistory;
+
+static MacHistory History;
+static pthread_mutex_t HistoryLock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Return the number of lines of 's'. */
+static int count_lines(sds s) {
+    int lines = 1;
+    for (const char *p = s, *end = s + sdslen(s);
+         (p = memchr(p, '\n', end - p)) != NULL; p++) lines++;
+    return lines;
+}
+
+/* Drop the loaded history. Must be called with HistoryLock held. */
+static void history_clear(void) {
+    if (History.value) CFRelease(History.value);
+    scrollbackFree(History.sb);
+    for (int j = 0; j < History.rows; j++) sdsfree(History.screen[j]);
+    free(History.screen);
+    memset(&History, 0, sizeof(History));
+}
+
+/* Load the text area 'value' of window 'wid' in the history. Must be
+ * called with HistoryLock held. */
+static void history_load(uint32_t wid, CFStringRef value, CFRange visible) {
+    history_clear();
+    sds all = sds_from_cfstring(value);
+    int count = count_lines(all);
+    int rows = count;
+    if (visible.length >= 0 &&
+        visible.location + visible.length <= CFStringGetLength(value))
+    {
+        CFStringRef str = CFStringCreateWithSubstring(NULL, value, visible);
+        sds screen = sds_from_cfstring(str);
+        CFRelease(str);
+        rows = count_lines(screen);
+        if (rows > count) rows = count;
+        sdsfree(screen);
+    }
+
+    History.wid = wid;
+    History.value = (CFStringRef)CFRetain(value);
+    History.visible = visible;
+    History.sb = scrollbackCreate(SCROLLBACK_MAX_SIZE, SCROLLBACK_MAX_LINES);
+    History.screen = malloc(sizeof(sds) * rows);
+    History.rows = rows;
+    const char *p = all, *end = all + sdslen(all);
+    for (int j = 0; j < count; j++) {
+        const char *nl = memchr(p, '\n', end - p);
+        size_t len = (nl ? nl : end) - p;
+        if (j < count-rows) scrollbackAppend(History.sb, p, len);
+        else History.screen[j-(count-rows)] = sdsnewlen(p, len);
+        p = nl ? nl+1 : end;
+    }
+    sdsfree(all);
+}
+
+/* Search the history of the window for 'pattern' if not NULL, or return
+ * page 'page'. The text area is read once, with its visible range. */
+static sds macos_history(const Session *s, const char *pattern, int page, int *pages) {
+    AXUIElementRef area = copy_session_text_area(s);
+    if (!area) return NULL;
+    CFTypeRef value = NULL;
+    AXValueRef range = NULL;
+    AXUIElementCopyAttributeValue(area, kAXValueAttribute, &value);
+    AXUIElementCopyAttributeValue(area, kAXVisibleCharacterRangeAttribute,
+                                  (CFTypeRef *)&range);
+    CFRelease(area);
+    CFRange visible = CFRangeMake(0, -1);
+    if (range) {
+        if (!AXValueGetValue(range, kAXValueTypeCFRange, &visible))
+            visible = CFRangeMake(0, -1);
+        CFRelease(range);
+    }
+    if (!value) return NULL;
+    if (CFGetTypeID(value) != CFStringGetTypeID()) {
+        CFRelease(value);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&HistoryLock);
+    if (History.wid != s->id || !History.value ||
+        !CFEqual(History.value, value) ||
+        History.visible.location != visible.location ||
+        History.visible.length != visible.length)
+    {
+        history_load(s->id, (CFStringRef)value, visible);
+    }
+    sds text = pattern ?
+        scrollbackGrep(History.sb, History.screen, History.rows, pattern) :
+        scrollbackPage(History.sb, History.screen, History.rows, page, pages);
+    pthread_mutex_unlock(&HistoryLock);
+    CFRelease(value);
+    return text;
+}
+
+static sds macos_grep(const Session *s, const char *pattern) {
+    return macos_history(s, pattern, 0, NULL);
+}
+
+static sds macos_page(const Session *s, int page, int *pages) {
+    return macos_history(s, NULL, page, pages);
+}
+
+Backend MacOSBackend = {
+    .name = "macos",
+    .init = NULL,
+    .list = macos_list,
+    .spawn = NULL,
+    .alive = macos_alive,
+    .capture = macos_capture,
+    .generation = NULL,
+    .focus = macos_focus,
+    .key = macos_key,
+    .text = macos_text,
+    .grep = macos_grep,
+    .page = macos_page,
+    .follow = NULL,
+    .output = NULL,
+};
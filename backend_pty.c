@@ -0,0 +1,377 @@
+/* ============================================================================
+ * Pseudo terminal backend: shells owned by the bot.
+ *
+ * Instead of attaching to the windows of a terminal application, the bot
+ * spawns shells in pseudo terminals it owns, so it can drive headless
+ * servers too. A single reader thread collects the output of all the
+ * sessions and feeds it to a terminal view (termview.c) per session, that
+ * emulates the screen and draws text snapshots and screenshots from it.
+ * ==========================================================================*/
+
+#if defined(__linux__)
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+
+#include "backend.h"
+#include "termview.h"
+
+#define PTY_MAX_SESSIONS 16
+#define PTY_ROWS 40                     /* Terminal size of the sessions. */
+#define PTY_COLS 120
+#define PTY_TERM "xterm-256color"       /* TERM of the sessions. */
+#define PTY_MAX_PENDING (64*1024)       /* Max input queued per session. */
+
+typedef struct PtySession {
+    uint32_t id;                        /* 0 if the slot is free. */
+    int fd;                             /* Master side, -1 once exited. */
+    pid_t pid;
+    char owner[128];                    /* Command name. */
+    char title[256];                    /* Slave device name. */
+    TermView *view;                     /* Screen of the session. */
+    uint64_t generation;                /* Incremented on output. */
+    sds pending;                        /* Input the program didn't read
+                                           yet, written by the reader. */
+} PtySession;
+
+static PtySession Sessions[PTY_MAX_SESSIONS];
+static uint32_t NextId = 1;
+static int WakePipe[2];                 /* Wakes the reader on new sessions. */
+static pthread_mutex_t PtyLock = PTHREAD_MUTEX_INITIALIZER; /* Protects
+                                           the sessions. */
+
+/* Return the session with the given ID, or NULL. Must be called with
+ * PtyLock held. */
+static PtySession *pty_lookup(uint32_t id) {
+    for (int j = 0; j < PTY_MAX_SESSIONS; j++) {
+        if (Sessions[j].id && Sessions[j].id == id) return &Sessions[j];
+    }
+    return NULL;
+}
+
+/* Write as much of the pending input as the master accepts without
+ * blocking. Must be called with PtyLock held. */
+static void pty_flush(PtySession *ps) {
+    size_t len = sdslen(ps->pending);
+    if (len == 0) return;
+    ssize_t nwritten = write(ps->fd, ps->pending, len);
+    if (nwritten == -1) {
+        if (errno == EAGAIN || errno == EINTR) return;
+        /* The terminal is gone: the reader will notice. */
+        nwritten = len;
+    }
+    sdsrange(ps->pending, nwritten, -1);
+}
+
+/* Queue input for the program in the session and try to write it. What
+ * the master doesn't accept now is written by the reader once it can: a
+ * program that stops reading its input can't block the bot. Returns 1 if
+ * input is left pending. Must be called with PtyLock held. */
+static int pty_write(PtySession *ps, const void *buf, size_t len) {
+    if (ps->fd == -1) return 0;
+    /* Past the limit input is dropped, like the terminal driver does
+     * when its own buffer is full. */
+    if (sdslen(ps->pending) + len > PTY_MAX_PENDING) return 1;
+    ps->pending = sdscatlen(ps->pending, buf, len);
+    pty_flush(ps);
+    return sdslen(ps->pending) != 0;
+}
+
+/* Wake the reader, so it polls the sessions again. The pipe is non
+ * blocking: if it is full, the reader is awake already. */
+static void pty_wake(void) {
+    if (write(WakePipe[1], "x", 1) == -1 && errno != EAGAIN) perror("write");
+}
+
+/* Feed output to the terminal of the session, and write back its answers
+ * to queries like the cursor position. Must be called with PtyLock held. */
+static void pty_feed(PtySession *ps, const char *buf, size_t len) {
+    VtScreen *vt = ps->view->vt;
+    termViewWrite(ps->view, buf, len);
+    ps->generation++;
+    if (vt->replylen) {
+        pty_write(ps, vt->reply, vt->replylen);
+        vt->replylen = 0;
+    }
+}
+
+/* Reader thread: wait for output from any session, and for the sessions
+ * with pending input to accept it. When the terminal is closed the master
+ * returns EOF or EIO, and the session is marked as exited. The process is
+ * reaped later by pty_list(): it may still be running, if it moved away
+ * from the terminal. */
+static void *pty_reader(void *arg) {
+    (void)arg;
+    while (1) {
+        struct pollfd fds[PTY_MAX_SESSIONS+1];
+        uint32_t ids[PTY_MAX_SESSIONS+1];
+        int n = 0;
+        fds[n].fd = WakePipe[0];
+        fds[n++].events = POLLIN;
+        pthread_mutex_lock(&PtyLock);
+        for (int j = 0; j < PTY_MAX_SESSIONS; j++) {
+            if (!Sessions[j].id || Sessions[j].fd == -1) continue;
+            ids[n] = Sessions[j].id;
+            fds[n].fd = Sessions[j].fd;
+            fds[n++].events = POLLIN |
+                (sdslen(Sessions[j].pending) ? POLLOUT : 0);
+        }
+        pthread_mutex_unlock(&PtyLock);
+
+        if (poll(fds, n, -1) == -1) {
+            if (errno == EINTR) continue;
+            perror("poll");
+            return NULL;
+        }
+
+        char buf[4096];
+        if (fds[0].revents) {
+            if (read(WakePipe[0], buf, sizeof(buf)) == -1) continue;
+        }
+        for (int j = 1; j < n; j++) {
+            if (!fds[j].revents) continue;
+            /* Sessions are only released after exiting, and only this
+             * thread marks them as exited, so the lookup can't fail. */
+            if (fds[j].revents & POLLOUT) {
+                pthread_mutex_lock(&PtyLock);
+                pty_flush(pty_lookup(ids[j]));
+                pthread_mutex_unlock(&PtyLock);
+            }
+            if (!(fds[j].revents & (POLLIN|POLLHUP|POLLERR))) continue;
+            ssize_t nread = read(fds[j].fd, buf, sizeof(buf));
+            if (nread == -1 && (errno == EINTR || errno == EAGAIN)) continue;
+
+            pthread_mutex_lock(&PtyLock);
+            PtySession *ps = pty_lookup(ids[j]);
+            if (nread > 0) {
+                pty_feed(ps, buf, nread);
+            } else {
+                close(ps->fd);
+                ps->fd = -1;
+                sdsclear(ps->pending);
+            }
+            pthread_mutex_unlock(&PtyLock);
+        }
+    }
+    return NULL;
+}
+
+static int pty_init(const char *arg) {
+    (void)arg;
+    if (pipe(WakePipe) == -1) return -1;
+    fcntl(WakePipe[0], F_SETFD, FD_CLOEXEC);
+    fcntl(WakePipe[1], F_SETFD, FD_CLOEXEC);
+    fcntl(WakePipe[1], F_SETFL, O_NONBLOCK);
+
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, pty_reader, NULL) != 0) return -1;
+    pthread_detach(tid);
+    return 0;
+}
+
+/* Start 'cmd' with 'sh -c', or the user shell if NULL, in a new pseudo
+ * terminal. */
+static int pty_spawn(const char *cmd) {
+    pthread_mutex_lock(&PtyLock);
+    PtySession *ps = NULL;
+    for (int j = 0; j < PTY_MAX_SESSIONS && !ps; j++) {
+        if (!Sessions[j].id) ps = &Sessions[j];
+    }
+    pthread_mutex_unlock(&PtyLock);
+    if (!ps) return -1;
+
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master == -1) return -1;
+    char *slave = NULL;
+    if (grantpt(master) == -1 || unlockpt(master) == -1 ||
+        (slave = ptsname(master)) == NULL)
+    {
+        close(master);
+        return -1;
+    }
+    fcntl(master, F_SETFD, FD_CLOEXEC);
+    fcntl(master, F_SETFL, O_NONBLOCK);
+    struct winsize ws = {.ws_row = PTY_ROWS, .ws_col = PTY_COLS};
+    ioctl(master, TIOCSWINSZ, &ws);
+
+    const char *shell = getenv("SHELL");
+    if (!shell || !shell[0]) shell = "/bin/sh";
+
+    pid_t pid = fork();
+    if (pid == -1) {
+        close(master);
+        return -1;
+    }
+    if (pid == 0) {
+        /* Child: the slave becomes the controlling terminal of a new
+         * session, and our standard input and output. */
+        setsid();
+        int fd = open(slave, O_RDWR);
+        if (fd == -1) _exit(127);
+        ioctl(fd, TIOCSCTTY, 0);
+        dup2(fd, 0);
+        dup2(fd, 1);
+        dup2(fd, 2);
+        if (fd > 2) close(fd);
+        setenv("TERM", PTY_TERM, 1);
+        if (cmd) execl("/bin/sh", "sh", "-c", cmd, (char*)NULL);
+        else execl(shell, shell, (char*)NULL);
+        _exit(127);
+    }
+
+    pthread_mutex_lock(&PtyLock);
+    ps->id = NextId++;
+    ps->fd = master;
+    ps->pid = pid;
+    const char *name = cmd ? cmd : shell;
+    const char *slash = cmd ? NULL : strrchr(shell, '/');
+    snprintf(ps->owner, sizeof(ps->owner), "%s", slash ? slash+1 : name);
+    snprintf(ps->title, sizeof(ps->title), "%s", slave);
+    ps->view = termViewCreate(PTY_ROWS, PTY_COLS);
+    ps->generation = 1;
+    ps->pending = sdsempty();
+    pthread_mutex_unlock(&PtyLock);
+
+    pty_wake();
+    return 0;
+}
+
+/* List the sessions, releasing the ones whose shell exited. */
+static Session *pty_list(int all, int *count) {
+    (void)all;
+    Session *sessions = malloc(sizeof(Session) * PTY_MAX_SESSIONS);
+    *count = 0;
+    if (!sessions) return NULL;
+
+    pthread_mutex_lock(&PtyLock);
+    for (int j = 0; j < PTY_MAX_SESSIONS; j++) {
+        PtySession *ps = &Sessions[j];
+        if (!ps->id) continue;
+        if (ps->fd == -1) {
+            /* Keep the slot until the process can be reaped, without
+             * waiting for it. */
+            if (waitpid(ps->pid, NULL, WNOHANG) == 0) continue;
+            termViewFree(ps->view);
+            sdsfree(ps->pending);
+            ps->id = 0;
+            continue;
+        }
+        Session *s = &sessions[(*count)++];
+        s->id = ps->id;
+        s->pid = ps->pid;
+        memcpy(s->owner, ps->owner, sizeof(s->owner));
+        /* Prefer the title set by the program, like the current directory
+         * many shells show. */
+        const VtScreen *vt = ps->view->vt;
+        const char *title = vt->title[0] ? vt->title : ps->title;
+        snprintf(s->title, sizeof(s->title), "%s", title);
+    }
+    pthread_mutex_unlock(&PtyLock);
+    return sessions;
+}
+
+static int pty_alive(Session *s) {
+    pthread_mutex_lock(&PtyLock);
+    PtySession *ps = pty_lookup(s->id);
+    int alive = ps && ps->fd != -1;
+    pthread_mutex_unlock(&PtyLock);
+    return alive;
+}
+
+static void pty_key(const Session *s, int key, uint32_t ch, int mods) {
+    unsigned char buf[BACKEND_KEY_MAX];
+    int len = backendKeyBytes(key, ch, mods, buf);
+    pthread_mutex_lock(&PtyLock);
+    PtySession *ps = pty_lookup(s->id);
+    int pending = ps && pty_write(ps, buf, len);
+    pthread_mutex_unlock(&PtyLock);
+    if (pending) pty_wake();
+}
+
+static sds pty_text(const Session *s) {
+    pthread_mutex_lock(&PtyLock);
+    PtySession *ps = pty_lookup(s->id);
+    sds text = ps ? termViewText(ps->view) : NULL;
+    pthread_mutex_unlock(&PtyLock);
+    return text;
+}
+
+static Frame *pty_capture(uint32_t id, const double *region) {
+    pthread_mutex_lock(&PtyLock);
+    PtySession *ps = pty_lookup(id);
+    Frame *f = ps ? termViewCapture(ps->view, region) : NULL;
+    pthread_mutex_unlock(&PtyLock);
+    return f;
+}
+
+static uint64_t pty_generation(uint32_t id) {
+    pthread_mutex_lock(&PtyLock);
+    PtySession *ps = pty_lookup(id);
+    uint64_t generation = ps ? ps->generation : 0;
+    pthread_mutex_unlock(&PtyLock);
+    return generation;
+}
+
+static sds pty_grep(const Session *s, const char *pattern) {
+    pthread_mutex_lock(&PtyLock);
+    PtySession *ps = pty_lookup(s->id);
+    sds text = ps ? termViewGrep(ps->view, pattern) : NULL;
+    pthread_mutex_unlock(&PtyLock);
+    return text;
+}
+
+static sds pty_page(const Session *s, int page, int *pages) {
+    pthread_mutex_lock(&PtyLock);
+    PtySession *ps = pty_lookup(s->id);
+    sds text = ps ? termViewPage(ps->view, page, pages) : NULL;
+    pthread_mutex_unlock(&PtyLock);
+    return text;
+}
+
+static int pty_follow(const Session *s, int on) {
+    pthread_mutex_lock(&PtyLock);
+    PtySession *ps = pty_lookup(s->id);
+    if (ps) termViewFollow(ps->view, on);
+    pthread_mutex_unlock(&PtyLock);
+    return ps ? 0 : -1;
+}
+
+/* Once the shell exited, the output ends with the last text collected. */
+static sds pty_new_output(const Session *s) {
+    pthread_mutex_lock(&PtyLock);
+    PtySession *ps = pty_lookup(s->id);
+    sds text = ps ? termViewOutput(ps->view) : NULL;
+    if (text && ps->fd == -1 && sdslen(text) == 0) {
+        sdsfree(text);
+        text = NULL;
+    }
+    pthread_mutex_unlock(&PtyLock);
+    return text;
+}
+
+Backend PtyBackend = {
+    .name = "pty",
+    .init = pty_init,
+    .list = pty_list,
+    .spawn = pty_spawn,
+    .alive = pty_alive,
+    .capture = pty_capture,
+    .generation = pty_generation,
+    .focus = NULL,
+    .key = pty_key,
+    .text = pty_text,
+    .grep = pty_grep,
+    .page = pty_page,
+    .follow = pty_follow,
+    .output = pty_new_output,
+};
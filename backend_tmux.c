@@ -0,0 +1,649 @@
+/* ============================================================================
+ * tmux backend: the panes of a running tmux server.
+ *
+ * The bot attaches to the server as a control mode client (tmux -C, the
+ * protocol of -CC without the terminal setup, that we don't need over
+ * pipes). Commands are written as lines, and tmux answers every one with
+ * a block of lines between %begin and %end (or %error). Between blocks it
+ * sends notifications: %output carries everything a pane writes, so a
+ * terminal view per pane (termview.c) keeps a copy of the screen without
+ * polling, and screenshots and text come from it. A pane is synced with
+ * capture-pane when first listed and after layout changes, from then on
+ * %output alone keeps it current.
+ *
+ * A single reader thread parses what tmux writes. Commands don't wait for
+ * their answer unless the caller needs it: the answers arrive in order, so
+ * a queue of callbacks, run by the reader, matches them to the commands.
+ * ==========================================================================*/
+
+#if defined(__linux__)
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/wait.h>
+
+#include "backend.h"
+#include "termview.h"
+
+#define TMUX_MAX_PANES 64
+#define TMUX_MAX_PENDING 256    /* Commands sent and not yet answered. Keeps
+                                   the commands in flight well under the pipe
+                                   buffer, so writing them never blocks. */
+
+/* Format of list-panes: pane ID, pid, command, and a title for display. */
+#define TMUX_LIST_FORMAT "#{pane_id} #{pane_pid} #{pane_current_command} " \
+                         "#{session_name}:#{window_index}.#{pane_index} #{pane_title}"
+
+/* Called by the reader thread, with TmuxLock held, with the output of a
+ * command as lines separated by newlines. 'error' is true for %error. */
+typedef void TmuxCallback(sds reply, int error, void *privdata);
+
+typedef struct TmuxPending {
+    TmuxCallback *cb;           /* NULL if nobody waits for the answer. */
+    void *privdata;
+} TmuxPending;
+
+typedef struct TmuxPane {
+    uint32_t id;                /* N of the %N tmux pane ID. */
+    int used;                   /* 0 if the slot is free. */
+    TermView *view;             /* NULL until the first sync. */
+    int syncs;                  /* Syncs sent and not applied yet. */
+    int stale;                  /* Must be synced again, see tmux_line(). */
+    uint64_t generation;        /* Incremented on output and syncs. */
+} TmuxPane;
+
+/* State of a pane sync, that takes the answers of three commands. */
+typedef struct TmuxSync {
+    uint32_t id;
+    int answers;                /* Answers received so far. */
+    int error;
+    sds info;                   /* Size, cursor and alternate screen flag. */
+    sds main;                   /* Main screen while in the alternate one. */
+} TmuxSync;
+
+static int TmuxIn = -1, TmuxOut = -1;   /* Pipes to and from tmux. */
+static pid_t TmuxPid;
+static int TmuxAttached;                /* False once tmux exited. */
+static TmuxPane Panes[TMUX_MAX_PANES];
+static TmuxPending Pending[TMUX_MAX_PENDING]; /* Circular queue. */
+static int PendingHead, PendingCount;
+static pthread_mutex_t TmuxLock = PTHREAD_MUTEX_INITIALIZER; /* Protects
+                                           all the above. */
+static pthread_cond_t TmuxCond = PTHREAD_COND_INITIALIZER;  /* Signaled
+                                           after every answer. */
+
+/* ============================================================================
+ * Commands
+ * ==========================================================================*/
+
+/* Append 'arg' to 's' quoted for the tmux command parser, that follows the
+ * shell rules for single quotes. */
+static sds tmux_quote(sds s, const char *arg) {
+    s = sdscatlen(s, "'", 1);
+    for (const char *p = arg; *p; p++) {
+        if (*p == '\'') s = sdscat(s, "'\"'\"'");
+        else s = sdscatlen(s, p, 1);
+    }
+    return sdscatlen(s, "'", 1);
+}
+
+/* Send a command line producing 'answers' answers, one per command, calling
+ * 'cb' for each. Must be called with TmuxLock held. Returns -1 if tmux is
+ * gone, in which case 'cb' is never called. */
+static int tmux_send(const char *line, int answers, TmuxCallback *cb,
+                     void *privdata)
+{
+    while (TmuxAttached && PendingCount + answers > TMUX_MAX_PENDING)
+        pthread_cond_wait(&TmuxCond, &TmuxLock);
+    if (!TmuxAttached) return -1;
+
+    sds buf = sdscatlen(sdsnew(line), "\n", 1);
+    size_t off = 0;
+    while (off < sdslen(buf)) {
+        ssize_t n = write(TmuxIn, buf + off, sdslen(buf) - off);
+        if (n == -1 && errno == EINTR) continue;
+        if (n == -1) {
+            sdsfree(buf);
+            return -1;
+        }
+        off += n;
+    }
+    sdsfree(buf);
+
+    for (int j = 0; j < answers; j++) {
+        int slot = (PendingHead + PendingCount++) % TMUX_MAX_PENDING;
+        Pending[slot].cb = cb;
+        Pending[slot].privdata = privdata;
+    }
+    return 0;
+}
+
+typedef struct TmuxReply {
+    sds text;
+    int error;
+    int done;
+} TmuxReply;
+
+static void tmux_reply_done(sds reply, int error, void *privdata) {
+    TmuxReply *r = privdata;
+    r->text = sdsdup(reply);
+    r->error = error;
+    r->done = 1;
+}
+
+/* Run a command and return its output, or NULL on error. Must be called
+ * with TmuxLock held, that is released while waiting for the answer. */
+static sds tmux_query(const char *line) {
+    TmuxReply r = {NULL, 0, 0};
+    if (tmux_send(line, 1, tmux_reply_done, &r) == -1) return NULL;
+    while (!r.done) pthread_cond_wait(&TmuxCond, &TmuxLock);
+    if (r.error) {
+        sdsfree(r.text);
+        return NULL;
+    }
+    return r.text;
+}
+
+/* ============================================================================
+ * Panes
+ * ==========================================================================*/
+
+/* Return the pane with the given ID, or NULL. Must be called with TmuxLock
+ * held. */
+static TmuxPane *tmux_lookup(uint32_t id) {
+    for (int j = 0; j < TMUX_MAX_PANES; j++) {
+        if (Panes[j].used && Panes[j].id == id) return &Panes[j];
+    }
+    return NULL;
+}
+
+static void tmux_forget(TmuxPane *p) {
+    termViewFree(p->view);
+    p->view = NULL;
+    p->used = 0;
+}
+
+/* Write the lines of a capture-pane output starting from the top left,
+ * one per row. Every line sets its own attributes. Returns the number of
+ * rows up to the last one with text. */
+static int tmux_write_lines(VtScreen *vt, const char *text) {
+    const char *p = text;
+    int used = 0;
+    for (int y = 0; y < vt->rows && *p; y++) {
+        const char *nl = strchr(p, '\n');
+        size_t len = nl ? (size_t)(nl - p) : strlen(p);
+        if (y) vtWrite(vt, "\r\n", 2);
+        vtWrite(vt, "\033[0m", 4);
+        vtWrite(vt, p, len);
+        if (len) used = y+1;
+        p += len + (nl != NULL);
+    }
+    return used;
+}
+
+/* Rebuild the screen of the pane from the answers of a sync. The view is
+ * created again if the pane changed size, followed if the old one was. */
+static void tmux_apply_sync(TmuxSync *sync, const char *screen) {
+    TmuxPane *p = tmux_lookup(sync->id);
+    if (!p) return;
+    if (sync->error) {
+        tmux_forget(p);     /* The pane was closed. */
+        return;
+    }
+
+    int width, height, cx, cy, cursor, alt;
+    if (sscanf(sync->info, "%d %d %d %d %d %d", &width, &height, &cx, &cy,
+               &cursor, &alt) != 6 || width < 1 || height < 1)
+    {
+        tmux_forget(p);
+        return;
+    }
+    if (!p->view || p->view->vt->rows != height || p->view->vt->cols != width) {
+        TermView *view = termViewCreate(height, width);
+        if (p->view && p->view->output) termViewFollow(view, 1);
+        termViewFree(p->view);
+        p->view = view;
+    }
+
+    VtScreen *vt = p->view->vt;
+    vtWrite(vt, "\033c", 2);
+    char buf[32];
+    int len;
+    if (alt) {
+        /* tmux doesn't tell where the cursor of the main screen was saved.
+         * Programs using the alternate screen are usually started from a
+         * prompt, so it is at the start of the line after the text. */
+        int used = tmux_write_lines(vt, sync->main);
+        if (used == vt->rows) used--;
+        len = snprintf(buf, sizeof(buf), "\033[%d;1H\033[?1049h", used+1);
+        vtWrite(vt, buf, len);
+    }
+    tmux_write_lines(vt, screen);
+    len = snprintf(buf, sizeof(buf), "\033[%d;%dH%s", cy+1, cx+1,
+                       cursor ? "" : "\033[?25l");
+    vtWrite(vt, buf, len);
+    vt->replylen = 0;
+    p->generation++;
+}
+
+static void tmux_sync_answer(sds reply, int error, void *privdata) {
+    TmuxSync *sync = privdata;
+    if (error) sync->error = 1;
+    if (sync->answers == 0) {
+        sync->info = sdsdup(reply);
+    } else if (sync->answers == 1) {
+        sync->main = sdsdup(reply);
+    } else {
+        TmuxPane *p = tmux_lookup(sync->id);
+        if (p && p->syncs) p->syncs--;
+        tmux_apply_sync(sync, reply);
+        sdsfree(sync->info);
+        sdsfree(sync->main);
+        free(sync);
+        return;
+    }
+    sync->answers++;
+}
+
+/* Ask tmux for the size, cursor and contents of the pane, to rebuild its
+ * screen. Must be called with TmuxLock held. %output that arrives before
+ * the answers is already part of them, the one after is applied on top,
+ * since the reader runs the callbacks in order. */
+static void tmux_sync(uint32_t id) {
+    TmuxSync *sync = malloc(sizeof(*sync));
+    if (!sync) return;
+    sync->id = id;
+    sync->answers = 0;
+    sync->error = 0;
+    sync->info = NULL;
+    sync->main = NULL;
+
+    char line[256];
+    snprintf(line, sizeof(line),
+        "display -p -t %%%u '#{pane_width} #{pane_height} #{cursor_x} "
+        "#{cursor_y} #{cursor_flag} #{alternate_on}' ; "
+        "capture-pane -p -e -a -q -t %%%u ; capture-pane -p -e -t %%%u",
+        id, id, id);
+    if (tmux_send(line, 3, tmux_sync_answer, sync) == -1) {
+        free(sync);
+        return;
+    }
+    TmuxPane *p = tmux_lookup(id);
+    if (p) p->syncs++;
+}
+
+/* Sync the panes marked stale by the reader thread. Must be called with
+ * TmuxLock held, by any thread but the reader: tmux_send() may have to
+ * wait for answers that only the reader can process. */
+static void tmux_sync_stale(void) {
+    for (int j = 0; j < TMUX_MAX_PANES; j++) {
+        if (!Panes[j].used || !Panes[j].stale) continue;
+        Panes[j].stale = 0;
+        tmux_sync(Panes[j].id);
+    }
+}
+
+/* Return the pane once its syncs completed, or NULL if the pane is
+ * unknown or gone. Must be called with TmuxLock held. */
+static TmuxPane *tmux_synced_pane(uint32_t id) {
+    TmuxPane *p;
+    tmux_sync_stale();
+    while ((p = tmux_lookup(id)) != NULL && (!p->view || p->syncs) &&
+           TmuxAttached)
+    {
+        pthread_cond_wait(&TmuxCond, &TmuxLock);
+    }
+    return p && p->view ? p : NULL;
+}
+
+/* ============================================================================
+ * Reader thread
+ * ==========================================================================*/
+
+static sds Reply;               /* Output of the command being answered. */
+static char ReplyGuard[64];     /* "time number" of its %begin, or "". */
+static int ReplyOurs;           /* Answer to one of our commands. */
+
+/* Pass an answer to the callback of the oldest command. */
+static void tmux_answer(int error) {
+    if (PendingCount == 0) return;
+    TmuxPending *pending = &Pending[PendingHead];
+    PendingHead = (PendingHead + 1) % TMUX_MAX_PENDING;
+    PendingCount--;
+    if (pending->cb) pending->cb(Reply, error, pending->privdata);
+    pthread_cond_broadcast(&TmuxCond);
+}
+
+static int is_octal(char c) {
+    return c >= '0' && c <= '7';
+}
+
+/* %output %N data: bytes below 32 and backslashes are escaped as \ooo. */
+static void tmux_output(char *p) {
+    uint32_t id = strtoul(p, &p, 10);
+    if (*p++ != ' ') return;
+    TmuxPane *pane = tmux_lookup(id);
+    if (!pane || !pane->view) return;
+
+    char *dst = p;
+    size_t len = 0;
+    while (*p) {
+        if (p[0] == '\\' && is_octal(p[1]) && is_octal(p[2]) && is_octal(p[3])) {
+            dst[len++] = (p[1]-'0') << 6 | (p[2]-'0') << 3 | (p[3]-'0');
+            p += 4;
+        } else {
+            dst[len++] = *p++;
+        }
+    }
+    termViewWrite(pane->view, dst, len);
+    pane->view->vt->replylen = 0;  /* tmux answers queries itself. */
+    pane->generation++;
+}
+
+/* Handle a line from tmux, without the newline. Called with TmuxLock held. */
+static void tmux_line(char *line) {
+    if (ReplyGuard[0]) {
+        /* A block ends with %end or %error followed by the same time and
+         * number of its %begin, so output lines can't be mistaken for it. */
+        const char *guard = NULL;
+        int error = 0;
+        if (strncmp(line, "%end ", 5) == 0) {
+            guard = line+5;
+        } else if (strncmp(line, "%error ", 7) == 0) {
+            guard = line+7;
+            error = 1;
+        }
+        size_t glen = strlen(ReplyGuard);
+        if (guard && strncmp(guard, ReplyGuard, glen) == 0 && guard[glen] == ' ') {
+            if (ReplyOurs) tmux_answer(error);
+            ReplyGuard[0] = '\0';
+            sdsclear(Reply);
+        } else {
+            if (sdslen(Reply)) Reply = sdscatlen(Reply, "\n", 1);
+            Reply = sdscat(Reply, line);
+        }
+        return;
+    }
+
+    if (strncmp(line, "%begin ", 7) == 0) {
+        /* %begin time number flags: flags is 1 for our commands. */
+        char *flags = strrchr(line, ' ');
+        ReplyOurs = atoi(flags+1) & 1;
+        snprintf(ReplyGuard, sizeof(ReplyGuard), "%.*s",
+                 (int)(flags - (line+7)), line+7);
+    } else if (strncmp(line, "%output %", 9) == 0) {
+        tmux_output(line+9);
+    } else if (strncmp(line, "%layout-change ", 15) == 0 ||
+               strncmp(line, "%session-changed ", 17) == 0)
+    {
+        /* Panes may have changed size: they must be synced again, but
+         * not from here. tmux_send() waits when too many commands are in
+         * flight, and only this thread can lower their number. */
+        for (int j = 0; j < TMUX_MAX_PANES; j++) {
+            if (!Panes[j].used) continue;
+            Panes[j].stale = 1;
+            Panes[j].generation++;
+        }
+    }
+}
+
+static void *tmux_reader(void *arg) {
+    (void)arg;
+    sds buf = sdsempty();
+    Reply = sdsempty();
+    char chunk[65536];
+    while (1) {
+        ssize_t n = read(TmuxOut, chunk, sizeof(chunk));
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) break;
+        buf = sdscatlen(buf, chunk, n);
+
+        pthread_mutex_lock(&TmuxLock);
+        char *p = buf, *nl;
+        while ((nl = memchr(p, '\n', sdslen(buf) - (p - buf))) != NULL) {
+            *nl = '\0';
+            tmux_line(p);
+            p = nl+1;
+        }
+        pthread_mutex_unlock(&TmuxLock);
+        sdsrange(buf, p - buf, -1);
+    }
+
+    /* tmux exited or detached us: fail the commands still waiting. */
+    pthread_mutex_lock(&TmuxLock);
+    TmuxAttached = 0;
+    sdsclear(Reply);
+    while (PendingCount) tmux_answer(1);
+    pthread_cond_broadcast(&TmuxCond);
+    pthread_mutex_unlock(&TmuxLock);
+    waitpid(TmuxPid, NULL, 0);
+    sdsfree(buf);
+    return NULL;
+}
+
+/* ============================================================================
+ * Backend methods
+ * ==========================================================================*/
+
+/* Attach to the session 'arg', or to the most recently used one, of the
+ * tmux server: the one the bot runs in if started inside tmux, as $TMUX
+ * names its socket. */
+static int tmux_init(const char *arg) {
+    int in[2], out[2];
+    if (pipe(in) == -1) return -1;
+    if (pipe(out) == -1) {
+        close(in[0]);
+        close(in[1]);
+        return -1;
+    }
+
+    TmuxPid = fork();
+    if (TmuxPid == -1) return -1;
+    if (TmuxPid == 0) {
+        dup2(in[0], 0);
+        dup2(out[1], 1);
+        close(in[0]);
+        close(in[1]);
+        close(out[0]);
+        close(out[1]);
+        if (arg) execlp("tmux", "tmux", "-C", "attach-session", "-t", arg, (char*)NULL);
+        else execlp("tmux", "tmux", "-C", "attach-session", (char*)NULL);
+        _exit(127);
+    }
+    close(in[0]);
+    close(out[1]);
+    TmuxIn = in[1];
+    TmuxOut = out[0];
+    fcntl(TmuxIn, F_SETFD, FD_CLOEXEC);
+    fcntl(TmuxOut, F_SETFD, FD_CLOEXEC);
+    /* Writing to a tmux that exited must fail, not kill the bot. */
+    signal(SIGPIPE, SIG_IGN);
+    TmuxAttached = 1;
+
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, tmux_reader, NULL) != 0) return -1;
+    pthread_detach(tid);
+
+    /* Wait for tmux to answer, so that a missing server is reported. */
+    pthread_mutex_lock(&TmuxLock);
+    sds name = tmux_query("display -p '#{session_name}'");
+    pthread_mutex_unlock(&TmuxLock);
+    if (!name) return -1;
+    sdsfree(name);
+    return 0;
+}
+
+/* List the panes of the attached session, starting to track the new ones
+ * and forgetting the closed ones. */
+static Session *tmux_list(int all, int *count) {
+    (void)all;
+    *count = 0;
+    pthread_mutex_lock(&TmuxLock);
+    tmux_sync_stale();
+    sds reply = tmux_query("list-panes -s -F '" TMUX_LIST_FORMAT "'");
+    if (!reply) {
+        pthread_mutex_unlock(&TmuxLock);
+        return NULL;
+    }
+
+    int numlines;
+    sds *lines = sdssplitlen(reply, sdslen(reply), "\n", 1, &numlines);
+    Session *sessions = malloc(sizeof(Session) * (numlines ? numlines : 1));
+    int seen[TMUX_MAX_PANES] = {0};
+    for (int j = 0; sessions && j < numlines; j++) {
+        unsigned id;
+        int pid, off = 0;
+        char cmd[128];
+        if (sscanf(lines[j], "%%%u %d %127s %n", &id, &pid, cmd, &off) != 3 ||
+            off == 0) continue;
+
+        TmuxPane *p = tmux_lookup(id);
+        for (int k = 0; k < TMUX_MAX_PANES && !p; k++) {
+            if (Panes[k].used) continue;
+            p = &Panes[k];
+            p->id = id;
+            p->used = 1;
+            p->view = NULL;
+            p->syncs = 0;
+            p->stale = 0;
+            tmux_sync(id);
+        }
+        if (!p) continue;
+        seen[p - Panes] = 1;
+
+        Session *s = &sessions[(*count)++];
+        s->id = id;
+        s->pid = pid;
+        snprintf(s->owner, sizeof(s->owner), "%s", cmd);
+        snprintf(s->title, sizeof(s->title), "%s", lines[j] + off);
+    }
+    for (int j = 0; j < TMUX_MAX_PANES; j++) {
+        if (Panes[j].used && !seen[j]) tmux_forget(&Panes[j]);
+    }
+    pthread_mutex_unlock(&TmuxLock);
+    sdsfreesplitres(lines, numlines);
+    sdsfree(reply);
+    return sessions;
+}
+
+/* Open a new window in the attached session. */
+static int tmux_spawn(const char *cmd) {
+    sds line = sdsnew("new-window -d");
+    if (cmd) line = tmux_quote(sdscatlen(line, " ", 1), cmd);
+    pthread_mutex_lock(&TmuxLock);
+    sds reply = tmux_query(line);
+    pthread_mutex_unlock(&TmuxLock);
+    sdsfree(line);
+    if (!reply) return -1;
+    sdsfree(reply);
+    return 0;
+}
+
+static int tmux_alive(Session *s) {
+    char line[64];
+    snprintf(line, sizeof(line), "display -p -t %%%u '#{pane_id}'", s->id);
+    pthread_mutex_lock(&TmuxLock);
+    sds reply = tmux_query(line);
+    pthread_mutex_unlock(&TmuxLock);
+    if (!reply) return 0;
+    sdsfree(reply);
+    return 1;
+}
+
+static Frame *tmux_capture(uint32_t id, const double *region) {
+    pthread_mutex_lock(&TmuxLock);
+    TmuxPane *p = tmux_synced_pane(id);
+    Frame *f = p ? termViewCapture(p->view, region) : NULL;
+    pthread_mutex_unlock(&TmuxLock);
+    return f;
+}
+
+/* Panes change only through %output and syncs: a stale pane gets a new
+ * generation too, so the next capture syncs it. */
+static uint64_t tmux_generation(uint32_t id) {
+    pthread_mutex_lock(&TmuxLock);
+    TmuxPane *p = tmux_lookup(id);
+    uint64_t generation = p && p->view ? p->generation : 0;
+    pthread_mutex_unlock(&TmuxLock);
+    return generation;
+}
+
+/* Keys are written with send-keys as the bytes a terminal would send,
+ * without waiting for the answer: the keys of a message reach tmux as a
+ * single burst of commands. */
+static void tmux_key(const Session *s, int key, uint32_t ch, int mods) {
+    unsigned char buf[BACKEND_KEY_MAX];
+    int len = backendKeyBytes(key, ch, mods, buf);
+    sds line = sdscatprintf(sdsempty(), "send-keys -t %%%u -H", s->id);
+    for (int j = 0; j < len; j++) line = sdscatprintf(line, " %02x", buf[j]);
+    pthread_mutex_lock(&TmuxLock);
+    tmux_send(line, 1, NULL, NULL);
+    pthread_mutex_unlock(&TmuxLock);
+    sdsfree(line);
+}
+
+static sds tmux_text(const Session *s) {
+    pthread_mutex_lock(&TmuxLock);
+    TmuxPane *p = tmux_synced_pane(s->id);
+    sds text = p ? termViewText(p->view) : NULL;
+    pthread_mutex_unlock(&TmuxLock);
+    return text;
+}
+
+static sds tmux_grep(const Session *s, const char *pattern) {
+    pthread_mutex_lock(&TmuxLock);
+    TmuxPane *p = tmux_synced_pane(s->id);
+    sds text = p ? termViewGrep(p->view, pattern) : NULL;
+    pthread_mutex_unlock(&TmuxLock);
+    return text;
+}
+
+static sds tmux_page(const Session *s, int page, int *pages) {
+    pthread_mutex_lock(&TmuxLock);
+    TmuxPane *p = tmux_synced_pane(s->id);
+    sds text = p ? termViewPage(p->view, page, pages) : NULL;
+    pthread_mutex_unlock(&TmuxLock);
+    return text;
+}
+
+static int tmux_follow(const Session *s, int on) {
+    pthread_mutex_lock(&TmuxLock);
+    TmuxPane *p = tmux_synced_pane(s->id);
+    if (p) termViewFollow(p->view, on);
+    pthread_mutex_unlock(&TmuxLock);
+    return p ? 0 : -1;
+}
+
+static sds tmux_new_output(const Session *s) {
+    pthread_mutex_lock(&TmuxLock);
+    tmux_sync_stale();
+    TmuxPane *p = tmux_lookup(s->id);
+    sds text = p && p->view ? termViewOutput(p->view) : NULL;
+    pthread_mutex_unlock(&TmuxLock);
+    return text;
+}
+
+Backend TmuxBackend = {
+    .name = "tmux",
+    .init = tmux_init,
+    .list = tmux_list,
+    .spawn = tmux_spawn,
+    .alive = tmux_alive,
+    .capture = tmux_capture,
+    .generation = tmux_generation,
+    .focus = NULL,
+    .key = tmux_key,
+    .text = tmux_text,
+    .grep = tmux_grep,
+    .page = tmux_page,
+    .follow = tmux_follow,
+    .output = tmux_new_output,
+};
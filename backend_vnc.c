@@ -0,0 +1,541 @@
+/* ============================================================================
+ * VNC backend: a remote desktop or VM through its VNC server.
+ *
+ * The bot is an RFB client (RFC 6143) that keeps a local copy of the remote
+ * framebuffer. After the first full update it always has an incremental
+ * update request pending, so the server sends only the rectangles that
+ * changed, as soon as they change: screenshots are cut from the local copy
+ * with no round trip to the server. Keys are sent as RFB key events, so the
+ * server types them into whatever has the focus on the remote desktop.
+ *
+ * The desktop is the only session. Only the "None" security type is
+ * supported: run the server on localhost, or reach it through a tunnel.
+ * ==========================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdint.h>
+
+#include "backend.h"
+#include "xmalloc.h"
+
+#define VNC_SESSION_ID 1
+#define VNC_BASE_PORT 5900      /* Port of display :0. */
+#define VNC_MAX_SIDE 16384      /* Larger framebuffers are a protocol error. */
+
+/* Client to server messages. */
+#define VNC_SET_PIXEL_FORMAT 0
+#define VNC_SET_ENCODINGS 2
+#define VNC_UPDATE_REQUEST 3
+#define VNC_KEY_EVENT 4
+
+/* Server to client messages. */
+#define VNC_FRAMEBUFFER_UPDATE 0
+#define VNC_SET_COLOUR_MAP 1
+#define VNC_BELL 2
+#define VNC_CUT_TEXT 3
+
+/* Encodings. */
+#define VNC_ENC_RAW 0
+#define VNC_ENC_COPYRECT 1
+#define VNC_ENC_DESKTOP_SIZE (-223)
+
+static char VncHost[256] = "localhost";
+static char VncPort[16] = "5900";
+static int VncFd = -1;
+static int VncConnected;
+static uint32_t *Fb;            /* The remote screen, BGRA like frames. */
+static int FbWidth, FbHeight;
+static char DesktopName[256];
+static uint64_t FbGeneration;   /* Incremented by every update applied. */
+static pthread_mutex_t VncLock = PTHREAD_MUTEX_INITIALIZER; /* Protects the
+                                   framebuffer, and writes to the socket. */
+
+/* ============================================================================
+ * Wire helpers
+ * ==========================================================================*/
+
+static int read_full(int fd, void *buf, size_t len) {
+    unsigned char *p = buf;
+    while (len) {
+        ssize_t n = read(fd, p, len);
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int write_full(int fd, const void *buf, size_t len) {
+    const unsigned char *p = buf;
+    while (len) {
+        ssize_t n = write(fd, p, len);
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static uint16_t get16(const unsigned char *p) {
+    return p[0] << 8 | p[1];
+}
+
+static uint32_t get32(const unsigned char *p) {
+    return (uint32_t)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+static void put16(unsigned char *p, uint16_t v) {
+    p[0] = v >> 8;
+    p[1] = v;
+}
+
+static void put32(unsigned char *p, uint32_t v) {
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+/* Skip 'len' bytes of the stream. */
+static int skip(int fd, size_t len) {
+    unsigned char buf[4096];
+    while (len) {
+        size_t n = len < sizeof(buf) ? len : sizeof(buf);
+        if (read_full(fd, buf, n) == -1) return -1;
+        len -= n;
+    }
+    return 0;
+}
+
+/* Ask for the changes of the whole screen, or for all of it if not
+ * 'incremental'. Must be called with VncLock held. */
+static int request_update(int incremental) {
+    unsigned char msg[10] = {VNC_UPDATE_REQUEST, incremental};
+    put16(msg+2, 0);
+    put16(msg+4, 0);
+    put16(msg+6, FbWidth);
+    put16(msg+8, FbHeight);
+    return write_full(VncFd, msg, sizeof(msg));
+}
+
+/* ============================================================================
+ * Framebuffer updates
+ * ==========================================================================*/
+
+/* Resize the framebuffer, that starts black. Must be called with VncLock
+ * held. */
+static void resize_fb(int width, int height) {
+    xfree(Fb);
+    FbWidth = width;
+    FbHeight = height;
+    Fb = xmalloc(sizeof(uint32_t)*width*height);
+    for (size_t j = 0; j < (size_t)width*height; j++) Fb[j] = 0xff000000;
+}
+
+/* Read a raw rectangle a row at a time, so the lock is not held while
+ * waiting for the network. */
+static int read_raw(int fd, int x, int y, int w, int h) {
+    uint32_t *row = xmalloc(sizeof(uint32_t)*(w ? w : 1));
+    for (int j = 0; j < h; j++) {
+        if (read_full(fd, row, sizeof(uint32_t)*w) == -1) {
+            xfree(row);
+            return -1;
+        }
+        pthread_mutex_lock(&VncLock);
+        uint32_t *dst = Fb + (size_t)(y+j)*FbWidth + x;
+        /* The padding byte of the pixels becomes an opaque alpha. */
+        for (int i = 0; i < w; i++) dst[i] = row[i] | 0xff000000;
+        pthread_mutex_unlock(&VncLock);
+    }
+    xfree(row);
+    return 0;
+}
+
+/* Copy a rectangle of the framebuffer, that may overlap its source. */
+static void copy_rect(int sx, int sy, int x, int y, int w, int h) {
+    pthread_mutex_lock(&VncLock);
+    for (int j = 0; j < h; j++) {
+        int row = sy < y ? h-1-j : j;    /* Moving down: bottom up. */
+        memmove(Fb + (size_t)(y+row)*FbWidth + x,
+                Fb + (size_t)(sy+row)*FbWidth + sx, sizeof(uint32_t)*w);
+    }
+    pthread_mutex_unlock(&VncLock);
+}
+
+/* Apply a FramebufferUpdate message, after its type byte. '*resized' is
+ * set to true if the desktop changed size. */
+static int handle_update(int fd, int *resized) {
+    unsigned char hdr[3];
+    *resized = 0;
+    if (read_full(fd, hdr, sizeof(hdr)) == -1) return -1;
+    int rects = get16(hdr+1);
+    for (int r = 0; r < rects; r++) {
+        unsigned char rh[12];
+        if (read_full(fd, rh, sizeof(rh)) == -1) return -1;
+        int x = get16(rh), y = get16(rh+2), w = get16(rh+4), h = get16(rh+6);
+        int32_t enc = (int32_t)get32(rh+8);
+
+        if (enc == VNC_ENC_DESKTOP_SIZE) {
+            if (w == 0 || h == 0 || w > VNC_MAX_SIDE || h > VNC_MAX_SIDE) return -1;
+            pthread_mutex_lock(&VncLock);
+            resize_fb(w, h);
+            pthread_mutex_unlock(&VncLock);
+            *resized = 1;
+            continue;
+        }
+        /* Rectangles outside the screen can't be applied: the stream is
+         * broken or the server is misbehaving. */
+        if (x + w > FbWidth || y + h > FbHeight) return -1;
+        if (enc == VNC_ENC_RAW) {
+            if (read_raw(fd, x, y, w, h) == -1) return -1;
+        } else if (enc == VNC_ENC_COPYRECT) {
+            unsigned char src[4];
+            if (read_full(fd, src, sizeof(src)) == -1) return -1;
+            int sx = get16(src), sy = get16(src+2);
+            if (sx + w > FbWidth || sy + h > FbHeight) return -1;
+            copy_rect(sx, sy, x, y, w, h);
+        } else {
+            return -1;      /* Not an encoding we asked for. */
+        }
+    }
+    return 0;
+}
+
+/* Reader thread: apply the updates, asking for the next changes after each
+ * one. Other messages are skipped. */
+static void *vnc_reader(void *arg) {
+    int fd = (int)(intptr_t)arg;
+    while (1) {
+        unsigned char type;
+        if (read_full(fd, &type, 1) == -1) break;
+        if (type == VNC_FRAMEBUFFER_UPDATE) {
+            int resized;
+            if (handle_update(fd, &resized) == -1) break;
+            /* After a resize the framebuffer is blank: ask for all of it,
+             * not only for what changes next. */
+            pthread_mutex_lock(&VncLock);
+            FbGeneration++;
+            int err = request_update(!resized);
+            pthread_mutex_unlock(&VncLock);
+            if (err == -1) break;
+        } else if (type == VNC_SET_COLOUR_MAP) {
+            unsigned char hdr[5];
+            if (read_full(fd, hdr, sizeof(hdr)) == -1 ||
+                skip(fd, (size_t)get16(hdr+3)*6) == -1) break;
+        } else if (type == VNC_BELL) {
+            continue;
+        } else if (type == VNC_CUT_TEXT) {
+            unsigned char hdr[7];
+            if (read_full(fd, hdr, sizeof(hdr)) == -1 ||
+                skip(fd, get32(hdr+3)) == -1) break;
+        } else {
+            break;          /* Unknown message: can't find the next one. */
+        }
+    }
+
+    pthread_mutex_lock(&VncLock);
+    VncConnected = 0;
+    close(VncFd);
+    VncFd = -1;
+    pthread_mutex_unlock(&VncLock);
+    return NULL;
+}
+
+/* ============================================================================
+ * Connection
+ * ==========================================================================*/
+
+static int tcp_connect(const char *host, const char *port) {
+    struct addrinfo hints, *res;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, port, &hints, &res) != 0) return -1;
+    int fd = -1;
+    for (struct addrinfo *ai = res; ai && fd == -1; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd == -1) continue;
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) == -1) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(res);
+    if (fd != -1) {
+        int one = 1;    /* Key events are tiny and must go out at once. */
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    return fd;
+}
+
+/* Read the reason string the server sends when it refuses the connection
+ * or the authentication fails. Returns "" if it can't be read. */
+static const char *read_reason(int fd, char *buf, size_t size) {
+    unsigned char len[4];
+    buf[0] = '\0';
+    if (read_full(fd, len, sizeof(len)) == -1) return buf;
+    uint32_t n = get32(len);
+    size_t keep = n < size ? n : size-1;
+    if (read_full(fd, buf, keep) == -1) keep = 0;
+    buf[keep] = '\0';
+    return buf;
+}
+
+/* Version and security handshake, then the init messages. Returns -1 on
+ * error, printing why. */
+static int handshake(int fd, int *width, int *height) {
+    unsigned char buf[256];
+    if (read_full(fd, buf, 12) == -1 || memcmp(buf, "RFB ", 4) != 0) return -1;
+    int minor = atoi((char *)buf+8);
+    int v38 = minor >= 8, v37 = minor >= 7;
+    if (write_full(fd, v38 ? "RFB 003.008\n" : v37 ? "RFB 003.007\n" :
+                   "RFB 003.003\n", 12) == -1) return -1;
+
+    uint32_t security;
+    if (v37) {
+        /* The server lists the types it supports, we pick None. */
+        unsigned char count;
+        if (read_full(fd, &count, 1) == -1) return -1;
+        if (count == 0) security = 0;
+        else {
+            if (read_full(fd, buf, count) == -1) return -1;
+            security = memchr(buf, 1, count) ? 1 : 2;
+            if (security == 1 && write_full(fd, "\1", 1) == -1) return -1;
+        }
+    } else {
+        if (read_full(fd, buf, 4) == -1) return -1;
+        security = get32(buf);
+    }
+    if (security == 0) {
+        fprintf(stderr, "The VNC server refused the connection: %s\n",
+                read_reason(fd, (char *)buf, sizeof(buf)));
+        return -1;
+    }
+    if (security != 1) {
+        fprintf(stderr, "The VNC server requires a password: only servers "
+                        "without authentication are supported.\n");
+        return -1;
+    }
+    if (v38) {
+        if (read_full(fd, buf, 4) == -1) return -1;
+        if (get32(buf) != 0) {
+            fprintf(stderr, "VNC authentication failed: %s\n",
+                    read_reason(fd, (char *)buf, sizeof(buf)));
+            return -1;
+        }
+    }
+
+    /* ClientInit: share the desktop with other viewers. */
+    if (write_full(fd, "\1", 1) == -1) return -1;
+    if (read_full(fd, buf, 24) == -1) return -1;
+    *width = get16(buf);
+    *height = get16(buf+2);
+    uint32_t namelen = get32(buf+20);
+    size_t keep = namelen < sizeof(DesktopName) ? namelen : sizeof(DesktopName)-1;
+    if (read_full(fd, DesktopName, keep) == -1 || skip(fd, namelen-keep) == -1)
+        return -1;
+    DesktopName[keep] = '\0';
+    if (*width == 0 || *height == 0 || *width > VNC_MAX_SIDE ||
+        *height > VNC_MAX_SIDE) return -1;
+
+    /* 32 bit little endian true color with blue in the low byte: in memory
+     * B, G, R, padding, the frame format. */
+    unsigned char pf[20] = {VNC_SET_PIXEL_FORMAT, 0, 0, 0,
+                            32, 24, 0, 1, 0, 255, 0, 255, 0, 255, 16, 8, 0};
+    unsigned char enc[4+3*4] = {VNC_SET_ENCODINGS, 0};
+    put16(enc+2, 3);
+    put32(enc+4, VNC_ENC_COPYRECT);
+    put32(enc+8, VNC_ENC_RAW);
+    put32(enc+12, (uint32_t)VNC_ENC_DESKTOP_SIZE);
+    if (write_full(fd, pf, sizeof(pf)) == -1 ||
+        write_full(fd, enc, sizeof(enc)) == -1) return -1;
+    return 0;
+}
+
+/* Connect to the server and start receiving updates. */
+static int vnc_connect(void) {
+    int fd = tcp_connect(VncHost, VncPort);
+    if (fd == -1) {
+        fprintf(stderr, "Can't connect to the VNC server %s:%s\n", VncHost, VncPort);
+        return -1;
+    }
+    int width, height;
+    if (handshake(fd, &width, &height) == -1) {
+        close(fd);
+        return -1;
+    }
+
+    pthread_mutex_lock(&VncLock);
+    VncFd = fd;
+    resize_fb(width, height);
+    FbGeneration++;
+    int err = request_update(0);
+    if (err == 0) VncConnected = 1;
+    pthread_mutex_unlock(&VncLock);
+
+    pthread_t tid;
+    if (err == -1 ||
+        pthread_create(&tid, NULL, vnc_reader, (void *)(intptr_t)fd) != 0)
+    {
+        pthread_mutex_lock(&VncLock);
+        VncConnected = 0;
+        VncFd = -1;
+        pthread_mutex_unlock(&VncLock);
+        close(fd);
+        return -1;
+    }
+    pthread_detach(tid);
+    return 0;
+}
+
+/* 'arg' is host, host:display or host::port, like VNC viewers accept. */
+static int vnc_init(const char *arg) {
+    if (arg && *arg) {
+        const char *colon = strchr(arg, ':');
+        size_t hostlen = colon ? (size_t)(colon-arg) : strlen(arg);
+        if (hostlen) {
+            snprintf(VncHost, sizeof(VncHost), "%.*s", (int)hostlen, arg);
+        }
+        if (colon && colon[1] == ':') {
+            snprintf(VncPort, sizeof(VncPort), "%s", colon+2);
+        } else if (colon) {
+            snprintf(VncPort, sizeof(VncPort), "%d", VNC_BASE_PORT + atoi(colon+1));
+        }
+    }
+    return vnc_connect();
+}
+
+/* ============================================================================
+ * Backend methods
+ * ==========================================================================*/
+
+/* The desktop is the only session. The connection is opened again if it
+ * was lost, like when the VM restarted. */
+static Session *vnc_list(int all, int *count) {
+    (void)all;
+    *count = 0;
+    pthread_mutex_lock(&VncLock);
+    int connected = VncConnected;
+    pthread_mutex_unlock(&VncLock);
+    if (!connected && vnc_connect() == -1) return NULL;
+
+    Session *s = malloc(sizeof(Session));
+    if (!s) return NULL;
+    s->id = VNC_SESSION_ID;
+    s->pid = 0;
+    snprintf(s->owner, sizeof(s->owner), "VNC %.64s:%s", VncHost, VncPort);
+    snprintf(s->title, sizeof(s->title), "%s", DesktopName);
+    *count = 1;
+    return s;
+}
+
+static int vnc_alive(Session *s) {
+    pthread_mutex_lock(&VncLock);
+    int alive = VncConnected && s->id == VNC_SESSION_ID;
+    pthread_mutex_unlock(&VncLock);
+    return alive;
+}
+
+/* Return a copy of the local framebuffer, already up to date. */
+static Frame *vnc_capture(uint32_t id, const double *region) {
+    pthread_mutex_lock(&VncLock);
+    if (!VncConnected || id != VNC_SESSION_ID) {
+        pthread_mutex_unlock(&VncLock);
+        return NULL;
+    }
+    int x = 0, y = 0, width = FbWidth, height = FbHeight;
+    if (region) {
+        x = FbWidth * region[0] / 100;
+        y = FbHeight * region[1] / 100;
+        width = FbWidth * region[2] / 100;
+        height = FbHeight * region[3] / 100;
+        if (x < 0) x = 0;
+        if (y < 0) y = 0;
+        if (x + width > FbWidth) width = FbWidth - x;
+        if (y + height > FbHeight) height = FbHeight - y;
+    }
+    Frame *f = NULL;
+    if (width > 0 && height > 0) {
+        f = frameCreate(width, height);
+        for (int j = 0; j < height; j++) {
+            memcpy(f->pixels + (size_t)j*f->stride,
+                   Fb + (size_t)(y+j)*FbWidth + x, sizeof(uint32_t)*width);
+        }
+    }
+    pthread_mutex_unlock(&VncLock);
+    return f;
+}
+
+/* The server sends only what changed: no update, no change. */
+static uint64_t vnc_generation(uint32_t id) {
+    pthread_mutex_lock(&VncLock);
+    uint64_t generation = VncConnected && id == VNC_SESSION_ID ?
+                          FbGeneration : 0;
+    pthread_mutex_unlock(&VncLock);
+    return generation;
+}
+
+/* Keysyms are the X11 ones. */
+#define XK_TAB 0xff09
+#define XK_RETURN 0xff0d
+#define XK_ESCAPE 0xff1b
+#define XK_CONTROL_L 0xffe3
+#define XK_ALT_L 0xffe9
+#define XK_SUPER_L 0xffeb
+
+static int key_event(uint32_t keysym, int down) {
+    unsigned char msg[8] = {VNC_KEY_EVENT, down, 0, 0};
+    put32(msg+4, keysym);
+    return write_full(VncFd, msg, sizeof(msg));
+}
+
+static void vnc_key(const Session *s, int key, uint32_t ch, int mods) {
+    (void)s;
+    uint32_t sym;
+    if (key == KEY_RETURN) sym = XK_RETURN;
+    else if (key == KEY_TAB) sym = XK_TAB;
+    else if (key == KEY_ESCAPE) sym = XK_ESCAPE;
+    else if ((ch >= 0x20 && ch < 0x7f) || (ch >= 0xa0 && ch <= 0xff)) sym = ch;
+    else sym = 0x01000000 | ch;     /* Unicode keysym. */
+
+    pthread_mutex_lock(&VncLock);
+    if (VncConnected) {
+        if (mods & MOD_CTRL) key_event(XK_CONTROL_L, 1);
+        if (mods & MOD_ALT) key_event(XK_ALT_L, 1);
+        if (mods & MOD_CMD) key_event(XK_SUPER_L, 1);
+        key_event(sym, 1);
+        key_event(sym, 0);
+        if (mods & MOD_CMD) key_event(XK_SUPER_L, 0);
+        if (mods & MOD_ALT) key_event(XK_ALT_L, 0);
+        if (mods & MOD_CTRL) key_event(XK_CONTROL_L, 0);
+    }
+    pthread_mutex_unlock(&VncLock);
+}
+
+Backend VncBackend = {
+    .name = "vnc",
+    .init = vnc_init,
+    .list = vnc_list,
+    .spawn = NULL,
+    .alive = vnc_alive,
+    .capture = vnc_capture,
+    .generation = vnc_generation,
+    .focus = NULL,
+    .key = vnc_key,
+    .text = NULL,
+    .grep = NULL,
+    .page = NULL,
+    .follow = NULL,
+    .output = NULL,
+};
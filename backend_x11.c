@@ -0,0 +1,460 @@
+/* ============================================================================
+ * X11 backend: terminal windows of a Linux desktop.
+ *
+ * Windows are the clients listed by the window manager in _NET_CLIENT_LIST
+ * (or the top level windows, without a window manager), and terminals are
+ * recognized by their WM_CLASS. Keystrokes are injected with XTest into
+ * the focused window.
+ *
+ * Captures go through a MIT-SHM segment: the X server writes the window
+ * pixels straight into memory we share with it, instead of sending them
+ * over the socket. The segment of the captured window is kept, and an
+ * XDamage object tells when the window changed: until then captures are
+ * served from the segment without asking the server at all.
+ *
+ * Xlib is used from the bot and the screenshot threads, so every call is
+ * made with X11Lock held.
+ * ==========================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/Xatom.h>
+#include <X11/XKBlib.h>
+#include <X11/keysym.h>
+#include <X11/extensions/XShm.h>
+#include <X11/extensions/XTest.h>
+#include <X11/extensions/Xdamage.h>
+
+#include "backend.h"
+
+#define X11_MAX_WINDOWS 256
+
+/* The captured window: its shared memory image holds the last capture,
+ * valid until the window is damaged. */
+typedef struct X11Capture {
+    Window win;                 /* None if nothing is captured. */
+    Damage damage;
+    int damaged;                /* Changed since the image was taken. */
+    XImage *image;              /* NULL until the first capture. */
+    XShmSegmentInfo shm;
+    uint64_t generation;        /* Changes while the window is damaged. */
+} X11Capture;
+
+static Display *Dpy;
+static Window Root;
+static int DamageEvent;         /* Event base of the XDamage extension. */
+static KeyCode SpareKeycode;    /* Remapped for characters not in the
+                                   keyboard map, 0 if there is none. */
+static KeySym SpareKeysym;      /* Currently mapped to SpareKeycode. */
+static Atom AtomClientList, AtomWmName, AtomUtf8, AtomWmPid, AtomActive;
+static X11Capture Capture = {None, None, 0, NULL, {0}};
+static int X11Error;            /* Set by the error handler. */
+static pthread_mutex_t X11Lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* The default handler exits the process: windows can go away at any time,
+ * so errors are just recorded and checked after XSync(). */
+static int x11_error_handler(Display *dpy, XErrorEvent *ev) {
+    (void)dpy;
+    (void)ev;
+    X11Error = 1;
+    return 0;
+}
+
+/* Return a keycode without keysyms, that can be remapped at will. */
+static KeyCode x11_spare_keycode(void) {
+    int min, max, per;
+    XDisplayKeycodes(Dpy, &min, &max);
+    KeySym *map = XGetKeyboardMapping(Dpy, min, max-min+1, &per);
+    if (!map) return 0;
+    KeyCode spare = 0;
+    for (int kc = max; kc >= min && !spare; kc--) {
+        int empty = 1;
+        for (int j = 0; j < per; j++) {
+            if (map[(kc-min)*per + j] != NoSymbol) empty = 0;
+        }
+        if (empty) spare = kc;
+    }
+    XFree(map);
+    return spare;
+}
+
+/* Connect to the display 'arg', or to $DISPLAY. */
+static int x11_init(const char *arg) {
+    Dpy = XOpenDisplay(arg);
+    if (!Dpy) return -1;
+    XSetErrorHandler(x11_error_handler);
+    Root = DefaultRootWindow(Dpy);
+
+    int major, minor, error_base, event_base;
+    Bool pixmaps;
+    if (!XShmQueryVersion(Dpy, &major, &minor, &pixmaps) ||
+        !XTestQueryExtension(Dpy, &event_base, &error_base, &major, &minor) ||
+        !XDamageQueryExtension(Dpy, &DamageEvent, &error_base))
+    {
+        fprintf(stderr, "The X server lacks MIT-SHM, XTEST or DAMAGE.\n");
+        XCloseDisplay(Dpy);
+        return -1;
+    }
+
+    AtomClientList = XInternAtom(Dpy, "_NET_CLIENT_LIST", False);
+    AtomWmName = XInternAtom(Dpy, "_NET_WM_NAME", False);
+    AtomUtf8 = XInternAtom(Dpy, "UTF8_STRING", False);
+    AtomWmPid = XInternAtom(Dpy, "_NET_WM_PID", False);
+    AtomActive = XInternAtom(Dpy, "_NET_ACTIVE_WINDOW", False);
+    SpareKeycode = x11_spare_keycode();
+    return 0;
+}
+
+/* ============================================================================
+ * Windows
+ * ==========================================================================*/
+
+/* Return the value of a window property of the given type, that must be
+ * freed with XFree(), or NULL. Sets '*count' to the number of items. */
+static unsigned char *x11_property(Window win, Atom prop, Atom type,
+                                   unsigned long *count)
+{
+    Atom actual;
+    int format;
+    unsigned long after;
+    unsigned char *data = NULL;
+    *count = 0;
+    if (XGetWindowProperty(Dpy, win, prop, 0, 65536, False, type, &actual,
+                           &format, count, &after, &data) != Success) return NULL;
+    if (actual != type) {
+        if (data) XFree(data);
+        *count = 0;
+        return NULL;
+    }
+    return data;
+}
+
+/* Fill the fields of 's' for the window. Returns -1 if it is not a
+ * terminal and 'all' is false, or if it has no class. */
+static int x11_describe(Window win, int all, Session *s) {
+    XClassHint hint;
+    if (!XGetClassHint(Dpy, win, &hint)) return -1;
+    int terminal = backendIsTerminal(hint.res_class) ||
+                   backendIsTerminal(hint.res_name);
+    snprintf(s->owner, sizeof(s->owner), "%s",
+             hint.res_class ? hint.res_class : "");
+    if (hint.res_name) XFree(hint.res_name);
+    if (hint.res_class) XFree(hint.res_class);
+    if (!terminal && !all) return -1;
+
+    s->id = win;
+    unsigned long count;
+    unsigned char *pid = x11_property(win, AtomWmPid, XA_CARDINAL, &count);
+    s->pid = pid && count ? (pid_t)*(unsigned long *)pid : 0;
+    if (pid) XFree(pid);
+
+    s->title[0] = '\0';
+    unsigned char *name = x11_property(win, AtomWmName, AtomUtf8, &count);
+    if (name) {
+        snprintf(s->title, sizeof(s->title), "%.*s", (int)count, name);
+        XFree(name);
+    } else {
+        char *legacy;
+        if (XFetchName(Dpy, win, &legacy) && legacy) {
+            snprintf(s->title, sizeof(s->title), "%s", legacy);
+            XFree(legacy);
+        }
+    }
+    return 0;
+}
+
+/* Return the windows managed by the window manager. Without one, like on a
+ * bare Xvfb, the mapped top level windows. */
+static Session *x11_list(int all, int *count) {
+    *count = 0;
+    Session *sessions = malloc(sizeof(Session) * X11_MAX_WINDOWS);
+    if (!sessions) return NULL;
+
+    pthread_mutex_lock(&X11Lock);
+    unsigned long n;
+    Window *wins = (Window *)x11_property(Root, AtomClientList, XA_WINDOW, &n);
+    Window *children = NULL;
+    if (!wins) {
+        Window root, parent;
+        unsigned int nchildren;
+        if (XQueryTree(Dpy, Root, &root, &parent, &children, &nchildren)) {
+            wins = children;
+            n = nchildren;
+        }
+    }
+    for (unsigned long j = 0; j < n && *count < X11_MAX_WINDOWS; j++) {
+        if (children) {
+            XWindowAttributes wa;
+            if (!XGetWindowAttributes(Dpy, wins[j], &wa) ||
+                wa.map_state != IsViewable || wa.override_redirect) continue;
+        }
+        if (x11_describe(wins[j], all, &sessions[*count]) == 0) (*count)++;
+    }
+    if (wins) XFree(wins);
+    XSync(Dpy, False);
+    X11Error = 0;
+    pthread_mutex_unlock(&X11Lock);
+    return sessions;
+}
+
+static int x11_alive(Session *s) {
+    pthread_mutex_lock(&X11Lock);
+    XWindowAttributes wa;
+    X11Error = 0;
+    int alive = XGetWindowAttributes(Dpy, s->id, &wa) && !X11Error;
+    pthread_mutex_unlock(&X11Lock);
+    return alive;
+}
+
+/* ============================================================================
+ * Capture
+ * ==========================================================================*/
+
+/* Release the image and the damage of the captured window. */
+static void x11_release_capture(void) {
+    if (Capture.image) {
+        XShmDetach(Dpy, &Capture.shm);
+        XDestroyImage(Capture.image);
+        shmdt(Capture.shm.shmaddr);
+        Capture.image = NULL;
+    }
+    if (Capture.damage != None) XDamageDestroy(Dpy, Capture.damage);
+    Capture.damage = None;
+    Capture.win = None;
+}
+
+/* Create the shared image for a window of the given size and depth. */
+static int x11_create_image(Visual *visual, int depth, int width, int height) {
+    XImage *img = XShmCreateImage(Dpy, visual, depth, ZPixmap, NULL,
+                                  &Capture.shm, width, height);
+    if (!img) return -1;
+    Capture.shm.shmid = shmget(IPC_PRIVATE, (size_t)img->bytes_per_line*height,
+                               IPC_CREAT|0600);
+    if (Capture.shm.shmid == -1) {
+        XDestroyImage(img);
+        return -1;
+    }
+    Capture.shm.shmaddr = img->data = shmat(Capture.shm.shmid, NULL, 0);
+    Capture.shm.readOnly = False;
+    X11Error = 0;
+    int attached = img->data != (char *)-1 && XShmAttach(Dpy, &Capture.shm);
+    XSync(Dpy, False);
+    /* Marked for removal now, so it goes away with the last detach even
+     * if the bot is killed. */
+    shmctl(Capture.shm.shmid, IPC_RMID, NULL);
+    if (!attached || X11Error) {
+        if (img->data != (char *)-1) shmdt(img->data);
+        img->data = NULL;
+        XDestroyImage(img);
+        return -1;
+    }
+    Capture.image = img;
+    return 0;
+}
+
+/* Read the damage notifications received so far, and refresh the
+ * keyboard map cached by Xlib when it changes, like after remapping the
+ * spare keycode. */
+static void x11_drain_events(void) {
+    while (XPending(Dpy)) {
+        XEvent ev;
+        XNextEvent(Dpy, &ev);
+        if (ev.type == MappingNotify) {
+            XRefreshKeyboardMapping(&ev.xmapping);
+        } else if (ev.type == DamageEvent + XDamageNotify &&
+            ((XDamageNotifyEvent *)&ev)->drawable == Capture.win)
+        {
+            Capture.damaged = 1;
+        }
+    }
+}
+
+/* Make the shared image hold the current contents of the window. The
+ * server is asked only if the window changed since the last capture. */
+static int x11_refresh_image(Window win) {
+    XWindowAttributes wa;
+    X11Error = 0;
+    if (!XGetWindowAttributes(Dpy, win, &wa) || X11Error ||
+        wa.map_state != IsViewable) return -1;
+
+    int resized = Capture.image && (Capture.image->width != wa.width ||
+                                    Capture.image->height != wa.height);
+    if (Capture.win != win || resized) {
+        x11_release_capture();
+        if (x11_create_image(wa.visual, wa.depth, wa.width, wa.height) == -1)
+            return -1;
+        Capture.win = win;
+        Capture.damage = XDamageCreate(Dpy, win, XDamageReportNonEmpty);
+        Capture.damaged = 1;
+    }
+
+    /* Only 32 bit pixels with 8 bit channels are supported: they are the
+     * BGRA frame format, alpha aside. */
+    XImage *img = Capture.image;
+    if (img->bits_per_pixel != 32 || img->red_mask != 0xff0000 ||
+        img->green_mask != 0xff00 || img->blue_mask != 0xff) return -1;
+
+    x11_drain_events();
+    if (!Capture.damaged) return 0;
+    /* Reset the damage before reading, so changes made while reading
+     * are notified again. */
+    XDamageSubtract(Dpy, Capture.damage, None, None);
+    Capture.damaged = 0;
+    X11Error = 0;
+    if (!XShmGetImage(Dpy, win, img, 0, 0, AllPlanes) || X11Error) {
+        Capture.damaged = 1;
+        return -1;
+    }
+    return 0;
+}
+
+/* Only the captured window is watched for damage: others are unknown. */
+static uint64_t x11_generation(uint32_t id) {
+    pthread_mutex_lock(&X11Lock);
+    uint64_t generation = 0;
+    if (Capture.win == id) {
+        x11_drain_events();
+        if (Capture.damaged) Capture.generation++;
+        generation = Capture.generation;
+    }
+    pthread_mutex_unlock(&X11Lock);
+    return generation;
+}
+
+static Frame *x11_capture(uint32_t id, const double *region) {
+    pthread_mutex_lock(&X11Lock);
+    if (x11_refresh_image(id) == -1) {
+        pthread_mutex_unlock(&X11Lock);
+        return NULL;
+    }
+
+    XImage *img = Capture.image;
+    int x = 0, y = 0, width = img->width, height = img->height;
+    if (region) {
+        x = img->width * region[0] / 100;
+        y = img->height * region[1] / 100;
+        width = img->width * region[2] / 100;
+        height = img->height * region[3] / 100;
+        if (x < 0) x = 0;
+        if (y < 0) y = 0;
+        if (x + width > img->width) width = img->width - x;
+        if (y + height > img->height) height = img->height - y;
+    }
+    Frame *f = NULL;
+    if (width > 0 && height > 0) {
+        /* The only copy: the alpha byte of X pixels is undefined, frames
+         * must be opaque. */
+        f = frameCreate(width, height);
+        for (int j = 0; j < height; j++) {
+            const uint32_t *src = (const uint32_t *)(img->data +
+                (size_t)(y+j)*img->bytes_per_line) + x;
+            uint32_t *dst = (uint32_t *)(f->pixels + (size_t)j*f->stride);
+            for (int i = 0; i < width; i++) dst[i] = src[i] | 0xff000000;
+        }
+    }
+    pthread_mutex_unlock(&X11Lock);
+    return f;
+}
+
+/* ============================================================================
+ * Keyboard
+ * ==========================================================================*/
+
+/* Activate the window: through the window manager if there is one, and
+ * directly for the bare server case. */
+static void x11_focus(const Session *s) {
+    pthread_mutex_lock(&X11Lock);
+    XEvent ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.xclient.type = ClientMessage;
+    ev.xclient.window = s->id;
+    ev.xclient.message_type = AtomActive;
+    ev.xclient.format = 32;
+    ev.xclient.data.l[0] = 2;   /* Source: pager, like tools acting for
+                                   the user. */
+    ev.xclient.data.l[1] = CurrentTime;
+    XSendEvent(Dpy, Root, False,
+               SubstructureRedirectMask|SubstructureNotifyMask, &ev);
+    XRaiseWindow(Dpy, s->id);
+    XSetInputFocus(Dpy, s->id, RevertToParent, CurrentTime);
+    XSync(Dpy, False);
+    X11Error = 0;
+    pthread_mutex_unlock(&X11Lock);
+}
+
+static void x11_press(KeySym sym, int down) {
+    KeyCode kc = XKeysymToKeycode(Dpy, sym);
+    if (kc) XTestFakeKeyEvent(Dpy, kc, down, CurrentTime);
+}
+
+/* Type the key into the focused window. Characters missing from the
+ * keyboard map are typed by remapping a spare keycode to them. */
+static void x11_key(const Session *s, int key, uint32_t ch, int mods) {
+    (void)s;
+    KeySym sym;
+    if (key == KEY_RETURN) sym = XK_Return;
+    else if (key == KEY_TAB) sym = XK_Tab;
+    else if (key == KEY_ESCAPE) sym = XK_Escape;
+    else if ((ch >= 0x20 && ch < 0x7f) || (ch >= 0xa0 && ch <= 0xff)) sym = ch;
+    else sym = 0x01000000 | ch;     /* Unicode keysym. */
+
+    pthread_mutex_lock(&X11Lock);
+    x11_drain_events();
+    KeyCode kc = XKeysymToKeycode(Dpy, sym);
+    int shift = 0;
+    /* The map cached by Xlib may lag behind the last remapping: what the
+     * spare keycode types is tracked here instead. */
+    if (kc && kc == SpareKeycode) kc = 0;
+    if (kc) {
+        if (XkbKeycodeToKeysym(Dpy, kc, 0, 0) != sym) shift = 1;
+        if (shift && XkbKeycodeToKeysym(Dpy, kc, 0, 1) != sym) kc = 0;
+    }
+    if (!kc && SpareKeycode) {
+        if (SpareKeysym != sym) {
+            KeySym syms[2] = {sym, sym};
+            XChangeKeyboardMapping(Dpy, SpareKeycode, 2, syms, 1);
+            XSync(Dpy, False);
+            SpareKeysym = sym;
+        }
+        kc = SpareKeycode;
+        shift = 0;
+    }
+    if (kc) {
+        if (mods & MOD_CTRL) x11_press(XK_Control_L, True);
+        if (mods & MOD_ALT) x11_press(XK_Alt_L, True);
+        if (mods & MOD_CMD) x11_press(XK_Super_L, True);
+        if (shift) x11_press(XK_Shift_L, True);
+        XTestFakeKeyEvent(Dpy, kc, True, CurrentTime);
+        XTestFakeKeyEvent(Dpy, kc, False, CurrentTime);
+        if (shift) x11_press(XK_Shift_L, False);
+        if (mods & MOD_CMD) x11_press(XK_Super_L, False);
+        if (mods & MOD_ALT) x11_press(XK_Alt_L, False);
+        if (mods & MOD_CTRL) x11_press(XK_Control_L, False);
+        XSync(Dpy, False);
+    }
+    pthread_mutex_unlock(&X11Lock);
+}
+
+Backend X11Backend = {
+    .name = "x11",
+    .init = x11_init,
+    .list = x11_list,
+    .spawn = NULL,
+    .alive = x11_alive,
+    .capture = x11_capture,
+    .generation = x11_generation,
+    .focus = x11_focus,
+    .key = x11_key,
+    .text = NULL,
+    .grep = NULL,
+    .page = NULL,
+    .follow = NULL,
+    .output = NULL,
+};
@@ -0,0 +1,252 @@
+/* ============================================================================
+ * tgbench: throughput of the terminal emulator and of the renderer.
+ *
+ * Usage: tgbench [file ...]
+ *
+ * Every file is a recorded output stream, for instance captured with
+ * 'script -q out.txt make', fed to a 40x120 screen in 4 KB reads like the
+ * pty reader does. Without arguments two synthetic streams are used: a
+ * compiler log, that is mostly scrolling colored lines, and an agent TUI
+ * that redraws a boxed region with cursor movements, 256 colors and
+ * UTF-8 text. The TUI screen is then rendered, to time full and single
+ * row updates of a RENDER_ROWSxRENDER_COLS screen, and the scrollback left
+ * by the compiler log is searched like .grep does.
+ * ==========================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+
+#include "vt.h"
+#include "render.h"
+#include "xmalloc.h"
+
+#define BENCH_ROWS 40
+#define BENCH_COLS 120
+#define BENCH_READ 4096             /* Bytes per vtWrite(), like a read(). */
+#define BENCH_MIN_BYTES (256<<20)   /* Bytes to feed for every stream. */
+#define RENDER_ROWS 60
+#define RENDER_COLS 200
+#define RENDER_RUNS 1000
+#define HISTORY_SIZE (16*1024*1024)  /* Scrollback of the sessions. */
+#define HISTORY_LINES 500000
+#define GREP_RUNS 20
+
+/* The emulator uses the bot allocator, here it is plain malloc(). */
+void *xmalloc(size_t size) {
+    void *p = malloc(size);
+    if (!p) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    return p;
+}
+
+void *xrealloc(void *ptr, size_t size) {
+    void *p = realloc(ptr, size);
+    if (!p) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    return p;
+}
+
+void *xalignedalloc(size_t alignment, size_t size) {
+    void *p = aligned_alloc(alignment, size);
+    if (!p) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    return p;
+}
+
+void xcharge(void *ptr, const char *subsystem) {
+    (void)ptr;
+    (void)subsystem;
+}
+
+void xfree(void *ptr) {
+    free(ptr);
+}
+
+typedef struct Stream {
+    char *buf;
+    size_t len, cap;
+} Stream;
+
+/* Append formatted text to the stream. */
+static void append(Stream *s, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(NULL, 0, fmt, ap);
+    va_end(ap);
+    if (s->len + n + 1 > s->cap) {
+        s->cap = (s->len + n + 1) * 2;
+        s->buf = xrealloc(s->buf, s->cap);
+    }
+    va_start(ap, fmt);
+    vsnprintf(s->buf + s->len, n + 1, fmt, ap);
+    va_end(ap);
+    s->len += n;
+}
+
+/* Lines like the ones of a C build with warnings. */
+static void make_compiler_log(Stream *s) {
+    for (int j = 0; j < 20000; j++) {
+        if (j % 10 == 0) {
+            append(s, "\033[1mmodule_%d.c:%d:%d: \033[1;35mwarning: \033[0m"
+                      "\033[1munused variable 'tmp%d' [-Wunused-variable]\033[0m\r\n"
+                      "  %d |     int tmp%d = compute(a, b);\r\n"
+                      "     |         \033[1;32m^~~~\033[0m\r\n",
+                   j/10, j%500, j%40, j, j%500, j);
+        } else {
+            append(s, "cc -Wall -O2 -Iinclude -c src/module_%d.c "
+                      "-o build/module_%d.o\r\n", j, j);
+        }
+    }
+}
+
+/* Frames of a full screen program: a status line, a spinner, and a box
+ * of output redrawn in place. */
+static void make_agent_tui(Stream *s) {
+    static const char *spinner[] = {"⠋","⠙","⠹","⠸","⠼","⠴","⠦","⠧"};
+    append(s, "\033[?1049h\033[?25l\033[2J");
+    for (int f = 0; f < 3000; f++) {
+        append(s, "\033[1;1H\033[48;5;236m\033[38;5;250m %s Working… "
+                  "(%ds · ↓ %d tokens)\033[K\033[0m",
+               spinner[f % 8], f / 10, f * 37);
+        append(s, "\033[3;1H\033[38;5;244m╭");
+        for (int x = 0; x < BENCH_COLS-2; x++) append(s, "─");
+        append(s, "╮\033[0m");
+        for (int y = 0; y < 30; y++) {
+            append(s, "\033[%d;1H\033[38;5;244m│\033[0m ", y+4);
+            append(s, "\033[38;2;%d;%d;200m%4d\033[0m  ", (y*8)&255, (f*3)&255,
+                   f+y);
+            append(s, "\033[1mdef\033[0m \033[33mhandler_%d\033[0m(request, "
+                      "context): \033[3m# étape %d\033[0m\033[K",
+                   f+y, y);
+            append(s, "\033[%d;%dH\033[38;5;244m│\033[0m", y+4, BENCH_COLS);
+        }
+        append(s, "\033[34;1H\033[38;5;244m╰");
+        for (int x = 0; x < BENCH_COLS-2; x++) append(s, "─");
+        append(s, "╯\033[0m\033[36;1H\033[2K> \033[7m \033[0m");
+    }
+}
+
+static int read_file(Stream *s, const char *path) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return -1;
+    char buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+        if (s->len + n > s->cap) {
+            s->cap = (s->len + n) * 2;
+            s->buf = xrealloc(s->buf, s->cap);
+        }
+        memcpy(s->buf + s->len, buf, n);
+        s->len += n;
+    }
+    fclose(fp);
+    return 0;
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Feed the stream repeatedly and print the throughput. Lines scrolled off
+ * the screen go to 'sb', like in the sessions. */
+static void bench(const char *name, const Stream *s, Scrollback *sb) {
+    if (s->len == 0) return;
+    VtScreen *vt = vtCreate(BENCH_ROWS, BENCH_COLS);
+    vt->scrollback = sb;
+    size_t total = 0;
+    double start = now();
+    while (total < BENCH_MIN_BYTES) {
+        for (size_t j = 0; j < s->len; j += BENCH_READ) {
+            size_t n = s->len - j < BENCH_READ ? s->len - j : BENCH_READ;
+            vtWrite(vt, s->buf + j, n);
+            vt->replylen = 0;
+        }
+        total += s->len;
+    }
+    double secs = now() - start;
+    printf("%-20s %8.1f MB/s  (%zu KB stream)\n", name,
+           total / secs / (1024*1024), s->len / 1024);
+    vtFree(vt);
+}
+
+/* Time a search of the scrollback. */
+static void bench_grep(const Scrollback *sb, const char *pattern) {
+    double start = now();
+    size_t len = 0;
+    for (int j = 0; j < GREP_RUNS; j++) {
+        sds res = scrollbackGrep(sb, NULL, 0, pattern);
+        len += sdslen(res);
+        sdsfree(res);
+    }
+    double secs = (now() - start) / GREP_RUNS;
+    printf("grep %-15s %8.3f ms  (%llu lines, %zu KB, %zu bytes result)\n",
+           pattern, secs*1000, (unsigned long long)(sb->next - sb->first),
+           (sb->wrap_line > sb->first ? sb->size : sb->wpos) / 1024,
+           len / GREP_RUNS);
+}
+
+/* Time the renderer on the screen left by the stream. */
+static void bench_render(const Stream *s) {
+    VtScreen *vt = vtCreate(RENDER_ROWS, RENDER_COLS);
+    vtWrite(vt, s->buf, s->len);
+    Renderer *r = renderCreate(RENDER_ROWS, RENDER_COLS);
+    uint64_t all[(RENDER_ROWS+63)/64], one[(RENDER_ROWS+63)/64];
+    memset(all, 0xff, sizeof(all));
+    memset(one, 0, sizeof(one));
+    one[0] = 1;
+    renderScreen(r, vt, all);
+
+    double start = now();
+    for (int j = 0; j < RENDER_RUNS; j++) renderScreen(r, vt, all);
+    double full = (now() - start) / RENDER_RUNS;
+    start = now();
+    for (int j = 0; j < RENDER_RUNS; j++) renderScreen(r, vt, one);
+    double row = (now() - start) / RENDER_RUNS;
+
+    printf("render %dx%d         %8.3f ms full, %.3f ms one row "
+           "(atlas %llu hits, %llu misses)\n", RENDER_COLS, RENDER_ROWS,
+           full*1000, row*1000, (unsigned long long)r->hits,
+           (unsigned long long)r->misses);
+    renderFree(r);
+    vtFree(vt);
+}
+
+int main(int argc, char **argv) {
+    Scrollback *sb = scrollbackCreate(HISTORY_SIZE, HISTORY_LINES);
+    if (argc == 1) {
+        Stream log = {0}, tui = {0};
+        make_compiler_log(&log);
+        make_agent_tui(&tui);
+        bench("compiler log", &log, sb);
+        bench_grep(sb, "module_19999.c");
+        bench_grep(sb, "warning");
+        bench("agent TUI", &tui, NULL);
+        bench_render(&tui);
+        xfree(log.buf);
+        xfree(tui.buf);
+        scrollbackFree(sb);
+        return 0;
+    }
+    for (int j = 1; j < argc; j++) {
+        Stream s = {0};
+        if (read_file(&s, argv[j]) == -1) {
+            perror(argv[j]);
+            return 1;
+        }
+        bench(argv[j], &s, sb);
+        xfree(s.buf);
+    }
+    scrollbackFree(sb);
+    return 0;
+}
@@ -2,11 +2,34 @@
  * bot.c - Telegram bot to control terminal windows on macOS
  *
  * Allows capturing screenshots and sending keystrokes to terminal applications
- * (Terminal, iTerm2, Ghostty, kitty, etc.) via Telegram messages.
+ * (Terminal, iTerm2, Ghostty, kitty, etc.) via Telegram messages, also on
+ * X11 desktops. With the pty backend it runs its own shells in pseudo
+ * terminals instead, with the tmux backend it drives the panes of a tmux
+ * server, and with the vnc backend a remote desktop.
  *
  * Commands:
  *   .list    - List available terminal windows
  *   .1 .2 .. - Connect to window by number
+ *   .new     - Start a new session (pty and tmux backends)
+ *   .color   - Screenshot colors: auto, gray or mono
+ *   .width   - Downscale screenshots to the given width
+ *   .crop    - Toggle removal of blank areas from screenshots
+ *   .tail N  - Screenshot of the last N text lines only
+ *   .zoom    - Save and capture named regions of the window
+ *   .cache   - Show the uploaded screenshots cache statistics
+ *   .pipeline - Show the screenshot pipeline statistics
+ *   .stats   - Show the latency of every stage of the requests
+ *   .slowlog - Show the slowest recent requests, stage by stage
+ *   .memory  - Show the memory allocated by every subsystem
+ *   .progressive - Toggle sending a quick preview before screenshots
+ *   .latency - Adapt screenshot quality to a delivery time target
+ *   .sampler - Toggle background sampling for instant refresh
+ *   .live    - Keep one screenshot message updated as the window changes
+ *   .follow  - Stream the output of the session as text
+ *   .stop    - Stop the live view and the output stream
+ *   .text    - Send the window contents as text instead of screenshots
+ *   .grep    - Search the output, scrollback included
+ *   .scroll  - Send a page of the scrollback as text
  *   .help    - Show help
  *
  * Once connected, any text is sent as keystrokes (newline auto-added).
@@ -21,46 +44,33 @@
 #include <unistd.h>
 #include <ctype.h>
 #include <pthread.h>
-
-#include <CoreGraphics/CoreGraphics.h>
-#include <CoreFoundation/CoreFoundation.h>
-#include <ImageIO/ImageIO.h>
-#include <ApplicationServices/ApplicationServices.h>
+#include <sys/stat.h>
+#include <time.h>
 
 #include "botlib.h"
+#include "backend.h"
 #include "sha1.h"
 #include "qrcodegen.h"
+#include "frame.h"
+#include "png.h"
+#include "pipeline.h"
+#include "pool.h"
+#include "quality.h"
+#include "stats.h"
+#include "slowlog.h"
+#include "trace.h"
+#include "alloc.h"
+#include "metrics.h"
 
 /* ============================================================================
  * Terminal Window Management
  * ========================================================================= */
 
-#define kVK_Return    0x24
-#define kVK_Tab       0x30
-#define kVK_Escape    0x35
-
-#define MOD_CTRL    (1<<0)
-#define MOD_ALT     (1<<1)
-#define MOD_CMD     (1<<2)
-
-/* Known terminal application names. */
-static const char *TerminalApps[] = {
-    "Terminal", "iTerm2", "iTerm", "Ghostty", "kitty", "Alacritty",
-    "Hyper", "Warp", "WezTerm", "Tabby", NULL
-};
-
-/* Window information. */
-typedef struct {
-    CGWindowID window_id;
-    pid_t pid;
-    char owner[128];
-    char title[256];
-} WinInfo;
-
 /* Global state. */
 static pthread_mutex_t RequestLock = PTHREAD_MUTEX_INITIALIZER;
+static Backend *Platform = NULL;      /* Backend implementing the sessions. */
 static int DangerMode = 0;            /* If 1, show all windows, not just terminals. */
-static WinInfo *WindowList = NULL;    /* Cached window list for .list display. */
+static Session *WindowList = NULL;    /* Cached window list for .list display. */
 static int WindowCount = 0;           /* Number of windows in list. */
 
 /* TOTP authentication state. */
@@ -69,12 +79,86 @@ static int Authenticated = 0;        /* Whether OTP has been verified. */
 static time_t LastActivity = 0;      /* Last time owner sent a valid command. */
 static int OtpTimeout = 300;         /* Timeout in seconds (default 5 min). */
 
+/* Screenshot settings. */
+static int ColorMode = PNG_COLOR_AUTO; /* PNG_COLOR_* used for screenshots. */
+static const char *ColorModeNames[] = {"auto", "gray", "mono", NULL};
+static int ScaleWidth = 0;             /* Max screenshot width, 0 = native. */
+static int AutoCrop = 1;               /* Remove blank areas and chrome. */
+static int Progressive = 0;            /* Send a preview first. */
+
+#define ZOOM_NAME_MAX 32                /* Max length of .zoom region names. */
+#define TAIL_MAX_LINES 200              /* Max lines for .tail. */
+#define CROP_MARGIN 8                  /* Pixels kept around the content. */
+
+/* Cache of the Telegram file_id of uploaded screenshots, by content hash. */
+#define FILEID_CACHE_LEN 64             /* Entries kept in memory. */
+#define FILEID_TTL (86400*30)           /* Seconds entries are kept in the DB. */
+#define HASH_HEX_LEN (SHA1_DIGEST_SIZE*2)
+
+typedef struct FileIdEntry {
+    char hash[HASH_HEX_LEN+1];  /* Hex SHA1 of the frame, "" if unused. */
+    sds file_id;                /* Telegram file_id of the uploaded photo. */
+    size_t size;                /* Size of the PNG file we uploaded. */
+} FileIdEntry;
+
+static FileIdEntry FileIdCache[FILEID_CACHE_LEN];
+static int FileIdNext = 0;              /* Next entry to replace. */
+static uint64_t FileIdHits = 0;         /* Screenshots sent by file_id. */
+static uint64_t FileIdMisses = 0;       /* Screenshots uploaded. */
+static uint64_t UploadedBytes = 0;      /* Bytes of uploaded screenshots. */
+static uint64_t SavedBytes = 0;         /* Bytes not uploaded thanks to hits. */
+static pthread_mutex_t FileIdLock = PTHREAD_MUTEX_INITIALIZER; /* Protects
+                                           the cache and its counters. */
+
+/* Screenshots are captured, encoded and uploaded by a pipeline of threads,
+ * see the Screenshot Pipeline section. */
+#define PIPELINE_QUEUE_LEN 2            /* Jobs waiting for every stage. */
+#define UPLOAD_STAGE 2                  /* Index of the upload stage. */
+#define PREVIEW_WIDTH 480               /* Width of progressive previews. */
+static Pipeline *ScreenshotPipeline = NULL;
+static const char *DbPath = NULL;       /* Database, for pipeline threads. */
+
+/* Background sampler state. */
+#define SAMPLER_INTERVAL 2              /* Seconds between samples. */
+#define SHOWN_CACHE_LEN 16              /* Messages whose frame we track. */
+static int Sampler = 0;                 /* Sample the window in background. */
+static uint64_t LastInputUs = 0;        /* When keystrokes were last sent. */
+
+/* Live view state. */
+#define LIVE_MIN_INTERVAL 5             /* Min seconds between live edits. */
+#define LIVE_DEFAULT_MINUTES 10         /* .live duration if not given. */
+#define LIVE_MAX_MINUTES 240            /* Max .live duration. */
+static int64_t LiveChat = 0;            /* Chat of the live view, 0 if off. */
+static int64_t LiveMsgId = 0;           /* Its message, 0 until sent. */
+static time_t LiveUntil = 0;            /* When the live view ends. */
+static uint64_t LiveEditUs = 0;         /* When we last edited the message. */
+static pthread_mutex_t LiveLock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Output streaming state. */
+#define FOLLOW_POLL_MS 250              /* How often new output is read. */
+#define FOLLOW_DEBOUNCE_MS 500          /* Quiet time before an edit. */
+#define FOLLOW_MIN_INTERVAL_MS 1500     /* Min time between edits. */
+#define FOLLOW_MAX_DELAY_MS 5000        /* Max time output waits, if it
+                                           never stops. */
+#define FOLLOW_DEFAULT_MINUTES 30       /* .follow duration if not given. */
+#define FOLLOW_MAX_MINUTES 240          /* Max .follow duration. */
+static int64_t FollowChat = 0;          /* Chat of the stream, 0 if off. */
+static Session FollowSession;           /* Session whose output we stream. */
+static time_t FollowUntil = 0;          /* When the stream ends. */
+static uint64_t FollowGen = 0;          /* Incremented at every start and
+                                           stop, to tell streams apart. */
+static pthread_mutex_t FollowLock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Slow log. */
+#define SLOWLOG_SHOW 10                 /* Entries .slowlog shows by default. */
+
+/* Text snapshots. */
+#define TEXT_CHUNK_MAX 4096             /* Telegram message length limit. */
+static int TextMode = 0;                /* Reply with text, not screenshots. */
+
 /* Connected window - stored directly, not as index. */
 static int Connected = 0;             /* 1 if connected, 0 otherwise. */
-static CGWindowID ConnectedWid = 0;   /* Window ID of connected window. */
-static pid_t ConnectedPid = 0;        /* PID of connected window. */
-static char ConnectedOwner[128];      /* Owner name for display. */
-static char ConnectedTitle[256];      /* Title for display. */
+static Session ConnectedSession;      /* Connected window. */
 
 /* ============================================================================
  * TOTP Authentication
@@ -308,14 +392,6 @@ int ends_with_purple_heart(const char *text) {
  * Window Functions
  * ========================================================================= */
 
-/* Check if app name is a known terminal. */
-int is_terminal_app(const char *name) {
-    for (int i = 0; TerminalApps[i]; i++) {
-        if (strcasestr(name, TerminalApps[i])) return 1;
-    }
-    return 0;
-}
-
 /* Free the cached window list. */
 void free_window_list(void) {
     if (WindowList) {
@@ -328,303 +404,315 @@ void free_window_list(void) {
 /* Refresh the window list. Returns number of windows found. */
 int refresh_window_list(void) {
     free_window_list();
-
-    CFArrayRef list = CGWindowListCopyWindowInfo(
-        kCGWindowListOptionOnScreenOnly | kCGWindowListExcludeDesktopElements,
-        kCGNullWindowID
-    );
-    if (!list) return 0;
-
-    CFIndex count = CFArrayGetCount(list);
-
-    /* Allocate maximum possible size. */
-    WindowList = malloc(count * sizeof(WinInfo));
-    if (!WindowList) {
-        CFRelease(list);
-        return 0;
-    }
-
-    for (CFIndex i = 0; i < count; i++) {
-        CFDictionaryRef info = CFArrayGetValueAtIndex(list, i);
-
-        /* Get owner name. */
-        CFStringRef owner_ref = CFDictionaryGetValue(info, kCGWindowOwnerName);
-        if (!owner_ref) continue;
-
-        char owner[128];
-        if (!CFStringGetCString(owner_ref, owner, sizeof(owner), kCFStringEncodingUTF8))
-            continue;
-
-        /* Filter to terminals only unless in danger mode. */
-        if (!DangerMode && !is_terminal_app(owner)) continue;
-
-        /* Get window ID and PID. */
-        CFNumberRef wid_ref = CFDictionaryGetValue(info, kCGWindowNumber);
-        CFNumberRef pid_ref = CFDictionaryGetValue(info, kCGWindowOwnerPID);
-        if (!wid_ref || !pid_ref) continue;
-
-        CGWindowID wid;
-        pid_t pid;
-        CFNumberGetValue(wid_ref, kCGWindowIDCFNumberType, &wid);
-        CFNumberGetValue(pid_ref, kCFNumberIntType, &pid);
-
-        /* Only layer 0. */
-        CFNumberRef layer_ref = CFDictionaryGetValue(info, kCGWindowLayer);
-        int layer = 0;
-        if (layer_ref) CFNumberGetValue(layer_ref, kCFNumberIntType, &layer);
-        if (layer != 0) continue;
-
-        /* Must have reasonable size. */
-        CFDictionaryRef bounds_dict = CFDictionaryGetValue(info, kCGWindowBounds);
-        if (!bounds_dict) continue;
-
-        CGRect bounds;
-        CGRectMakeWithDictionaryRepresentation(bounds_dict, &bounds);
-        if (bounds.size.width <= 50 || bounds.size.height <= 50) continue;
-
-        /* Get window title. */
-        CFStringRef title_ref = CFDictionaryGetValue(info, kCGWindowName);
-        char title[256] = "";
-        if (title_ref)
-            CFStringGetCString(title_ref, title, sizeof(title), kCFStringEncodingUTF8);
-
-        /* Add to list. */
-        WinInfo *w = &WindowList[WindowCount++];
-        w->window_id = wid;
-        w->pid = pid;
-        strncpy(w->owner, owner, sizeof(w->owner) - 1);
-        w->owner[sizeof(w->owner) - 1] = '\0';
-        strncpy(w->title, title, sizeof(w->title) - 1);
-        w->title[sizeof(w->title) - 1] = '\0';
-    }
-
-    CFRelease(list);
+    WindowList = Platform->list(DangerMode, &WindowCount);
     return WindowCount;
 }
 
-/* Check if connected window still exists on screen. If the exact window ID
- * is gone but the same PID still has an on-screen window (tab switch),
- * update ConnectedWid to the new window. */
+/* Check if connected window still exists. The backend may move the
+ * session to another window, like after a tab switch. */
 int connected_window_exists(void) {
     if (!Connected) return 0;
-
-    CFArrayRef list = CGWindowListCopyWindowInfo(
-        kCGWindowListOptionOnScreenOnly | kCGWindowListExcludeDesktopElements,
-        kCGNullWindowID
-    );
-    if (!list) return 0;
-
-    int found = 0;
-    CGWindowID fallback_wid = 0;
-    CFIndex count = CFArrayGetCount(list);
-    for (CFIndex i = 0; i < count; i++) {
-        CFDictionaryRef info = CFArrayGetValueAtIndex(list, i);
-        CFNumberRef wid_ref = CFDictionaryGetValue(info, kCGWindowNumber);
-        CFNumberRef pid_ref = CFDictionaryGetValue(info, kCGWindowOwnerPID);
-        if (!wid_ref || !pid_ref) continue;
-
-        CGWindowID wid;
-        pid_t pid;
-        CFNumberGetValue(wid_ref, kCGWindowIDCFNumberType, &wid);
-        CFNumberGetValue(pid_ref, kCFNumberIntType, &pid);
-
-        if (wid == ConnectedWid) {
-            found = 1;
-            break;
-        }
-
-        /* Track a fallback: another on-screen window from the same PID. */
-        if (pid == ConnectedPid && !fallback_wid) {
-            CFNumberRef layer_ref = CFDictionaryGetValue(info, kCGWindowLayer);
-            int layer = 0;
-            if (layer_ref) CFNumberGetValue(layer_ref, kCFNumberIntType, &layer);
-            if (layer == 0) fallback_wid = wid;
-        }
-    }
-
-    /* Window gone but same app has another window — likely a tab switch. */
-    if (!found && fallback_wid) {
-        ConnectedWid = fallback_wid;
-        found = 1;
-    }
-
-    CFRelease(list);
-    return found;
+    return Platform->alive(&ConnectedSession);
 }
 
 /* Disconnect from current window. */
 void disconnect(void) {
     Connected = 0;
-    ConnectedWid = 0;
-    ConnectedPid = 0;
-    ConnectedOwner[0] = '\0';
-    ConnectedTitle[0] = '\0';
+    memset(&ConnectedSession, 0, sizeof(ConnectedSession));
 }
 
 /* ============================================================================
  * Screenshot Functions
  * ========================================================================= */
 
-int save_png(CGImageRef image, const char *path) {
-    CFStringRef cfpath = CFStringCreateWithCString(NULL, path, kCFStringEncodingUTF8);
-    CFURLRef url = CFURLCreateWithFileSystemPath(NULL, cfpath, kCFURLPOSIXPathStyle, false);
-    CFRelease(cfpath);
-    if (!url) return -1;
+/* Return the PNG_COLOR_* mode with the given name, or -1 if unknown. */
+int color_mode_by_name(const char *name) {
+    for (int i = 0; ColorModeNames[i]; i++) {
+        if (strcasecmp(name, ColorModeNames[i]) == 0) return i;
+    }
+    return -1;
+}
 
-    CGImageDestinationRef dest = CGImageDestinationCreateWithURL(url, CFSTR("public.png"), 1, NULL);
-    CFRelease(url);
-    if (!dest) return -1;
+/* Load the persisted screenshot settings from the database. */
+void load_screenshot_settings(const char *db_path) {
+    sqlite3 *db;
+    if (sqlite3_open(db_path, &db) != SQLITE_OK) return;
+    sqlite3_exec(db, TB_CREATE_KV_STORE, 0, 0, NULL);
 
-    CGImageDestinationAddImage(dest, image, NULL);
-    int ok = CGImageDestinationFinalize(dest);
-    CFRelease(dest);
-    return ok ? 0 : -1;
+    sds mode = kvGet(db, "color_mode");
+    if (mode) {
+        int m = color_mode_by_name(mode);
+        if (m != -1) ColorMode = m;
+        sdsfree(mode);
+    }
+    sds width = kvGet(db, "scale_width");
+    if (width) {
+        ScaleWidth = atoi(width);
+        sdsfree(width);
+    }
+    sds auto_crop = kvGet(db, "auto_crop");
+    if (auto_crop) {
+        AutoCrop = atoi(auto_crop);
+        sdsfree(auto_crop);
+    }
+    sds progressive = kvGet(db, "progressive");
+    if (progressive) {
+        Progressive = atoi(progressive);
+        sdsfree(progressive);
+    }
+    sds text_mode = kvGet(db, "text_mode");
+    if (text_mode) {
+        TextMode = atoi(text_mode);
+        sdsfree(text_mode);
+    }
+    sds sampler = kvGet(db, "sampler");
+    if (sampler) {
+        Sampler = atoi(sampler);
+        sdsfree(sampler);
+    }
+    sds target = kvGet(db, "latency_target");
+    if (target) {
+        qualitySetTarget(atoi(target));
+        sdsfree(target);
+    }
+    sds quality = kvGet(db, "quality");
+    if (quality) {
+        int level;
+        double latency, throughput;
+        if (sscanf(quality, "%d %lf %lf", &level, &latency, &throughput) == 3 &&
+            qualityTarget())
+        {
+            qualityRestore(level, latency, throughput);
+        }
+        sdsfree(quality);
+    }
+    sqlite3_close(db);
 }
 
-CGImageRef capture_window(CGWindowID wid) {
-    return CGWindowListCreateImage(CGRectNull, kCGWindowListOptionIncludingWindow, wid,
-        kCGWindowImageBoundsIgnoreFraming | kCGWindowImageNominalResolution);
+/* Return true if 'name' is a valid .zoom region name. */
+int valid_zoom_name(const char *name) {
+    size_t len = strlen(name);
+    if (len == 0 || len > ZOOM_NAME_MAX) return 0;
+    for (size_t i = 0; i < len; i++) {
+        if (!isalnum((unsigned char)name[i]) && name[i] != '-' && name[i] != '_')
+            return 0;
+    }
+    return 1;
 }
 
-/* Capture and save screenshot of connected window. Returns 0 on success. */
-int capture_connected_window(const char *path) {
-    if (!Connected) return -1;
-
-    CGImageRef img = capture_window(ConnectedWid);
-    if (!img) return -1;
-
-    int ret = save_png(img, path);
-    CGImageRelease(img);
-    return ret;
+/* Load the region saved with .zoom for the connected window into
+ * region[0..3] (x, y, width, height in percent). Returns 0 on success,
+ * -1 if there is no such region. */
+int zoom_get(sqlite3 *db, const char *name, double *region) {
+    sds key = sdscatprintf(sdsempty(), "zoom:%u:%s", (unsigned)ConnectedSession.id, name);
+    sds val = kvGet(db, key);
+    sdsfree(key);
+    if (!val) return -1;
+    int n = sscanf(val, "%lf %lf %lf %lf", region, region+1, region+2, region+3);
+    sdsfree(val);
+    return n == 4 ? 0 : -1;
 }
 
 /* ============================================================================
- * Keystroke Functions
+ * Uploaded Screenshots Cache
  * ========================================================================= */
 
-/* Private API to get CGWindowID from AXUIElement. */
-extern AXError _AXUIElementGetWindow(AXUIElementRef element, CGWindowID *wid);
-
-/* Bring app to front. */
-int bring_to_front(pid_t pid) {
-    ProcessSerialNumber psn;
-    if (GetProcessForPID(pid, &psn) != noErr) return -1;
-    if (SetFrontProcessWithOptions(&psn, kSetFrontProcessFrontWindowOnly) != noErr) return -1;
-    usleep(100000);
-    return 0;
+/* Telegram gives every uploaded photo a file_id, and the same photo can
+ * be sent again just by referencing it. Switching back to a tab that did
+ * not change, or refreshing an idle terminal, produces exactly the same
+ * frame, so we remember the file_id of recent uploads by the hash of the
+ * frame, and resend them with zero upload bytes. The entries are also
+ * stored in the KV store, so they survive restarts. */
+
+/* Set 'hex' to the hash of the frame pixels and of the color mode and
+ * palette size used to encode it. */
+void frame_hash(const Frame *f, int color_mode, int maxcolors, char *hex) {
+    SHA1_CTX ctx;
+    unsigned char digest[SHA1_DIGEST_SIZE];
+    int32_t hdr[4] = {f->width, f->height, color_mode, maxcolors};
+
+    sha1_init(&ctx);
+    sha1_update(&ctx, (unsigned char*)hdr, sizeof(hdr));
+    for (int y = 0; y < f->height; y++)
+        sha1_update(&ctx, f->pixels + (size_t)y * f->stride, (size_t)f->width * 4);
+    sha1_final(&ctx, digest);
+    for (int j = 0; j < SHA1_DIGEST_SIZE; j++)
+        snprintf(hex + j*2, 3, "%02x", digest[j]);
 }
 
-/* Raise the specific window by matching CGWindowID via Accessibility API. */
-int raise_window_by_id(pid_t pid, CGWindowID target_wid) {
-    AXUIElementRef app = AXUIElementCreateApplication(pid);
-    if (!app) return -1;
-
-    CFArrayRef windows = NULL;
-    AXUIElementCopyAttributeValue(app, kAXWindowsAttribute, (CFTypeRef *)&windows);
-    CFRelease(app);
-
-    if (!windows) return -1;
+/* Add an entry to the in memory cache, replacing the oldest one. Must be
+ * called with FileIdLock held. */
+void fileid_cache_add(const char *hash, const char *file_id, size_t size) {
+    FileIdEntry *e = &FileIdCache[FileIdNext];
+    FileIdNext = (FileIdNext + 1) % FILEID_CACHE_LEN;
+    memcpy(e->hash, hash, HASH_HEX_LEN+1);
+    sdsfree(e->file_id);
+    e->file_id = sdsnew(file_id);
+    e->size = size;
+}
 
-    int found = 0;
-    CFIndex count = CFArrayGetCount(windows);
-    for (CFIndex i = 0; i < count; i++) {
-        AXUIElementRef win = (AXUIElementRef)CFArrayGetValueAtIndex(windows, i);
-
-        CGWindowID wid = 0;
-        if (_AXUIElementGetWindow(win, &wid) == kAXErrorSuccess) {
-            if (wid == target_wid) {
-                AXUIElementPerformAction(win, kAXRaiseAction);
-                found = 1;
-                break;
-            }
+/* Look up the file_id of the frame with the given hash. Returns a new sds
+ * string, setting '*size' to the size of the upload it avoids, or NULL
+ * if the frame was never uploaded. */
+sds fileid_get(sqlite3 *db, const char *hash, size_t *size) {
+    pthread_mutex_lock(&FileIdLock);
+    for (int j = 0; j < FILEID_CACHE_LEN; j++) {
+        if (strcmp(FileIdCache[j].hash, hash) == 0) {
+            *size = FileIdCache[j].size;
+            sds file_id = sdsdup(FileIdCache[j].file_id);
+            pthread_mutex_unlock(&FileIdLock);
+            return file_id;
         }
     }
+    pthread_mutex_unlock(&FileIdLock);
+
+    sds key = sdscatprintf(sdsempty(), "fileid:%s", hash);
+    sds val = kvGet(db, key);
+    sdsfree(key);
+    if (!val) return NULL;
+
+    /* The value is "<size> <file_id>". */
+    sds file_id = NULL;
+    char *space = strchr(val, ' ');
+    if (space) {
+        *size = strtoull(val, NULL, 10);
+        file_id = sdsnew(space + 1);
+        pthread_mutex_lock(&FileIdLock);
+        fileid_cache_add(hash, file_id, *size);
+        pthread_mutex_unlock(&FileIdLock);
+    }
+    sdsfree(val);
+    return file_id;
+}
 
-    CFRelease(windows);
-
-    /* Also bring the app to front. */
-    bring_to_front(pid);
-    return found ? 0 : -1;
-}
-
-/* Map ASCII character to macOS virtual keycode (US keyboard layout). */
-CGKeyCode keycode_for_char(char c) {
-    /* Letters a-z (same codes for upper/lowercase). */
-    static const CGKeyCode letter_map[26] = {
-        0x00,0x0B,0x08,0x02,0x0E,0x03,0x05,0x04,0x22,0x26, /* a-j */
-        0x28,0x25,0x2E,0x2D,0x1F,0x23,0x0C,0x0F,0x01,0x11, /* k-t */
-        0x20,0x09,0x0D,0x07,0x10,0x06                       /* u-z */
-    };
-    /* Digits 0-9. */
-    static const CGKeyCode digit_map[10] = {
-        0x1D,0x12,0x13,0x14,0x15,0x17,0x16,0x1A,0x1C,0x19  /* 0-9 */
-    };
-    /* Punctuation / symbols. */
-    if (c >= 'a' && c <= 'z') return letter_map[c - 'a'];
-    if (c >= 'A' && c <= 'Z') return letter_map[c - 'A'];
-    if (c >= '0' && c <= '9') return digit_map[c - '0'];
-    switch (c) {
-        case '-':  return 0x1B;  case '=':  return 0x18;
-        case '[':  return 0x21;  case ']':  return 0x1E;
-        case '\\': return 0x2A;  case ';':  return 0x29;
-        case '\'': return 0x27;  case ',':  return 0x2B;
-        case '.':  return 0x2F;  case '/':  return 0x2C;
-        case '`':  return 0x32;  case ' ':  return 0x31;
-    }
-    return 0xFFFF; /* Unknown. */
-}
-
-void send_key(pid_t pid, CGKeyCode keycode, UniChar ch, int mods) {
-    /* When modifiers are active and we have a character, use the
-     * correct virtual keycode so the system sends the right combo. */
-    int mapped_keycode = 0;
-    if (ch && mods) {
-        CGKeyCode mapped = keycode_for_char((char)ch);
-        if (mapped != 0xFFFF) {
-            keycode = mapped;
-            mapped_keycode = 1;
-        }
-    }
-
-    CGEventRef down = CGEventCreateKeyboardEvent(NULL, keycode, true);
-    CGEventRef up = CGEventCreateKeyboardEvent(NULL, keycode, false);
-    if (!down || !up) {
-        if (down) CFRelease(down);
-        if (up) CFRelease(up);
-        return;
+/* Remember the file_id of an uploaded frame. */
+void fileid_set(sqlite3 *db, const char *hash, const char *file_id, size_t size) {
+    pthread_mutex_lock(&FileIdLock);
+    fileid_cache_add(hash, file_id, size);
+    pthread_mutex_unlock(&FileIdLock);
+    sds key = sdscatprintf(sdsempty(), "fileid:%s", hash);
+    sds val = sdscatprintf(sdsempty(), "%zu %s", size, file_id);
+    kvSet(db, key, val, time(NULL) + FILEID_TTL);
+    sdsfree(key);
+    sdsfree(val);
+}
+
+/* Forget a file_id Telegram no longer accepts. */
+void fileid_del(sqlite3 *db, const char *hash) {
+    pthread_mutex_lock(&FileIdLock);
+    for (int j = 0; j < FILEID_CACHE_LEN; j++) {
+        if (strcmp(FileIdCache[j].hash, hash) == 0) FileIdCache[j].hash[0] = '\0';
     }
+    pthread_mutex_unlock(&FileIdLock);
+    sds key = sdscatprintf(sdsempty(), "fileid:%s", hash);
+    kvDel(db, key);
+    sdsfree(key);
+}
 
-    CGEventFlags flags = 0;
-    if (mods & MOD_CTRL) flags |= kCGEventFlagMaskControl;
-    if (mods & MOD_ALT)  flags |= kCGEventFlagMaskAlternate;
-    if (mods & MOD_CMD)  flags |= kCGEventFlagMaskCommand;
+/* Build the reply of the .cache command. */
+sds build_cache_message(void) {
+    pthread_mutex_lock(&FileIdLock);
+    uint64_t total = FileIdHits + FileIdMisses;
+    sds msg = sdscatprintf(sdsempty(),
+        "Screenshots sent: %llu\n"
+        "Resent by file_id: %llu (%.1f%%)\n"
+        "Uploaded: %llu (%llu KB)\n"
+        "Upload saved: %llu KB",
+        (unsigned long long)total,
+        (unsigned long long)FileIdHits,
+        total ? (double)FileIdHits * 100 / total : 0.0,
+        (unsigned long long)FileIdMisses,
+        (unsigned long long)(UploadedBytes / 1024),
+        (unsigned long long)(SavedBytes / 1024));
+    pthread_mutex_unlock(&FileIdLock);
+    return msg;
+}
 
-    if (flags) {
-        CGEventSetFlags(down, flags);
-        CGEventSetFlags(up, flags);
+/* We also remember the hash of the frame shown by the last messages we
+ * sent or edited, so that refreshing a message with the same frame can
+ * be skipped altogether. */
+typedef struct ShownEntry {
+    int64_t chat_id;
+    int64_t msg_id;
+    char hash[HASH_HEX_LEN+1];
+} ShownEntry;
+
+static ShownEntry Shown[SHOWN_CACHE_LEN];
+static int ShownNext = 0;
+static pthread_mutex_t ShownLock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Record that the message now shows the frame with the given hash. */
+void shown_set(int64_t chat_id, int64_t msg_id, const char *hash) {
+    pthread_mutex_lock(&ShownLock);
+    ShownEntry *e = NULL;
+    for (int j = 0; j < SHOWN_CACHE_LEN && !e; j++) {
+        if (Shown[j].chat_id == chat_id && Shown[j].msg_id == msg_id) e = &Shown[j];
+    }
+    if (!e) {
+        e = &Shown[ShownNext];
+        ShownNext = (ShownNext + 1) % SHOWN_CACHE_LEN;
+        e->chat_id = chat_id;
+        e->msg_id = msg_id;
     }
+    memcpy(e->hash, hash, HASH_HEX_LEN+1);
+    pthread_mutex_unlock(&ShownLock);
+}
 
-    /* When we have a mapped keycode with modifiers, let the system
-     * derive the character from keycode + flags. Otherwise set it. */
-    if (ch && !mapped_keycode) {
-        CGEventKeyboardSetUnicodeString(down, 1, &ch);
-        CGEventKeyboardSetUnicodeString(up, 1, &ch);
+/* Return true if the message is known to show the frame with the given
+ * hash. */
+int shown_is(int64_t chat_id, int64_t msg_id, const char *hash) {
+    pthread_mutex_lock(&ShownLock);
+    int found = 0;
+    for (int j = 0; j < SHOWN_CACHE_LEN; j++) {
+        if (Shown[j].chat_id == chat_id && Shown[j].msg_id == msg_id) {
+            found = strcmp(Shown[j].hash, hash) == 0;
+            break;
+        }
     }
+    pthread_mutex_unlock(&ShownLock);
+    return found;
+}
 
-    CGEventPostToPid(pid, down);
-    usleep(1000);
-    CGEventPostToPid(pid, up);
-    usleep(5000);
+/* ============================================================================
+ * Keystroke Functions
+ * ========================================================================= */
 
-    CFRelease(down);
-    CFRelease(up);
+/* Type a key into the connected window. */
+void send_key(int key, uint32_t ch, int mods) {
+    Platform->key(&ConnectedSession, key, ch, mods);
+}
+
+/* Decode the UTF-8 character at 'p', setting '*ch'. Returns the bytes
+ * consumed: invalid sequences are consumed one byte at a time. */
+int utf8_decode(const unsigned char *p, size_t len, uint32_t *ch) {
+    int n = 1;
+    if (p[0] >= 0xF0) n = 4;
+    else if (p[0] >= 0xE0) n = 3;
+    else if (p[0] >= 0xC0) n = 2;
+    if ((size_t)n > len) n = 1;
+
+    uint32_t c = n == 1 ? p[0] : p[0] & (0x7F >> n);
+    for (int j = 1; j < n; j++) {
+        if ((p[j] & 0xC0) != 0x80) {
+            *ch = p[0];
+            return 1;
+        }
+        c = (c << 6) | (p[j] & 0x3F);
+    }
+    *ch = c;
+    return n;
 }
 
 /* Send keystrokes to connected window. Auto-adds newline unless ends with 💜. */
 int send_keys(const char *text) {
     if (!Connected) return -1;
 
-    raise_window_by_id(ConnectedPid, ConnectedWid);
+    uint64_t start = statsUstime();
+    if (Platform->focus) {
+        Platform->focus(&ConnectedSession);
+        statsRecordSince("raise", start);
+        start = statsUstime();
+    }
 
     /* Check if we should suppress trailing newline. */
     int add_newline = !ends_with_purple_heart(text);
@@ -640,6 +728,7 @@ int send_keys(const char *text) {
     int mods = 0;
     int consumed;
     char heart;
+    uint32_t ch;
     int keycount = 0;       /* Number of actual keystrokes sent. */
     int had_mods = 0;       /* True if any keystroke used modifiers. */
     int last_was_nl = 0;    /* True if last keystroke was Enter. */
@@ -652,7 +741,7 @@ int send_keys(const char *text) {
         }
 
         if ((consumed = match_orange_heart(p, len)) > 0) {
-            send_key(ConnectedPid, kVK_Return, 0, mods);
+            send_key(KEY_RETURN, 0, mods);
             if (mods) had_mods = 1;
             keycount++; last_was_nl = 1; mods = 0;
             p += consumed; len -= consumed;
@@ -661,7 +750,7 @@ int send_keys(const char *text) {
 
         if ((consumed = match_colored_heart(p, len, &heart)) > 0) {
             if (heart == 'Y') {
-                send_key(ConnectedPid, kVK_Escape, 0, 0);
+                send_key(KEY_ESCAPE, 0, 0);
                 keycount++; had_mods = 1; last_was_nl = 0;
                 mods = 0;
             } else if (heart == 'B') {
@@ -676,28 +765,29 @@ int send_keys(const char *text) {
         last_was_nl = 0;
         if (*p == '\\' && len > 1) {
             if (p[1] == 'n') {
-                send_key(ConnectedPid, kVK_Return, 0, mods);
+                send_key(KEY_RETURN, 0, mods);
                 if (mods) had_mods = 1;
                 keycount++; last_was_nl = 1; mods = 0;
                 p += 2; len -= 2;
                 continue;
             } else if (p[1] == 't') {
-                send_key(ConnectedPid, kVK_Tab, 0, mods);
+                send_key(KEY_TAB, 0, mods);
                 if (mods) had_mods = 1;
                 keycount++; mods = 0; p += 2; len -= 2;
                 continue;
             } else if (p[1] == '\\') {
-                send_key(ConnectedPid, 0, '\\', mods);
+                send_key(KEY_CHAR, '\\', mods);
                 if (mods) had_mods = 1;
                 keycount++; mods = 0; p += 2; len -= 2;
                 continue;
             }
         }
 
-        send_key(ConnectedPid, 0, (UniChar)*p, mods);
+        consumed = utf8_decode(p, len, &ch);
+        send_key(KEY_CHAR, ch, mods);
         if (mods) had_mods = 1;
         keycount++; mods = 0;
-        p++; len--;
+        p += consumed; len -= consumed;
     }
 
     /* Add newline unless:
@@ -706,9 +796,9 @@ int send_keys(const char *text) {
      * - Last explicit keystroke was already a newline */
     if (add_newline && !(keycount == 1 && had_mods) && !last_was_nl) {
         usleep(50000);
-        send_key(ConnectedPid, kVK_Return, 0, 0);
+        send_key(KEY_RETURN, 0, 0);
     }
-
+    statsRecordSince("keys", start);
     return 0;
 }
 
@@ -728,12 +818,12 @@ sds build_list_message(void) {
 
     msg = sdscat(msg, "Terminal windows:\n");
     for (int i = 0; i < WindowCount; i++) {
-        WinInfo *w = &WindowList[i];
+        Session *w = &WindowList[i];
         char line[512];
         if (w->title[0]) {
-            snprintf(line, sizeof(line), ".%d [%u] %s - %s\n", i + 1, w->window_id, w->owner, w->title);
+            snprintf(line, sizeof(line), ".%d [%u] %s - %s\n", i + 1, w->id, w->owner, w->title);
         } else {
-            snprintf(line, sizeof(line), ".%d [%u] %s\n", i + 1, w->window_id, w->owner);
+            snprintf(line, sizeof(line), ".%d [%u] %s\n", i + 1, w->id, w->owner);
         }
         msg = sdscat(msg, line);
     }
@@ -745,6 +835,28 @@ sds build_help_message(void) {
         "Commands:\n"
         ".list - Show terminal windows\n"
         ".1 .2 ... - Connect to window\n"
+        ".new [command] - Start a shell or command (pty, tmux)\n"
+        ".color auto|gray|mono - Screenshot colors\n"
+        ".width <pixels> - Downscale screenshots, 0 = native\n"
+        ".crop on|off - Remove blank areas from screenshots\n"
+        ".tail [lines] - Screenshot of the last lines only\n"
+        ".zoom [name] - Capture a saved region, or list them\n"
+        ".zoom <name> <x> <y> <w> <h> - Save region, in % of window\n"
+        ".zoom <name> del - Delete region\n"
+        ".cache - Screenshots resent without uploading\n"
+        ".pipeline - Time spent capturing, encoding, uploading\n"
+        ".stats - Latency percentiles of every request stage\n"
+        ".slowlog [count|reset] - Recent slow requests\n"
+        ".memory - Memory allocated by every subsystem\n"
+        ".progressive on|off - Send a quick preview first\n"
+        ".latency [ms|off] - Adapt quality to the link speed\n"
+        ".sampler on|off - Sample the window for instant refresh\n"
+        ".live [minutes] - Update one screenshot as the window changes\n"
+        ".follow [minutes] - Stream the output as text\n"
+        ".stop - Stop the live view and the output stream\n"
+        ".text [on|off] - Send the window as text\n"
+        ".grep <text> - Search the output, scrollback included\n"
+        ".scroll [page] - Send older output, 0 is the screen\n"
         ".help - This help\n\n"
         "Once connected, text is sent as keystrokes.\n"
         "Newline is auto-added; end with `💜` to suppress it.\n\n"
@@ -759,25 +871,919 @@ sds build_help_message(void) {
  * Telegram Bot Callbacks
  * ========================================================================= */
 
-#define SCREENSHOT_PATH "/tmp/tgterm_screenshot.png"
+#define SCREENSHOT_PATH "/tmp/tgterm_screenshot_%llu.png"
 #define OWNER_KEY "owner_id"
 #define REFRESH_BTN "🔄 Refresh"
 #define REFRESH_DATA "refresh"
+#define TEXT_DATA "text"
+
+/* Return the callback data of the refresh button. The region of interest
+ * is part of it, so that refreshing captures the same region again. */
+sds refresh_data(const char *roi) {
+    sds data = sdsnew(REFRESH_DATA);
+    if (roi) data = sdscatprintf(data, " %s", roi);
+    return data;
+}
+
+/* ============================================================================
+ * Screenshot Pipeline
+ * ========================================================================= */
+
+/* Screenshots flow through three stages, each in its own thread: capture,
+ * encode and upload. Uploading is by far the slowest part on mobile
+ * links, and meanwhile the next screenshot can already be captured and
+ * encoded. Request handlers just queue a job and return. A job carries a
+ * copy of everything it needs (window, settings, destination), so it is
+ * not affected by requests processed while it is in the pipeline, and
+ * the frame is handed from stage to stage without copies. */
+
+typedef struct ScreenshotJob {
+    int64_t chat_id;            /* Chat to send the screenshot to. */
+    int64_t msg_id;             /* Message to edit, 0 to send a new one. */
+    uint32_t wid;               /* Window to capture. */
+    int color_mode;             /* Settings when the job was created. */
+    int scale_width;
+    int auto_crop;
+    int progressive;
+    int quality;                /* Level of the QualityLadder. */
+    int live;                   /* First message of the live view. */
+    int tail;                   /* Text lines for .tail, 0 for all. */
+    int zoom;                   /* If true, capture only 'region'. */
+    double region[4];           /* .zoom region, in percent of the window. */
+    sds refresh_data;           /* Callback data of the refresh button. */
+    Frame *frame;               /* Captured frame. */
+    int src_width;              /* Frame size before scaling. */
+    int src_height;
+    uint64_t created_us;        /* When the job was queued. */
+    uint64_t upload_us;         /* When the upload stage got it. */
+    size_t uploaded;            /* Bytes uploaded by send_job(). */
+    char hash[HASH_HEX_LEN+1];  /* Hash of 'frame'. */
+    sds file_id;                /* file_id if already uploaded, or NULL. */
+    size_t size;                /* Size of the upload 'file_id' avoids. */
+    sds path;                   /* Encoded PNG file, or NULL. */
+    struct ScreenshotJob *owner; /* For previews, the full quality job. */
+    _Atomic int refcount;       /* The pipeline's, and one per preview. */
+    SlowlogTrace *trace;        /* Request that queued the job, or NULL. */
+} ScreenshotJob;
+
+void free_screenshot_job(void *arg);
+void live_set_message(int64_t chat_id, int64_t msg_id);
+
+/* Every pipeline thread uses its own database connection. */
+static _Thread_local sqlite3 *StageDb = NULL;
+
+sqlite3 *stage_db(void) {
+    if (StageDb) return StageDb;
+    if (sqlite3_open(DbPath, &StageDb) != SQLITE_OK) {
+        sqlite3_close(StageDb);
+        StageDb = NULL;
+        return NULL;
+    }
+    sqlite3_busy_timeout(StageDb, 1000);
+    return StageDb;
+}
+
+/* Capture stage: grab the window and reduce the frame to what will be
+ * sent: crop it to the region of interest and downscale it. */
+int capture_stage(void *arg) {
+    ScreenshotJob *job = arg;
+    Frame *f = Platform->capture(job->wid, job->zoom ? job->region : NULL);
+    if (!f) return 1;
+
+    /* A zoomed region is exactly what the user asked for: don't crop it
+     * further. */
+    if (job->tail) frameTail(f, job->tail, CROP_MARGIN);
+    else if (job->auto_crop && !job->zoom) frameAutoCrop(f, CROP_MARGIN);
+
+    /* Downscale before encoding: phones show screenshots much smaller
+     * than the window, and Telegram recompresses them anyway. On slow
+     * links the quality controller may ask for even smaller images. */
+    job->src_width = f->width;
+    job->src_height = f->height;
+    int width = job->scale_width;
+    int qwidth = QualityLadder[job->quality].width;
+    if (qwidth && (width == 0 || qwidth < width)) width = qwidth;
+    if (width && f->width > width) {
+        Frame *scaled = frameScale(f, width);
+        frameFree(f);
+        f = scaled;
+    }
+    job->frame = f;
+    return 0;
+}
+
+/* Return a new path for a screenshot file. Jobs in different stages
+ * have their own files. */
+sds screenshot_path(void) {
+    static unsigned long long seq = 0;
+    static pthread_mutex_t seqlock = PTHREAD_MUTEX_INITIALIZER;
+
+    pthread_mutex_lock(&seqlock);
+    unsigned long long id = seq++;
+    pthread_mutex_unlock(&seqlock);
+    return sdscatprintf(sdsempty(), SCREENSHOT_PATH, id);
+}
+
+/* Write the frame of the job as a PNG file. Returns 0 on success. */
+int encode_job(ScreenshotJob *job) {
+    job->path = screenshot_path();
+    const QualityLevel *q = &QualityLadder[job->quality];
+    return pngWrite(job->frame, job->color_mode, q->maxcolors, q->zlevel, job->path);
+}
+
+/* Queue a small preview of the job frame straight to the upload stage.
+ * It is sent as a new message while the full frame is still encoding,
+ * then the full frame replaces it. */
+void queue_preview(ScreenshotJob *job) {
+    ScreenshotJob *preview = xmalloc(sizeof(*preview));
+    memset(preview, 0, sizeof(*preview));
+    atomic_init(&preview->refcount, 1);
+    preview->chat_id = job->chat_id;
+    preview->color_mode = job->color_mode;
+    preview->quality = job->quality;
+    preview->refresh_data = sdsdup(job->refresh_data);
+    /* The preview writes its message id in the full job when sent, so
+     * the job must live until then, even if it fails to encode. */
+    preview->owner = job;
+    atomic_fetch_add(&job->refcount, 1);
+    preview->trace = job->trace;
+    slowlogRetain(preview->trace);
+    preview->frame = frameScale(job->frame, PREVIEW_WIDTH);
+    if (encode_job(preview) != 0) {
+        free_screenshot_job(preview);
+        return;
+    }
+    pipelinePush(ScreenshotPipeline, UPLOAD_STAGE, preview);
+}
+
+/* Encode stage: frames that were already uploaded are sent again by
+ * file_id, so they don't need to be encoded at all. */
+int encode_stage(void *arg) {
+    ScreenshotJob *job = arg;
+    sqlite3 *db = stage_db();
+    frame_hash(job->frame, job->color_mode,
+               QualityLadder[job->quality].maxcolors, job->hash);
+    if (db) job->file_id = fileid_get(db, job->hash, &job->size);
+    if (job->file_id) return 0;
+
+    /* A preview is only worth it for new messages of large frames. */
+    if (job->progressive && !job->msg_id && job->frame->width > PREVIEW_WIDTH*2)
+        queue_preview(job);
+    return encode_job(job) == 0 ? 0 : 1;
+}
+
+/* Send the job screenshot, by file_id if set, otherwise uploading the
+ * encoded file. Returns 1 on success, 0 on error. The duration of every
+ * successful request feeds the link speed estimation. */
+int send_job(ScreenshotJob *job) {
+    char *path = job->file_id ? NULL : job->path;
+    struct stat st;
+    job->uploaded = path && stat(path, &st) == 0 ? (size_t)st.st_size : 0;
+
+    uint64_t start = statsUstime();
+    int64_t msg_id = job->msg_id;
+    int sent;
+    if (job->msg_id) {
+        sent = botEditMessageMedia(job->chat_id, job->msg_id, path,
+                                   REFRESH_BTN, job->refresh_data, &job->file_id);
+    } else {
+        /* The full quality job replaces the message of its preview. The
+         * preview is queued before it, and holds a reference to it. */
+        sent = botSendImageWithKeyboard(job->chat_id, path, REFRESH_BTN,
+                                        job->refresh_data, &msg_id, &job->file_id);
+        if (sent && job->owner) job->owner->msg_id = msg_id;
+    }
+    if (!sent) return 0;
+
+    /* Previews have no hash: their message is about to change anyway. */
+    if (job->hash[0]) shown_set(job->chat_id, msg_id, job->hash);
+    if (job->live) live_set_message(job->chat_id, msg_id);
+
+    qualityAddUpload(job->uploaded, (statsUstime() - start) / 1e6);
+    pthread_mutex_lock(&FileIdLock);
+    UploadedBytes += job->uploaded;
+    pthread_mutex_unlock(&FileIdLock);
+    statsIncr("uploaded_bytes_total", job->uploaded);
+    return 1;
+}
+
+/* Feed an uploaded screenshot to the quality controller, and save its
+ * state so that it survives restarts. */
+void adapt_quality(sqlite3 *db, ScreenshotJob *job) {
+    qualityFrameSent(job->quality, job->src_width, job->src_height,
+                     job->scale_width, job->uploaded,
+                     (job->upload_us - job->created_us) / 1e6);
+    if (!db) return;
+
+    int level;
+    double latency, throughput;
+    qualityGetEstimates(&level, &latency, &throughput);
+    sds val = sdscatprintf(sdsempty(), "%d %.4f %.0f", level, latency, throughput);
+    kvSet(db, "quality", val, 0);
+    sdsfree(val);
+}
+
+/* Upload stage. */
+int upload_stage(void *arg) {
+    ScreenshotJob *job = arg;
+    sqlite3 *db = stage_db();
+    job->upload_us = statsUstime();
+
+    if (job->owner) {
+        send_job(job);
+        return 0;
+    }
+
+    if (job->file_id) {
+        if (send_job(job)) {
+            pthread_mutex_lock(&FileIdLock);
+            FileIdHits++;
+            SavedBytes += job->size;
+            pthread_mutex_unlock(&FileIdLock);
+            return 0;
+        }
+        /* Expired or invalid file_id: upload the frame. Sampled frames
+         * come already encoded. */
+        if (db) fileid_del(db, job->hash);
+        sdsfree(job->file_id);
+        job->file_id = NULL;
+        if (!job->path && encode_job(job) != 0) return 1;
+    }
+
+    if (!send_job(job)) return 1;
+    pthread_mutex_lock(&FileIdLock);
+    FileIdMisses++;
+    pthread_mutex_unlock(&FileIdLock);
+    if (job->file_id && db) fileid_set(db, job->hash, job->file_id, job->uploaded);
+    adapt_quality(db, job);
+    return 0;
+}
+
+/* Release a reference to the job, freeing it with the last one. */
+void free_screenshot_job(void *arg) {
+    ScreenshotJob *job = arg;
+    if (atomic_fetch_sub(&job->refcount, 1) != 1) return;
+    if (job->owner) free_screenshot_job(job->owner);
+    frameFree(job->frame);
+    sdsfree(job->refresh_data);
+    sdsfree(job->file_id);
+    if (job->path) unlink(job->path);
+    sdsfree(job->path);
+    slowlogEnd(job->trace);
+    xfree(job);
+}
+
+SlowlogTrace *screenshot_job_trace(void *arg) {
+    ScreenshotJob *job = arg;
+    return job->trace;
+}
+
+/* Create the screenshot pipeline and start its threads. */
+void start_screenshot_pipeline(const char *db_path) {
+    DbPath = db_path;
+    ScreenshotPipeline = pipelineCreate(PIPELINE_QUEUE_LEN, free_screenshot_job,
+                                        screenshot_job_trace);
+    pipelineAddStage(ScreenshotPipeline, "capture", capture_stage);
+    pipelineAddStage(ScreenshotPipeline, "encode", encode_stage);
+    pipelineAddStage(ScreenshotPipeline, "upload", upload_stage);
+    if (pipelineStart(ScreenshotPipeline) != 0) {
+        fprintf(stderr, "Can't start the screenshot pipeline.\n");
+        exit(1);
+    }
+}
 
-/* Send screenshot with refresh button. */
-void send_screenshot(int64_t chat_id) {
-    if (capture_connected_window(SCREENSHOT_PATH) != 0) return;
-    botSendImageWithKeyboard(chat_id, SCREENSHOT_PATH, REFRESH_BTN, REFRESH_DATA, NULL);
+/* Queue a screenshot of the connected window with refresh button, as a
+ * new message if 'msg_id' is zero, otherwise replacing the media of the
+ * existing message. 'roi' selects the region of interest: NULL for the
+ * whole window, "tail <lines>" for the last text lines, or "zoom <name>"
+ * for a region saved with .zoom. 'live' marks the first message of the
+ * live view. */
+void post_screenshot(sqlite3 *db, int64_t chat_id, int64_t msg_id,
+                     const char *roi, int live)
+{
+    if (!Connected) return;
+
+    ScreenshotJob *job = xmalloc(sizeof(*job));
+    memset(job, 0, sizeof(*job));
+    atomic_init(&job->refcount, 1);
+    if (roi && strncmp(roi, "zoom ", 5) == 0) {
+        if (zoom_get(db, roi + 5, job->region) != 0) {
+            xfree(job);
+            return;
+        }
+        job->zoom = 1;
+    } else if (roi && strncmp(roi, "tail ", 5) == 0) {
+        job->tail = atoi(roi + 5);
+    }
+    job->chat_id = chat_id;
+    job->msg_id = msg_id;
+    job->wid = ConnectedSession.id;
+    job->color_mode = ColorMode;
+    job->scale_width = ScaleWidth;
+    job->auto_crop = AutoCrop;
+    job->progressive = Progressive;
+    job->live = live;
+    job->quality = qualityLevel();
+    job->created_us = statsUstime();
+    job->refresh_data = refresh_data(roi);
+    /* The request is served when the screenshot is sent. */
+    job->trace = slowlogCurrent();
+    slowlogRetain(job->trace);
+    pipelineSubmit(ScreenshotPipeline, job);
+}
+
+int send_text_snapshot(int64_t chat_id, int64_t msg_id);
+
+/* Send screenshot with refresh button. Backends that can't capture the
+ * window reply with its text instead. */
+void send_screenshot(sqlite3 *db, int64_t chat_id, const char *roi) {
+    if (!Platform->capture) {
+        if (!send_text_snapshot(chat_id, 0))
+            botSendMessage(chat_id, "Can't capture this window.", 0);
+        return;
+    }
+    post_screenshot(db, chat_id, 0, roi, 0);
 }
 
+/* Return values of sampled_screenshot_job() and post_sampled_screenshot(). */
+#define SAMPLE_NONE 0           /* No current sample: capture a new frame. */
+#define SAMPLE_SKIPPED 1        /* The message already shows the sample. */
+#define SAMPLE_QUEUED 2         /* The sample was queued for upload. */
+
+int post_sampled_screenshot(sqlite3 *db, int64_t chat_id, int64_t msg_id);
+
 /* Refresh an existing screenshot message by editing its media. */
-void refresh_screenshot(int64_t chat_id, int64_t msg_id) {
-    if (capture_connected_window(SCREENSHOT_PATH) != 0) return;
-    botEditMessageMedia(chat_id, msg_id, SCREENSHOT_PATH, REFRESH_BTN, REFRESH_DATA);
+void refresh_screenshot(sqlite3 *db, int64_t chat_id, int64_t msg_id, const char *roi) {
+    if (roi == NULL && post_sampled_screenshot(db, chat_id, msg_id)) return;
+    post_screenshot(db, chat_id, msg_id, roi, 0);
+}
+
+/* ============================================================================
+ * Background Sampler
+ * ========================================================================= */
+
+/* With .sampler on, a thread captures the connected window every few
+ * seconds while the session is active, and keeps the latest frame already
+ * encoded. A refresh tap then just uploads it, with no capture or encoding
+ * while the request lock is held, or sends nothing at all when the message
+ * already shows the same frame. Frames that didn't change since the last
+ * sample are only hashed, not encoded again, and backends that know when
+ * a session changes spare the capture too. Sampling pauses when the OTP
+ * timeout expires, since nobody can ask for screenshots until the next
+ * login. */
+
+typedef struct SampledFrame {
+    uint32_t wid;               /* Sampled window, 0 if no sample. */
+    int color_mode;             /* Settings used for the sample. */
+    int scale_width;
+    int auto_crop;
+    int quality;
+    int src_width;              /* Frame size before scaling. */
+    int src_height;
+    uint64_t captured_us;       /* When the last capture started. */
+    uint64_t generation;        /* Backend generation of the session when
+                                   captured, 0 if unknown. */
+    char hash[HASH_HEX_LEN+1];  /* Hash of the frame. */
+    sds png;                    /* Encoded frame, or NULL. */
+} SampledFrame;
+
+static SampledFrame Sample;
+static uint64_t SampleHits = 0;         /* Refreshes served by samples. */
+static uint64_t SampleSkips = 0;        /* Refreshes not needed at all. */
+static pthread_mutex_t SampleLock = PTHREAD_MUTEX_INITIALIZER; /* Protects
+                                           the sample and its counters. */
+
+/* What live_update() decided to send, sent by live_send() once
+ * RequestLock is released: the network may be slow. */
+typedef struct LiveUpdate {
+    int64_t ended_chat;         /* Chat to tell the view ended, or 0. */
+    struct ScreenshotJob *job;  /* Sampled frame to upload, or NULL. */
+} LiveUpdate;
+
+int live_running(void);
+void live_update(LiveUpdate *update);
+void live_send(LiveUpdate *update);
+int follow_running(void);
+int follow_start(int64_t chat_id, int minutes);
+void follow_stop(void);
+
+/* Return true if the owner is still logged in: the OTP was verified and
+ * didn't time out yet, or it is not required. Must be called with
+ * RequestLock held. */
+int owner_authenticated(void) {
+    if (WeakSecurity) return 1;
+    return Authenticated && time(NULL) - LastActivity <= OtpTimeout;
+}
+
+/* Return true if the sampler should run: when enabled, or for the live
+ * view, and only while the owner is logged in. Must be called with
+ * RequestLock held. */
+int sampler_active(void) {
+    if (!Connected || !Platform->capture) return 0;
+    if (!owner_authenticated()) return 0;
+    if (live_running()) return 1;
+    if (!Sampler) return 0;
+    return time(NULL) - LastActivity <= OtpTimeout;
+}
+
+/* Drop the sampled frame. */
+void clear_sample(void) {
+    pthread_mutex_lock(&SampleLock);
+    sdsfree(Sample.png);
+    Sample.png = NULL;
+    Sample.wid = 0;
+    pthread_mutex_unlock(&SampleLock);
+}
+
+/* Return true if the sample was taken with the settings of 'job'. Must be
+ * called with SampleLock held. */
+int sample_matches(const ScreenshotJob *job) {
+    return Sample.png && Sample.wid == job->wid &&
+           Sample.scale_width == job->scale_width &&
+           Sample.auto_crop == job->auto_crop &&
+           Sample.quality == job->quality;
+}
+
+/* Sampler thread: capture the window using the same stage as the
+ * pipeline, and encode the frame only if it changed. */
+void *sampler_main(void *arg) {
+    UNUSED(arg);
+    traceThreadName("sampler");
+    allocSetSubsystem("sampler");
+    while (1) {
+        sleep(SAMPLER_INTERVAL);
+        uint64_t start = statsUstime();
+
+        ScreenshotJob job;
+        memset(&job, 0, sizeof(job));
+        pthread_mutex_lock(&RequestLock);
+        int active = sampler_active();
+        job.wid = ConnectedSession.id;
+        job.color_mode = ColorMode;
+        job.scale_width = ScaleWidth;
+        job.auto_crop = AutoCrop;
+        pthread_mutex_unlock(&RequestLock);
+        LiveUpdate update;
+        if (!active) {
+            clear_sample();
+            pthread_mutex_lock(&RequestLock);
+            uint64_t locked = statsUstime();
+            live_update(&update);
+            traceRecordSince("locked", locked);
+            pthread_mutex_unlock(&RequestLock);
+            live_send(&update);
+            continue;
+        }
+
+        job.quality = qualityLevel();
+        job.created_us = statsUstime();
+        /* Read before capturing: a change while capturing gives a new
+         * generation, so the next round captures again. */
+        uint64_t generation = Platform->generation ?
+                              Platform->generation(job.wid) : 0;
+        const QualityLevel *q = &QualityLadder[job.quality];
+
+        pthread_mutex_lock(&SampleLock);
+        int same = generation && Sample.generation == generation &&
+                   sample_matches(&job);
+        pthread_mutex_unlock(&SampleLock);
+        if (same) {
+            statsIncr("captures_skipped_total", 1);
+        } else {
+            if (capture_stage(&job) != 0) continue;
+            frame_hash(job.frame, job.color_mode, q->maxcolors, job.hash);
+        }
+
+        pthread_mutex_lock(&SampleLock);
+        if (!same) {
+            same = sample_matches(&job) && strcmp(Sample.hash, job.hash) == 0;
+        }
+        if (same) {
+            Sample.captured_us = job.created_us;
+            Sample.generation = generation;
+        }
+        statsIncr(same ? "frames_unchanged_total" : "frames_changed_total", 1);
+        pthread_mutex_unlock(&SampleLock);
+
+        if (!same) {
+            sds png = pngEncode(job.frame, job.color_mode, q->maxcolors, q->zlevel);
+            pthread_mutex_lock(&SampleLock);
+            sdsfree(Sample.png);
+            Sample.png = png;
+            Sample.wid = job.wid;
+            Sample.color_mode = job.color_mode;
+            Sample.scale_width = job.scale_width;
+            Sample.auto_crop = job.auto_crop;
+            Sample.quality = job.quality;
+            Sample.src_width = job.src_width;
+            Sample.src_height = job.src_height;
+            Sample.captured_us = job.created_us;
+            Sample.generation = generation;
+            memcpy(Sample.hash, job.hash, sizeof(job.hash));
+            pthread_mutex_unlock(&SampleLock);
+        }
+        frameFree(job.frame);
+        traceRecordSince("sample", start);
+
+        pthread_mutex_lock(&RequestLock);
+        uint64_t locked = statsUstime();
+        live_update(&update);
+        traceRecordSince("locked", locked);
+        pthread_mutex_unlock(&RequestLock);
+        live_send(&update);
+    }
+    return NULL;
+}
+
+void start_sampler(void) {
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, sampler_main, NULL) != 0) {
+        fprintf(stderr, "Can't start the background sampler.\n");
+        exit(1);
+    }
+    pthread_detach(tid);
+}
+
+/* Make a job refreshing the message with the sampled frame, if it is
+ * current: taken after the last keystrokes, of the connected window, with
+ * the current settings. Returns SAMPLE_QUEUED setting '*jobptr' to the job,
+ * ready for the upload stage, or SAMPLE_NONE if a new frame must be
+ * captured instead. Must be called with RequestLock held. */
+int sampled_screenshot_job(sqlite3 *db, int64_t chat_id, int64_t msg_id,
+                           ScreenshotJob **jobptr)
+{
+    pthread_mutex_lock(&SampleLock);
+    if (!Sample.png || Sample.wid != ConnectedSession.id ||
+        Sample.color_mode != ColorMode || Sample.scale_width != ScaleWidth ||
+        Sample.auto_crop != AutoCrop || Sample.captured_us < LastInputUs)
+    {
+        pthread_mutex_unlock(&SampleLock);
+        return SAMPLE_NONE;
+    }
+
+    /* The message already shows this frame. */
+    if (shown_is(chat_id, msg_id, Sample.hash)) {
+        SampleSkips++;
+        statsIncr("frames_skipped_total", 1);
+        pthread_mutex_unlock(&SampleLock);
+        return SAMPLE_SKIPPED;
+    }
+
+    ScreenshotJob *job = xmalloc(sizeof(*job));
+    memset(job, 0, sizeof(*job));
+    atomic_init(&job->refcount, 1);
+    job->chat_id = chat_id;
+    job->msg_id = msg_id;
+    job->wid = Sample.wid;
+    job->color_mode = Sample.color_mode;
+    job->scale_width = Sample.scale_width;
+    job->auto_crop = Sample.auto_crop;
+    job->quality = Sample.quality;
+    job->src_width = Sample.src_width;
+    job->src_height = Sample.src_height;
+    job->created_us = statsUstime();
+    job->refresh_data = refresh_data(NULL);
+    memcpy(job->hash, Sample.hash, sizeof(job->hash));
+    job->path = screenshot_path();
+    FILE *fp = fopen(job->path, "w");
+    int ok = fp && fwrite(Sample.png, sdslen(Sample.png), 1, fp) == 1;
+    if (fp && fclose(fp) != 0) ok = 0;
+    if (ok) SampleHits++;
+    pthread_mutex_unlock(&SampleLock);
+
+    if (!ok) {
+        free_screenshot_job(job);
+        return SAMPLE_NONE;
+    }
+    job->file_id = fileid_get(db, job->hash, &job->size);
+    *jobptr = job;
+    return SAMPLE_QUEUED;
+}
+
+/* Refresh the message with the sampled frame, if it is current, see
+ * sampled_screenshot_job(). Must be called with RequestLock held. */
+int post_sampled_screenshot(sqlite3 *db, int64_t chat_id, int64_t msg_id) {
+    ScreenshotJob *job;
+    int retval = sampled_screenshot_job(db, chat_id, msg_id, &job);
+    if (retval == SAMPLE_QUEUED) pipelinePush(ScreenshotPipeline, UPLOAD_STAGE, job);
+    return retval;
+}
+
+/* Build the reply of the .sampler command. */
+sds build_sampler_message(void) {
+    pthread_mutex_lock(&SampleLock);
+    sds msg = sdscatprintf(sdsempty(),
+        "Background sampler: %s\n"
+        "Refreshes from samples: %llu\n"
+        "Refreshes skipped, unchanged: %llu",
+        Sampler ? "on" : "off",
+        (unsigned long long)SampleHits,
+        (unsigned long long)SampleSkips);
+    pthread_mutex_unlock(&SampleLock);
+    return msg;
+}
+
+/* ============================================================================
+ * Live View
+ * ========================================================================= */
+
+/* .live keeps a single screenshot message that is edited in place as the
+ * window changes, instead of a new photo for every interaction. The
+ * background sampler already detects changes by hashing every frame, so
+ * after each sample we just refresh the live message with it: unchanged
+ * frames cost nothing, and changed ones are sent at most once every
+ * LIVE_MIN_INTERVAL seconds. The live view ends after the requested time,
+ * with .stop, when disconnecting from the window, or when the OTP times
+ * out. */
+
+/* Return true if the live view is running. */
+int live_running(void) {
+    pthread_mutex_lock(&LiveLock);
+    int running = LiveChat != 0;
+    pthread_mutex_unlock(&LiveLock);
+    return running;
+}
+
+/* Start the live view in the specified chat, sending its message. */
+void live_start(sqlite3 *db, int64_t chat_id, int minutes) {
+    pthread_mutex_lock(&LiveLock);
+    LiveChat = chat_id;
+    LiveMsgId = 0;
+    LiveUntil = time(NULL) + (time_t)minutes * 60;
+    LiveEditUs = statsUstime();
+    pthread_mutex_unlock(&LiveLock);
+    post_screenshot(db, chat_id, 0, NULL, 1);
+}
+
+void live_stop(void) {
+    pthread_mutex_lock(&LiveLock);
+    LiveChat = 0;
+    LiveMsgId = 0;
+    pthread_mutex_unlock(&LiveLock);
+}
+
+/* Called by the upload stage once the live view message was sent. */
+void live_set_message(int64_t chat_id, int64_t msg_id) {
+    pthread_mutex_lock(&LiveLock);
+    if (LiveChat == chat_id && LiveMsgId == 0) LiveMsgId = msg_id;
+    pthread_mutex_unlock(&LiveLock);
+}
+
+/* Called by the sampler after every sample: decide whether to edit the
+ * live message, if the frame changed, or to end the live view. Must be
+ * called with RequestLock held, then live_send() sends what was decided
+ * once it is released. */
+void live_update(LiveUpdate *update) {
+    update->ended_chat = 0;
+    update->job = NULL;
+
+    pthread_mutex_lock(&LiveLock);
+    int64_t chat_id = LiveChat, msg_id = LiveMsgId;
+    int ended = chat_id && (!Connected || !owner_authenticated() ||
+                            time(NULL) > LiveUntil);
+    int due = statsUstime() - LiveEditUs >= (uint64_t)LIVE_MIN_INTERVAL * 1000000;
+    if (ended) LiveChat = LiveMsgId = 0;
+    pthread_mutex_unlock(&LiveLock);
+
+    if (ended) {
+        update->ended_chat = chat_id;
+        return;
+    }
+    if (!msg_id || !due) return;
+    sqlite3 *db = stage_db();
+    if (db && sampled_screenshot_job(db, chat_id, msg_id, &update->job) == SAMPLE_QUEUED) {
+        pthread_mutex_lock(&LiveLock);
+        LiveEditUs = statsUstime();
+        pthread_mutex_unlock(&LiveLock);
+    }
+}
+
+/* Send what live_update() decided. Called without RequestLock, since
+ * both the message and a full upload queue may block. */
+void live_send(LiveUpdate *update) {
+    if (update->ended_chat)
+        botSendMessage(update->ended_chat, "Live view ended.", 0);
+    if (update->job)
+        pipelinePush(ScreenshotPipeline, UPLOAD_STAGE, update->job);
+}
+
+/* ============================================================================
+ * Text Snapshots
+ * ========================================================================= */
+
+/* A screenshot of a shell is a very expensive way to send a few KB of
+ * text. Backends can read the visible text of the session (on macOS
+ * terminal apps expose their screen to the Accessibility API), so we send
+ * it as a monospace message instead, edited in place by the refresh
+ * button. */
+
+/* Remove trailing spaces from every line and trailing empty lines, that
+ * terminals pad the screen with. */
+void trim_screen_text(sds s) {
+    char *src = s, *dst = s, *end = s + sdslen(s);
+    while (src < end) {
+        char *nl = memchr(src, '\n', end - src);
+        char *eol = nl ? nl : end;
+        char *last = eol;
+        while (last > src && (last[-1] == ' ' || last[-1] == '\r')) last--;
+        memmove(dst, src, last - src);
+        dst += last - src;
+        if (nl) *dst++ = '\n';
+        src = nl ? nl + 1 : end;
+    }
+    while (dst > s && dst[-1] == '\n') dst--;
+    sdssetlen(s, dst - s);
+    *dst = '\0';
+}
+
+/* Return the text visible in the connected window, or NULL if the
+ * backend can't read it. */
+sds window_text(void) {
+    if (!Platform->text) return NULL;
+    sds text = Platform->text(&ConnectedSession);
+    if (text) trim_screen_text(text);
+    return text;
+}
+
+/* Return how many bytes of 'text' go in a message: at most TEXT_CHUNK_MAX,
+ * ending at a line boundary when possible, never inside an UTF-8
+ * sequence. */
+size_t text_chunk_len(const char *text, size_t len) {
+    if (len <= TEXT_CHUNK_MAX) return len;
+    size_t n = TEXT_CHUNK_MAX;
+    while (n > 0 && text[n] != '\n') n--;
+    if (n == 0) {
+        n = TEXT_CHUNK_MAX;
+        while (n > 0 && ((unsigned char)text[n] & 0xC0) == 0x80) n--;
+    }
+    return n;
+}
+
+/* Return the text as an HTML preformatted block. */
+sds html_pre(const char *text, size_t len) {
+    sds pre = sdsnew("<pre>");
+    for (size_t j = 0; j < len; j++) {
+        switch (text[j]) {
+        case '&': pre = sdscat(pre, "&amp;"); break;
+        case '<': pre = sdscat(pre, "&lt;"); break;
+        case '>': pre = sdscat(pre, "&gt;"); break;
+        default: pre = sdscatlen(pre, text + j, 1); break;
+        }
+    }
+    return sdscat(pre, "</pre>");
+}
+
+/* Split the text in chunks that fit a message. Returns the chunks as HTML
+ * preformatted blocks, setting '*count'. */
+sds *split_text_message(const char *text, int *count) {
+    sds *chunks = NULL;
+    size_t len = strlen(text);
+    *count = 0;
+    do {
+        size_t n = text_chunk_len(text, len);
+        chunks = xrealloc(chunks, sizeof(sds) * (*count + 1));
+        chunks[(*count)++] = html_pre(text, n);
+
+        if (n < len && text[n] == '\n') n++;
+        text += n;
+        len -= n;
+    } while (len);
+    return chunks;
+}
+
+/* Send the text of the connected window, as new messages if 'msg_id' is
+ * zero, otherwise editing the message. Only the last message has the
+ * refresh button, and when editing it shows the end of the screen, that
+ * is where the cursor usually is. Returns 0 if the window has no text
+ * to read. */
+int send_text_snapshot(int64_t chat_id, int64_t msg_id) {
+    sds text = window_text();
+    if (!text) return 0;
+    if (sdslen(text) == 0) text = sdscat(text, " ");
+
+    int count;
+    sds *chunks = split_text_message(text, &count);
+    sdsfree(text);
+    if (msg_id) {
+        botEditHTMLWithKeyboard(chat_id, msg_id, chunks[count-1],
+                                REFRESH_BTN, TEXT_DATA);
+    } else {
+        for (int j = 0; j < count-1; j++)
+            botSendHTMLWithKeyboard(chat_id, chunks[j], NULL, NULL, NULL);
+        botSendHTMLWithKeyboard(chat_id, chunks[count-1], REFRESH_BTN,
+                                TEXT_DATA, NULL);
+    }
+    for (int j = 0; j < count; j++) sdsfree(chunks[j]);
+    xfree(chunks);
+    return 1;
+}
+
+/* Send 'text' as preformatted messages, with no buttons. */
+void send_text_message(int64_t chat_id, const char *text) {
+    int count;
+    sds *chunks = split_text_message(text, &count);
+    for (int j = 0; j < count; j++) {
+        botSendHTMLWithKeyboard(chat_id, chunks[j], NULL, NULL, NULL);
+        sdsfree(chunks[j]);
+    }
+    xfree(chunks);
+}
+
+/* Reply to the .scroll command with page 'page' of the connected session
+ * output, the screen being page 0. */
+void handle_scroll(int64_t chat_id, int page) {
+    int pages;
+    sds text = Platform->page ? Platform->page(&ConnectedSession, page, &pages) : NULL;
+    if (!text) {
+        botSendMessage(chat_id, "This window doesn't keep its output.", 0);
+        return;
+    }
+    trim_screen_text(text);
+    if (pages < 1) pages = 1;
+    if (page > pages-1) page = pages-1;
+    if (page < 0) page = 0;
+    sds msg = sdscatprintf(sdsempty(), "-- page %d of 0-%d\n%s", page,
+                           pages-1, text);
+    send_text_message(chat_id, msg);
+    sdsfree(msg);
+    sdsfree(text);
+}
+
+/* Reply to the .zoom command. With no arguments list the regions saved for
+ * the connected window, otherwise capture, save or delete a region. */
+void handle_zoom(sqlite3 *db, int64_t chat_id, const char *arg) {
+    int argc;
+    sds *argv = sdssplitargs(arg, &argc);
+    if (!argv) {
+        botSendMessage(chat_id, "Invalid .zoom arguments.", 0);
+        return;
+    }
+
+    if (argc == 0) {
+        sds prefix = sdscatprintf(sdsempty(), "zoom:%u:", (unsigned)ConnectedSession.id);
+        sds pattern = sdscatprintf(sdsempty(), "%s%%", prefix);
+        sds msg = sdsnew("Regions:\n");
+        int count = 0;
+        sqlRow row;
+        sqlSelect(db, &row, "SELECT key,value FROM KeyValue WHERE key LIKE ?s", pattern);
+        while (sqlNextRow(&row)) {
+            msg = sdscatprintf(msg, "%s: %s\n", row.col[0].s + sdslen(prefix),
+                               row.col[1].s);
+            count++;
+        }
+        sqlEnd(&row);
+        if (count == 0) {
+            sdsfree(msg);
+            msg = sdsnew("No regions saved for this window.");
+        }
+        botSendMessage(chat_id, msg, 0);
+        sdsfree(msg);
+        sdsfree(pattern);
+        sdsfree(prefix);
+    } else if (!valid_zoom_name(argv[0])) {
+        botSendMessage(chat_id, "Region names are letters, digits, - and _.", 0);
+    } else if (argc == 1) {
+        double region[4];
+        if (zoom_get(db, argv[0], region) != 0) {
+            botSendMessage(chat_id, "No such region.", 0);
+        } else {
+            sds roi = sdscatprintf(sdsempty(), "zoom %s", argv[0]);
+            send_screenshot(db, chat_id, roi);
+            sdsfree(roi);
+        }
+    } else if (argc == 2 && strcasecmp(argv[1], "del") == 0) {
+        sds key = sdscatprintf(sdsempty(), "zoom:%u:%s", (unsigned)ConnectedSession.id, argv[0]);
+        kvDel(db, key);
+        sdsfree(key);
+        botSendMessage(chat_id, "Region deleted.", 0);
+    } else if (argc == 5) {
+        double r[4];
+        for (int j = 0; j < 4; j++) r[j] = atof(argv[j+1]);
+        if (r[0] < 0 || r[1] < 0 || r[2] <= 0 || r[3] <= 0 ||
+            r[0] + r[2] > 100 || r[1] + r[3] > 100)
+        {
+            botSendMessage(chat_id, "Region must be inside the window (0-100%).", 0);
+        } else {
+            sds key = sdscatprintf(sdsempty(), "zoom:%u:%s", (unsigned)ConnectedSession.id, argv[0]);
+            sds val = sdscatprintf(sdsempty(), "%g %g %g %g", r[0], r[1], r[2], r[3]);
+            kvSet(db, key, val, 0);
+            sdsfree(key);
+            sdsfree(val);
+            sds roi = sdscatprintf(sdsempty(), "zoom %s", argv[0]);
+            send_screenshot(db, chat_id, roi);
+            sdsfree(roi);
+        }
+    } else {
+        botSendMessage(chat_id, "Usage: .zoom [name] [x y w h | del]", 0);
+    }
+    sdsfreesplitres(argv, argc);
 }
 
 void handle_request(sqlite3 *db, BotRequest *br) {
+    uint64_t start = statsUstime();
     pthread_mutex_lock(&RequestLock);
+    statsRecordSince("lock", start);
+    uint64_t locked = statsUstime();
 
     /* Check owner. First user to message becomes owner. */
     sds owner_str = kvGet(db, OWNER_KEY);
@@ -825,14 +1831,21 @@ void handle_request(sqlite3 *db, BotRequest *br) {
             }
             goto done;
         }
-        LastActivity = time(NULL);
     }
+    LastActivity = time(NULL);
 
     /* Handle callback query (button press). */
     if (br->is_callback) {
         botAnswerCallbackQuery(br->callback_id);
-        if (strcmp(br->callback_data, REFRESH_DATA) == 0 && Connected) {
-            refresh_screenshot(br->target, br->msg_id);
+        const char *data = br->callback_data;
+        size_t len = strlen(REFRESH_DATA);
+        if (strncmp(data, REFRESH_DATA, len) == 0 &&
+            (data[len] == '\0' || data[len] == ' ') && Connected)
+        {
+            const char *roi = data[len] ? data + len + 1 : NULL;
+            refresh_screenshot(db, br->target, br->msg_id, roi);
+        } else if (strcmp(data, TEXT_DATA) == 0 && Connected) {
+            send_text_snapshot(br->target, br->msg_id);
         }
         goto done;
     }
@@ -873,6 +1886,333 @@ void handle_request(sqlite3 *db, BotRequest *br) {
         goto done;
     }
 
+    /* Handle .color command. */
+    if (strncasecmp(req, ".color", 6) == 0 && (req[6] == ' ' || req[6] == '\0')) {
+        char *arg = req + 6;
+        while (*arg == ' ') arg++;
+        int mode = color_mode_by_name(arg);
+        if (mode == -1) {
+            botSendMessage(br->target, "Usage: .color auto|gray|mono", 0);
+            goto done;
+        }
+        ColorMode = mode;
+        kvSet(db, "color_mode", ColorModeNames[mode], 0);
+        sds msg = sdscatprintf(sdsempty(), "Screenshot colors set to %s.",
+                               ColorModeNames[mode]);
+        botSendMessage(br->target, msg, 0);
+        sdsfree(msg);
+        goto done;
+    }
+
+    /* Handle .width command. */
+    if (strncasecmp(req, ".width", 6) == 0 && (req[6] == ' ' || req[6] == '\0')) {
+        char *arg = req + 6;
+        while (*arg == ' ') arg++;
+        if (!isdigit((unsigned char)*arg)) {
+            botSendMessage(br->target, "Usage: .width <pixels>, 0 for the native resolution", 0);
+            goto done;
+        }
+        int width = atoi(arg);
+        if (width != 0 && width < 160) width = 160;
+        ScaleWidth = width;
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%d", width);
+        kvSet(db, "scale_width", buf, 0);
+        sds msg = width ? sdscatprintf(sdsempty(), "Screenshots scaled to %d pixels wide.", width)
+                        : sdsnew("Screenshots at native resolution.");
+        botSendMessage(br->target, msg, 0);
+        sdsfree(msg);
+        goto done;
+    }
+
+    /* Handle .crop command. */
+    if (strncasecmp(req, ".crop", 5) == 0 && (req[5] == ' ' || req[5] == '\0')) {
+        char *arg = req + 5;
+        while (*arg == ' ') arg++;
+        if (strcasecmp(arg, "on") == 0) {
+            AutoCrop = 1;
+        } else if (strcasecmp(arg, "off") == 0) {
+            AutoCrop = 0;
+        } else {
+            botSendMessage(br->target, "Usage: .crop on|off", 0);
+            goto done;
+        }
+        kvSet(db, "auto_crop", AutoCrop ? "1" : "0", 0);
+        botSendMessage(br->target, AutoCrop ? "Auto crop enabled." :
+                                              "Auto crop disabled.", 0);
+        goto done;
+    }
+
+    /* Handle .tail command. */
+    if (strncasecmp(req, ".tail", 5) == 0 && (req[5] == ' ' || req[5] == '\0')) {
+        if (!Connected) {
+            botSendMessage(br->target, "Not connected to a window.", 0);
+            goto done;
+        }
+        char *arg = req + 5;
+        while (*arg == ' ') arg++;
+        int lines = *arg ? atoi(arg) : 10;
+        if (lines < 1) lines = 1;
+        if (lines > TAIL_MAX_LINES) lines = TAIL_MAX_LINES;
+        char roi[32];
+        snprintf(roi, sizeof(roi), "tail %d", lines);
+        send_screenshot(db, br->target, roi);
+        goto done;
+    }
+
+    /* Handle .zoom command. */
+    if (strncasecmp(req, ".zoom", 5) == 0 && (req[5] == ' ' || req[5] == '\0')) {
+        if (!Connected) {
+            botSendMessage(br->target, "Not connected to a window.", 0);
+            goto done;
+        }
+        handle_zoom(db, br->target, req + 5);
+        goto done;
+    }
+
+    /* Handle .cache command. */
+    if (strcasecmp(req, ".cache") == 0) {
+        sds msg = build_cache_message();
+        botSendMessage(br->target, msg, 0);
+        sdsfree(msg);
+        goto done;
+    }
+
+    /* Handle .stats command. */
+    if (strcasecmp(req, ".stats") == 0) {
+        sds msg = botStatsInfo();
+        botSendMessage(br->target, msg, 0);
+        sdsfree(msg);
+        goto done;
+    }
+
+    /* Handle .slowlog command. */
+    if (strncasecmp(req, ".slowlog", 8) == 0 && (req[8] == ' ' || req[8] == '\0')) {
+        char *arg = req + 8;
+        while (*arg == ' ') arg++;
+        if (strcasecmp(arg, "reset") == 0) {
+            slowlogReset();
+            botSendMessage(br->target, "Slow log cleared.", 0);
+        } else {
+            int count = *arg ? atoi(arg) : SLOWLOG_SHOW;
+            if (count < 1) count = 1;
+            sds msg = slowlogInfo(count);
+            if (sdslen(msg) == 0) {
+                msg = sdscatprintf(msg, "No requests slower than %llu ms.",
+                                   (unsigned long long)slowlogThreshold());
+                botSendMessage(br->target, msg, 0);
+            } else {
+                send_text_message(br->target, msg);
+            }
+            sdsfree(msg);
+        }
+        goto done;
+    }
+
+    /* Handle .memory command. */
+    if (strcasecmp(req, ".memory") == 0) {
+        sds msg = allocInfo();
+        botSendMessage(br->target, msg, 0);
+        sdsfree(msg);
+        goto done;
+    }
+
+    /* Handle .pipeline command. */
+    if (strcasecmp(req, ".pipeline") == 0) {
+        PoolStats ps;
+        poolGetStats(&ps);
+        sds msg = pipelineInfo(ScreenshotPipeline);
+        msg = sdscatprintf(msg, "buffers: %llu reused, %llu allocated, "
+                                "%d cached (%zu KB)",
+                           (unsigned long long)ps.hits,
+                           (unsigned long long)ps.misses,
+                           ps.cached, ps.cached_bytes / 1024);
+        botSendMessage(br->target, msg, 0);
+        sdsfree(msg);
+        goto done;
+    }
+
+    /* Handle .progressive command. */
+    if (strncasecmp(req, ".progressive", 12) == 0 && (req[12] == ' ' || req[12] == '\0')) {
+        char *arg = req + 12;
+        while (*arg == ' ') arg++;
+        if (strcasecmp(arg, "on") == 0) {
+            Progressive = 1;
+        } else if (strcasecmp(arg, "off") == 0) {
+            Progressive = 0;
+        } else {
+            botSendMessage(br->target, "Usage: .progressive on|off", 0);
+            goto done;
+        }
+        kvSet(db, "progressive", Progressive ? "1" : "0", 0);
+        botSendMessage(br->target, Progressive ? "Progressive screenshots enabled." :
+                                                 "Progressive screenshots disabled.", 0);
+        goto done;
+    }
+
+    /* Handle .latency command. */
+    if (strncasecmp(req, ".latency", 8) == 0 && (req[8] == ' ' || req[8] == '\0')) {
+        char *arg = req + 8;
+        while (*arg == ' ') arg++;
+        if (*arg) {
+            int ms = strcasecmp(arg, "off") == 0 ? 0 : atoi(arg);
+            if (ms != 0 && ms < 500) ms = 500;
+            qualitySetTarget(ms);
+            char buf[32];
+            snprintf(buf, sizeof(buf), "%d", ms);
+            kvSet(db, "latency_target", buf, 0);
+        }
+        sds msg = qualityInfo();
+        botSendMessage(br->target, msg, 0);
+        sdsfree(msg);
+        goto done;
+    }
+
+    /* Handle .sampler command. */
+    if (strncasecmp(req, ".sampler", 8) == 0 && (req[8] == ' ' || req[8] == '\0')) {
+        char *arg = req + 8;
+        while (*arg == ' ') arg++;
+        if (strcasecmp(arg, "on") == 0) {
+            Sampler = 1;
+        } else if (strcasecmp(arg, "off") == 0) {
+            Sampler = 0;
+        } else if (*arg) {
+            botSendMessage(br->target, "Usage: .sampler [on|off]", 0);
+            goto done;
+        }
+        if (*arg) kvSet(db, "sampler", Sampler ? "1" : "0", 0);
+        sds msg = build_sampler_message();
+        botSendMessage(br->target, msg, 0);
+        sdsfree(msg);
+        goto done;
+    }
+
+    /* Handle .live command. */
+    if (strncasecmp(req, ".live", 5) == 0 && (req[5] == ' ' || req[5] == '\0')) {
+        if (!Connected) {
+            botSendMessage(br->target, "Not connected to a window.", 0);
+            goto done;
+        }
+        if (!Platform->capture) {
+            botSendMessage(br->target, "Can't capture this window.", 0);
+            goto done;
+        }
+        char *arg = req + 5;
+        while (*arg == ' ') arg++;
+        int minutes = *arg ? atoi(arg) : LIVE_DEFAULT_MINUTES;
+        if (minutes < 1) minutes = 1;
+        if (minutes > LIVE_MAX_MINUTES) minutes = LIVE_MAX_MINUTES;
+        live_start(db, br->target, minutes);
+        goto done;
+    }
+
+    /* Handle .follow command. */
+    if (strncasecmp(req, ".follow", 7) == 0 && (req[7] == ' ' || req[7] == '\0')) {
+        if (!Connected) {
+            botSendMessage(br->target, "Not connected to a window.", 0);
+            goto done;
+        }
+        char *arg = req + 7;
+        while (*arg == ' ') arg++;
+        int minutes = *arg ? atoi(arg) : FOLLOW_DEFAULT_MINUTES;
+        if (minutes < 1) minutes = 1;
+        if (minutes > FOLLOW_MAX_MINUTES) minutes = FOLLOW_MAX_MINUTES;
+        if (!Platform->follow || follow_start(br->target, minutes) != 0) {
+            botSendMessage(br->target, "Can't read the output of this window.", 0);
+            goto done;
+        }
+        sds msg = sdscatprintf(sdsempty(), "Following the output for %d "
+                               "minutes, .stop to end.", minutes);
+        botSendMessage(br->target, msg, 0);
+        sdsfree(msg);
+        goto done;
+    }
+
+    /* Handle .stop command: ends the live view and the output stream. */
+    if (strcasecmp(req, ".stop") == 0) {
+        char *msg = "Nothing to stop.";
+        if (live_running() && follow_running())
+            msg = "Live view and output stream stopped.";
+        else if (live_running())
+            msg = "Live view stopped.";
+        else if (follow_running())
+            msg = "Output stream stopped.";
+        botSendMessage(br->target, msg, 0);
+        live_stop();
+        follow_stop();
+        goto done;
+    }
+
+    /* Handle .text command. */
+    if (strncasecmp(req, ".text", 5) == 0 && (req[5] == ' ' || req[5] == '\0')) {
+        char *arg = req + 5;
+        while (*arg == ' ') arg++;
+        if (strcasecmp(arg, "on") == 0 || strcasecmp(arg, "off") == 0) {
+            TextMode = strcasecmp(arg, "on") == 0;
+            kvSet(db, "text_mode", TextMode ? "1" : "0", 0);
+            botSendMessage(br->target, TextMode ? "Text mode enabled." :
+                                                  "Text mode disabled.", 0);
+        } else if (*arg) {
+            botSendMessage(br->target, "Usage: .text [on|off]", 0);
+        } else if (!Connected) {
+            botSendMessage(br->target, "Not connected to a window.", 0);
+        } else if (!send_text_snapshot(br->target, 0)) {
+            botSendMessage(br->target, "This window doesn't expose its text.", 0);
+        }
+        goto done;
+    }
+
+    /* Handle .grep command. */
+    if (strncasecmp(req, ".grep", 5) == 0 && (req[5] == ' ' || req[5] == '\0')) {
+        char *arg = req + 5;
+        while (*arg == ' ') arg++;
+        sds text = NULL;
+        if (!*arg) {
+            botSendMessage(br->target, "Usage: .grep <text>", 0);
+        } else if (!Connected) {
+            botSendMessage(br->target, "Not connected to a window.", 0);
+        } else if (!Platform->grep ||
+                   (text = Platform->grep(&ConnectedSession, arg)) == NULL)
+        {
+            botSendMessage(br->target, "This window doesn't keep its output.", 0);
+        } else {
+            send_text_message(br->target, text);
+            sdsfree(text);
+        }
+        goto done;
+    }
+
+    /* Handle .scroll command. */
+    if (strncasecmp(req, ".scroll", 7) == 0 && (req[7] == ' ' || req[7] == '\0')) {
+        char *arg = req + 7;
+        while (*arg == ' ') arg++;
+        if (!Connected) {
+            botSendMessage(br->target, "Not connected to a window.", 0);
+        } else {
+            handle_scroll(br->target, *arg ? atoi(arg) : 1);
+        }
+        goto done;
+    }
+
+    /* Handle .new command. */
+    if (strncasecmp(req, ".new", 4) == 0 && (req[4] == ' ' || req[4] == '\0')) {
+        char *arg = req + 4;
+        while (*arg == ' ') arg++;
+        if (!Platform->spawn) {
+            botSendMessage(br->target, "The backend can't start new sessions.", 0);
+        } else if (Platform->spawn(*arg ? arg : NULL) != 0) {
+            botSendMessage(br->target, "Can't start the session.", 0);
+        } else {
+            sds msg = sdsnew("Session started.\n\n");
+            sds list = build_list_message();
+            msg = sdscatsds(msg, list);
+            sdsfree(list);
+            botSendMessage(br->target, msg, 0);
+            sdsfree(msg);
+        }
+        goto done;
+    }
+
     /* Handle .N to connect to window N. */
     if (req[0] == '.' && isdigit(req[1])) {
         int n = atoi(req + 1);
@@ -884,27 +2224,21 @@ void handle_request(sqlite3 *db, BotRequest *br) {
         }
 
         /* Store connection info directly. */
-        WinInfo *w = &WindowList[n - 1];
         Connected = 1;
-        ConnectedWid = w->window_id;
-        ConnectedPid = w->pid;
-        strncpy(ConnectedOwner, w->owner, sizeof(ConnectedOwner) - 1);
-        ConnectedOwner[sizeof(ConnectedOwner) - 1] = '\0';
-        strncpy(ConnectedTitle, w->title, sizeof(ConnectedTitle) - 1);
-        ConnectedTitle[sizeof(ConnectedTitle) - 1] = '\0';
+        ConnectedSession = WindowList[n - 1];
 
         sds msg = sdsnew("Connected to ");
-        msg = sdscat(msg, ConnectedOwner);
-        if (ConnectedTitle[0]) {
+        msg = sdscat(msg, ConnectedSession.owner);
+        if (ConnectedSession.title[0]) {
             msg = sdscat(msg, " - ");
-            msg = sdscat(msg, ConnectedTitle);
+            msg = sdscat(msg, ConnectedSession.title);
         }
         botSendMessage(br->target, msg, 0);
         sdsfree(msg);
 
         /* Raise the window and send welcome screenshot. */
-        raise_window_by_id(w->pid, w->window_id);
-        send_screenshot(br->target);
+        if (Platform->focus) Platform->focus(&ConnectedSession);
+        send_screenshot(db, br->target, NULL);
         goto done;
     }
 
@@ -928,16 +2262,25 @@ void handle_request(sqlite3 *db, BotRequest *br) {
         goto done;
     }
 
-    /* Send keystrokes. */
+    /* Send keystrokes. Samples taken before are now stale. */
+    LastInputUs = statsUstime();
     send_keys(req);
 
     /* Wait a bit for the terminal to react, then re-check the window
      * (keystrokes like ESC+N may switch tabs, changing the window ID). */
+    start = statsUstime();
     sleep(2);
     connected_window_exists();
-    send_screenshot(br->target);
+    statsRecordSince("settle", start);
+
+    /* In live mode the live message will show the result. In text mode
+     * screenshots are only used for windows without readable text. */
+    if (live_running()) goto done;
+    if (!TextMode || !send_text_snapshot(br->target, 0))
+        send_screenshot(db, br->target, NULL);
 
 done:
+    traceRecordSince("locked", locked);
     pthread_mutex_unlock(&RequestLock);
 }
 
@@ -945,13 +2288,251 @@ void cron_callback(sqlite3 *db) {
     UNUSED(db);
 }
 
+/* ============================================================================
+ * Output Streaming
+ * ========================================================================= */
+
+/* .follow streams the output of the session as text, for example to watch
+ * a long build without screenshots. The backend keeps the output with the
+ * escape sequences stripped, and a thread collects it a few times per
+ * second and appends it to a message edited in place. Edits are batched:
+ * they wait for the output to pause a moment, but not longer than
+ * FOLLOW_MAX_DELAY_MS, and are never closer than FOLLOW_MIN_INTERVAL_MS,
+ * to stay within the Telegram rate limits. Once the text is too long for
+ * a message it continues in a new one. */
+
+/* A stream being sent, only accessed by the follower thread. */
+typedef struct OutputStream {
+    int64_t chat_id;
+    int64_t msg_id;         /* Message being edited, 0 until sent. */
+    sds text;               /* Its text. */
+    size_t line;            /* Offset in 'text' of the last line. */
+    int cr;                 /* A carriage return is pending. */
+    int dirty;              /* The text changed since the last edit. */
+    uint64_t output_us;     /* When output was last received. */
+    uint64_t edit_us;       /* When the message was last sent or edited. */
+} OutputStream;
+
+/* Return true if the output stream is running. */
+int follow_running(void) {
+    pthread_mutex_lock(&FollowLock);
+    int running = FollowChat != 0;
+    pthread_mutex_unlock(&FollowLock);
+    return running;
+}
+
+/* Stop the output stream. Must be called with FollowLock held. */
+static void follow_stop_locked(void) {
+    if (FollowChat && Platform->follow) Platform->follow(&FollowSession, 0);
+    FollowChat = 0;
+    FollowGen++;
+}
+
+void follow_stop(void) {
+    pthread_mutex_lock(&FollowLock);
+    follow_stop_locked();
+    pthread_mutex_unlock(&FollowLock);
+}
+
+/* Start streaming the output of the connected session to the specified
+ * chat, replacing the current stream. Returns 0 on success, -1 if the
+ * session can't be followed. Must be called with RequestLock held. */
+int follow_start(int64_t chat_id, int minutes) {
+    pthread_mutex_lock(&FollowLock);
+    if (FollowChat && FollowSession.id != ConnectedSession.id)
+        follow_stop_locked();
+    int retval = Platform->follow(&ConnectedSession, 1);
+    if (retval == 0) {
+        FollowChat = chat_id;
+        FollowSession = ConnectedSession;
+        FollowUntil = time(NULL) + (time_t)minutes * 60;
+        FollowGen++;
+    }
+    pthread_mutex_unlock(&FollowLock);
+    return retval;
+}
+
+/* Truncate the stream text to 'len' bytes. */
+static void stream_truncate(OutputStream *os, size_t len) {
+    if (len) sdsrange(os->text, 0, len-1);
+    else sdsclear(os->text);
+}
+
+/* Append output to the stream text. Carriage returns and backspaces
+ * rewrite the last line, like a terminal does, so progress bars update
+ * in place instead of adding a line for every step. */
+static void stream_append(OutputStream *os, const char *p, size_t len) {
+    while (len) {
+        if (os->cr && *p != '\n') stream_truncate(os, os->line);
+        os->cr = 0;
+
+        size_t n = 0;
+        while (n < len && p[n] != '\n' && p[n] != '\r' && p[n] != '\b') n++;
+        os->text = sdscatlen(os->text, p, n);
+        p += n;
+        len -= n;
+        if (!len) break;
+
+        if (*p == '\n') {
+            os->text = sdscatlen(os->text, "\n", 1);
+            os->line = sdslen(os->text);
+        } else if (*p == '\r') {
+            os->cr = 1;
+        } else {
+            /* Backspace: remove the last character of the line. */
+            size_t end = sdslen(os->text);
+            while (end > os->line &&
+                   ((unsigned char)os->text[--end] & 0xC0) == 0x80);
+            stream_truncate(os, end);
+        }
+        p++;
+        len--;
+    }
+    os->dirty = 1;
+}
+
+/* Send or edit the message of the stream with its text. */
+static void stream_send(OutputStream *os, const char *text, size_t len) {
+    if (len == 0) return;
+    sds html = html_pre(text, len);
+    if (os->msg_id)
+        botEditHTMLWithKeyboard(os->chat_id, os->msg_id, html, NULL, NULL);
+    else
+        botSendHTMLWithKeyboard(os->chat_id, html, NULL, NULL, &os->msg_id);
+    sdsfree(html);
+}
+
+/* Update the message with the new output. When the text no longer fits,
+ * the message gets the part that fits and the rest goes in a new one. If
+ * the rest doesn't fit either, only its end is sent, so that a flood of
+ * output costs at most two messages per edit. */
+static void stream_flush(OutputStream *os) {
+    size_t len = sdslen(os->text);
+    size_t head = text_chunk_len(os->text, len);
+    if (head < len) {
+        stream_send(os, os->text, head);
+        os->msg_id = 0;
+        if (os->text[head] == '\n') head++;
+        size_t skip = head;
+        if (len - head > TEXT_CHUNK_MAX - 64) {
+            /* Drop the oldest lines of the rest, leaving room for the
+             * note about them. */
+            skip = len - (TEXT_CHUNK_MAX - 64);
+            while (skip < len && os->text[skip-1] != '\n') skip++;
+            if (skip == len) skip = len - (TEXT_CHUNK_MAX - 64);
+            while (((unsigned char)os->text[skip] & 0xC0) == 0x80) skip++;
+        }
+        sds rest = sdsempty();
+        if (skip > head) {
+            rest = sdscatprintf(rest, "[... %zu bytes skipped ...]\n",
+                                skip - head);
+        }
+        size_t note = sdslen(rest);
+        rest = sdscatlen(rest, os->text + skip, len - skip);
+        os->line = os->line >= skip ? os->line - skip + note : note;
+        sdsfree(os->text);
+        os->text = rest;
+    }
+    stream_send(os, os->text, sdslen(os->text));
+    os->dirty = 0;
+    os->edit_us = statsUstime();
+}
+
+/* Follower thread: collect the output of the followed session and send
+ * it, until the stream is stopped, expires, or the session exits. */
+void *follow_main(void *arg) {
+    UNUSED(arg);
+    OutputStream os;
+    memset(&os, 0, sizeof(os));
+    uint64_t gen = 0;           /* Stream 'os' belongs to, 0 if none. */
+    traceThreadName("follow");
+    allocSetSubsystem("follow");
+    while (1) {
+        usleep(FOLLOW_POLL_MS * 1000);
+
+        pthread_mutex_lock(&FollowLock);
+        Session s = FollowSession;
+        int64_t chat_id = FollowChat;
+        int expired = chat_id && time(NULL) > FollowUntil;
+        uint64_t cur = chat_id ? FollowGen : 0;
+        pthread_mutex_unlock(&FollowLock);
+
+        /* Connecting to another window ends the stream. */
+        pthread_mutex_lock(&RequestLock);
+        uint32_t connected_id = Connected ? ConnectedSession.id : 0;
+        pthread_mutex_unlock(&RequestLock);
+
+        /* Send what is left of a stream stopped or replaced. */
+        if (gen && gen != cur) {
+            if (os.dirty) stream_flush(&os);
+            sdsfree(os.text);
+            memset(&os, 0, sizeof(os));
+            gen = 0;
+        }
+        if (!cur) continue;
+        if (!gen) {
+            gen = cur;
+            os.chat_id = chat_id;
+            os.text = sdsempty();
+            os.edit_us = 0;
+        }
+
+        sds out = s.id == connected_id ? Platform->output(&s) : NULL;
+        uint64_t now = statsUstime();
+        if (out && sdslen(out)) {
+            stream_append(&os, out, sdslen(out));
+            os.output_us = now;
+        }
+        int ended = out == NULL || expired;
+        sdsfree(out);
+
+        if (ended) {
+            if (os.dirty) stream_flush(&os);
+            pthread_mutex_lock(&FollowLock);
+            int current = FollowGen == gen;
+            if (current) follow_stop_locked();
+            pthread_mutex_unlock(&FollowLock);
+            if (current) botSendMessage(os.chat_id, "Output stream ended.", 0);
+            continue;           /* The stream is released on the next loop. */
+        }
+
+        uint64_t since_edit = (now - os.edit_us) / 1000;
+        uint64_t quiet = (now - os.output_us) / 1000;
+        if (os.dirty && since_edit >= FOLLOW_MIN_INTERVAL_MS &&
+            (quiet >= FOLLOW_DEBOUNCE_MS || since_edit >= FOLLOW_MAX_DELAY_MS))
+        {
+            stream_flush(&os);
+        }
+    }
+    return NULL;
+}
+
+void start_follower(void) {
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, follow_main, NULL) != 0) {
+        fprintf(stderr, "Can't start the output follower.\n");
+        exit(1);
+    }
+    pthread_detach(tid);
+}
+
 /* ============================================================================
  * Main
  * ========================================================================= */
 
 int main(int argc, char **argv) {
+    /* Accounting changes the layout of every allocation, so it must be
+     * enabled before anything is allocated. */
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--memory-accounting") == 0) allocEnable();
+    }
+
     /* Parse our custom flags. */
     const char *dbfile = "./mybot.sqlite";
+    const char *backend_arg = NULL;
+    int metrics_port = 0;
+    int slowlog_persist = 0;
+    const char *trace_file = NULL;
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "--dangerously-attach-to-any-window") == 0) {
             DangerMode = 1;
@@ -961,11 +2542,67 @@ int main(int argc, char **argv) {
             printf("WARNING: OTP authentication disabled.\n");
         } else if (strcmp(argv[i], "--dbfile") == 0 && i+1 < argc) {
             dbfile = argv[i+1];
+        } else if (strcmp(argv[i], "--metrics-port") == 0 && i+1 < argc) {
+            metrics_port = atoi(argv[i+1]);
+        } else if (strcmp(argv[i], "--slowlog-ms") == 0 && i+1 < argc) {
+            slowlogSetThreshold(strtoull(argv[i+1], NULL, 10));
+        } else if (strcmp(argv[i], "--slowlog-persist") == 0) {
+            slowlog_persist = 1;
+        } else if (strcmp(argv[i], "--trace") == 0 && i+1 < argc) {
+            trace_file = argv[i+1];
+        } else if (strcmp(argv[i], "--backend") == 0 && i+1 < argc) {
+            /* --backend name, or name:arg to pass an argument to it. */
+            const char *colon = strchr(argv[i+1], ':');
+            sds name = colon ? sdsnewlen(argv[i+1], colon-argv[i+1]) :
+                               sdsnew(argv[i+1]);
+            if (colon) backend_arg = colon+1;
+            Platform = backendByName(name);
+            if (!Platform) {
+                sds names = backendNames();
+                fprintf(stderr, "Unknown backend '%s', available: %s\n",
+                        name, names);
+                sdsfree(names);
+                exit(1);
+            }
+            sdsfree(name);
         }
     }
 
+    /* Start tracing before the threads, so that the trace shows them all
+     * from the start. */
+    if (trace_file && traceStart(trace_file) != 0) {
+        fprintf(stderr, "Can't write the trace to %s.\n", trace_file);
+        exit(1);
+    }
+
+    /* Backend setup. Backends that can start sessions get a shell if they
+     * have none, so there is always something to connect to. */
+    if (!Platform) Platform = backendDefault();
+    if (Platform->init && Platform->init(backend_arg) != 0) {
+        fprintf(stderr, "Can't initialize the %s backend.\n", Platform->name);
+        exit(1);
+    }
+    if (Platform->spawn && refresh_window_list() == 0 && Platform->spawn(NULL) != 0)
+        fprintf(stderr, "Can't start a shell in the %s backend.\n", Platform->name);
+
     /* TOTP setup: check/generate secret before starting the bot. */
     totp_setup(dbfile);
+    load_screenshot_settings(dbfile);
+    if (slowlog_persist && slowlogPersist(dbfile) != 0)
+        fprintf(stderr, "Can't open the database to save the slow log.\n");
+
+    /* Create the histograms of the request path first, so that .stats
+     * lists them in the order requests go through them. */
+    static const char *stages[] = {"receive", "dispatch", "lock", "raise",
+                                   "keys", "settle", NULL};
+    for (int j = 0; stages[j]; j++) statsGet(stages[j]);
+    start_screenshot_pipeline(dbfile);
+    start_sampler();
+    start_follower();
+    if (metrics_port && metricsStart(metrics_port) != 0) {
+        fprintf(stderr, "Can't serve the metrics on port %d.\n", metrics_port);
+        exit(1);
+    }
 
     /* Triggers: respond to all private messages. */
     static char *triggers[] = { "*", NULL };
@@ -50,6 +50,10 @@
 #include "sds.h"
 #include "cJSON.h"
 #include "botlib.h"
+#include "stats.h"
+#include "slowlog.h"
+#include "trace.h"
+#include "alloc.h"
 
 /* Thread local and atomic state. */
 _Thread_local sqlite3 *DbHandle = NULL; /* Per-thread sqlite handle. */
@@ -72,7 +76,8 @@ struct {
 /* Global stats. Sometimes we access such stats from threads without caring
  * about race conditions, since they in practice are very unlikely to happen
  * in most archs with this data types, and even so we don't care.
- * This stuff is reported by the bot when the $$ info command is used. */
+ * Reported by botStatsInfo(), together with the latency histograms of the
+ * Telegram API calls, see stats.c. */
 struct {
     time_t start_time;      /* Unix time the bot was started. */
     uint64_t queries;       /* Number of queries received. */
@@ -205,10 +210,11 @@ int strmatch(const char *pattern, int patternLen,
 
 /* ============================================================================
  * Allocator wrapper: we want to exit on OOM instead of trying to recover.
+ * With --memory-accounting allocations are counted by alloc.c.
  * ========================================================================= */
 
 void *xmalloc(size_t size) {
-    void *p = malloc(size);
+    void *p = allocEnabled() ? allocMalloc(size) : malloc(size);
     if (p == NULL) {
         printf("Out of memory: malloc(%zu)", size);
         exit(1);
@@ -217,7 +223,7 @@ void *xmalloc(size_t size) {
 }
 
 void *xrealloc(void *ptr, size_t size) {
-    void *p = realloc(ptr,size);
+    void *p = allocEnabled() ? allocRealloc(ptr,size) : realloc(ptr,size);
     if (p == NULL) {
         printf("Out of memory: realloc(%zu)", size);
         exit(1);
@@ -225,8 +231,26 @@ void *xrealloc(void *ptr, size_t size) {
     return p;
 }
 
+/* Like aligned_alloc(). The block is released with xfree(). */
+void *xalignedalloc(size_t alignment, size_t size) {
+    void *p = allocEnabled() ? allocAligned(alignment,size) :
+                               aligned_alloc(alignment,size);
+    if (p == NULL) {
+        printf("Out of memory: aligned_alloc(%zu)", size);
+        exit(1);
+    }
+    return p;
+}
+
+/* Charge a block that is cached and reused to 'subsystem', or to the
+ * calling thread if NULL. Only matters with --memory-accounting. */
+void xcharge(void *ptr, const char *subsystem) {
+    allocCharge(ptr,subsystem);
+}
+
 void xfree(void *ptr) {
-    free(ptr);
+    if (allocEnabled()) allocFree(ptr);
+    else free(ptr);
 }
 
 /* ============================================================================
@@ -317,18 +341,33 @@ sds makeHTTPGETCallOpt(const char *url, int *resptr, char **optlist, int optnum)
     return body;
 }
 
+/* Count a Telegram API call, started at 'start', by method and outcome,
+ * and its time in the histogram of the method. */
+static void botRecordCall(const char *method, uint64_t start, int ok) {
+    char name[STATS_NAME_LEN];
+    snprintf(name,sizeof(name),"api.%s",method);
+    statsRecordSince(name,start);
+    snprintf(name,sizeof(name),"api_calls_total{method=\"%s\",status=\"%s\"}",
+        method, ok ? "ok" : "error");
+    statsIncr(name,1);
+}
+
 /* Make an HTTP request to the Telegram bot API, where 'req' is the specified
  * action name. This is a low level API that is used by other bot APIs
  * in order to do higher level work. 'resptr' works the same as in
  * makeHTTPGETCall(). */
 sds makeGETBotRequest(const char *action, int *resptr, char **optlist, int numopt)
 {
+    uint64_t start = statsUstime();
+    int res = 0;
     sds url = sdsnew("https://api.telegram.org/bot");
     url = sdscat(url,Bot.apikey);
     url = sdscatlen(url,"/",1);
     url = sdscat(url,action);
-    sds body = makeHTTPGETCallOpt(url,resptr,optlist,numopt);
+    sds body = makeHTTPGETCallOpt(url,&res,optlist,numopt);
     sdsfree(url);
+    botRecordCall(action,start,res);
+    if (resptr) *resptr = res;
     return body;
 }
 
@@ -370,6 +409,7 @@ int botSendImage(int64_t target, char *filename) {
         curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 15);
 
         /* Perform the request, res will get the return code */
+        uint64_t start = statsUstime();
         res = curl_easy_perform(curl);
 
         /* Check for errors */
@@ -383,6 +423,7 @@ int botSendImage(int64_t target, char *filename) {
             retval = 0;
         }
 
+        botRecordCall("sendPhoto",start,retval);
         if (retval == 0)
             printf("sendImage() error from Telegram API: %s\n", body);
         sdsfree(body);
@@ -394,9 +435,26 @@ int botSendImage(int64_t target, char *filename) {
     return retval;
 }
 
+/* Telegram replies to sendPhoto and editMessageMedia with the message,
+ * whose 'photo' field lists the sizes it generated, the largest last.
+ * Set '*file_id' to the file_id of the latter, so that the same photo can
+ * be sent again without uploading it. */
+static void botGetPhotoFileId(cJSON *json, sds *file_id) {
+    cJSON *photo = cJSON_Select(json,".result.photo:a");
+    if (!photo) return;
+    int size = cJSON_GetArraySize(photo);
+    cJSON *id = size ? cJSON_Select(photo,"[*].file_id:s",size-1) : NULL;
+    if (!id) return;
+    sdsfree(*file_id);
+    *file_id = sdsnew(id->valuestring);
+}
+
 /* Send an image with an inline keyboard button. Returns message_id via msg_id
- * if not NULL. Return 1 on success, 0 on error. */
-int botSendImageWithKeyboard(int64_t target, char *filename, const char *btn_text, const char *btn_data, int64_t *msg_id) {
+ * if not NULL. If 'file_id' is not NULL and points to a non NULL string,
+ * the photo already uploaded with that file_id is sent instead of
+ * 'filename'. On success '*file_id', if not NULL, is set to the file_id of
+ * the sent photo. Return 1 on success, 0 on error. */
+int botSendImageWithKeyboard(int64_t target, char *filename, const char *btn_text, const char *btn_data, int64_t *msg_id, sds *file_id) {
     CURL *curl;
     CURLcode res;
     int retval = 0;
@@ -411,10 +469,17 @@ int botSendImageWithKeyboard(int64_t target, char *filename, const char *btn_tex
              CURLFORM_END);
     sdsfree(strtarget);
 
-    curl_formadd(&formpost, &lastptr,
-                 CURLFORM_COPYNAME, "photo",
-                 CURLFORM_FILE, filename,
-                 CURLFORM_END);
+    if (file_id && *file_id) {
+        curl_formadd(&formpost, &lastptr,
+                     CURLFORM_COPYNAME, "photo",
+                     CURLFORM_COPYCONTENTS, *file_id,
+                     CURLFORM_END);
+    } else {
+        curl_formadd(&formpost, &lastptr,
+                     CURLFORM_COPYNAME, "photo",
+                     CURLFORM_FILE, filename,
+                     CURLFORM_END);
+    }
 
     /* Build inline keyboard JSON. */
     sds keyboard = sdscatprintf(sdsempty(),
@@ -441,6 +506,7 @@ int botSendImageWithKeyboard(int64_t target, char *filename, const char *btn_tex
         curl_easy_setopt(curl, CURLOPT_TIMEOUT, 15);
         curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 15);
 
+        uint64_t start = statsUstime();
         res = curl_easy_perform(curl);
 
         if (res == CURLE_OK) {
@@ -449,17 +515,21 @@ int botSendImageWithKeyboard(int64_t target, char *filename, const char *btn_tex
             curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &code);
             if (code == 500 || code == 400) retval = 0;
 
-            /* Extract message_id if requested. */
-            if (msg_id && retval) {
+            /* Extract message_id and file_id if requested. */
+            if ((msg_id || file_id) && retval) {
                 cJSON *json = cJSON_Parse(body);
-                cJSON *mid = cJSON_Select(json, ".result.message_id:n");
-                if (mid) *msg_id = (int64_t)mid->valuedouble;
+                if (msg_id) {
+                    cJSON *mid = cJSON_Select(json, ".result.message_id:n");
+                    if (mid) *msg_id = (int64_t)mid->valuedouble;
+                }
+                if (file_id) botGetPhotoFileId(json, file_id);
                 cJSON_Delete(json);
             }
         } else {
             retval = 0;
         }
 
+        botRecordCall("sendPhoto",start,retval);
         if (retval == 0)
             printf("sendImageWithKeyboard() error: %s\n", body);
         sdsfree(body);
@@ -469,8 +539,11 @@ int botSendImageWithKeyboard(int64_t target, char *filename, const char *btn_tex
     return retval;
 }
 
-/* Edit a message to replace its media with a new image. */
-int botEditMessageMedia(int64_t chat_id, int64_t message_id, char *filename, const char *btn_text, const char *btn_data) {
+/* Edit a message to replace its media with a new image. 'file_id' works
+ * like in botSendImageWithKeyboard(). Editing the message with the photo
+ * it already shows is not an error: '*file_id' is left untouched in this
+ * case. Return 1 on success, 0 on error. */
+int botEditMessageMedia(int64_t chat_id, int64_t message_id, char *filename, const char *btn_text, const char *btn_data, sds *file_id) {
     CURL *curl;
     CURLcode res;
     int retval = 0;
@@ -491,17 +564,26 @@ int botEditMessageMedia(int64_t chat_id, int64_t message_id, char *filename, con
              CURLFORM_END);
     sdsfree(strmsg);
 
-    /* The media parameter describes the new media. */
-    curl_formadd(&formpost, &lastptr,
-                 CURLFORM_COPYNAME, "media",
-                 CURLFORM_COPYCONTENTS, "{\"type\":\"photo\",\"media\":\"attach://photo\"}",
-                 CURLFORM_END);
-
-    /* Attach the actual file. */
-    curl_formadd(&formpost, &lastptr,
-                 CURLFORM_COPYNAME, "photo",
-                 CURLFORM_FILE, filename,
-                 CURLFORM_END);
+    /* The media parameter describes the new media: either a photo
+     * Telegram already has, or the attached file. */
+    if (file_id && *file_id) {
+        sds media = sdscatprintf(sdsempty(),
+            "{\"type\":\"photo\",\"media\":\"%s\"}", *file_id);
+        curl_formadd(&formpost, &lastptr,
+                     CURLFORM_COPYNAME, "media",
+                     CURLFORM_COPYCONTENTS, media,
+                     CURLFORM_END);
+        sdsfree(media);
+    } else {
+        curl_formadd(&formpost, &lastptr,
+                     CURLFORM_COPYNAME, "media",
+                     CURLFORM_COPYCONTENTS, "{\"type\":\"photo\",\"media\":\"attach://photo\"}",
+                     CURLFORM_END);
+        curl_formadd(&formpost, &lastptr,
+                     CURLFORM_COPYNAME, "photo",
+                     CURLFORM_FILE, filename,
+                     CURLFORM_END);
+    }
 
     /* Inline keyboard. */
     if (btn_text && btn_data) {
@@ -530,6 +612,7 @@ int botEditMessageMedia(int64_t chat_id, int64_t message_id, char *filename, con
         curl_easy_setopt(curl, CURLOPT_TIMEOUT, 15);
         curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 15);
 
+        uint64_t start = statsUstime();
         res = curl_easy_perform(curl);
 
         if (res == CURLE_OK) {
@@ -537,10 +620,18 @@ int botEditMessageMedia(int64_t chat_id, int64_t message_id, char *filename, con
             long code;
             curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &code);
             if (code == 500 || code == 400) retval = 0;
+            if (code == 400 && strstr(body,"message is not modified")) {
+                retval = 1;
+            } else if (file_id && retval) {
+                cJSON *json = cJSON_Parse(body);
+                botGetPhotoFileId(json, file_id);
+                cJSON_Delete(json);
+            }
         } else {
             retval = 0;
         }
 
+        botRecordCall("editMessageMedia",start,retval);
         if (retval == 0)
             printf("editMessageMedia() error: %s\n", body);
         sdsfree(body);
@@ -655,6 +746,83 @@ int botEditMessageText(int64_t chat_id, int message_id, sds text) {
     return res;
 }
 
+/* Send a message formatted as HTML, with an inline keyboard made of a
+ * single button, or no keyboard if 'btn_text' is NULL. If 'msg_id' is not
+ * NULL, it is set to the ID of the new message, so that it can be edited
+ * later with botEditHTMLWithKeyboard().
+ * Return 1 on success, 0 on error. */
+int botSendHTMLWithKeyboard(int64_t target, sds text, const char *btn_text, const char *btn_data, int64_t *msg_id) {
+    char *options[10];
+    int optlen = 4;
+    options[0] = "chat_id";
+    options[1] = sdsfromlonglong(target);
+    options[2] = "text";
+    options[3] = text;
+    options[4] = "parse_mode";
+    options[5] = "HTML";
+    options[6] = "disable_web_page_preview";
+    options[7] = "true";
+    if (btn_text) {
+        optlen++;
+        options[8] = "reply_markup";
+        options[9] = sdscatprintf(sdsempty(),
+            "{\"inline_keyboard\":[[{\"text\":\"%s\",\"callback_data\":\"%s\"}]]}",
+            btn_text, btn_data);
+    } else {
+        options[9] = NULL; /* So we can sdsfree it later without problems. */
+    }
+
+    int res;
+    sds body = makeGETBotRequest("sendMessage",&res,options,optlen);
+    if (res && msg_id) {
+        cJSON *json = cJSON_Parse(body);
+        cJSON *id = cJSON_Select(json,".result.message_id:n");
+        if (id) *msg_id = (int64_t) id->valuedouble;
+        cJSON_Delete(json);
+    }
+    sdsfree(body);
+    sdsfree(options[1]);
+    sdsfree(options[9]);
+    return res;
+}
+
+/* Replace the text of a message sent with botSendHTMLWithKeyboard(),
+ * with a single button, or no keyboard if 'btn_text' is NULL.
+ * Setting the same text again is not considered an error.
+ * Return 1 on success, 0 on error. */
+int botEditHTMLWithKeyboard(int64_t chat_id, int64_t message_id, sds text, const char *btn_text, const char *btn_data) {
+    char *options[12];
+    int optlen = 5;
+    options[0] = "chat_id";
+    options[1] = sdsfromlonglong(chat_id);
+    options[2] = "message_id";
+    options[3] = sdsfromlonglong(message_id);
+    options[4] = "text";
+    options[5] = text;
+    options[6] = "parse_mode";
+    options[7] = "HTML";
+    options[8] = "disable_web_page_preview";
+    options[9] = "true";
+    if (btn_text) {
+        optlen++;
+        options[10] = "reply_markup";
+        options[11] = sdscatprintf(sdsempty(),
+            "{\"inline_keyboard\":[[{\"text\":\"%s\",\"callback_data\":\"%s\"}]]}",
+            btn_text, btn_data);
+    } else {
+        options[11] = NULL; /* So we can sdsfree it later without problems. */
+    }
+
+    int res;
+    sds body = makeGETBotRequest("editMessageText",&res,options,optlen);
+    if (!res && strstr(body,"message is not modified")) res = 1;
+    sdsfree(body);
+    sdsfree(options[1]);
+    sdsfree(options[3]);
+    sdsfree(options[11]);
+    return res;
+}
+
 /* This function should be called from the bot implementation callback.
  * If the bot request has a file (the user can see that by inspecting
  * the br->file_type field), then this function will attempt to download
@@ -737,7 +905,7 @@ void freeBotRequest(BotRequest *br) {
     sdsfree(br->callback_data);
     if (br->mentions) {
         for (int j = 0; j < br->num_mentions; j++) sdsfree(br->mentions[j]);
-        free(br->mentions);
+        xfree(br->mentions);
     }
     free(br);
 }
@@ -764,6 +932,7 @@ BotRequest *createBotRequest(void) {
     br->is_callback = 0;
     br->callback_id = NULL;
     br->callback_data = NULL;
+    br->received_us = 0;
     return br;
 }
 
@@ -808,14 +977,25 @@ void dbClose(void) {
 
 /* Request handling thread entry point. */
 void *botHandleRequest(void *arg) {
+    traceThreadName("request");
+    allocSetSubsystem("request");
     DbHandle = dbInit(NULL);
     BotRequest *br = arg;
+    SlowlogTrace *trace = slowlogBegin(br->request,br->received_us);
+    slowlogAttach(trace);
+    statsRecordSince("dispatch",br->received_us);
+    statsIncr("request_threads",1);
 
     /* Parse the request as a command composed of arguments. */
     br->argv = sdssplitargs(br->request,&br->argc);
     Bot.req_callback(DbHandle,br);
     freeBotRequest(br);
     dbClose();
+    statsIncr("request_threads",-1);
+
+    /* The request may still be served by jobs holding the trace. */
+    slowlogAttach(NULL);
+    slowlogEnd(trace);
     return NULL;
 }
 
@@ -836,6 +1016,7 @@ int64_t botProcessUpdates(int64_t offset, int timeout) {
     options[4] = "allowed_updates";
     options[5] = "[\"message\",\"callback_query\"]";
     sds body = makeGETBotRequest("getUpdates",&res,options,3);
+    uint64_t received = statsUstime();
     sdsfree(options[1]);
     sdsfree(options[3]);
 
@@ -878,6 +1059,8 @@ int64_t botProcessUpdates(int64_t offset, int timeout) {
                     br->type = TB_TYPE_PRIVATE;
 
                     botStats.queries++;
+                    br->received_us = statsUstime();
+                    statsRecordSince("receive",received);
                     pthread_t tid;
                     if (pthread_create(&tid,NULL,botHandleRequest,br) == 0) {
                         pthread_detach(tid);
@@ -1001,7 +1184,8 @@ int64_t botProcessUpdates(int64_t offset, int timeout) {
                 if (off+len <= sdslen(br->request)) {
                     sds mention = sdsnewlen(br->request+off,len);
                     br->num_mentions++;
-                    br->mentions = xrealloc(br->mentions,br->num_mentions);
+                    br->mentions = xrealloc(br->mentions,
+                                    sizeof(sds)*br->num_mentions);
                     br->mentions[br->num_mentions-1] = mention;
                     /* Is the user addressing the bot? Set the flag. */
                     if (Bot.username && !strcmp(Bot.username,mention+1))
@@ -1018,6 +1202,8 @@ int64_t botProcessUpdates(int64_t offset, int timeout) {
 
         /* Spawn a thread that will handle the request. */
         botStats.queries++;
+        br->received_us = statsUstime();
+        statsRecordSince("receive",received);
         pthread_t tid;
         if (pthread_create(&tid,NULL,botHandleRequest,br) != 0) {
             freeBotRequest(br);
@@ -1050,6 +1236,8 @@ void botMain(void) {
     int previd;
 
     botGetUsername(); // Will cache Bot.username as side effect.
+    traceThreadName("poll");
+    allocSetSubsystem("poll");
     while(1) {
         previd = nextid;
         nextid = botProcessUpdates(nextid,1);
@@ -1057,7 +1245,11 @@ void botMain(void) {
          * the above call fails and returns immediately (for networking
          * errors for instance), so wait a bit at every cycle, but only
          * if we didn't made any progresses with the ID. */
-        if (nextid == previd) usleep(100000);
+        if (nextid == previd) {
+            uint64_t start = statsUstime();
+            usleep(100000);
+            traceRecordSince("backoff",start);
+        }
         if (Bot.cron_callback) Bot.cron_callback(DbHandle);
     }
 }
@@ -1080,6 +1272,19 @@ void readApiKeyFromFile(void) {
     Bot.apikey = sdstrim(Bot.apikey," \t\r\n");
 }
 
+/* Return the bot stats followed by the latency histograms, for the
+ * command reporting them. */
+sds botStatsInfo(void) {
+    time_t uptime = time(NULL) - botStats.start_time;
+    sds info = sdscatprintf(sdsempty(),"Up %lldh %lldm, %llu requests\n",
+        (long long)uptime/3600, (long long)uptime%3600/60,
+        (unsigned long long)botStats.queries);
+    sds hists = statsInfo();
+    info = sdscatsds(info,hists);
+    sdsfree(hists);
+    return info;
+}
+
 void resetBotStats(void) {
     botStats.start_time = time(NULL);
     botStats.queries = 0;
@@ -38,6 +38,7 @@ typedef struct BotRequest {
     int is_callback;    /* True if this is a callback query (button press). */
     sds callback_id;    /* Callback query ID for answering. */
     sds callback_data;  /* Callback data from button. */
+    uint64_t received_us; /* When the update was parsed, statsUstime(). */
 } BotRequest;
 
 /* Bot callback type. This must be registed when the bot is initialized.
@@ -83,12 +84,15 @@ sds makeGETBotRequest(const char *action, int *resptr, char **optlist, int numop
 int botSendMessageAndGetInfo(int64_t target, sds text, int64_t reply_to, int64_t *chat_id, int64_t *message_id);
 int botSendMessage(int64_t target, sds text, int64_t reply_to);
 int botEditMessageText(int64_t chat_id, int message_id, sds text);
+int botSendHTMLWithKeyboard(int64_t target, sds text, const char *btn_text, const char *btn_data, int64_t *msg_id);
+int botEditHTMLWithKeyboard(int64_t chat_id, int64_t message_id, sds text, const char *btn_text, const char *btn_data);
 int botSendImage(int64_t target, char *filename);
-int botSendImageWithKeyboard(int64_t target, char *filename, const char *btn_text, const char *btn_data, int64_t *msg_id);
-int botEditMessageMedia(int64_t chat_id, int64_t message_id, char *filename, const char *btn_text, const char *btn_data);
+int botSendImageWithKeyboard(int64_t target, char *filename, const char *btn_text, const char *btn_data, int64_t *msg_id, sds *file_id);
+int botEditMessageMedia(int64_t chat_id, int64_t message_id, char *filename, const char *btn_text, const char *btn_data, sds *file_id);
 int botAnswerCallbackQuery(const char *callback_id);
 int botGetFile(BotRequest *br, const char *target_filename);
 char *botGetUsername(void);
+sds botStatsInfo(void);
 void freeBotRequest(BotRequest *br);
 
 /* Database. */
@@ -0,0 +1,835 @@
+/* ============================================================================
+ * Embedded bitmap font for the terminal renderer.
+ *
+ * Glyphs are 9x18 pixels, rasterized from DejaVu Sans Mono at 15 pixels
+ * and thresholded to one bit per pixel, covering Latin, Greek, Cyrillic,
+ * punctuation, arrows, geometric shapes and the symbols TUIs commonly use.
+ * Box drawing, block elements and braille are not here: the renderer
+ * draws them, so that they connect across cells.
+ *
+ * Every glyph is a string of FONT_HEIGHT rows of 3 hex digits, the most
+ * significant of the 9 bits being the leftmost pixel.
+ *
+ * The DejaVu fonts are derived from Bitstream Vera, and come with this
+ * license:
+ *
+ * Copyright (c) 2003 by Bitstream, Inc. All Rights Reserved. Bitstream Vera
+ * is a trademark of Bitstream, Inc. DejaVu changes are in public domain.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of the fonts accompanying this license ("Fonts") and associated
+ * documentation files (the "Font Software"), to reproduce and distribute
+ * the Font Software, including without limitation the rights to use, copy,
+ * merge, publish, distribute, and/or sell copies of the Font Software, and
+ * to permit persons to whom the Font Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright and trademark notices and this permission notice
+ * shall be included in all copies of one or more of the Font Software
+ * typefaces.
+ *
+ * The Font Software may be modified, altered, or added to, and in
+ * particular the designs of glyphs or characters in the Fonts may be
+ * modified and additional glyphs or characters may be added to the Fonts,
+ * only if the fonts are renamed to names not containing either the words
+ * "Bitstream" or the word "Vera".
+ *
+ * This License becomes null and void to the extent applicable to Fonts or
+ * Font Software that has been modified and is distributed under the
+ * "Bitstream Vera" names.
+ *
+ * The Font Software may be sold as part of a larger software package but
+ * no copy of one or more of the Font Software typefaces may be sold by
+ * itself.
+ *
+ * THE FONT SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO ANY WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT OF
+ * COPYRIGHT, PATENT, TRADEMARK, OR OTHER RIGHT. IN NO EVENT SHALL BITSTREAM
+ * OR THE GNOME FOUNDATION BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, INCLUDING ANY GENERAL, SPECIAL, INDIRECT, INCIDENTAL, OR
+ * CONSEQUENTIAL DAMAGES, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF THE USE OR INABILITY TO USE THE FONT
+ * SOFTWARE OR FROM OTHER DEALINGS IN THE FONT SOFTWARE.
+ *
+ * Except as contained in this notice, the names of Gnome, the Gnome
+ * Foundation, and Bitstream Inc., shall not be used in advertising or
+ * otherwise to promote the sale, use or other dealings in this Font
+ * Software without prior written authorization from the Gnome Foundation
+ * or Bitstream Inc., respectively.
+ * ==========================================================================*/
+
+#include <stddef.h>
+
+#include "font.h"
+
+typedef struct FontGlyph {
+    uint32_t cp;
+    const char *rows;
+} FontGlyph;
+
+/* Sorted by codepoint. */
+static const FontGlyph Glyphs[] = {
+    {0x0020, "000000000000000000000000000000000000000000000000000000"},
+    {0x0021, "000000000010010010010010010010000000010010000000000000"},
+    {0x0022, "00000000006c06c06c06c000000000000000000000000000000000"},
+    {0x0023, "0000000000120360240ff02406c06c1fe0480d80d8000000000000"},
+    {0x0024, "00000001001003c0560d00d007801c0160120d607c010010000000"},
+    {0x0025, "0000000000e01b01101b00e60380ce01b01101b00e000000000000"},
+    {0x0026, "00000000007c04004006007009119b18f1860c607b000000000000"},
+    {0x0027, "000000000010010010010000000000000000000000000000000000"},
+    {0x0028, "000000000008018010010030030030030030010010018008000000"},
+    {0x0029, "000000000020030010018018018018018018018010030020000000"},
+    {0x002a, "0000000000100d60380380d6010000000000000000000000000000"},
+    {0x002b, "0000000000000000000100100100ff010010010000000000000000"},
+    {0x002c, "000000000000000000000000000000000000018018030020000000"},
+    {0x002d, "00000000000000000000000000007c000000000000000000000000"},
+    {0x002e, "000000000000000000000000000000000000038038000000000000"},
+    {0x002f, "00000000000600400c0080180100300200600400c0080000000000"},
+    {0x0030, "00000000003806c0c60c60d60d60c60c60c606c038000000000000"},
+    {0x0031, "00000000003805801801801801801801801801807e000000000000"},
+    {0x0032, "0000000000780cc08600600400c0180300600c00fe000000000000"},
+    {0x0033, "0000000000780cc00600600c03800c00600608e07c000000000000"},
+    {0x0034, "00000000000c01c03c02c06c0cc08c0fe00c00c00c000000000000"},
+    {0x0035, "0000000000fc0c00c00c00f808c00600600608c078000000000000"},
+    {0x0036, "00000000003c0640c00c00fc0e60c60c60c606603c000000000000"},
+    {0x0037, "0000000000fe00600400c00c018018010030030020000000000000"},
+    {0x0038, "00000000007c0460c60c604407c0c60c60c60c607c000000000000"},
+    {0x0039, "0000000000780cc0c60c60c60ce07e00600604c078000000000000"},
+    {0x003a, "000000000000000000038038000000000000038038000000000000"},
+    {0x003b, "000000000000000000038038000000000000018018030020000000"},
+    {0x003c, "00000000000000000000201e0f00c00f001e002000000000000000"},
+    {0x003d, "0000000000000000000000ff0000000ff000000000000000000000"},
+    {0x003e, "0000000000000000000800f001e00701e0f0080000000000000000"},
+    {0x003f, "00000000003c04400600400c018010010000030030000000000000"},
+    {0x0040, "00000000000003c06608319f1b31231231b309f0c006003c000000"},
+    {0x0041, "00000000003803802806c06c0440460fe0c6082183000000000000"},
+    {0x0042, "0000000000fc0c60c60c60c60fc0c60c20c20c60fc000000000000"},
+    {0x0043, "00000000003c0660c00c00c00c00c00c00c006603c000000000000"},
+    {0x0044, "0000000000f80cc0c60c60c60c60c60c60c60cc0f8000000000000"},
+    {0x0045, "0000000000fe0c00c00c00c00fe0c00c00c00c00fe000000000000"},
+    {0x0046, "00000000007e04004004004007e040040040040040000000000000"},
+    {0x0047, "00000000003c0660c00c008008e0820c20c206603c000000000000"},
+    {0x0048, "0000000000c60c60c60c60c60fe0c60c60c60c60c6000000000000"},
+    {0x0049, "0000000000fe0100100100100100100100100100fe000000000000"},
+    {0x004a, "00000000003c00c00c00c00c00c00c00c00c08c0f8000000000000"},
+    {0x004b, "0000000000c20c60cc0d80f00f00d80cc0cc0c60c3000000000000"},
+    {0x004c, "0000000000c00c00c00c00c00c00c00c00c00c00fe000000000000"},
+    {0x004d, "0000000000c70c70ef0ab0ab0bb093083083083083000000000000"},
+    {0x004e, "0000000000c60e60e60e60f60d60de0ce0ce0ce0c6000000000000"},
+    {0x004f, "0000000000380440c60c60c60c20c60c60c604403c000000000000"},
+    {0x0050, "0000000000fc0c60c20c20c20c60fc0c00c00c00c0000000000000"},
+    {0x0051, "0000000000380440c60c60c60c20c60c60c604403c00c004000000"},
+    {0x0052, "0000000000f80cc0c60c60cc0f80cc0c60c60c20c3000000000000"},
+    {0x0053, "00000000007c0c60c00c00e003c0060060860c607c000000000000"},
+    {0x0054, "0000000001ff010010010010010010010010010010000000000000"},
+    {0x0055, "0000000000c60c60c60c60c60c60c60c60c60c607c000000000000"},
+    {0x0056, "0000000001830820c60c604406406c06c028038038000000000000"},
+    {0x0057, "0000000001831831831930ba0ba0aa0ee0ee0c60c6000000000000"},
+    {0x0058, "0000000000c20c606c02c03803803806c0440c6183000000000000"},
+    {0x0059, "0000000001830c604406c038038010010010010010000000000000"},
+    {0x005a, "0000000000ff00600600c0180180300200600c00ff000000000000"},
+    {0x005b, "00000000003c03003003003003003003003003003003003c000000"},
+    {0x005c, "0000000000800c004006002003001001800800c004006000000000"},
+    {0x005d, "000000000078018018018018018018018018018018018078000000"},
+    {0x005e, "00000000003803c044082000000000000000000000000000000000"},
+    {0x005f, "0000000000000000000000000000000000000000000000000001ff"},
+    {0x0060, "000000060030010000000000000000000000000000000000000000"},
+    {0x0061, "00000000000000000007c04600607e0c60860ce07e000000000000"},
+    {0x0062, "0000000000c00c00c00fc0e60c60c20c20c60e60fc000000000000"},
+    {0x0063, "00000000000000000003c0620400c00c004006203c000000000000"},
+    {0x0064, "00000000000600600607e0ce0c60860860c60ce07e000000000000"},
+    {0x0065, "00000000000000000003c0640c60c20fe0c004203c000000000000"},
+    {0x0066, "00000000001e0100100fe010010010010010010010000000000000"},
+    {0x0067, "00000000000000000007e0ce0c60860860c60ce07e00604c078000"},
+    {0x0068, "0000000000c00c00c00fc0e60c60c60c60c60c60c6000000000000"},
+    {0x0069, "0000000000100100000700100100100100100100fe000000000000"},
+    {0x006a, "0000000000180180000780180180180180180180180180180f0000"},
+    {0x006b, "00000000004004004004604c05807807804c046043000000000000"},
+    {0x006c, "0000000000f003003003003003003003003003001e000000000000"},
+    {0x006d, "0000000000000000000fe09a092092092092092092000000000000"},
+    {0x006e, "0000000000000000000fc0e60c60c60c60c60c60c6000000000000"},
+    {0x006f, "00000000000000000007c0440c60c60c60c604407c000000000000"},
+    {0x0070, "0000000000000000000fc0e60c60c20c20c60e60fc0c00c00c0000"},
+    {0x0071, "00000000000000000007e04e0c60c60c60c604e07e006006006000"},
+    {0x0072, "00000000000000000002e030020020020020020020000000000000"},
+    {0x0073, "00000000000000000007c04404007001c00604407c000000000000"},
+    {0x0074, "0000000000000300300fe03003003003003003001e000000000000"},
+    {0x0075, "0000000000000000000c60c60c60c60c60c604e07e000000000000"},
+    {0x0076, "0000000000000000000820c604404406c028038038000000000000"},
+    {0x0077, "0000000000000000001831831930ba0aa0ee0ee044000000000000"},
+    {0x0078, "0000000000000000000c606c03803803806c0440c6000000000000"},
+    {0x0079, "0000000000000000000820c604606406c0380380180100300e0000"},
+    {0x007a, "00000000000000000007e00400c0180300600400fe000000000000"},
+    {0x007b, "00000000001e01801001001003006003001001001001001800e000"},
+    {0x007c, "000000000010010010010010010010010010010010010010010010"},
+    {0x007d, "00000000007003001001001001800e018010010010010030060000"},
+    {0x007e, "0000000000000000000000000f001e000000000000000000000000"},
+    {0x00a0, "000000000000000000000000000000000000000000000000000000"},
+    {0x00a1, "000000000000000000010010000000010010010010010010010000"},
+    {0x00a2, "00000000000000800803c06a04804804804806a03c008008000000"},
+    {0x00a3, "00000000001c0320300200200200fc0200200200fe000000000000"},
+    {0x00a4, "00000000000000000004207e06404406407e042000000000000000"},
+    {0x00a5, "0000000001830c604406c0fe0380fe010010010010000000000000"},
+    {0x00a6, "000000000010010010010010010000000010010010010010010000"},
+    {0x00a7, "00000000003c06006007005c0c604607401c00c00c078000000000"},
+    {0x00a8, "00000000006c06c000000000000000000000000000000000000000"},
+    {0x00a9, "00000000000007c0c61bb1411411411bb0c607c000000000000000"},
+    {0x00aa, "00000000007800403c04404c03c00007c000000000000000000000"},
+    {0x00ab, "0000000000000000000020260cc0980cc026002000000000000000"},
+    {0x00ac, "0000000000000000000000000ff003003003000000000000000000"},
+    {0x00ad, "00000000000000000000000000007c000000000000000000000000"},
+    {0x00ae, "00000000000007c0c61bb12d1391291af0c607c000000000000000"},
+    {0x00af, "00000000007c000000000000000000000000000000000000000000"},
+    {0x00b0, "00000000003806c04406c038000000000000000000000000000000"},
+    {0x00b1, "0000000000000000000100100ff0100100000000ff000000000000"},
+    {0x00b2, "00000000007800c00801002007c000000000000000000000000000"},
+    {0x00b3, "00000000007800c03800c00c078000000000000000000000000000"},
+    {0x00b4, "00000000c018010000000000000000000000000000000000000000"},
+    {0x00b5, "0000000000000000000c60c60c60c60c60c60c60fb0c00c00c0000"},
+    {0x00b6, "00000000007e0f60f60f60f6076016016016016016016000000000"},
+    {0x00b7, "000000000000000000000000038038000000000000000000000000"},
+    {0x00b8, "000000000000000000000000000000000000000000018008038000"},
+    {0x00b9, "00000000007001001001001003c000000000000000000000000000"},
+    {0x00ba, "00000000003806c04404406c03800007c000000000000000000000"},
+    {0x00bb, "0000000000000000000800c80660320660c8080000000000000000"},
+    {0x00bc, "0000000c00400400400400f000607c1c400c01401403e004000000"},
+    {0x00bd, "0000000c00400400400400f000607c1dc00600600c01801e000000"},
+    {0x00be, "0000000f00300600100100e000607c1c400c01401403e004000000"},
+    {0x00bf, "0000000000000000000180180000180100300600400c006407c000"},
+    {0x00c0, "03001000003803802806c06c0440460fe0c6082183000000000000"},
+    {0x00c1, "01801000003803802806c06c0440460fe0c6082183000000000000"},
+    {0x00c2, "03802800003803802806c06c0440460fe0c6082183000000000000"},
+    {0x00c3, "07405c00003803802806c06c0440460fe0c6082183000000000000"},
+    {0x00c4, "06c06c00003803802806c06c0440460fe0c6082183000000000000"},
+    {0x00c5, "03806c02c03803802806c06c0440460fe0c6082183000000000000"},
+    {0x00c6, "00000000003f0680680480480ce0c80f808818818f000000000000"},
+    {0x00c7, "00000000003c0660c00c00c00c00c00c00c006603c00800c018000"},
+    {0x00c8, "0300100000fe0c00c00c00c00fe0c00c00c00c00fe000000000000"},
+    {0x00c9, "0080100000fe0c00c00c00c00fe0c00c00c00c00fe000000000000"},
+    {0x00ca, "03802c0000fe0c00c00c00c00fe0c00c00c00c00fe000000000000"},
+    {0x00cb, "06c06c0000fe0c00c00c00c00fe0c00c00c00c00fe000000000000"},
+    {0x00cc, "0300100000fe0100100100100100100100100100fe000000000000"},
+    {0x00cd, "0180100000fe0100100100100100100100100100fe000000000000"},
+    {0x00ce, "0380280000fe0100100100100100100100100100fe000000000000"},
+    {0x00cf, "06c06c0000fe0100100100100100100100100100fe000000000000"},
+    {0x00d0, "0000000000f80cc0c60c60c61f60c60c60c60cc0f8000000000000"},
+    {0x00d1, "07405c0000c60e60e60e60f60d60de0ce0ce0ce0c6000000000000"},
+    {0x00d2, "0300100000380440c60c60c60c20c60c60c604403c000000000000"},
+    {0x00d3, "0180100000380440c60c60c60c20c60c60c604403c000000000000"},
+    {0x00d4, "0380280000380440c60c60c60c20c60c60c604403c000000000000"},
+    {0x00d5, "07405c0000380440c60c60c60c20c60c60c604403c000000000000"},
+    {0x00d6, "06c06c0000380440c60c60c60c20c60c60c604403c000000000000"},
+    {0x00d7, "0000000000000000000c606c03803803806c0c6000000000000000"},
+    {0x00d8, "00000000003b0460c60ce0de0d20e60e60c60c41f8000000000000"},
+    {0x00d9, "0300100000c60c60c60c60c60c60c60c60c60c607c000000000000"},
+    {0x00da, "0180100000c60c60c60c60c60c60c60c60c60c607c000000000000"},
+    {0x00db, "0380280000c60c60c60c60c60c60c60c60c60c607c000000000000"},
+    {0x00dc, "06c06c0000c60c60c60c60c60c60c60c60c60c607c000000000000"},
+    {0x00dd, "0180100001830c604406c038038010010010010010000000000000"},
+    {0x00de, "0000000000c00c00fc0c60c30c30c60fc0c00c00c0000000000000"},
+    {0x00df, "0000000000780440c60d80d00d80dc0c60c20c20fe000000000000"},
+    {0x00e0, "00000006003001000007c04600607e0c60860ce07e000000000000"},
+    {0x00e1, "00000000c01801000007c04600607e0c60860ce07e000000000000"},
+    {0x00e2, "00000001003806c00007c04600607e0c60860ce07e000000000000"},
+    {0x00e3, "00000007405c00000007c04600607e0c60860ce07e000000000000"},
+    {0x00e4, "00000000006c06c00007c04600607e0c60860ce07e000000000000"},
+    {0x00e5, "00003806c06c03800007c04600607e0c60860ce07e000000000000"},
+    {0x00e6, "0000000000000000000ee0bb0130130ff1901990ee000000000000"},
+    {0x00e7, "00000000000000000003c0620400c00c004006203c00800c018000"},
+    {0x00e8, "00000006003001000003c0640c60c20fe0c004203c000000000000"},
+    {0x00e9, "00000000c00801000003c0640c60c20fe0c004203c000000000000"},
+    {0x00ea, "00000001803806400003c0640c60c20fe0c004203c000000000000"},
+    {0x00eb, "00000000006c06c00003c0640c60c20fe0c004203c000000000000"},
+    {0x00ec, "0000000600300100000700100100100100100100fe000000000000"},
+    {0x00ed, "00000000c0180100000700100100100100100100fe000000000000"},
+    {0x00ee, "00000001003806c0000700100100100100100100fe000000000000"},
+    {0x00ef, "00000000006c06c0000700100100100100100100fe000000000000"},
+    {0x00f0, "00000000002407800807c0460c60c60c60c604407c000000000000"},
+    {0x00f1, "00000007405c0000000fc0e60c60c60c60c60c60c6000000000000"},
+    {0x00f2, "00000006003001000007c0440c60c60c60c604407c000000000000"},
+    {0x00f3, "00000000c01801000007c0440c60c60c60c604407c000000000000"},
+    {0x00f4, "00000001003806c00007c0440c60c60c60c604407c000000000000"},
+    {0x00f5, "00000007405c00000007c0440c60c60c60c604407c000000000000"},
+    {0x00f6, "00000000006c06c00007c0440c60c60c60c604407c000000000000"},
+    {0x00f7, "0000000000000000000180180000ff000018018000000000000000"},
+    {0x00f8, "00000000000000000007e0460ce0de0f60e60c40fc000000000000"},
+    {0x00f9, "0000000600300100000c60c60c60c60c60c604e07e000000000000"},
+    {0x00fa, "00000000c0180100000c60c60c60c60c60c604e07e000000000000"},
+    {0x00fb, "00000001003806c0000c60c60c60c60c60c604e07e000000000000"},
+    {0x00fc, "00000000006c06c0000c60c60c60c60c60c604e07e000000000000"},
+    {0x00fd, "00000000c0180100000820c604606406c0380380180100300e0000"},
+    {0x00fe, "0000000000c00c00c00fc0e60c60c20c20c60e60fc0c00c00c0000"},
+    {0x00ff, "00000000006c06c0000820c604606406c0380380180100300e0000"},
+    {0x0100, "00007c00003803802806c06c0440460fe0c6082183000000000000"},
+    {0x0101, "00000000007c00000007c04600607e0c60860ce07e000000000000"},
+    {0x0102, "06c03800003803802806c06c0440460fe0c6082183000000000000"},
+    {0x0103, "00000004c03800000007c04600607e0c60860ce07e000000000000"},
+    {0x0104, "00000000003803802806c06c0440460fe0c6082183002006003000"},
+    {0x0105, "00000000000000000007c04600607e0c60860ce07e004004006000"},
+    {0x0106, "00c01800003c0660c00c00c00c00c00c00c006603c000000000000"},
+    {0x0107, "00000000400c01800003c0620400c00c004006203c000000000000"},
+    {0x0108, "01c03400003c0660c00c00c00c00c00c00c006603c000000000000"},
+    {0x0109, "00000001801c02400003c0620400c00c004006203c000000000000"},
+    {0x010a, "01801800003c0660c00c00c00c00c00c00c006603c000000000000"},
+    {0x010b, "00000000001801800003c0620400c00c004006203c000000000000"},
+    {0x010c, "03401800003c0660c00c00c00c00c00c00c006603c000000000000"},
+    {0x010d, "00000002401c01800003c0620400c00c004006203c000000000000"},
+    {0x010e, "0480300000f80cc0c60c60c60c60c60c60c60cc0f8000000000000"},
+    {0x010f, "00000000000700700707e0ce0c60860860c60ce07e000000000000"},
+    {0x0110, "0000000000f80cc0c60c60c61f60c60c60c60cc0f8000000000000"},
+    {0x0111, "00000000000601f00607e0ce0c60860860c60ce07e000000000000"},
+    {0x0112, "00007c0000fe0c00c00c00c00fe0c00c00c00c00fe000000000000"},
+    {0x0113, "00000000007c00000003c0640c60c20fe0c004203c000000000000"},
+    {0x0114, "0640380000fe0c00c00c00c00fe0c00c00c00c00fe000000000000"},
+    {0x0115, "00000006403800000003c0640c60c20fe0c004203c000000000000"},
+    {0x0116, "0180180000fe0c00c00c00c00fe0c00c00c00c00fe000000000000"},
+    {0x0117, "00000000001001000003c0640c60c20fe0c004203c000000000000"},
+    {0x0118, "0000000000fe0c00c00c00c00fe0c00c00c00c00fe00400c006000"},
+    {0x0119, "00000000000000000003c0640c60c20fe0c004203c00800800e000"},
+    {0x011a, "02c0180000fe0c00c00c00c00fe0c00c00c00c00fe000000000000"},
+    {0x011b, "00000002403801800003c0640c60c20fe0c004203c000000000000"},
+    {0x011c, "03802800003c0660c00c008008e0820c20c206603c000000000000"},
+    {0x011d, "00000001003806c00007e0ce0c60860860c60ce07e00604c078000"},
+    {0x011e, "02403c00003c0660c00c008008e0820c20c206603c000000000000"},
+    {0x011f, "00000004c03800000007e0ce0c60860860c60ce07e00604c078000"},
+    {0x0120, "01801800003c0660c00c008008e0820c20c206603c000000000000"},
+    {0x0121, "00000000001001000007e0ce0c60860860c60ce07e00604c078000"},
+    {0x0122, "00000000003c0660c00c008008e0820c20c206603c000018018010"},
+    {0x0123, "00000000801801800007e0ce0c60860860c60ce07e00604c078000"},
+    {0x0124, "0380280000c60c60c60c60c60fe0c60c60c60c60c6000000000000"},
+    {0x0125, "0380280000c00c00c00fc0e60c60c60c60c60c60c6000000000000"},
+    {0x0126, "0000000000c60c61ff0c60c60fe0c60c60c60c60c6000000000000"},
+    {0x0127, "0000000000c01f00c00fc0e60c60c60c60c60c60c6000000000000"},
+    {0x0128, "07405c0000fe0100100100100100100100100100fe000000000000"},
+    {0x0129, "00000007405c0000000700100100100100100100fe000000000000"},
+    {0x012a, "00007c0000fe0100100100100100100100100100fe000000000000"},
+    {0x012b, "00000000007c0000000700100100100100100100fe000000000000"},
+    {0x012c, "06c0380000fe0100100100100100100100100100fe000000000000"},
+    {0x012d, "00000004c0380000000700100100100100100100fe000000000000"},
+    {0x012e, "0000000000fe0100100100100100100100100100fe010010018000"},
+    {0x012f, "0000000000100100000700100100100100100100fe010010018000"},
+    {0x0130, "0100100000fe0100100100100100100100100100fe000000000000"},
+    {0x0131, "0000000000000000000700100100100100100100fe000000000000"},
+    {0x0132, "0000000001f704104104104104104104104104b1fe000000000000"},
+    {0x0133, "0000000000430430001cf0430430430430430431fb00300201e000"},
+    {0x0134, "01802400003c00c00c00c00c00c00c00c00c08c0f8000000000000"},
+    {0x0135, "00000001003806c0000780180180180180180180180180180f0000"},
+    {0x0136, "0000000000c20c60cc0d80f00f00d80cc0cc0c60c3000018018010"},
+    {0x0137, "00000000004004004004604c05807807804c046043000008018010"},
+    {0x0138, "00000000000000000004604c05807807804c046043000000000000"},
+    {0x0139, "0600400000c00c00c00c00c00c00c00c00c00c00fe000000000000"},
+    {0x013a, "0100200000f003003003003003003003003003001e000000000000"},
+    {0x013b, "0000000000c00c00c00c00c00c00c00c00c00c00fe000018018010"},
+    {0x013c, "0000000000f003003003003003003003003003001e000030030020"},
+    {0x013d, "0000000000cc0c80c80c00c00c00c00c00c00c00fe000000000000"},
+    {0x013e, "0000000000f203203203003003003003003003001e000000000000"},
+    {0x013f, "0000000000c00c00c00c00c60c60c00c00c00c00fe000000000000"},
+    {0x0140, "0000000000f003003003003303303003003003001e000000000000"},
+    {0x0141, "0000000000c00c00c00c80f00e01c01c00c00c00fe000000000000"},
+    {0x0142, "0000000000f003003003c0380700f003003003001e000000000000"},
+    {0x0143, "0080100000c60e60e60e60f60d60de0ce0ce0ce0c6000000000000"},
+    {0x0144, "00000000c0080100000fc0e60c60c60c60c60c60c6000000000000"},
+    {0x0145, "0000000000c60e60e60e60f60d60de0ce0ce0ce0c6000018010030"},
+    {0x0146, "0000000000000000000fc0e60c60c60c60c60c60c6000018010030"},
+    {0x0147, "02c0180000c60e60e60e60f60d60de0ce0ce0ce0c6000000000000"},
+    {0x0148, "00000006c0380300000fc0e60c60c60c60c60c60c6000000000000"},
+    {0x0149, "0000000000c00c01801fe072063063063063063063000000000000"},
+    {0x014a, "0000000000fc0e60c60c60c60c60c60c60c60c60c600600601c000"},
+    {0x014b, "0000000000000000000fc0e60c60c60c60c60c60c600600601c000"},
+    {0x014c, "00007c0000380440c60c60c60c20c60c60c604403c000000000000"},
+    {0x014d, "00000000007c00000007c0440c60c60c60c604407c000000000000"},
+    {0x014e, "06c0380000380440c60c60c60c20c60c60c604403c000000000000"},
+    {0x014f, "00000004c03800000007c0440c60c60c60c604407c000000000000"},
+    {0x0150, "03402c0000380440c60c60c60c20c60c60c604403c000000000000"},
+    {0x0151, "00000001402c02800007c0440c60c60c60c604407c000000000000"},
+    {0x0152, "00000000007f0c808808818818f1880880880c807f000000000000"},
+    {0x0153, "0000000000000000000ee19b19319119f1901990ee000000000000"},
+    {0x0154, "0100300000f80cc0c60c60cc0f80cc0c60c60c20c3000000000000"},
+    {0x0155, "00000000200400c00002e030020020020020020020000000000000"},
+    {0x0156, "0000000000f80cc0c60c60cc0f80cc0c60c60c20c3000018018010"},
+    {0x0157, "00000000000000000002e030020020020020020020000020060060"},
+    {0x0158, "0480300000f80cc0c60c60cc0f80cc0c60c60c20c3000000000000"},
+    {0x0159, "00000002401c01800002e030020020020020020020000000000000"},
+    {0x015a, "00801000007c0c60c00c00e003c0060060860c607c000000000000"},
+    {0x015b, "00000000c00801000007c04404007001c00604407c000000000000"},
+    {0x015c, "03802800007c0c60c00c00e003c0060060860c607c000000000000"},
+    {0x015d, "00000001003806c00007c04404007001c00604407c000000000000"},
+    {0x015e, "00000000007c0c60c00c00e003c0060060860c607c018008038000"},
+    {0x015f, "00000000000000000007c04404007001c00604407c018008038000"},
+    {0x0160, "02803800007c0c60c00c00e003c0060060860c607c000000000000"},
+    {0x0161, "00000006c03801000007c04404007001c00604407c000000000000"},
+    {0x0162, "0000000001ff010010010010010010010010010010018008038000"},
+    {0x0163, "0000000000000300300fe03003003003003003001e00800401c000"},
+    {0x0164, "02c0380001ff010010010010010010010010010010000000000000"},
+    {0x0165, "00000000400403c0300fe03003003003003003001e000000000000"},
+    {0x0166, "0000000001ff01001001001001007c010010010010000000000000"},
+    {0x0167, "0000000000000300300fe0300300f803003003001e000000000000"},
+    {0x0168, "07405c0000c60c60c60c60c60c60c60c60c60c607c000000000000"},
+    {0x0169, "00000007405c0000000c60c60c60c60c60c604e07e000000000000"},
+    {0x016a, "00007c0000c60c60c60c60c60c60c60c60c60c607c000000000000"},
+    {0x016b, "00000000007c0000000c60c60c60c60c60c604e07e000000000000"},
+    {0x016c, "06c0380000c60c60c60c60c60c60c60c60c60c607c000000000000"},
+    {0x016d, "00000004c0380000000c60c60c60c60c60c604e07e000000000000"},
+    {0x016e, "03802c02c0fe0c60c60c60c60c60c60c60c60c607c000000000000"},
+    {0x016f, "00003802c02c0380000c60c60c60c60c60c604e07e000000000000"},
+    {0x0170, "03402c0000c60c60c60c60c60c60c60c60c60c607c000000000000"},
+    {0x0171, "00000001402c0280000c60c60c60c60c60c604e07e000000000000"},
+    {0x0172, "0000000000c60c60c60c60c60c60c60c60c60c607c010030018000"},
+    {0x0173, "0000000000000000000c60c60c60c60c60c604e07e006004007000"},
+    {0x0174, "0380280001831831831930ba0ba0aa0ee0ee0c60c6000000000000"},
+    {0x0175, "00000001003806c0001831831930ba0aa0ee0ee044000000000000"},
+    {0x0176, "0380280001830c604406c038038010010010010010000000000000"},
+    {0x0177, "00000001803806c0000820c604606406c0380380180100300e0000"},
+    {0x0178, "06c06c0001830c604406c038038010010010010010000000000000"},
+    {0x0179, "0080100000ff00600600c0180180300200600c00ff000000000000"},
+    {0x017a, "00000000400c01800007e00400c0180300600400fe000000000000"},
+    {0x017b, "0180180000ff00600600c0180180300200600c00ff000000000000"},
+    {0x017c, "00000000001001000007e00400c0180300600400fe000000000000"},
+    {0x017d, "0280380000ff00600600c0180180300200600c00ff000000000000"},
+    {0x017e, "00000006c03801000007e00400c0180300600400fe000000000000"},
+    {0x017f, "00000000001e0100100f0010010010010010010010000000000000"},
+    {0x0391, "00000000003803802806c06c0440460fe0c6082183000000000000"},
+    {0x0392, "0000000000fc0c60c60c60c60fc0c60c20c20c60fc000000000000"},
+    {0x0393, "0000000000fe0c00c00c00c00c00c00c00c00c00c0000000000000"},
+    {0x0394, "00000000003803803806c06c06c0460c60c60821ff000000000000"},
+    {0x0395, "0000000000fe0c00c00c00c00fe0c00c00c00c00fe000000000000"},
+    {0x0396, "0000000000ff00600600c0180180300200600c00ff000000000000"},
+    {0x0397, "0000000000c60c60c60c60c60fe0c60c60c60c60c6000000000000"},
+    {0x0398, "0000000000380440c60c60c60fa0c60c60c604403c000000000000"},
+    {0x0399, "0000000000fe0100100100100100100100100100fe000000000000"},
+    {0x039a, "0000000000c20c60cc0d80f00f00d80cc0cc0c60c3000000000000"},
+    {0x039b, "00000000003803802806c06c0440460c60c6082183000000000000"},
+    {0x039c, "0000000000c70c70ef0ab0ab0bb093083083083083000000000000"},
+    {0x039d, "0000000000c60e60e60e60f60d60de0ce0ce0ce0c6000000000000"},
+    {0x039e, "0000000000fe00000000000007c0000000000000fe000000000000"},
+    {0x039f, "0000000000380440c60c60c60c20c60c60c604403c000000000000"},
+    {0x03a0, "0000000000fe0c60c60c60c60c60c60c60c60c60c6000000000000"},
+    {0x03a1, "0000000000fc0c60c20c20c20c60fc0c00c00c00c0000000000000"},
+    {0x03a3, "0000000000fe0c00600200300180300200600c00fe000000000000"},
+    {0x03a4, "0000000001ff010010010010010010010010010010000000000000"},
+    {0x03a5, "0000000001830c604406c038038010010010010010000000000000"},
+    {0x03a6, "00000000003801007c0de0d60d60d60de07c010038000000000000"},
+    {0x03a7, "0000000000c20c606c02c03803803806c0440c6183000000000000"},
+    {0x03a8, "0000000000920920920920d60d607c03c010010038000000000000"},
+    {0x03a9, "00000000000007c0c60c60820820820820c60641ef000000000000"},
+    {0x03aa, "06c06c0000fe0100100100100100100100100100fe000000000000"},
+    {0x03ab, "06c06c0001830c604406c038038010010010010010000000000000"},
+    {0x03ac, "00000000c01801000007a0ce08c18c18c08c0de073000000000000"},
+    {0x03ad, "00000000c01801000007c0460400780400c00c207c000000000000"},
+    {0x03ae, "00000000c0180100000fc0e60c60c60c60c60c60c6006006006000"},
+    {0x03af, "00000000c01801000007001001001001001001800c000000000000"},
+    {0x03b0, "01801000006c06c0001c604204204204204606c038000000000000"},
+    {0x03b1, "00000000000000000007a0ce08c18c18c08c0de073000000000000"},
+    {0x03b2, "00000003007c0c40c40c40dc0fc0c60c20c20ee0fc0c00c00c0000"},
+    {0x03b3, "0000000000000000001820c604406c06c038038018010010010000"},
+    {0x03b4, "00000001807c04007007c0c60c60c60c60c60c607c000000000000"},
+    {0x03b5, "00000000000000000007c0460400780400c00c207c000000000000"},
+    {0x03b6, "00000007c0fe01c0300600400c00c00c00c006003c00600600c000"},
+    {0x03b7, "0000000000000000000fc0e60c60c60c60c60c60c6006006006000"},
+    {0x03b8, "00000000003806c0c60c60c60fe0c60c60c606c038000000000000"},
+    {0x03b9, "00000000000000000007001001001001001001800c000000000000"},
+    {0x03ba, "00000000000000000004604c05807807804c046043000000000000"},
+    {0x03bb, "00000000007003001001803803c06c0640460c6082000000000000"},
+    {0x03bc, "0000000000000000000c60c60c60c60c60c60c60fb0c00c00c0000"},
+    {0x03bd, "0000000000000000000c40c604606606606c038030000000000000"},
+    {0x03be, "00000007c07e06004004007803c0600c00c006007c00600600c000"},
+    {0x03bf, "00000000000000000007c0440c60c60c60c604407c000000000000"},
+    {0x03c0, "0000000000000000001ff0c6046046046046046047000000000000"},
+    {0x03c1, "00000000000000000003c0660c60c20c20c60e60fc0c00c00c0000"},
+    {0x03c2, "00000000000000000003e0600c00c00c004006003c00600600c000"},
+    {0x03c3, "00000000000000000007e04c0c60c60c60c6044078000000000000"},
+    {0x03c4, "0000000000000000000fe01001001001001001800c000000000000"},
+    {0x03c5, "0000000000000000001c604204204204204606c038000000000000"},
+    {0x03c6, "00000000000000000005c0d60921930930920d607c010010010000"},
+    {0x03c7, "0000000000000000000c606402c03803801003803806804c0c6000"},
+    {0x03c8, "0000000000000000000920920920920920d60fe07c010010010000"},
+    {0x03c9, "0000000000000000000c60820821931931930ba0ee000000000000"},
+    {0x0400, "0300100000fe0c00c00c00c00fe0c00c00c00c00fe000000000000"},
+    {0x0401, "02c02c0000fe0c00c00c00c00fe0c00c00c00c00fe000000000000"},
+    {0x0402, "0000000001f80c00c00c00dc0fe0c20c20c20c20c200200601e008"},
+    {0x0403, "00c0180000fe0c00c00c00c00c00c00c00c00c00c0000000000000"},
+    {0x0404, "00000000003c0660c00c00c00fc0c00c00c006603c000000000000"},
+    {0x0405, "00000000007c0c60c00c00e003c0060060860c607c000000000000"},
+    {0x0406, "0000000000fe0100100100100100100100100100fe000000000000"},
+    {0x0407, "06c06c0000fe0100100100100100100100100100fe000000000000"},
+    {0x0408, "00000000003c00c00c00c00c00c00c00c00c08c0f8000000000000"},
+    {0x0409, "00000000007807805805805c05e05b05b0db0db19e000000000000"},
+    {0x040a, "0000000001981981981981fc1fe19b19b19b19b19e000000000000"},
+    {0x040b, "0000000001f80c00c00c00dc0fe0c20c20c20c20c2000000000000"},
+    {0x040c, "0080100000c20c60cc0d80f00f00d80cc0cc0c60c3000000000000"},
+    {0x040d, "0300100000c60ce0ce0ce0de0d60f60e60e60e60c6000000000000"},
+    {0x040e, "06c0380000c20c604606c06c0380380180100300e0000000000000"},
+    {0x040f, "0000000000c60c60c60c60c60c60c60c60c60c60fe010010000000"},
+    {0x0410, "00000000003803802806c06c0440460fe0c6082183000000000000"},
+    {0x0411, "0000000000fe0c00c00c00c00fc0c60c20c20c60fc000000000000"},
+    {0x0412, "0000000000fc0c60c60c60c60fc0c60c20c20c60fc000000000000"},
+    {0x0413, "0000000000fe0c00c00c00c00c00c00c00c00c00c0000000000000"},
+    {0x0414, "00000000007e0460460460c60c60c60c60c60c61ff183183000000"},
+    {0x0415, "0000000000fe0c00c00c00c00fe0c00c00c00c00fe000000000000"},
+    {0x0416, "0000000001930d60d607c07c07c07c0d60d2093193000000000000"},
+    {0x0417, "0000000000780cc00600600c03800c00600608e07c000000000000"},
+    {0x0418, "0000000000c60ce0ce0ce0de0d60f60e60e60e60c6000000000000"},
+    {0x0419, "06c0380000c60ce0ce0ce0de0d60f60e60e60e60c6000000000000"},
+    {0x041a, "0000000000c20c60cc0d80f00f00d80cc0cc0c60c3000000000000"},
+    {0x041b, "00000000007e0660660660660660660660460c6186000000000000"},
+    {0x041c, "0000000000c70c70ef0ab0ab0bb093083083083083000000000000"},
+    {0x041d, "0000000000c60c60c60c60c60fe0c60c60c60c60c6000000000000"},
+    {0x041e, "0000000000380440c60c60c60c20c60c60c604403c000000000000"},
+    {0x041f, "0000000000fe0c60c60c60c60c60c60c60c60c60c6000000000000"},
+    {0x0420, "0000000000fc0c60c20c20c20c60fc0c00c00c00c0000000000000"},
+    {0x0421, "00000000003c0660c00c00c00c00c00c00c006603c000000000000"},
+    {0x0422, "0000000001ff010010010010010010010010010010000000000000"},
+    {0x0423, "0000000000c20c604606c06c0380380180100300e0000000000000"},
+    {0x0424, "00000000001007c0d60921931931930920d607c010000000000000"},
+    {0x0425, "0000000000c20c606c02c03803803806c0440c6183000000000000"},
+    {0x0426, "0000000001861861861861861861861861861861ff003003000000"},
+    {0x0427, "0000000000c60c60c60c60c607e006006006006006000000000000"},
+    {0x0428, "0000000000920920920920920920920920920920fe000000000000"},
+    {0x0429, "0000000001b61b61b61b61b61b61b61b61b61b61ff003003000000"},
+    {0x042a, "0000000001e006006006006007c06606206206607c000000000000"},
+    {0x042b, "0000000001821821821821821f219a19a19a19a1f2000000000000"},
+    {0x042c, "0000000000c00c00c00c00fc0c60c20c20c20c60fc000000000000"},
+    {0x042d, "00000000007808c00400600607e00600600408c078000000000000"},
+    {0x042e, "00000000019c1b61b21a31a31e31a31a31b21b619c000000000000"},
+    {0x042f, "00000000007e0e20c20c20c207e0320620620c2082000000000000"},
+    {0x0430, "00000000000000000007c04600607e0c60860ce07e000000000000"},
+    {0x0431, "00000001c0700400c00fc0c40c60c60c60c604407c000000000000"},
+    {0x0432, "0000000000000000000f80cc0cc0fc0c40c60c40fc000000000000"},
+    {0x0433, "00000000000000000007e040040040040040040040000000000000"},
+    {0x0434, "00000000000000000007c0440440440440440c40fe082082000000"},
+    {0x0435, "00000000000000000003c0640c60c20fe0c004203c000000000000"},
+    {0x0436, "0000000000000000000920d607c07c07c0d6092093000000000000"},
+    {0x0437, "00000000000000000007c0c600403c00600608607c000000000000"},
+    {0x0438, "0000000000000000000c60ce0ce0de0f60e60e60c6000000000000"},
+    {0x0439, "00000004c0380000000c60ce0ce0de0f60e60e60c6000000000000"},
+    {0x043a, "00000000000000000004604c05807807804c046043000000000000"},
+    {0x043b, "00000000000000000007e0460460460460460c6186000000000000"},
+    {0x043c, "0000000000000000001831c71c71ef1bb1bb183183000000000000"},
+    {0x043d, "0000000000000000000c60c60c60fe0c60c60c60c6000000000000"},
+    {0x043e, "00000000000000000007c0440c60c60c60c604407c000000000000"},
+    {0x043f, "0000000000000000000fe0c60c60c60c60c60c60c6000000000000"},
+    {0x0440, "0000000000000000000fc0e60c60c20c20c60e60fc0c00c00c0000"},
+    {0x0441, "00000000000000000003c0620400c00c004006203c000000000000"},
+    {0x0442, "00000000000000000007e010010010010010010010000000000000"},
+    {0x0443, "0000000000000000000820c604606406c0380380180100300e0000"},
+    {0x0444, "00000000001001001007c0d60920920920920d607c010010010000"},
+    {0x0445, "0000000000000000000c606c03803803806c0440c6000000000000"},
+    {0x0446, "0000000000000000000840840840840840840840fe002002000000"},
+    {0x0447, "0000000000000000000c60c60c60c607e006006006000000000000"},
+    {0x0448, "0000000000000000000920920920920920920920fe000000000000"},
+    {0x0449, "0000000000000000001b61b61b61b61b61b61b61ff001001000000"},
+    {0x044a, "0000000000000000001e006006007e06606306207e000000000000"},
+    {0x044b, "0000000000000000000820820820f209a09a09a0f2000000000000"},
+    {0x044c, "0000000000000000000c00c00c00fc0c60c60c60fc000000000000"},
+    {0x044d, "00000000000000000007808c00607e00600608c078000000000000"},
+    {0x044e, "00000000000000000019c1b61b31f31b31b31b619c000000000000"},
+    {0x044f, "00000000000000000007c04404404403c0240640c4000000000000"},
+    {0x0450, "00000006002001000003c0640c60c20fe0c004203c000000000000"},
+    {0x0451, "00000000000006c06c03c0640c60c20fe0c004203c000000000000"},
+    {0x0452, "0000000400400400c01f804005c07e04604204204600600c018000"},
+    {0x0453, "00000000400c01800007e040040040040040040040000000000000"},
+    {0x0454, "00000000000000000003c0620400fc0c004006203c000000000000"},
+    {0x0455, "00000000000000000007c04404007001c00604407c000000000000"},
+    {0x0456, "0000000000100100000700100100100100100100fe000000000000"},
+    {0x0457, "00000000006c06c0000700100100100100100100fe000000000000"},
+    {0x0458, "0000000000180180000780180180180180180180180180180f0000"},
+    {0x0459, "00000000000000000007804804804e04b04b0cb18e000000000000"},
+    {0x045a, "0000000000000000001981981981fc19e19b19b19e000000000000"},
+    {0x045b, "0000000400400400c01f804005c07e046046046046000000000000"},
+    {0x045c, "00000000c00801000004604c05807807804c046043000000000000"},
+    {0x045d, "0000000200100180000c60ce0ce0de0f60e60e60c6000000000000"},
+    {0x045e, "00000004c0380000000820c604606406c0380380180100300e0000"},
+    {0x045f, "0000000000000000000c60c60c60c60c60c60c60fe010010000000"},
+    {0x2010, "00000000000000000000000000007c000000000000000000000000"},
+    {0x2011, "00000000000000000000000000007c000000000000000000000000"},
+    {0x2012, "0000000000000000000000000001ff000000000000000000000000"},
+    {0x2013, "0000000000000000000000000001ff000000000000000000000000"},
+    {0x2014, "0000000000000000000000000001ff000000000000000000000000"},
+    {0x2015, "0000000000000000000000000001ff000000000000000000000000"},
+    {0x2016, "000000000044044044044044044044044044044044044044044044"},
+    {0x2017, "0000000000000000000000000000000000000000000001ff0001ff"},
+    {0x2018, "000000000018018030030000000000000000000000000000000000"},
+    {0x2019, "000000000018018010030000000000000000000000000000000000"},
+    {0x201a, "000000000000000000000000000000000000018018030020000000"},
+    {0x201b, "000000010030030018008000000000000000000000000000000000"},
+    {0x201c, "00000000002406c06c0ec000000000000000000000000000000000"},
+    {0x201d, "00000000006606c06c048000000000000000000000000000000000"},
+    {0x201e, "00000000000000000000000000000000000006606c06c048000000"},
+    {0x201f, "0000000480ec06c064024000000000000000000000000000000000"},
+    {0x2020, "0000000000100100100fe010010010010010010010010000000000"},
+    {0x2021, "0000000000100100100fe0100100100100fe010010010000000000"},
+    {0x2022, "00000000000000000003807c07c038000000000000000000000000"},
+    {0x2023, "00000000000000000006007807c078060000000000000000000000"},
+    {0x2026, "0000000000000000000000000000000000001ff1ff000000000000"},
+    {0x2030, "0000000000e01201220ec0380e01800ee1b91b90ee000000000000"},
+    {0x2031, "0000000000401e01201a20dc0601801ff12916d0fe000000000000"},
+    {0x2032, "000000000018010020000000000000000000000000000000000000"},
+    {0x2033, "00000000003c028050000000000000000000000000000000000000"},
+    {0x2034, "00000000005e0d40a0000000000000000000000000000000000000"},
+    {0x2035, "000000000030010008000000000000000000000000000000000000"},
+    {0x2036, "000000000068028014000000000000000000000000000000000000"},
+    {0x2037, "0000000000f405602a000000000000000000000000000000000000"},
+    {0x2039, "000000000000000000008018030060030018008000000000000000"},
+    {0x203a, "00000000000000000002003001800c018030020000000000000000"},
+    {0x20ac, "00000000003c0660600401f80c01f804006006603c000000000000"},
+    {0x2122, "0000000001d209e09e092000000000000000000000000000000000"},
+    {0x2190, "0000000000000000000000000c00fe0fe040000000000000000000"},
+    {0x2191, "000000000000000000010038054010010010010010000000000000"},
+    {0x2192, "0000000000000000000000000060fe0fe004000000000000000000"},
+    {0x2193, "000000000000000000010010010010010054038010000000000000"},
+    {0x2194, "0000000000000000000000000c60fe0fe044000000000000000000"},
+    {0x2195, "000000000000000000010038054010010054038010000000000000"},
+    {0x2196, "0000000000000000000000000f00e00b001800c004000000000000"},
+    {0x2197, "00000000000000000000000001e00e01a030060040000000000000"},
+    {0x2198, "0000000000000000000000000c006003001a00e01e000000000000"},
+    {0x2199, "00000000000000000000000000600c0180f00e00f0000000000000"},
+    {0x219a, "0000000000000000000000000c60fe0fe058000000000000000000"},
+    {0x219b, "0000000000000000000000000360fe0fe0c4000000000000000000"},
+    {0x219c, "0000000000000000000000000ee0d80f0000000000000000000000"},
+    {0x219d, "0000000000000000000000000ee03601e000000000000000000000"},
+    {0x219e, "0000000000000000000000000d00fe0fe058000000000000000000"},
+    {0x219f, "00000000000000000001003805403807c010010010000000000000"},
+    {0x21a0, "0000000000000000000000000160fe0fe014000000000000000000"},
+    {0x21a1, "00000000000000000001001001007c038054038010000000000000"},
+    {0x21a2, "0000000000000000000000000c20fc0fe042000000000000000000"},
+    {0x21a3, "00000000000000000000000008607e07e084000000000000000000"},
+    {0x21a4, "0000000000000000000000000c30ff0ff043000000000000000000"},
+    {0x21a5, "00000000000000000001003805401001001001007c000000000000"},
+    {0x21a6, "0000000000000000000000001861fe1fe184000000000000000000"},
+    {0x21a7, "00000000000000000007c010010010010054038010000000000000"},
+    {0x21a8, "00000000000000000001003805401001007c03807c000000000000"},
+    {0x21a9, "0000000000000000000060020c30fe0fc040000000000000000000"},
+    {0x21aa, "0000000000000000000c00801860fe07e004000000000000000000"},
+    {0x21ab, "00000000000000000000e01e0db0fe0fc058000000000000000000"},
+    {0x21ac, "0000000000000000000600f01b60fe07e034000000000000000000"},
+    {0x21ad, "0000000000000000000000000c60fe0ee044000000000000000000"},
+    {0x21ae, "0000000000000000000000100d60fe0fe074000000000000000000"},
+    {0x21af, "0000000000000400c60dc0f40e408c00c01c01e00c000000000000"},
+    {0x21b0, "0000000000000200600fe066026006006006006006000000000000"},
+    {0x21b1, "00000000000000800c0fe0cc0c80c00c00c00c00c0000000000000"},
+    {0x21b2, "0000000000000060060060060060260660fe060020000000000000"},
+    {0x21b3, "0000000000000c00c00c00c00c00c80cc0fe00c008000000000000"},
+    {0x21b4, "0000000000000000000f801800800800803803c018000000000000"},
+    {0x21b5, "0000000000000000000000000030430c31ff0c0040000000000000"},
+    {0x21b6, "00000000000000000000003e0220f2060000000000000000000000"},
+    {0x21b7, "0000000000000000000000f808809e00c000000000000000000000"},
+    {0x21b8, "0000000000000000000fe0000f00e00b001800c004000000000000"},
+    {0x21b9, "0000000000000001a01e01ff1e01ab00f1ff00f00b000000000000"},
+    {0x21ba, "00000000000000000000600e08e08a0820860ec078000000000000"},
+    {0x21bb, "0000000000000000000e00e00e20a20820c206603c000000000000"},
+    {0x21d0, "0000000000000000000000000c00800fe040000000000000000000"},
+    {0x21d1, "00000000000000000001002806c028028028028028000000000000"},
+    {0x21d2, "0000000000000000000000000060020fe004000000000000000000"},
+    {0x21d3, "00000000000000000002802802802802806c028010000000000000"},
+    {0x21d4, "0000000000000000000000000c60820fe044000000000000000000"},
+    {0x21d5, "00000000000000000001002806c02802806c028010000000000000"},
+    {0x2200, "0000000001830820c60fe04604406c06c028038038000000000000"},
+    {0x2202, "00000000000003800c00600607e04e0c40c40cc078000000000000"},
+    {0x2203, "0000000000fe0060060060060fe0060060060060fe000000000000"},
+    {0x2205, "00000000000000003807e08e09a0b30e20c60fc000000000000000"},
+    {0x2206, "00000000000003803802806c06c0440c60821831ff000000000000"},
+    {0x2207, "0000000001ff1ff0820c20c604406c06c028038038000000000000"},
+    {0x2208, "00000000003e07e0400c00800fe0c00c00c006003e000000000000"},
+    {0x2209, "00000000403e07e04c0c80980fe0d80d00f007003e060000000000"},
+    {0x220b, "0000000000f80fc0040060020fe00600600600c0f8000000000000"},
+    {0x220f, "0000000000fe082082082082082082082082082082082082082000"},
+    {0x2211, "0000000000fe0c00600200300100080080100300200400c00fe000"},
+    {0x2212, "0000000000000000000000000000ff000000000000000000000000"},
+    {0x2213, "0000000000000000fe0fe0000100100fe0fe010010000000000000"},
+    {0x2217, "0000000000000000000100d60380380d6010000000000000000000"},
+    {0x2218, "00000000000000000000003806c04406c038000000000000000000"},
+    {0x2219, "00000000000000000003807c07c038000000000000000000000000"},
+    {0x221a, "0000000030020020060040440cc048068038038030030000000000"},
+    {0x221d, "0000000000000000000000760dc0880dc076000000000000000000"},
+    {0x221e, "0000000000000000000000ee1bb1111111bb0ee000000000000000"},
+    {0x2227, "00000000000000001003803802806c06c0440460c6000000000000"},
+    {0x2228, "0000000000000000c60c604406c06c028038038038000000000000"},
+    {0x2229, "00000000000000003807c0c60c60c60c60c60c60c6000000000000"},
+    {0x222a, "0000000000000000820c60c60c60c60c60c60ee07c000000000000"},
+    {0x222b, "00000e0100100100100100100100100100100100100100100e0000"},
+    {0x2248, "0000000000000000000000000f001e0f001e000000000000000000"},
+    {0x2260, "0000000000000000020040ff0180300ff040080000000000000000"},
+    {0x2261, "0000000000000000000fe0000000fe0000fe0fe000000000000000"},
+    {0x2264, "00000000000000000000603e0f00f003e0060000ff000000000000"},
+    {0x2265, "0000000000000000000c00f801e01e0f80c00000ff000000000000"},
+    {0x2282, "00000000000000000007e0c00800800800e003e000000000000000"},
+    {0x2283, "0000000000000000000fc00600200200200e0fc000000000000000"},
+    {0x2286, "00000000000000007e0c00800800800fe03e0000ff000000000000"},
+    {0x2287, "0000000000000000fc0060020020020fe0f80000ff000000000000"},
+    {0x2295, "00000000000000003807c0920920ff0920d607c000000000000000"},
+    {0x2297, "00000000000000003807c0ee0ba0bb0ae0c607c000000000000000"},
+    {0x22a5, "0000000000000100100100100100100100100100ff000000000000"},
+    {0x22c5, "000000000000000000000000038038000000000000000000000000"},
+    {0x22ef, "0000000000000000000000001ff1ff000000000000000000000000"},
+    {0x2318, "0000000000000c60ab0aa07c0280fe1a90ee000000000000000000"},
+    {0x2325, "0000000000000000ee0e603003001801800e000000000000000000"},
+    {0x2326, "0000000000000000001fc1561631621541f8000000000000000000"},
+    {0x232b, "00000000000000000003f0d518d08d05503f000000000000000000"},
+    {0x23ce, "0000000000000000000050050c5101081040000000000000000000"},
+    {0x23cf, "00000000000000001003807c0fe0001ff1ff1ff1ff000000000000"},
+    {0x25a0, "0000000000000000001ff1ff1ff1ff1ff1ff1ff1ff1ff000000000"},
+    {0x25a1, "0000000000000000001ff1011011011011011011011ff000000000"},
+    {0x25a2, "0000000000000000001ff10110110110110110118307e000000000"},
+    {0x25a3, "0000000000000000001ff17d1ff1ff1ff1ff1ff1011ff000000000"},
+    {0x25a4, "0000000000000000001ff1ff1011ff1ff1011ff1011ff000000000"},
+    {0x25a5, "0000000000000000001ff16d16d16d16d16d16d1ff1ff000000000"},
+    {0x25a6, "0000000000000000001ff1ff1ef1ff1ff1ff1ff1ff1ff000000000"},
+    {0x25a7, "0000000000000000001ff16b1b515b1ad1571ab1f71ff000000000"},
+    {0x25a8, "0000000000000000001ff1ad15b1b516b1d51ab1df1ff000000000"},
+    {0x25a9, "0000000000000000001ff1ff1ff1ff1ff1ff1ff1ff1ff000000000"},
+    {0x25aa, "00000000000000000000007c0fe0fe0fe0fe0fe000000000000000"},
+    {0x25ab, "00000000000000000000007c0c60c60c60c60fe000000000000000"},
+    {0x25ac, "0000000000000000000000001ff1ff1ff1ff000000000000000000"},
+    {0x25ad, "0000000000000000000000001ff1011011ff000000000000000000"},
+    {0x25ae, "00000000000000000007c07c07c07c07c07c07c07c038000000000"},
+    {0x25af, "00000000000000000007c04404404404404404406c038000000000"},
+    {0x25b0, "00000000000000000000000007f0fe0fe1fc000000000000000000"},
+    {0x25b1, "00000000000000000000000007f0820821fc000000000000000000"},
+    {0x25b2, "00000000000000000001003803807c07c0fe0fe1ff1ff000000000"},
+    {0x25b3, "00000000000000000001003802806c0440c20821831ff000000000"},
+    {0x25b4, "00000000000000000000000001003803807c07c000000000000000"},
+    {0x25b5, "00000000000000000000000001002802804407c000000000000000"},
+    {0x25b6, "0000000000000000001801e01f81fe1fe1f81e0180000000000000"},
+    {0x25b7, "000000000000000000180160118106106118160180000000000000"},
+    {0x25b8, "0000000000000000000000000e00f80fc0f0040000000000000000"},
+    {0x25b9, "0000000000000000000000000e00d80cc0f0040000000000000000"},
+    {0x25ba, "0000000000000000000001001e01fc1fe1f0180000000000000000"},
+    {0x25bb, "0000000000000000000001001e011c10e1f0180000000000000000"},
+    {0x25bc, "0000000000000000001ff0fe0fe07c07c038038010000000000000"},
+    {0x25bd, "0000000000000000001ff0820c604406c028038010000000000000"},
+    {0x25be, "00000000000000000000007c07c038038010010000000000000000"},
+    {0x25bf, "00000000000000000000007c044028028010010000000000000000"},
+    {0x25c0, "00000000000000000000300f03f0ff0ff03f00f003000000000000"},
+    {0x25c1, "00000000000000000000300d0310c10c103100d003000000000000"},
+    {0x25c2, "00000000000000000000000000e03e07e01e004000000000000000"},
+    {0x25c3, "00000000000000000000000000e03606601e004000000000000000"},
+    {0x25c4, "00000000000000000000000100f07f0ff01f003000000000000000"},
+    {0x25c5, "00000000000000000000000100f0710e101f003000000000000000"},
+    {0x25c6, "00000000000000000001003807c0fe1ff0fe07c038000000000000"},
+    {0x25c7, "0000000000000000000100280440821830c606c038000000000000"},
+    {0x25c8, "00000000000000000001002807c0fe1ff0fe07c038000000000000"},
+    {0x25c9, "00000000000000000007c0ba17d17d17d17d0ba06e038000000000"},
+    {0x25ca, "0000000100100280280440440820820820c6044044028038010010"},
+    {0x25cb, "00000000000000000007c08210110110110108206e038000000000"},
+    {0x25cc, "000000000000000000010082000101101000082046010000000000"},
+    {0x25cd, "00000000000000000007c0ee1ef16d16d1ef0ee07e038000000000"},
+    {0x25ce, "00000000000000000007c08211112912913908206e038000000000"},
+    {0x25cf, "00000000000000000007c0fe1ff1ff1ff1ff0fe07e038000000000"},
+    {0x25d0, "00000000000000000007c0f21f11f11f11f10f207e038000000000"},
+    {0x25d1, "00000000000000000007c09e11f11f11f11f09e07e038000000000"},
+    {0x25d2, "00000000000000000007c0821011011ff1ff0fe07e038000000000"},
+    {0x25d3, "00000000000000000007c0fe1ff1ff10110108206e038000000000"},
+    {0x25d4, "00000000000000000007c09e11f11f10110108206e038000000000"},
+    {0x25d5, "00000000000000000007c09e11f11f1ff1ff0fe07e038000000000"},
+    {0x25d6, "00000000000000000001c03c07c07c07c07c03c01c004000000000"},
+    {0x25d7, "00000000000000000007007807c07c07c07c078070040000000000"},
+    {0x25d8, "0000001ff1ff1ff1ff1ef1c71c31c71ff1ff1ff1ff000000000000"},
+    {0x25d9, "0000001ff1ff1ff1ff19317d0fe0fe0fe0fe17d1bb1ff1ff1ff1ff"},
+    {0x25da, "0000001ff1ff1ff1ff19317d0fe0fe000000000000000000000000"},
+    {0x25db, "0000000000000000000000000000000fe0fe17d1bb1ff1ff1ff1ff"},
+    {0x25dc, "00000000000000000001c020060040000000000000000000000000"},
+    {0x25dd, "00000000000000000007000800c004000000000000000000000000"},
+    {0x25de, "00000000000000000000000000000000400c008030040000000000"},
+    {0x25df, "000000000000000000000000000000040060020018004000000000"},
+    {0x25e0, "00000000000000000007c082101101000000000000000000000000"},
+    {0x25e1, "00000000000000000000000000000010110108206e038000000000"},
+    {0x25e2, "00000000000000000000100300700f01f03f07f0ff0ff000000000"},
+    {0x25e3, "0000000000000000001001801c01e01f01f81fc1fe1ff000000000"},
+    {0x25e4, "0000000000000000001fe1fc1f81f01e01c0180100000000000000"},
+    {0x25e5, "0000000000000000000ff07f03f01f00f007003001000000000000"},
+    {0x25e6, "000000000000000000010000044000010000000000000000000000"},
+    {0x25e7, "0000000000000000001ff1f11f11f11f11f11f11f11ff000000000"},
+    {0x25e8, "0000000000000000001ff11f11f11f11f11f11f11f1ff000000000"},
+    {0x25e9, "0000000000000000001ff1fd1f91f11e11c11811811ff000000000"},
+    {0x25ea, "0000000000000000001ff10310710f11f13f17f1ff1ff000000000"},
+    {0x25eb, "0000000000000000001ff1111111111111111111111ff000000000"},
+    {0x25ec, "00000000000000000001003802806c0540fa0821831ff000000000"},
+    {0x25ed, "00000000000000000001003803807c0740f20f21f31ff000000000"},
+    {0x25ee, "00000000000000000001003803807c05c0de09e19f1ff000000000"},
+    {0x25ef, "0000000000000000380ee0821011011011011830c6038000000000"},
+    {0x25f0, "0000000000000000001ff1111111111f11011011011ff000000000"},
+    {0x25f1, "0000000000000000001ff1011011011f11111111111ff000000000"},
+    {0x25f2, "0000000000000000001ff10110110111f1111111111ff000000000"},
+    {0x25f3, "0000000000000000001ff11111111111f1011011011ff000000000"},
+    {0x25f4, "00000000000000000007c0921111111f110108206e038000000000"},
+    {0x25f5, "00000000000000000007c0821011011f111109207e038000000000"},
+    {0x25f6, "00000000000000000007c08210110111f11109207e038000000000"},
+    {0x25f7, "00000000000000000007c09211111111f10108206e038000000000"},
+    {0x25f8, "0000000000000000001fe104108110120140180100000000000000"},
+    {0x25f9, "0000000000000000000ff041021011009005003001000000000000"},
+    {0x25fa, "0000000000000000001001801401201101081041061ff000000000"},
+    {0x25fb, "0000000000000000000fe0820820820820820820fe000000000000"},
+    {0x25fc, "0000000000000000000fe0fe0fe0fe0fe0fe0fe0fe000000000000"},
+    {0x25fd, "0000000000000000000000fe0820820820820fe000000000000000"},
+    {0x25fe, "0000000000000000000000fe0fe0fe0fe0fe0fe000000000000000"},
+    {0x25ff, "0000000000000000000010030050090110210410c10ff000000000"},
+    {0x2600, "0000000000000000120540380bf038044010010000000000000000"},
+    {0x2601, "00000000000000000000000000000000003c07e0ff000000000000"},
+    {0x2602, "00000000000000000000007c0fe0fe000000000000000000000000"},
+    {0x2603, "000000000000030028000000000080002002080078000000000000"},
+    {0x2605, "0000000000000000000000100100fe07c03806c044000000000000"},
+    {0x2606, "000000000000000000000010000082000000000000000000000000"},
+    {0x2610, "0000000000000000000fe0000000000000000000fe000000000000"},
+    {0x2611, "0000000000000000000fe0000000080100300200fe000000000000"},
+    {0x2612, "0000000000000000000000820c60aa0920aa0c60fe000000000000"},
+    {0x2613, "00000000000000004406c028010038028044044000000000000000"},
+    {0x263a, "0000000000000380c60821291011290920c6038000000000000000"},
+    {0x263b, "0000000000000380fe0ba1ff1ff1bb0c60fe038000000000000000"},
+    {0x2660, "00000000000001003803807c0fe0fe0fe054010000000000000000"},
+    {0x2661, "000000000000000000010000000000000000010000000000000000"},
+    {0x2662, "000000000000010000000000000000000000010000000000000000"},
+    {0x2663, "00000000000003803c03c0380fe1ff1ff0fe010000000000000000"},
+    {0x2664, "000000000000010000000000000000010010010000000000000000"},
+    {0x2665, "0000000000000ee1ff1ff1ff0fe0fe07c038010000000000000000"},
+    {0x2666, "00000000000001003803c07c0fe07c07c038010000000000000000"},
+    {0x2667, "000000000000000000000000000000010010010000000000000000"},
+    {0x266a, "00000000001001801e0120100100100100500f0060000000000000"},
+    {0x266b, "00000000000003e02e0200200200200200200e00ce00e000000000"},
+    {0x26a0, "0000000000000000000000100380100540820921ff000000000000"},
+    {0x26a1, "00000000000000000401803007001c018030040000000000000000"},
+    {0x2713, "00000000000000000000400c0180100e00e0040000000000000000"},
+    {0x2714, "00000000000000000000600e01c0b81f00e00e0000000000000000"},
+    {0x2715, "0000000000000000000820c607c03803806c0c6000000000000000"},
+    {0x2716, "0000000000000000440ee0fc07807c0fe0ce000000000000000000"},
+    {0x2717, "00000000000000002202403c01803807806c0c0080000000000000"},
+    {0x2718, "0000000000000020c70ee07c07807807c0fc1cc080000000000000"},
+    {0x271a, "0000000000000000000100380380fe0ff038038038000000000000"},
+    {0x2726, "00000000000000000000001003807c07c038010000000000000000"},
+    {0x2727, "000000000000000000000010028044044028010000000000000000"},
+    {0x2731, "0000000000000000100380fe0fe07c0fe0fe0ba038000000000000"},
+    {0x2732, "0000000000000000000100920fe06c06c0de010010000000000000"},
+    {0x2733, "0000000000000000000100540380fe038054010010000000000000"},
+    {0x276e, "00000000000000c01c01803007006006003003801801c000000000"},
+    {0x276f, "00000000000006007003801801c00c00c018038030070000000000"},
+    {0x2794, "00000000000000000000000c0fe0fe00c008000000000000000000"},
+    {0x279c, "00000000000000000000800c0fe0fe00c008000000000000000000"},
+    {0x279e, "0000000000000000000000061fe0fe004000000000000000000000"},
+    {0xfffd, "00001807c0c20ba1f91fb1f31e71ef1ef0fe0ee06c010000000000"}
+};
+
+static int hex_digit(char c) {
+    return c <= '9' ? c - '0' : c - 'a' + 10;
+}
+
+/* Set 'rows' to the bitmap of the character. Returns 0 if the font has no
+ * glyph for it. */
+int fontGlyph(uint32_t cp, uint16_t *rows) {
+    size_t lo = 0, hi = sizeof(Glyphs)/sizeof(Glyphs[0]);
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (Glyphs[mid].cp < cp) {
+            lo = mid + 1;
+        } else if (Glyphs[mid].cp > cp) {
+            hi = mid;
+        } else {
+            const char *p = Glyphs[mid].rows;
+            for (int y = 0; y < FONT_HEIGHT; y++, p += 3) {
+                rows[y] = hex_digit(p[0]) << 8 | hex_digit(p[1]) << 4 |
+                          hex_digit(p[2]);
+            }
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,12 @@
+#ifndef FONT_H
+#define FONT_H
+
+#include <stdint.h>
+
+#define FONT_WIDTH 9            /* Cell size in pixels. */
+#define FONT_HEIGHT 18
+#define FONT_BASELINE 14        /* First row below the baseline. */
+
+int fontGlyph(uint32_t cp, uint16_t *rows);
+
+#endif
@@ -0,0 +1,319 @@
+/* ============================================================================
+ * Frame buffers: raw BGRA images as captured from windows.
+ * ==========================================================================*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "frame.h"
+#include "pool.h"
+
+/* Offset of the pixels from the start of the frame allocation. */
+#define FRAME_HDR_SIZE ((sizeof(Frame)+POOL_ALIGN-1)/POOL_ALIGN*POOL_ALIGN)
+
+/* Create a frame of the specified size. The pixels are not initialized.
+ * The frame and its pixels are a single buffer from the pool. */
+Frame *frameCreate(int width, int height) {
+    Frame *f = poolAlloc(FRAME_HDR_SIZE + (size_t)width*4*height);
+    f->width = width;
+    f->height = height;
+    f->stride = width*4;
+    f->pixels = (unsigned char*)f + FRAME_HDR_SIZE;
+    return f;
+}
+
+void frameFree(Frame *f) {
+    poolFree(f);
+}
+
+/* ============================================================================
+ * Scaling and pixel format conversion.
+ *
+ * The kernels below are written as plain loops over contiguous bytes,
+ * with restrict pointers and no data dependent branches, so that the
+ * compiler can vectorize them.
+ * ==========================================================================*/
+
+/* acc[j] += src[j] * weight, for a whole row of bytes. */
+static void accumulate_row(uint32_t *restrict acc,
+                           const unsigned char *restrict src,
+                           size_t len, uint32_t weight)
+{
+    for (size_t j = 0; j < len; j++) acc[j] += src[j] * weight;
+}
+
+/* acc[j] = acc[j] * recip >> 15, that is acc[j]/total in 8.8 fixed point
+ * when recip is 2^23/total. */
+static void normalize_row(uint32_t *restrict acc, size_t len, uint32_t recip) {
+    for (size_t j = 0; j < len; j++) acc[j] = (acc[j] * recip) >> 15;
+}
+
+/* Reduce a row of 'sw' pixels in 8.8 fixed point to 'dw' BGRA pixels. */
+static void scale_row(unsigned char *dst, const uint32_t *src, int sw, int dw) {
+    int c = 0;
+    for (int x = 0; x < dw; x++) {
+        int64_t x1 = (int64_t)(x+1)*sw, x0 = x1-sw;
+        uint32_t sum[4] = {0};
+        for (; c < sw; c++) {
+            int64_t a = (int64_t)c*dw, b = a+dw;
+            uint32_t w = (b < x1 ? b : x1) - (a > x0 ? a : x0);
+            for (int k = 0; k < 4; k++) sum[k] += src[c*4+k] * w;
+            if (b >= x1) {
+                if (b == x1) c++;
+                break; /* Otherwise the pixel is shared with the next one. */
+            }
+        }
+        for (int k = 0; k < 4; k++)
+            dst[x*4+k] = (sum[k] + (uint32_t)sw*128) / ((uint32_t)sw*256);
+    }
+}
+
+/* Return a new frame that is the source frame downscaled to the given
+ * width, keeping the aspect ratio. Every destination pixel is the
+ * average of the source area it covers (box filter with fractional
+ * coverage at the edges), which is what looks right for text.
+ *
+ * We work in a coordinate system where source pixel c covers
+ * [c*dw, (c+1)*dw) and destination pixel x covers [x*sw, (x+1)*sw):
+ * all the boundaries are integers and the weights are exact.
+ *
+ * Rows are processed vertically first: every destination row is the
+ * weighted sum of a few whole source rows, so most of the work is done
+ * by accumulate_row() on long contiguous buffers. Only then the single
+ * accumulated row is reduced horizontally. */
+Frame *frameScale(const Frame *src, int width) {
+    int sw = src->width, sh = src->height, dw = width;
+    int dh = ((int64_t)sh*dw + sw/2) / sw;
+    if (dh < 1) dh = 1;
+
+    Frame *dst = frameCreate(dw,dh);
+    size_t len = (size_t)sw*4;
+    uint32_t *acc = poolAlloc(len*sizeof(uint32_t));
+
+    int r = 0;
+    for (int y = 0; y < dh; y++) {
+        int64_t y1 = (int64_t)(y+1)*sh, y0 = y1-sh;
+        memset(acc,0,len*sizeof(uint32_t));
+        for (; r < sh; r++) {
+            int64_t a = (int64_t)r*dh, b = a+dh;
+            uint32_t w = (b < y1 ? b : y1) - (a > y0 ? a : y0);
+            accumulate_row(acc,src->pixels+(size_t)r*src->stride,len,w);
+            if (b >= y1) {
+                if (b == y1) r++;
+                break; /* Otherwise the row is shared with the next one. */
+            }
+        }
+        normalize_row(acc,len,(1<<23)/sh);
+        scale_row(dst->pixels+(size_t)y*dst->stride,acc,sw,dw);
+    }
+    poolFree(acc);
+    return dst;
+}
+
+/* Convert a row of opaque BGRA pixels to RGB. */
+void frameRowToRGB(unsigned char *restrict dst,
+                   const unsigned char *restrict src, int width)
+{
+    for (int x = 0; x < width; x++) {
+        dst[x*3] = src[x*4+2];
+        dst[x*3+1] = src[x*4+1];
+        dst[x*3+2] = src[x*4];
+    }
+}
+
+/* Convert a row of BGRA pixels to 8 bit luma (BT.601 weights). */
+void frameRowToGray(unsigned char *restrict dst,
+                    const unsigned char *restrict src, int width)
+{
+    for (int x = 0; x < width; x++)
+        dst[x] = (77*src[x*4+2] + 150*src[x*4+1] + 29*src[x*4] + 128) >> 8;
+}
+
+/* ============================================================================
+ * Cropping.
+ * ==========================================================================*/
+
+#define CROP_MAX_BORDER 4       /* Uniform lines at the edges we take as
+                                   window border. */
+#define CROP_MAX_TITLEBAR 64    /* Max height of the title bar we remove. */
+
+/* Crop the frame in place to the specified rectangle, that must be
+ * inside the frame. No pixel is copied. */
+void frameCrop(Frame *f, int x, int y, int width, int height) {
+    f->pixels += (size_t)y*f->stride + (size_t)x*4;
+    f->width = width;
+    f->height = height;
+}
+
+static uint32_t load_pixel(const unsigned char *p) {
+    uint32_t v;
+    memcpy(&v,p,4);
+    return v;
+}
+
+/* A pixel is blank if it has the background color or is fully transparent,
+ * like the rounded corners of macOS windows. */
+static int pixel_is_blank(const unsigned char *p, uint32_t bg) {
+    return load_pixel(p) == bg || p[3] == 0;
+}
+
+/* Return 1 if the pixels from x0 to x1 (excluded) of row y are blank. */
+static int row_is_blank(const Frame *f, int y, int x0, int x1, uint32_t bg) {
+    const unsigned char *p = f->pixels + (size_t)y*f->stride;
+    for (int x = x0; x < x1; x++)
+        if (!pixel_is_blank(p+x*4,bg)) return 0;
+    return 1;
+}
+
+/* Return 1 if no pixel of row y has the background color. */
+static int row_lacks_color(const Frame *f, int y, uint32_t bg) {
+    const unsigned char *p = f->pixels + (size_t)y*f->stride;
+    for (int x = 0; x < f->width; x++)
+        if (load_pixel(p+x*4) == bg) return 0;
+    return 1;
+}
+
+/* Return 1 if row y (or column y if 'col' is true) is a single color,
+ * different from the background: a window border. */
+static int line_is_border(const Frame *f, int y, int col, uint32_t bg) {
+    int len = col ? f->height : f->width;
+    size_t step = col ? (size_t)f->stride : 4;
+    const unsigned char *p = f->pixels + (col ? (size_t)y*4 : (size_t)y*f->stride);
+    int j = 0;
+    while (j < len && p[j*step+3] == 0) j++; /* Skip rounded corners. */
+    if (j == len) return 0;
+    uint32_t color = load_pixel(p+j*step);
+    if (color == bg) return 0;
+    for (; j < len; j++)
+        if (load_pixel(p+j*step) != color && p[j*step+3] != 0) return 0;
+    return 1;
+}
+
+/* Guess the background color: the most common color of a row near the
+ * bottom, where terminals have at least some padding. Boyer-Moore
+ * majority vote, then a second pass to check we really have a majority.
+ * Return 0 if no color covers most of the row. */
+static int frame_background(const Frame *f, uint32_t *bg) {
+    int y = f->height - 1 - (f->height > 8 ? 4 : 0);
+    const unsigned char *p = f->pixels + (size_t)y*f->stride;
+    uint32_t candidate = 0;
+    int votes = 0, count = 0, total = 0;
+
+    for (int x = 0; x < f->width; x++) {
+        if (p[x*4+3] == 0) continue;
+        uint32_t v = load_pixel(p+x*4);
+        if (votes == 0) candidate = v;
+        votes += v == candidate ? 1 : -1;
+    }
+    for (int x = 0; x < f->width; x++) {
+        if (p[x*4+3] == 0) continue;
+        total++;
+        if (load_pixel(p+x*4) == candidate) count++;
+    }
+    *bg = candidate;
+    return count*2 > total;
+}
+
+/* Remove the blank background areas at the edges of the frame, keeping
+ * 'margin' pixels around the content. The bottom of the frame is scanned
+ * first since it's where an empty terminal has most of its blank space.
+ *
+ * Window chrome is removed as well: uniform border lines at the edges,
+ * and at the top a title bar, detected as rows without any background
+ * pixel followed by the terminal padding. A line of text always has some
+ * background between the glyphs, so it is not mistaken for a title bar. */
+void frameAutoCrop(Frame *f, int margin) {
+    int w = f->width, h = f->height;
+    uint32_t bg;
+    if (w < 16 || h < 16 || !frame_background(f,&bg)) return;
+
+    /* Chrome: borders and title bar. The content can't go past them even
+     * when adding the margin. */
+    int minx = 0, maxx = w, miny = 0, maxy = h;
+    while (maxy-miny > 1 && h-maxy < CROP_MAX_BORDER && line_is_border(f,maxy-1,0,bg)) maxy--;
+    while (maxy-miny > 1 && miny < CROP_MAX_BORDER && line_is_border(f,miny,0,bg)) miny++;
+    while (maxx-minx > 1 && w-maxx < CROP_MAX_BORDER && line_is_border(f,maxx-1,1,bg)) maxx--;
+    while (maxx-minx > 1 && minx < CROP_MAX_BORDER && line_is_border(f,minx,1,bg)) minx++;
+
+    int title = miny;
+    while (title < maxy && title-miny < CROP_MAX_TITLEBAR && row_lacks_color(f,title,bg))
+        title++;
+    if (title > miny && title < maxy && row_is_blank(f,title,minx,maxx,bg))
+        miny = title;
+
+    /* Blank rows, bottom up and then top down. */
+    int bottom = maxy, top = miny;
+    while (bottom > top && row_is_blank(f,bottom-1,minx,maxx,bg)) bottom--;
+    if (bottom == top) return; /* Nothing but background. */
+    while (row_is_blank(f,top,minx,maxx,bg)) top++;
+
+    /* Blank columns: find the leftmost and rightmost content pixels. */
+    int left = maxx, right = minx;
+    for (int y = top; y < bottom; y++) {
+        const unsigned char *p = f->pixels + (size_t)y*f->stride;
+        int x;
+        for (x = minx; x < left; x++)
+            if (!pixel_is_blank(p+x*4,bg)) { left = x; break; }
+        for (x = maxx-1; x >= right; x--)
+            if (!pixel_is_blank(p+x*4,bg)) { right = x+1; break; }
+    }
+
+    left = left-margin > minx ? left-margin : minx;
+    right = right+margin < maxx ? right+margin : maxx;
+    top = top-margin > miny ? top-margin : miny;
+    bottom = bottom+margin < maxy ? bottom+margin : maxy;
+    frameCrop(f,left,top,right-left,bottom-top);
+}
+
+/* Compare function for qsort() of ints. */
+static int cmp_int(const void *a, const void *b) {
+    return *(const int*)a - *(const int*)b;
+}
+
+/* Crop the frame to its last 'lines' lines of text, plus 'margin' pixels.
+ *
+ * We don't know the terminal font size, so we look at the bands of rows
+ * with content (text lines, separated by blank rows), scanning bottom up.
+ * The line height is estimated as the median distance between the start
+ * of consecutive bands. Then we take 'lines' line heights above the
+ * last band, moving the cut up to a blank row if we are in the middle of
+ * some glyph. Using the estimated height, instead of just counting bands,
+ * makes empty lines count as lines too. */
+void frameTail(Frame *f, int lines, int margin) {
+    uint32_t bg;
+    frameAutoCrop(f,margin);
+    if (lines <= 0 || !frame_background(f,&bg)) return;
+
+    int tops[64], numtops = 0;
+    int last = f->height; /* Bottom of the last band, excluded. */
+    while (last > 0 && row_is_blank(f,last-1,0,f->width,bg)) last--;
+    if (last == 0) return;
+
+    int in_band = 0;
+    for (int y = last-1; y >= 0 && numtops < 64; y--) {
+        int blank = row_is_blank(f,y,0,f->width,bg);
+        if (!blank) in_band = 1;
+        if (in_band && (blank || y == 0)) {
+            tops[numtops++] = blank ? y+1 : y;
+            in_band = 0;
+        }
+    }
+    if (numtops <= lines) return; /* Less lines than requested. */
+
+    int top;
+    if (numtops >= 3) {
+        int dist[63];
+        for (int j = 0; j < numtops-1; j++) dist[j] = tops[j]-tops[j+1];
+        qsort(dist,numtops-1,sizeof(int),cmp_int);
+        int pitch = dist[(numtops-1)/2];
+        top = last - lines*pitch;
+        for (int j = 0; top > 0 && j < pitch/2; j++, top--)
+            if (row_is_blank(f,top,0,f->width,bg)) break;
+        if (top < 0) top = 0;
+    } else {
+        top = tops[lines-1];
+    }
+
+    top = top-margin > 0 ? top-margin : 0;
+    frameCrop(f,0,top,f->width,f->height-top);
+}
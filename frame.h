@@ -0,0 +1,26 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <stdint.h>
+
+/* A captured window image. Pixels are 32 bit BGRA with premultiplied
+ * alpha, that is the native format of Core Graphics bitmap contexts on
+ * little endian machines (B, G, R, A byte order in memory). */
+typedef struct Frame {
+    int width;              /* Width in pixels. */
+    int height;             /* Height in pixels. */
+    int stride;             /* Bytes per row. */
+    unsigned char *pixels;  /* First pixel of the first row. After
+                               frameCrop() it points inside the frame. */
+} Frame;
+
+Frame *frameCreate(int width, int height);
+void frameFree(Frame *f);
+Frame *frameScale(const Frame *src, int width);
+void frameCrop(Frame *f, int x, int y, int width, int height);
+void frameAutoCrop(Frame *f, int margin);
+void frameTail(Frame *f, int lines, int margin);
+void frameRowToRGB(unsigned char *restrict dst, const unsigned char *restrict src, int width);
+void frameRowToGray(unsigned char *restrict dst, const unsigned char *restrict src, int width);
+
+#endif
@@ -0,0 +1,178 @@
+/* ============================================================================
+ * Metrics endpoint.
+ *
+ * With --metrics-port the counters and latency histograms of stats.c are
+ * served on localhost in the Prometheus text format, for a scraper or a
+ * quick curl. A single thread accepts one connection at a time, ignores
+ * the request, and answers with the page: scrapes are rare and the page
+ * is small, so there is no need for anything more. The page is built from
+ * atomic loads only, so a scrape never takes a lock the requests use.
+ * ==========================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "metrics.h"
+#include "stats.h"
+#include "xmalloc.h"
+
+#define METRICS_PREFIX "tgterm_"
+#define METRICS_TIMEOUT 2       /* Seconds to wait for the request. */
+
+static int ListenFd = -1;
+
+/* Upper bounds of the histogram buckets exported, in seconds. The
+ * histograms are much finer, these are what dashboards need. */
+static const double Buckets[] = {
+    0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5,
+    1, 2.5, 5, 10, 30, 60
+};
+
+static int compare_counters(const void *a, const void *b) {
+    return strcmp((*(StatsCounter **)a)->name, (*(StatsCounter **)b)->name);
+}
+
+/* Length of the metric name, without the labels. */
+static size_t family_len(const char *name) {
+    return strcspn(name, "{");
+}
+
+/* Append the counters and gauges, sorted so that the lines of a metric
+ * with different labels are together, as the format requires. */
+static sds render_counters(sds out) {
+    int count;
+    StatsCounter **list = statsCounterList(&count);
+    StatsCounter **sorted = xmalloc(sizeof(*sorted) * (count ? count : 1));
+    memcpy(sorted, list, sizeof(*sorted) * count);
+    qsort(sorted, count, sizeof(*sorted), compare_counters);
+
+    for (int j = 0; j < count; j++) {
+        const char *name = sorted[j]->name;
+        size_t len = family_len(name);
+        if (j == 0 || len != family_len(sorted[j-1]->name) ||
+            memcmp(name, sorted[j-1]->name, len) != 0)
+        {
+            int counter = len > 6 && memcmp(name + len - 6, "_total", 6) == 0;
+            out = sdscatprintf(out, "# TYPE " METRICS_PREFIX "%.*s %s\n",
+                               (int)len, name, counter ? "counter" : "gauge");
+        }
+        out = sdscatprintf(out, METRICS_PREFIX "%s %lld\n", name,
+            (long long)atomic_load_explicit(&sorted[j]->value, memory_order_relaxed));
+    }
+    xfree(sorted);
+    return out;
+}
+
+/* Append the histograms, as a single metric with the name as label. */
+static sds render_histograms(sds out) {
+    int count;
+    StatsHist **list = statsList(&count);
+    StatsSnapshot snap;
+    out = sdscat(out, "# TYPE " METRICS_PREFIX "latency_seconds histogram\n");
+    for (int j = 0; j < count; j++) {
+        statsSnapshot(list[j], &snap);
+        /* A bucket of the histogram is counted in the first exported
+         * bucket holding its longest duration. */
+        uint64_t cumulative = 0;
+        int b = 0;
+        for (size_t k = 0; k < sizeof(Buckets)/sizeof(Buckets[0]); k++) {
+            while (b < STATS_BUCKETS && statsBucketMax(b) <= Buckets[k] * 1e6)
+                cumulative += snap.buckets[b++];
+            out = sdscatprintf(out, METRICS_PREFIX "latency_seconds_bucket"
+                               "{name=\"%s\",le=\"%g\"} %llu\n", list[j]->name,
+                               Buckets[k], (unsigned long long)cumulative);
+        }
+        out = sdscatprintf(out,
+            METRICS_PREFIX "latency_seconds_bucket{name=\"%s\",le=\"+Inf\"} %llu\n"
+            METRICS_PREFIX "latency_seconds_sum{name=\"%s\"} %.6f\n"
+            METRICS_PREFIX "latency_seconds_count{name=\"%s\"} %llu\n",
+            list[j]->name, (unsigned long long)snap.count,
+            list[j]->name, snap.sum / 1e6,
+            list[j]->name, (unsigned long long)snap.count);
+    }
+    return out;
+}
+
+/* Write all of 'buf', returning -1 on error. */
+static int write_all(int fd, const char *buf, size_t len) {
+    while (len) {
+        ssize_t n = write(fd, buf, len);
+        if (n <= 0) return -1;
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static void *metrics_main(void *arg) {
+    (void)arg;
+    while (1) {
+        int fd = accept(ListenFd, NULL, NULL);
+        if (fd == -1) continue;
+
+        /* Read the request before answering, or closing the connection
+         * with unread data would reset it. A client sending nothing
+         * can't hold the thread longer than the timeout. */
+        struct timeval tv = {METRICS_TIMEOUT, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        char buf[4096];
+        if (read(fd, buf, sizeof(buf)) <= 0) {
+            close(fd);
+            continue;
+        }
+
+        sds body = render_histograms(render_counters(sdsempty()));
+        sds reply = sdscatprintf(sdsempty(),
+            "HTTP/1.0 200 OK\r\n"
+            "Content-Type: text/plain; version=0.0.4\r\n"
+            "Content-Length: %zu\r\n"
+            "Connection: close\r\n\r\n", sdslen(body));
+        reply = sdscatsds(reply, body);
+        write_all(fd, reply, sdslen(reply));
+        sdsfree(body);
+        sdsfree(reply);
+        close(fd);
+    }
+    return NULL;
+}
+
+/* Serve the metrics on 127.0.0.1:port. Returns 0 on success, -1 on
+ * error. */
+int metricsStart(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd == -1) return -1;
+    int yes = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+    struct sockaddr_in sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(port);
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) == -1 ||
+        listen(fd, 16) == -1)
+    {
+        close(fd);
+        return -1;
+    }
+
+    /* A scraper closing the connection early must not kill the bot. */
+    signal(SIGPIPE, SIG_IGN);
+
+    ListenFd = fd;
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, metrics_main, NULL) != 0) {
+        close(fd);
+        return -1;
+    }
+    pthread_detach(tid);
+    return 0;
+}
@@ -0,0 +1,6 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+int metricsStart(int port);
+
+#endif
@@ -0,0 +1,178 @@
+/* ============================================================================
+ * Pipeline of stages running in their own threads.
+ *
+ * Jobs enter the first stage with pipelineSubmit() and flow from stage to
+ * stage through bounded queues, so while a stage is working on a job the
+ * previous stage can already work on the next one. The job itself is just
+ * a pointer passed along: buffers are handed off, never copied. When a
+ * queue is full the stage feeding it blocks, so a slow stage slows down
+ * the whole pipeline instead of letting jobs pile up in memory.
+ * ==========================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pipeline.h"
+#include "trace.h"
+#include "alloc.h"
+#include "xmalloc.h"
+
+static void queue_init(PipelineQueue *q, int size) {
+    q->jobs = xmalloc(sizeof(void*) * size);
+    q->size = size;
+    q->head = 0;
+    q->len = 0;
+    q->maxlen = 0;
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->notempty, NULL);
+    pthread_cond_init(&q->notfull, NULL);
+}
+
+/* Append a job to the queue, waiting for room if it is full. */
+static void queue_push(PipelineQueue *q, void *job) {
+    pthread_mutex_lock(&q->lock);
+    while (q->len == q->size) pthread_cond_wait(&q->notfull, &q->lock);
+    q->jobs[(q->head + q->len) % q->size] = job;
+    q->len++;
+    if (q->len > q->maxlen) q->maxlen = q->len;
+    statsAdd(q->depth, 1);
+    pthread_cond_signal(&q->notempty);
+    pthread_mutex_unlock(&q->lock);
+}
+
+/* Remove the oldest job from the queue, waiting for one if it is empty.
+ * Must be called with the queue lock held. */
+static void *queue_pop_locked(PipelineQueue *q) {
+    while (q->len == 0) pthread_cond_wait(&q->notempty, &q->lock);
+    void *job = q->jobs[q->head];
+    q->head = (q->head + 1) % q->size;
+    q->len--;
+    statsAdd(q->depth, -1);
+    pthread_cond_signal(&q->notfull);
+    return job;
+}
+
+/* Stage thread: process jobs forever, passing them to the next stage. */
+static void *stage_main(void *arg) {
+    PipelineStage *s = arg;
+    Pipeline *p = s->pipeline;
+    PipelineStage *next = s->index+1 < p->numstages ? &p->stages[s->index+1] : NULL;
+    uint64_t busy = 0, blocked = 0;
+    int processed = 0;
+
+    traceThreadName(s->name);
+    allocSetSubsystem(s->name);
+    while (1) {
+        /* Statistics are published while we hold the lock anyway to get
+         * the next job, so they cost no additional synchronization. */
+        pthread_mutex_lock(&s->queue.lock);
+        s->jobs += processed;
+        s->busy_us += busy;
+        s->blocked_us += blocked;
+        void *job = queue_pop_locked(&s->queue);
+        pthread_mutex_unlock(&s->queue.lock);
+
+        if (p->job_trace) slowlogAttach(p->job_trace(job));
+        uint64_t start = statsUstime();
+        int done = s->proc(job);
+        uint64_t end = statsUstime();
+        busy = end - start;
+        processed = 1;
+        statsRecord(s->latency, busy);
+        slowlogAttach(NULL);
+
+        if (done || !next) {
+            p->free_job(job);
+            blocked = 0;
+        } else {
+            queue_push(&next->queue, job);
+            blocked = statsUstime() - end;
+        }
+    }
+    return NULL;
+}
+
+/* Create an empty pipeline. Every queue between stages holds at most
+ * 'queuelen' jobs. 'free_job' is called for every job leaving the
+ * pipeline, either after the last stage or because a stage was done
+ * with it. If 'job_trace' is not NULL, stages attach the slow log trace
+ * it returns while working on a job, so that the time the job spends in
+ * them is charged to its request. */
+Pipeline *pipelineCreate(int queuelen, PipelineFreeProc free_job,
+                         PipelineTraceProc job_trace)
+{
+    Pipeline *p = xmalloc(sizeof(*p));
+    memset(p, 0, sizeof(*p));
+    p->queuelen = queuelen;
+    p->free_job = free_job;
+    p->job_trace = job_trace;
+    return p;
+}
+
+/* Append a stage to the pipeline. Stages must be added before calling
+ * pipelineStart(). */
+void pipelineAddStage(Pipeline *p, const char *name, PipelineStageProc proc) {
+    if (p->numstages == PIPELINE_MAX_STAGES) abort();
+    PipelineStage *s = &p->stages[p->numstages];
+    s->name = name;
+    s->proc = proc;
+    s->pipeline = p;
+    s->index = p->numstages++;
+    s->latency = statsGet(name);
+    char gauge[STATS_NAME_LEN];
+    snprintf(gauge, sizeof(gauge), "pipeline_queue_depth{stage=\"%s\"}", name);
+    s->queue.depth = statsCounter(gauge);
+    queue_init(&s->queue, p->queuelen);
+}
+
+/* Start a thread for every stage. Returns 0 on success, -1 on error. */
+int pipelineStart(Pipeline *p) {
+    p->start_us = statsUstime();
+    for (int j = 0; j < p->numstages; j++) {
+        PipelineStage *s = &p->stages[j];
+        if (pthread_create(&s->thread, NULL, stage_main, s) != 0) return -1;
+        pthread_detach(s->thread);
+    }
+    return 0;
+}
+
+/* Add a job to the first stage queue. Blocks if the queue is full. */
+void pipelineSubmit(Pipeline *p, void *job) {
+    queue_push(&p->stages[0].queue, job);
+}
+
+/* Add a job directly to the queue of the specified stage, skipping the
+ * previous ones. Stages can use it to create new jobs on the fly. Blocks
+ * if the queue is full. */
+void pipelinePush(Pipeline *p, int stage, void *job) {
+    queue_push(&p->stages[stage].queue, job);
+}
+
+/* Return a report of the work done by every stage, so that the stage
+ * limiting the throughput is easy to spot: it is the one with the highest
+ * utilization, while the stages before it spend time blocked on a full
+ * queue. */
+sds pipelineInfo(Pipeline *p) {
+    uint64_t elapsed = statsUstime() - p->start_us;
+    if (elapsed == 0) elapsed = 1;
+
+    sds info = sdsempty();
+    for (int j = 0; j < p->numstages; j++) {
+        PipelineStage *s = &p->stages[j];
+        pthread_mutex_lock(&s->queue.lock);
+        uint64_t jobs = s->jobs, busy = s->busy_us, blocked = s->blocked_us;
+        int len = s->queue.len, maxlen = s->queue.maxlen;
+        pthread_mutex_unlock(&s->queue.lock);
+
+        info = sdscatprintf(info,
+            "%s: %llu jobs, %.1f ms avg, %.1f%% busy, %.1f%% blocked, "
+            "queue %d/%d (max %d)\n",
+            s->name, (unsigned long long)jobs,
+            jobs ? (double)busy / jobs / 1000 : 0.0,
+            (double)busy * 100 / elapsed,
+            (double)blocked * 100 / elapsed,
+            len, s->queue.size, maxlen);
+    }
+    return info;
+}
@@ -0,0 +1,64 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "sds.h"
+#include "stats.h"
+#include "slowlog.h"
+
+#define PIPELINE_MAX_STAGES 8
+
+/* A stage processes a job and returns 0 to pass it to the next stage, or
+ * non zero if the job is done (or failed) and should be released. */
+typedef int (*PipelineStageProc)(void *job);
+typedef void (*PipelineFreeProc)(void *job);
+/* Returns the slow log trace of the request a job works for, or NULL. */
+typedef SlowlogTrace *(*PipelineTraceProc)(void *job);
+
+/* Bounded FIFO of jobs between two stages. */
+typedef struct PipelineQueue {
+    void **jobs;            /* Circular buffer of 'size' jobs. */
+    int size;               /* Max number of jobs queued. */
+    int head;               /* Index of the oldest job. */
+    int len;                /* Number of jobs queued. */
+    int maxlen;             /* Max 'len' ever reached. */
+    StatsCounter *depth;    /* Gauge of 'len', read without the lock. */
+    pthread_mutex_t lock;
+    pthread_cond_t notempty;
+    pthread_cond_t notfull;
+} PipelineQueue;
+
+typedef struct PipelineStage {
+    const char *name;
+    PipelineStageProc proc;
+    PipelineQueue queue;    /* Jobs waiting for this stage. */
+    pthread_t thread;
+    struct Pipeline *pipeline;
+    int index;              /* Position of the stage in the pipeline. */
+    /* Statistics, protected by queue.lock. */
+    uint64_t jobs;          /* Jobs processed. */
+    uint64_t busy_us;       /* Time spent inside 'proc'. */
+    uint64_t blocked_us;    /* Time waiting for room in the next queue. */
+    StatsHist *latency;     /* Time of every job inside 'proc'. */
+} PipelineStage;
+
+typedef struct Pipeline {
+    PipelineStage stages[PIPELINE_MAX_STAGES];
+    int numstages;
+    int queuelen;               /* Size of every queue. */
+    PipelineFreeProc free_job;  /* Called when a job leaves the pipeline. */
+    PipelineTraceProc job_trace; /* Trace stages attach, or NULL. */
+    uint64_t start_us;          /* When the pipeline was started. */
+} Pipeline;
+
+Pipeline *pipelineCreate(int queuelen, PipelineFreeProc free_job,
+                         PipelineTraceProc job_trace);
+void pipelineAddStage(Pipeline *p, const char *name, PipelineStageProc proc);
+int pipelineStart(Pipeline *p);
+void pipelineSubmit(Pipeline *p, void *job);
+void pipelinePush(Pipeline *p, int stage, void *job);
+sds pipelineInfo(Pipeline *p);
+
+#endif
@@ -0,0 +1,496 @@
+/* ============================================================================
+ * PNG encoder for terminal screenshots.
+ *
+ * Terminal windows usually contain a handful of colors, so writing them as
+ * 32 bit RGBA like a general purpose encoder does is a waste. In automatic
+ * mode we try, in order:
+ *
+ * 1. An exact palette, when the image has at most 256 distinct colors. The
+ *    bit depth is the smallest of 1, 2, 4, 8 that can index the palette.
+ * 2. A median cut palette of 256 colors, when the number of distinct colors
+ *    is moderate, as it happens with anti-aliased text.
+ * 3. Truecolor RGB or RGBA, for graphical output where quantization would
+ *    do too much damage.
+ *
+ * The caller can ask for smaller palettes, down to 2 colors, trading
+ * quality for size on slow links.
+ *
+ * The grayscale and 1 bit modes are for text sessions where colors don't
+ * matter and the smallest possible upload is preferred.
+ * ==========================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <zlib.h>
+
+#include "png.h"
+#include "pool.h"
+
+#define PNG_MAX_PALETTE 256
+#define PNG_QUANT_MAX_COLORS 8192   /* With more colors we go truecolor. */
+#define PNG_HASH_BITS 14            /* 16384 slots: 2x the above. */
+#define PNG_HASH_SIZE (1<<PNG_HASH_BITS)
+
+#define PNG_TYPE_GRAY 0
+#define PNG_TYPE_RGB 2
+#define PNG_TYPE_INDEXED 3
+#define PNG_TYPE_RGBA 6
+
+/* Color histogram entry. Colors are packed as 0xAARRGGBB. */
+typedef struct ColorEntry {
+    uint32_t color;
+    uint32_t count;     /* Number of pixels. Zero means empty slot. */
+    int index;          /* Palette index the color maps to. */
+} ColorEntry;
+
+/* A median cut box: a range of the colors array, plus the channel with
+ * the widest range of values inside the box. */
+typedef struct ColorBox {
+    int start, end;
+    int shift;          /* Channel as bit shift inside the packed color. */
+    int range;          /* Max - min of the channel inside the box. */
+} ColorBox;
+
+/* ============================================================================
+ * Color analysis and quantization
+ * ==========================================================================*/
+
+static uint32_t pixel_color(const unsigned char *p) {
+    return (uint32_t)p[3]<<24 | (uint32_t)p[2]<<16 | (uint32_t)p[1]<<8 | p[0];
+}
+
+static ColorEntry *color_lookup(ColorEntry *table, uint32_t color) {
+    uint32_t h = (color * 2654435761u) >> (32-PNG_HASH_BITS);
+    while (table[h].count && table[h].color != color)
+        h = (h+1) & (PNG_HASH_SIZE-1);
+    return &table[h];
+}
+
+/* Populate the histogram with the image colors. Return the number of
+ * distinct colors, or -1 if there are more than 'max'. */
+static int color_histogram(const Frame *f, ColorEntry *table, int max) {
+    int colors = 0;
+    for (int y = 0; y < f->height; y++) {
+        const unsigned char *p = f->pixels + (size_t)y*f->stride;
+        ColorEntry *e = NULL;
+        for (int x = 0; x < f->width; x++, p += 4) {
+            uint32_t c = pixel_color(p);
+            /* Terminal rows are mostly long runs of the same color:
+             * avoid hashing when nothing changed. */
+            if (e == NULL || e->color != c) {
+                e = color_lookup(table,c);
+                if (e->count == 0) {
+                    if (colors == max) return -1;
+                    e->color = c;
+                    colors++;
+                }
+            }
+            e->count++;
+        }
+    }
+    return colors;
+}
+
+/* Give every color of the histogram its own palette entry. */
+static int exact_palette(ColorEntry *table, uint32_t *palette) {
+    int colors = 0;
+    for (int j = 0; j < PNG_HASH_SIZE; j++) {
+        if (table[j].count == 0) continue;
+        table[j].index = colors;
+        palette[colors++] = table[j].color;
+    }
+    return colors;
+}
+
+/* Find the channel with the widest range inside the box. */
+static void box_measure(ColorEntry **colors, ColorBox *b) {
+    b->range = -1;
+    for (int shift = 0; shift < 32; shift += 8) {
+        int min = 255, max = 0;
+        for (int j = b->start; j < b->end; j++) {
+            int v = (colors[j]->color >> shift) & 0xff;
+            if (v < min) min = v;
+            if (v > max) max = v;
+        }
+        if (max-min > b->range) {
+            b->range = max-min;
+            b->shift = shift;
+        }
+    }
+}
+
+/* Sort the box by its widest channel (counting sort, the channel has
+ * just 256 possible values), then split it at the pixel-weighted median,
+ * storing the upper half in 'nb'. */
+static void box_split(ColorEntry **colors, ColorEntry **tmp, ColorBox *b,
+                      ColorBox *nb)
+{
+    int pos[257] = {0};
+    uint64_t total = 0, acc = 0;
+
+    for (int j = b->start; j < b->end; j++) {
+        pos[((colors[j]->color >> b->shift) & 0xff)+1]++;
+        total += colors[j]->count;
+    }
+    for (int j = 1; j < 257; j++) pos[j] += pos[j-1];
+    for (int j = b->start; j < b->end; j++)
+        tmp[pos[(colors[j]->color >> b->shift) & 0xff]++] = colors[j];
+    memcpy(colors+b->start,tmp,sizeof(ColorEntry*)*(b->end-b->start));
+
+    int mid;
+    for (mid = b->start; mid < b->end-2; mid++) {
+        acc += colors[mid]->count;
+        if (acc*2 >= total) break;
+    }
+    nb->start = mid+1;
+    nb->end = b->end;
+    b->end = mid+1;
+    box_measure(colors,b);
+    box_measure(colors,nb);
+}
+
+/* Median cut quantization of the 'numcolors' colors of the histogram
+ * into at most 'maxcolors' palette entries. Every histogram entry gets
+ * the index of the palette entry it maps to. Return the palette size. */
+static int quantize(ColorEntry *table, int numcolors, uint32_t *palette,
+                    int maxcolors)
+{
+    ColorEntry **colors = poolAlloc(sizeof(ColorEntry*)*numcolors);
+    ColorEntry **tmp = poolAlloc(sizeof(ColorEntry*)*numcolors);
+    ColorBox boxes[PNG_MAX_PALETTE];
+    int numboxes = 1;
+
+    for (int j = 0, k = 0; j < PNG_HASH_SIZE; j++)
+        if (table[j].count) colors[k++] = &table[j];
+    boxes[0].start = 0;
+    boxes[0].end = numcolors;
+    box_measure(colors,&boxes[0]);
+
+    /* Always split the box with the widest channel range. */
+    while (numboxes < maxcolors) {
+        int best = -1;
+        for (int j = 0; j < numboxes; j++) {
+            if (boxes[j].end - boxes[j].start < 2) continue;
+            if (best == -1 || boxes[j].range > boxes[best].range) best = j;
+        }
+        if (best == -1 || boxes[best].range == 0) break;
+        box_split(colors,tmp,&boxes[best],&boxes[numboxes]);
+        numboxes++;
+    }
+
+    /* Every box becomes the pixel-weighted average of its colors. */
+    for (int j = 0; j < numboxes; j++) {
+        uint64_t sum[4] = {0}, total = 0;
+        for (int k = boxes[j].start; k < boxes[j].end; k++) {
+            ColorEntry *e = colors[k];
+            for (int c = 0; c < 4; c++)
+                sum[c] += (uint64_t)((e->color >> (c*8)) & 0xff) * e->count;
+            total += e->count;
+            e->index = j;
+        }
+        palette[j] = 0;
+        for (int c = 0; c < 4; c++)
+            palette[j] |= (uint32_t)((sum[c] + total/2) / total) << (c*8);
+    }
+    poolFree(colors);
+    poolFree(tmp);
+    return numboxes;
+}
+
+/* ============================================================================
+ * Pixel conversion
+ * ==========================================================================*/
+
+/* Frames use premultiplied alpha, PNG wants straight alpha. */
+static unsigned char unpremultiply(unsigned char c, unsigned char a) {
+    if (a == 0 || a == 255) return c;
+    return (c*255 + a/2) / a;
+}
+
+static int frame_is_opaque(const Frame *f) {
+    for (int y = 0; y < f->height; y++) {
+        const unsigned char *p = f->pixels + (size_t)y*f->stride;
+        for (int x = 0; x < f->width; x++)
+            if (p[x*4+3] != 255) return 0;
+    }
+    return 1;
+}
+
+/* Otsu's method: the luma threshold that best separates the two classes
+ * of pixels, text and background. */
+static int mono_threshold(const Frame *f, unsigned char *gray) {
+    uint64_t hist[256] = {0}, total = 0, sum = 0;
+    for (int y = 0; y < f->height; y++) {
+        frameRowToGray(gray,f->pixels + (size_t)y*f->stride,f->width);
+        for (int x = 0; x < f->width; x++) hist[gray[x]]++;
+    }
+    for (int j = 0; j < 256; j++) {
+        total += hist[j];
+        sum += (uint64_t)j*hist[j];
+    }
+
+    uint64_t wb = 0, sumb = 0;
+    double best = -1;
+    int threshold = 127;
+    for (int j = 0; j < 256; j++) {
+        wb += hist[j];
+        if (wb == 0) continue;
+        if (wb == total) break;
+        sumb += (uint64_t)j*hist[j];
+        double mb = (double)sumb/wb;
+        double mf = (double)(sum-sumb)/(total-wb);
+        double between = (double)wb*(total-wb)*(mb-mf)*(mb-mf);
+        if (between > best) {
+            best = between;
+            threshold = j;
+        }
+    }
+    return threshold;
+}
+
+/* ============================================================================
+ * Filtering and compression
+ * ==========================================================================*/
+
+static unsigned char paeth(int a, int b, int c) {
+    int p = a+b-c;
+    int pa = abs(p-a), pb = abs(p-b), pc = abs(p-c);
+    if (pa <= pb && pa <= pc) return a;
+    if (pb <= pc) return b;
+    return c;
+}
+
+/* Filter 'row' with the given PNG filter type into 'out'. 'bpp' is the
+ * number of bytes per complete pixel (at least 1). Return the sum of
+ * the absolute values of the output bytes taken as signed. */
+static uint64_t filter_row(int type, const unsigned char *row,
+                           const unsigned char *prev, size_t len, int bpp,
+                           unsigned char *out)
+{
+    uint64_t sum = 0;
+    for (size_t j = 0; j < len; j++) {
+        int a = j >= (size_t)bpp ? row[j-bpp] : 0;
+        int b = prev[j];
+        int c = j >= (size_t)bpp ? prev[j-bpp] : 0;
+        unsigned char v = row[j];
+        switch(type) {
+        case 1: v -= a; break;
+        case 2: v -= b; break;
+        case 3: v -= (a+b)/2; break;
+        case 4: v -= paeth(a,b,c); break;
+        }
+        out[j] = v;
+        sum += v < 128 ? v : 256-v;
+    }
+    return sum;
+}
+
+/* Deflate 'len' bytes appending the compressed output to *out. */
+/* zlib allocates about 300 KB of state for every stream: take it from
+ * the pool as well. */
+static voidpf zlib_alloc(voidpf opaque, uInt items, uInt size) {
+    (void)opaque;
+    return poolAlloc((size_t)items*size);
+}
+
+static void zlib_free(voidpf opaque, voidpf ptr) {
+    (void)opaque;
+    poolFree(ptr);
+}
+
+/* Compress 'len' bytes into the stream output buffer. The buffer is sized
+ * with deflateBound() for the whole image, so it never fills up. */
+static void compress_data(z_stream *zs, const unsigned char *data,
+                          size_t len, int flush)
+{
+    zs->next_in = (unsigned char*)data;
+    zs->avail_in = len;
+    deflate(zs,flush);
+}
+
+static void put32(unsigned char *p, uint32_t v) {
+    p[0] = v >> 24; p[1] = v >> 16; p[2] = v >> 8; p[3] = v;
+}
+
+static sds append_chunk(sds png, const char *type, const unsigned char *data,
+                        size_t len)
+{
+    unsigned char buf[8];
+    put32(buf,len);
+    memcpy(buf+4,type,4);
+    png = sdscatlen(png,buf,8);
+    png = sdscatlen(png,data,len);
+    uLong crc = crc32(0,buf+4,4);
+    crc = crc32(crc,data,len);
+    put32(buf,crc);
+    return sdscatlen(png,buf,4);
+}
+
+/* ============================================================================
+ * Encoder
+ * ==========================================================================*/
+
+/* Encode the frame as PNG with the specified PNG_COLOR_* mode, returning
+ * the file content as an SDS string. In PNG_COLOR_AUTO mode the palette
+ * has at most 'maxcolors' entries (2 to 256). 'level' is the zlib
+ * compression level, from 1 (fastest) to 9 (smallest). */
+sds pngEncode(const Frame *f, int mode, int maxcolors, int level) {
+    uint32_t palette[PNG_MAX_PALETTE];
+    int colors = 0;             /* Palette size, zero if not indexed. */
+    ColorEntry *table = NULL;
+    int type, depth, channels = 1, threshold = 0;
+    unsigned char *gray = poolAlloc(f->width);
+
+    if (mode == PNG_COLOR_AUTO) {
+        table = poolAlloc(sizeof(ColorEntry)*PNG_HASH_SIZE);
+        memset(table,0,sizeof(ColorEntry)*PNG_HASH_SIZE);
+        int n = color_histogram(f,table,PNG_QUANT_MAX_COLORS);
+        if (maxcolors > PNG_MAX_PALETTE) maxcolors = PNG_MAX_PALETTE;
+        if (maxcolors < 2) maxcolors = 2;
+        if (n <= maxcolors && n != -1)
+            colors = exact_palette(table,palette);
+        else if (n != -1)
+            colors = quantize(table,n,palette,maxcolors);
+    }
+
+    if (colors) {
+        type = PNG_TYPE_INDEXED;
+        depth = colors <= 2 ? 1 : colors <= 4 ? 2 : colors <= 16 ? 4 : 8;
+    } else if (mode == PNG_COLOR_GRAY) {
+        type = PNG_TYPE_GRAY;
+        depth = 8;
+    } else if (mode == PNG_COLOR_MONO) {
+        type = PNG_TYPE_GRAY;
+        depth = 1;
+        threshold = mono_threshold(f,gray);
+    } else {
+        type = frame_is_opaque(f) ? PNG_TYPE_RGB : PNG_TYPE_RGBA;
+        channels = type == PNG_TYPE_RGB ? 3 : 4;
+        depth = 8;
+    }
+
+    /* Signature and header. */
+    sds png = sdsnewlen("\x89PNG\r\n\x1a\n",8);
+    unsigned char ihdr[13];
+    put32(ihdr,f->width);
+    put32(ihdr+4,f->height);
+    ihdr[8] = depth;
+    ihdr[9] = type;
+    ihdr[10] = ihdr[11] = ihdr[12] = 0;
+    png = append_chunk(png,"IHDR",ihdr,13);
+
+    if (colors) {
+        unsigned char plte[PNG_MAX_PALETTE*3], trns[PNG_MAX_PALETTE];
+        int numtrns = 0;
+        for (int j = 0; j < colors; j++) {
+            unsigned char a = palette[j] >> 24;
+            plte[j*3] = unpremultiply(palette[j] >> 16,a);
+            plte[j*3+1] = unpremultiply(palette[j] >> 8,a);
+            plte[j*3+2] = unpremultiply(palette[j],a);
+            trns[j] = a;
+            if (a != 255) numtrns = j+1;
+        }
+        png = append_chunk(png,"PLTE",plte,colors*3);
+        if (numtrns) png = append_chunk(png,"tRNS",trns,numtrns);
+    }
+
+    /* Image data. Every row is converted to the target format, then
+     * filtered. Following the PNG specification recommendation, indexed
+     * and sub-byte images are not filtered, while for the others we pick
+     * the filter minimizing the sum of absolute differences. */
+    size_t rowlen = ((size_t)f->width*channels*depth+7)/8;
+    int bpp = channels*depth >= 8 ? channels*depth/8 : 1;
+    int adaptive = !colors && depth == 8;
+    unsigned char *row = poolAlloc(rowlen);
+    unsigned char *prev = poolAlloc(rowlen);
+    unsigned char *out = poolAlloc(rowlen+1);
+    unsigned char *best = poolAlloc(rowlen+1);
+    memset(prev,0,rowlen);
+
+    z_stream zs;
+    memset(&zs,0,sizeof(zs));
+    zs.zalloc = zlib_alloc;
+    zs.zfree = zlib_free;
+    deflateInit(&zs,level);
+    size_t idatsize = deflateBound(&zs,(rowlen+1)*f->height);
+    unsigned char *idat = poolAlloc(idatsize);
+    zs.next_out = idat;
+    zs.avail_out = idatsize;
+
+    for (int y = 0; y < f->height; y++) {
+        const unsigned char *p = f->pixels + (size_t)y*f->stride;
+        if (colors || depth == 1) memset(row,0,rowlen);
+
+        if (colors) {
+            ColorEntry *e = NULL;
+            for (int x = 0; x < f->width; x++, p += 4) {
+                uint32_t c = pixel_color(p);
+                if (e == NULL || e->color != c) e = color_lookup(table,c);
+                row[x*depth/8] |= e->index << (8-depth-(x*depth)%8);
+            }
+        } else if (type == PNG_TYPE_GRAY && depth == 1) {
+            frameRowToGray(gray,p,f->width);
+            for (int x = 0; x < f->width; x++)
+                if (gray[x] > threshold) row[x/8] |= 0x80 >> (x%8);
+        } else if (type == PNG_TYPE_GRAY) {
+            frameRowToGray(row,p,f->width);
+        } else if (type == PNG_TYPE_RGB) {
+            frameRowToRGB(row,p,f->width);
+        } else {
+            for (int x = 0; x < f->width; x++, p += 4) {
+                unsigned char *d = row + (size_t)x*4;
+                d[0] = unpremultiply(p[2],p[3]);
+                d[1] = unpremultiply(p[1],p[3]);
+                d[2] = unpremultiply(p[0],p[3]);
+                d[3] = p[3];
+            }
+        }
+
+        best[0] = 0;
+        memcpy(best+1,row,rowlen);
+        if (adaptive) {
+            uint64_t minsum = filter_row(0,row,prev,rowlen,bpp,best+1);
+            for (int ft = 1; ft <= 4; ft++) {
+                uint64_t sum = filter_row(ft,row,prev,rowlen,bpp,out+1);
+                if (sum < minsum) {
+                    minsum = sum;
+                    out[0] = ft;
+                    unsigned char *t = best; best = out; out = t;
+                }
+            }
+        }
+        compress_data(&zs,best,rowlen+1,Z_NO_FLUSH);
+        unsigned char *t = prev; prev = row; row = t;
+    }
+    compress_data(&zs,NULL,0,Z_FINISH);
+    size_t idatlen = zs.total_out;
+    deflateEnd(&zs);
+
+    png = sdsMakeRoomFor(png,idatlen+24);
+    png = append_chunk(png,"IDAT",idat,idatlen);
+    png = append_chunk(png,"IEND",NULL,0);
+
+    poolFree(idat);
+    poolFree(row);
+    poolFree(prev);
+    poolFree(out);
+    poolFree(best);
+    poolFree(table);
+    poolFree(gray);
+    return png;
+}
+
+/* Encode the frame like pngEncode() and write it to the specified path.
+ * Return 0 on success, -1 on error. */
+int pngWrite(const Frame *f, int mode, int maxcolors, int level,
+             const char *path)
+{
+    sds png = pngEncode(f,mode,maxcolors,level);
+    FILE *fp = fopen(path,"w");
+    int ok = fp && fwrite(png,sdslen(png),1,fp) == 1;
+    if (fp && fclose(fp) != 0) ok = 0;
+    sdsfree(png);
+    return ok ? 0 : -1;
+}
@@ -0,0 +1,16 @@
+#ifndef PNG_H
+#define PNG_H
+
+#include "sds.h"
+#include "frame.h"
+
+/* Color modes for pngEncode(). */
+#define PNG_COLOR_AUTO 0    /* Indexed when possible, truecolor otherwise. */
+#define PNG_COLOR_GRAY 1    /* 8 bit grayscale. */
+#define PNG_COLOR_MONO 2    /* 1 bit black and white, for plain text. */
+
+sds pngEncode(const Frame *f, int mode, int maxcolors, int level);
+int pngWrite(const Frame *f, int mode, int maxcolors, int level,
+             const char *path);
+
+#endif
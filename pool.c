@@ -0,0 +1,108 @@
+/* ============================================================================
+ * Pool of reusable buffers.
+ *
+ * Every screenshot needs a multi megabyte frame, plus scaling and
+ * encoding scratch buffers. Allocating and freeing them each time means
+ * page faults to map fresh memory and a fragmented heap in a process that
+ * runs for weeks. Freed buffers are instead kept in a small cache and
+ * handed out again: since windows don't change size often, in the steady
+ * state every allocation is served from the cache.
+ * ==========================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "pool.h"
+#include "xmalloc.h"
+
+/* Every buffer is preceded by a header of POOL_ALIGN bytes, so that the
+ * buffer itself stays aligned, storing its capacity. */
+typedef struct PoolHeader {
+    size_t capacity;
+} PoolHeader;
+
+static pthread_mutex_t PoolLock = PTHREAD_MUTEX_INITIALIZER;
+static PoolHeader *FreeList[POOL_MAX_BUFFERS]; /* Cached buffers, oldest first. */
+static int NumFree = 0;
+static size_t FreeBytes = 0;
+static uint64_t Hits = 0, Misses = 0;
+
+/* Round the size up to its size class. There are four classes for every
+ * power of two, so buffers of similar size are interchangeable, wasting
+ * at most 25% of the memory. */
+static size_t size_class(size_t size) {
+    size_t pow = POOL_ALIGN;
+    while (pow < size) pow *= 2;
+    size_t step = pow/8 > POOL_ALIGN ? pow/8 : POOL_ALIGN;
+    return (size + step - 1) / step * step;
+}
+
+/* Return a POOL_ALIGN aligned buffer of at least 'size' bytes, with
+ * undefined content. Exits on out of memory, like xmalloc(). */
+void *poolAlloc(size_t size) {
+    size_t cls = size_class(size);
+    PoolHeader *h = NULL;
+
+    /* Take the smallest cached buffer big enough, but not so big that
+     * we would waste a large frame buffer for a small allocation. */
+    pthread_mutex_lock(&PoolLock);
+    int best = -1;
+    for (int j = 0; j < NumFree; j++) {
+        size_t cap = FreeList[j]->capacity;
+        if (cap < cls || cap > cls*2) continue;
+        if (best == -1 || cap < FreeList[best]->capacity) best = j;
+    }
+    if (best != -1) {
+        h = FreeList[best];
+        memmove(FreeList+best, FreeList+best+1, sizeof(h)*(NumFree-best-1));
+        NumFree--;
+        FreeBytes -= h->capacity;
+        Hits++;
+    } else {
+        Misses++;
+    }
+    pthread_mutex_unlock(&PoolLock);
+
+    if (h == NULL) {
+        h = xalignedalloc(POOL_ALIGN, POOL_ALIGN + cls);
+        h->capacity = cls;
+    } else {
+        xcharge(h, NULL);
+    }
+    return (char*)h + POOL_ALIGN;
+}
+
+/* Return a buffer obtained with poolAlloc() to the pool. When the cache
+ * is full the oldest buffers are released to the system. */
+void poolFree(void *ptr) {
+    if (ptr == NULL) return;
+    PoolHeader *h = (PoolHeader*)((char*)ptr - POOL_ALIGN);
+    if (h->capacity > POOL_MAX_BYTES) {
+        xfree(h);
+        return;
+    }
+
+    /* With --memory-accounting cached buffers are shown apart. */
+    xcharge(h, "pool");
+    pthread_mutex_lock(&PoolLock);
+    while (NumFree == POOL_MAX_BUFFERS || FreeBytes + h->capacity > POOL_MAX_BYTES) {
+        FreeBytes -= FreeList[0]->capacity;
+        xfree(FreeList[0]);
+        memmove(FreeList, FreeList+1, sizeof(h)*(NumFree-1));
+        NumFree--;
+    }
+    FreeList[NumFree++] = h;
+    FreeBytes += h->capacity;
+    pthread_mutex_unlock(&PoolLock);
+}
+
+void poolGetStats(PoolStats *stats) {
+    pthread_mutex_lock(&PoolLock);
+    stats->hits = Hits;
+    stats->misses = Misses;
+    stats->cached = NumFree;
+    stats->cached_bytes = FreeBytes;
+    pthread_mutex_unlock(&PoolLock);
+}
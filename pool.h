@@ -0,0 +1,23 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define POOL_ALIGN 64                       /* Alignment of buffers. */
+#define POOL_MAX_BUFFERS 32                 /* Max free buffers cached. */
+#define POOL_MAX_BYTES (256*1024*1024)      /* Max bytes of free buffers. */
+
+/* Statistics returned by poolGetStats(). */
+typedef struct PoolStats {
+    uint64_t hits;          /* Allocations served by a cached buffer. */
+    uint64_t misses;        /* Allocations that needed a new buffer. */
+    int cached;             /* Free buffers in the cache. */
+    size_t cached_bytes;    /* Total size of the free buffers. */
+} PoolStats;
+
+void *poolAlloc(size_t size);
+void poolFree(void *ptr);
+void poolGetStats(PoolStats *stats);
+
+#endif
@@ -0,0 +1,196 @@
+/* ============================================================================
+ * Bandwidth adaptive screenshot quality.
+ *
+ * The time to deliver a screenshot is the local time to capture and encode
+ * it, plus the upload time, that we model as a fixed per request latency
+ * plus the size divided by the link throughput. Latency and throughput
+ * are estimated fitting a line to the (bytes, seconds) samples of recent
+ * uploads with least squares: uploads by file_id, with no payload, are
+ * especially useful since they measure the latency alone.
+ *
+ * After every screenshot we predict, for each level of the quality
+ * ladder, how long the same screenshot would take at that level, and pick
+ * the best quality level meeting the latency target. The size of a
+ * screenshot at a given level is estimated from the bytes per pixel we
+ * observed at that level, scaled to the pixels of the current window.
+ * Going back to a better level requires some headroom, so that we don't
+ * oscillate between two levels.
+ * ==========================================================================*/
+
+#include <pthread.h>
+
+#include "quality.h"
+
+#define QUALITY_EWMA_ALPHA 0.3  /* Weight of new samples in averages. */
+#define QUALITY_HEADROOM 0.8    /* Use better levels if within 80% target. */
+#define QUALITY_MIN_SAMPLES 4   /* Uploads needed before fitting. */
+
+const QualityLevel QualityLadder[QUALITY_LEVELS] = {
+    {0, 256, 6},        /* What the user configured. */
+    {1600, 256, 6},
+    {1200, 128, 9},
+    {960, 32, 9},
+    {720, 16, 9},
+    {480, 8, 9}
+};
+
+static pthread_mutex_t QualityLock = PTHREAD_MUTEX_INITIALIZER;
+static int TargetMs = 0;            /* Latency target, 0 = disabled. */
+static int Level = 0;               /* Current ladder level. */
+static double Samples[QUALITY_SAMPLES][2]; /* Uploads bytes and seconds. */
+static int NumSamples = 0;
+static int NextSample = 0;
+static double Latency = 0;          /* Seconds per upload request. */
+static double Throughput = 0;       /* Bytes per second, 0 = unknown. */
+static double LocalSecs = 0;        /* Average capture and encode time. */
+static double BytesPerPixel[QUALITY_LEVELS]; /* Per level, 0 = unknown. */
+
+/* Fit seconds = Latency + bytes / Throughput to the samples. */
+static void fit_link_model(void) {
+    if (NumSamples < QUALITY_MIN_SAMPLES) return;
+
+    double n = NumSamples, sx = 0, sy = 0, sxx = 0, sxy = 0;
+    for (int j = 0; j < NumSamples; j++) {
+        double x = Samples[j][0], y = Samples[j][1];
+        sx += x;
+        sy += y;
+        sxx += x*x;
+        sxy += x*y;
+    }
+    double var = n*sxx - sx*sx;
+    double slope = var > 0 ? (n*sxy - sx*sy) / var : 0;
+    if (slope > 0) {
+        double intercept = (sy - slope*sx) / n;
+        Latency = intercept > 0 ? intercept : 0;
+        Throughput = 1 / slope;
+    } else if (sx > 0 && sy > 0) {
+        /* All the uploads had about the same size, or the samples are
+         * too noisy: charge all the time to the transfer. */
+        Latency = 0;
+        Throughput = sx / sy;
+    }
+}
+
+/* Pixels of a width x height screenshot at the given level, when the
+ * user asked for at most 'maxwidth' pixels (0 = no limit). */
+static double level_pixels(int level, int width, int height, int maxwidth) {
+    int w = width;
+    if (maxwidth && w > maxwidth) w = maxwidth;
+    if (QualityLadder[level].width && w > QualityLadder[level].width)
+        w = QualityLadder[level].width;
+    return (double)w * ((double)height * w / width);
+}
+
+/* Predicted delivery time of the screenshot at the given level. When we
+ * never sent screenshots at this level, use the closest known level. */
+static double predict(int level, int width, int height, int maxwidth) {
+    double bpp = 0;
+    for (int d = 0; d < QUALITY_LEVELS && bpp == 0; d++) {
+        if (level-d >= 0 && BytesPerPixel[level-d]) bpp = BytesPerPixel[level-d];
+        else if (level+d < QUALITY_LEVELS && BytesPerPixel[level+d])
+            bpp = BytesPerPixel[level+d];
+    }
+    double bytes = bpp * level_pixels(level, width, height, maxwidth);
+    return LocalSecs + Latency + bytes / Throughput;
+}
+
+/* Set the latency target in milliseconds, 0 to disable adaptation and
+ * always use the best quality. */
+void qualitySetTarget(int ms) {
+    pthread_mutex_lock(&QualityLock);
+    TargetMs = ms;
+    if (ms == 0) Level = 0;
+    pthread_mutex_unlock(&QualityLock);
+}
+
+int qualityTarget(void) {
+    pthread_mutex_lock(&QualityLock);
+    int ms = TargetMs;
+    pthread_mutex_unlock(&QualityLock);
+    return ms;
+}
+
+/* Return the level to use for the next screenshot. */
+int qualityLevel(void) {
+    pthread_mutex_lock(&QualityLock);
+    int level = Level;
+    pthread_mutex_unlock(&QualityLock);
+    return level;
+}
+
+/* Restore the state saved with qualityGetEstimates(), so that after a
+ * restart we don't start from scratch. */
+void qualityRestore(int level, double latency, double throughput) {
+    pthread_mutex_lock(&QualityLock);
+    if (level >= 0 && level < QUALITY_LEVELS) Level = level;
+    if (latency >= 0) Latency = latency;
+    if (throughput > 0) Throughput = throughput;
+    pthread_mutex_unlock(&QualityLock);
+}
+
+void qualityGetEstimates(int *level, double *latency, double *throughput) {
+    pthread_mutex_lock(&QualityLock);
+    *level = Level;
+    *latency = Latency;
+    *throughput = Throughput;
+    pthread_mutex_unlock(&QualityLock);
+}
+
+/* Record an upload request of 'bytes' that took 'secs' seconds. */
+void qualityAddUpload(size_t bytes, double secs) {
+    pthread_mutex_lock(&QualityLock);
+    Samples[NextSample][0] = bytes;
+    Samples[NextSample][1] = secs;
+    NextSample = (NextSample + 1) % QUALITY_SAMPLES;
+    if (NumSamples < QUALITY_SAMPLES) NumSamples++;
+    fit_link_model();
+    pthread_mutex_unlock(&QualityLock);
+}
+
+/* Record a screenshot sent at 'level', whose frame before scaling was
+ * width x height, with the user limit of 'maxwidth' pixels: it was
+ * 'bytes' long and took 'local_secs' to capture and encode. Then pick
+ * the level for the next screenshots. */
+void qualityFrameSent(int level, int width, int height, int maxwidth,
+                      size_t bytes, double local_secs)
+{
+    pthread_mutex_lock(&QualityLock);
+    double bpp = bytes / level_pixels(level, width, height, maxwidth);
+    double a = QUALITY_EWMA_ALPHA;
+    BytesPerPixel[level] = BytesPerPixel[level] ? BytesPerPixel[level]*(1-a) + bpp*a : bpp;
+    LocalSecs = LocalSecs ? LocalSecs*(1-a) + local_secs*a : local_secs;
+
+    int old = Level;
+    if (TargetMs && Throughput > 0) {
+        double target = TargetMs / 1000.0;
+        Level = QUALITY_LEVELS-1;
+        for (int l = 0; l < QUALITY_LEVELS; l++) {
+            double limit = l < old ? target * QUALITY_HEADROOM : target;
+            if (predict(l, width, height, maxwidth) <= limit) {
+                Level = l;
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&QualityLock);
+}
+
+/* Describe the controller state, for the .latency command. */
+sds qualityInfo(void) {
+    pthread_mutex_lock(&QualityLock);
+    const QualityLevel *q = &QualityLadder[Level];
+    sds info = TargetMs ? sdscatprintf(sdsempty(), "Latency target: %d ms\n", TargetMs)
+                        : sdsnew("Latency target: off\n");
+    info = sdscatprintf(info, "Quality level: %d of %d (", Level, QUALITY_LEVELS-1);
+    info = q->width ? sdscatprintf(info, "%d px", q->width) : sdscat(info, "full width");
+    info = sdscatprintf(info, ", %d colors, zlib %d)\n", q->maxcolors, q->zlevel);
+    if (Throughput > 0) {
+        info = sdscatprintf(info, "Link: %.0f ms latency, %.0f KB/s (%d uploads)\n",
+                            Latency * 1000, Throughput / 1024, NumSamples);
+    } else {
+        info = sdscat(info, "Link: not measured yet\n");
+    }
+    info = sdscatprintf(info, "Capture and encode: %.0f ms", LocalSecs * 1000);
+    pthread_mutex_unlock(&QualityLock);
+    return info;
+}
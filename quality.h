@@ -0,0 +1,31 @@
+#ifndef QUALITY_H
+#define QUALITY_H
+
+#include <stddef.h>
+
+#include "sds.h"
+
+/* A step of the quality ladder: level 0 is the best quality, every next
+ * level produces smaller uploads. */
+typedef struct QualityLevel {
+    int width;          /* Max screenshot width, 0 = native. */
+    int maxcolors;      /* Max palette size. */
+    int zlevel;         /* zlib compression level. */
+} QualityLevel;
+
+#define QUALITY_LEVELS 6
+#define QUALITY_SAMPLES 32  /* Uploads used to estimate the link speed. */
+
+extern const QualityLevel QualityLadder[QUALITY_LEVELS];
+
+void qualitySetTarget(int ms);
+int qualityTarget(void);
+int qualityLevel(void);
+void qualityRestore(int level, double latency, double throughput);
+void qualityGetEstimates(int *level, double *latency, double *throughput);
+void qualityAddUpload(size_t bytes, double secs);
+void qualityFrameSent(int level, int width, int height, int maxwidth,
+                      size_t bytes, double local_secs);
+sds qualityInfo(void);
+
+#endif
@@ -0,0 +1,359 @@
+/* ============================================================================
+ * Software terminal renderer.
+ *
+ * Sessions without a window, like the ones of the pty backend, are turned
+ * into screenshots by drawing their cell grid with the embedded font.
+ * Glyph shapes are rasterized once into an atlas of tiles, keyed by
+ * codepoint and the attributes that change the shape (bold, underline,
+ * strike). A tile stores a full pixel mask, so drawing a glyph is a
+ * branch free select between foreground and background, and runs of
+ * blank cells are plain fills. Both loops are written so that the
+ * compiler can vectorize them.
+ *
+ * The frame persists across calls: only the dirty rows of the screen, and
+ * the rows where the cursor was and is, are drawn again.
+ * ==========================================================================*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "render.h"
+#include "font.h"
+#include "xmalloc.h"
+
+#define TILE_PIXELS (FONT_WIDTH*FONT_HEIGHT)
+#define ATLAS_PROBE 8                   /* Slots a glyph can be stored in. */
+#define STYLE_MASK (VT_ATTR_BOLD|VT_ATTR_UNDERLINE|VT_ATTR_STRIKE)
+
+typedef struct GlyphTile {
+    uint32_t cp;
+    uint16_t style;             /* VT_ATTR_* flags in STYLE_MASK. */
+    int used;
+    uint32_t mask[TILE_PIXELS]; /* All ones where the glyph is. */
+} GlyphTile;
+
+/* The 16 ANSI colors. */
+static const uint32_t AnsiColors[16] = {
+    0x000000, 0xcd3131, 0x0dbc79, 0xe5e510, 0x2472c8, 0xbc3fbc, 0x11a8cd,
+    0xe5e5e5, 0x666666, 0xf14c4c, 0x23d18b, 0xf5f543, 0x3b8eea, 0xd670d6,
+    0x29b8db, 0xffffff
+};
+
+/* Lines of the box drawing characters from U+2500 to U+257F: two bits for
+ * every direction (up, right, down, left from the low bits) with 0 for no
+ * line, 1 for light, 2 for heavy and 3 for double. Dashed lines are drawn
+ * solid, arcs as corners, and diagonals have 0 since they are special. */
+static const uint8_t BoxLines[128] = {
+    0x44, 0x88, 0x11, 0x22, 0x44, 0x88, 0x11, 0x22, 0x44, 0x88, 0x11, 0x22,
+    0x14, 0x18, 0x24, 0x28, 0x50, 0x90, 0x60, 0xa0, 0x05, 0x09, 0x06, 0x0a,
+    0x41, 0x81, 0x42, 0x82, 0x15, 0x19, 0x16, 0x25, 0x26, 0x1a, 0x29, 0x2a,
+    0x51, 0x91, 0x52, 0x61, 0x62, 0x92, 0xa1, 0xa2, 0x54, 0x94, 0x58, 0x98,
+    0x64, 0xa4, 0x68, 0xa8, 0x45, 0x85, 0x49, 0x89, 0x46, 0x86, 0x4a, 0x8a,
+    0x55, 0x95, 0x59, 0x99, 0x56, 0x65, 0x66, 0x96, 0x5a, 0xa5, 0x69, 0x9a,
+    0xa9, 0xa6, 0x6a, 0xaa, 0x44, 0x88, 0x11, 0x22, 0xcc, 0x33, 0x1c, 0x34,
+    0x3c, 0xd0, 0x70, 0xf0, 0x0d, 0x07, 0x0f, 0xc1, 0x43, 0xc3, 0x1d, 0x37,
+    0x3f, 0xd1, 0x73, 0xf3, 0xdc, 0x74, 0xfc, 0xcd, 0x47, 0xcf, 0xdd, 0x77,
+    0xff, 0x14, 0x50, 0x41, 0x05, 0x00, 0x00, 0x00, 0x40, 0x01, 0x04, 0x10,
+    0x80, 0x02, 0x08, 0x20, 0x48, 0x21, 0x84, 0x12
+};
+
+/* Quadrants of U+2596 to U+259F: 1 upper left, 2 upper right, 4 lower
+ * left, 8 lower right. */
+static const uint8_t Quadrants[10] = {4, 8, 1, 13, 9, 7, 11, 2, 6, 14};
+
+/* ============================================================================
+ * Glyph rasterization
+ * ==========================================================================*/
+
+static void set_pixel(uint16_t *rows, int x, int y) {
+    if (x >= 0 && x < FONT_WIDTH && y >= 0 && y < FONT_HEIGHT)
+        rows[y] |= 1 << (FONT_WIDTH-1-x);
+}
+
+static void fill_rect(uint16_t *rows, int x0, int y0, int x1, int y1) {
+    for (int y = y0; y < y1; y++)
+        for (int x = x0; x < x1; x++) set_pixel(rows, x, y);
+}
+
+/* Draw a box drawing line from the center of the cell to the edge in the
+ * given direction, with the given weight. */
+static void box_line(uint16_t *rows, int dir, int weight) {
+    int cx = FONT_WIDTH/2, cy = FONT_HEIGHT/2 - 1;
+    int thick = weight == 2 ? 3 : 1;
+    int offsets[2] = {0, 0}, count = 1;
+    if (weight == 3) {
+        offsets[0] = -2;
+        offsets[1] = 2;
+        count = 2;
+    }
+    for (int j = 0; j < count; j++) {
+        int o = offsets[j] - thick/2;
+        switch (dir) {
+        case 0: fill_rect(rows, cx+o, 0, cx+o+thick, cy+1); break;
+        case 1: fill_rect(rows, cx, cy+o, FONT_WIDTH, cy+o+thick); break;
+        case 2: fill_rect(rows, cx+o, cy, cx+o+thick, FONT_HEIGHT); break;
+        case 3: fill_rect(rows, 0, cy+o, cx+1, cy+o+thick); break;
+        }
+    }
+}
+
+/* Draw the characters that must fill the cell to connect with their
+ * neighbors. Returns 0 if 'cp' is not one of them. */
+static int draw_special(uint32_t cp, uint16_t *rows) {
+    int w = FONT_WIDTH, h = FONT_HEIGHT;
+    if (cp >= 0x2500 && cp <= 0x257f) {
+        int lines = BoxLines[cp-0x2500];
+        for (int dir = 0; dir < 4; dir++) {
+            int weight = (lines >> (dir*2)) & 3;
+            if (weight) box_line(rows, dir, weight);
+        }
+        for (int y = 0; y < h; y++) {
+            int x = y * (w-1) / (h-1);
+            if (cp == 0x2571 || cp == 0x2573) set_pixel(rows, w-1-x, y);
+            if (cp == 0x2572 || cp == 0x2573) set_pixel(rows, x, y);
+        }
+        return 1;
+    }
+    if (cp >= 0x2580 && cp <= 0x259f) {
+        int n;
+        if (cp == 0x2580) {
+            fill_rect(rows, 0, 0, w, h/2);
+        } else if (cp <= 0x2588) {
+            n = cp - 0x2580;
+            fill_rect(rows, 0, h - (n*h+4)/8, w, h);
+        } else if (cp <= 0x258f) {
+            n = 0x2590 - cp;
+            fill_rect(rows, 0, 0, (n*w+4)/8, h);
+        } else if (cp == 0x2590) {
+            fill_rect(rows, (4*w+4)/8, 0, w, h);
+        } else if (cp <= 0x2593) {
+            /* Shades: 25%, 50% and 75% of the pixels. */
+            for (int y = 0; y < h; y++) {
+                for (int x = 0; x < w; x++) {
+                    int on = cp == 0x2591 ? (x+2*y) % 4 == 0 :
+                             cp == 0x2592 ? (x+y) % 2 == 0 :
+                                            (x+2*y) % 4 != 0;
+                    if (on) set_pixel(rows, x, y);
+                }
+            }
+        } else if (cp == 0x2594) {
+            fill_rect(rows, 0, 0, w, (h+4)/8);
+        } else if (cp == 0x2595) {
+            fill_rect(rows, w - (w+4)/8, 0, w, h);
+        } else {
+            int q = Quadrants[cp-0x2596];
+            int mx = (4*w+4)/8, my = h/2;
+            if (q & 1) fill_rect(rows, 0, 0, mx, my);
+            if (q & 2) fill_rect(rows, mx, 0, w, my);
+            if (q & 4) fill_rect(rows, 0, my, mx, h);
+            if (q & 8) fill_rect(rows, mx, my, w, h);
+        }
+        return 1;
+    }
+    if (cp >= 0x2800 && cp <= 0x28ff) {
+        /* Braille: dots 1-3 and 7 on the left column, 4-6 and 8 on the
+         * right one. */
+        static const int dx[8] = {0, 0, 0, 1, 1, 1, 0, 1};
+        static const int dy[8] = {0, 1, 2, 0, 1, 2, 3, 3};
+        for (int j = 0; j < 8; j++) {
+            if (!(cp & (1 << j))) continue;
+            int x = 2 + dx[j]*3, y = 2 + dy[j]*4;
+            fill_rect(rows, x, y, x+2, y+2);
+        }
+        return 1;
+    }
+    return 0;
+}
+
+/* Rasterize the glyph of 'cp' with the given style into the tile. */
+static void build_tile(GlyphTile *t, uint32_t cp, uint16_t style) {
+    uint16_t rows[FONT_HEIGHT] = {0};
+    if (!draw_special(cp, rows)) {
+        if (fontGlyph(cp, rows)) {
+            /* No bold font: thicken the strokes by one pixel. */
+            if (style & VT_ATTR_BOLD) {
+                for (int y = 0; y < FONT_HEIGHT; y++) rows[y] |= rows[y] >> 1;
+            }
+        } else if (cp != ' ') {
+            /* Missing glyph: an empty box. */
+            fill_rect(rows, 1, 3, FONT_WIDTH-1, 4);
+            fill_rect(rows, 1, FONT_BASELINE-1, FONT_WIDTH-1, FONT_BASELINE);
+            fill_rect(rows, 1, 3, 2, FONT_BASELINE);
+            fill_rect(rows, FONT_WIDTH-2, 3, FONT_WIDTH-1, FONT_BASELINE);
+        }
+    }
+    if (style & VT_ATTR_UNDERLINE) rows[FONT_BASELINE+1] = (1 << FONT_WIDTH) - 1;
+    if (style & VT_ATTR_STRIKE) rows[FONT_HEIGHT/2] = (1 << FONT_WIDTH) - 1;
+
+    for (int y = 0; y < FONT_HEIGHT; y++) {
+        for (int x = 0; x < FONT_WIDTH; x++) {
+            int on = (rows[y] >> (FONT_WIDTH-1-x)) & 1;
+            t->mask[y*FONT_WIDTH+x] = on ? 0xffffffff : 0;
+        }
+    }
+    t->cp = cp;
+    t->style = style;
+    t->used = 1;
+}
+
+/* Return the tile of the glyph, rasterizing it on a miss. A glyph can
+ * live in any of ATLAS_PROBE slots after its hash: when they are all
+ * taken, the first one is replaced. */
+static const GlyphTile *lookup_tile(Renderer *r, uint32_t cp, uint16_t style) {
+    uint32_t h = ((cp * 2654435761u) ^ (style * 40503u)) >> 16;
+    GlyphTile *free_slot = NULL;
+    for (int j = 0; j < ATLAS_PROBE; j++) {
+        GlyphTile *t = &r->atlas[(h + j) & (RENDER_ATLAS_SLOTS-1)];
+        if (!t->used) {
+            if (!free_slot) free_slot = t;
+        } else if (t->cp == cp && t->style == style) {
+            r->hits++;
+            return t;
+        }
+    }
+    GlyphTile *t = free_slot ? free_slot : &r->atlas[h & (RENDER_ATLAS_SLOTS-1)];
+    r->misses++;
+    build_tile(t, cp, style);
+    return t;
+}
+
+/* ============================================================================
+ * Drawing
+ * ==========================================================================*/
+
+/* Return the RGB value of a VT_COLOR_* color. */
+static uint32_t color_rgb(uint32_t c, uint32_t def) {
+    if (VT_COLOR_TYPE(c) == 2) return c & 0xffffff;
+    if (VT_COLOR_TYPE(c) != 1) return def;
+    int n = c & 255;
+    if (n < 16) return AnsiColors[n];
+    if (n >= 232) {
+        uint32_t g = 8 + (n-232)*10;
+        return g << 16 | g << 8 | g;
+    }
+    /* 6x6x6 color cube. */
+    static const uint8_t levels[6] = {0, 95, 135, 175, 215, 255};
+    n -= 16;
+    return levels[n/36] << 16 | levels[(n/6)%6] << 8 | levels[n%6];
+}
+
+/* Pixels are written in blocks of 8: loops with a constant trip count
+ * are vectorized by compilers even at -O2, the rest are done one by one. */
+#define BLOCK 8
+
+/* Fill 'n' pixels with the same color. */
+static void fill_pixels(uint32_t *restrict dst, int n, uint32_t color) {
+    int x = 0;
+    for (; x + BLOCK <= n; x += BLOCK) {
+        for (int k = 0; k < BLOCK; k++) dst[x+k] = color;
+    }
+    for (; x < n; x++) dst[x] = color;
+}
+
+/* Draw a row of a glyph tile: every pixel is the foreground where the
+ * mask is set, the background elsewhere. */
+static void blit_pixels(uint32_t *restrict dst, const uint32_t *restrict mask,
+                        uint32_t fg, uint32_t bg)
+{
+    int x = 0;
+    for (; x + BLOCK <= FONT_WIDTH; x += BLOCK) {
+        for (int k = 0; k < BLOCK; k++)
+            dst[x+k] = (fg & mask[x+k]) | (bg & ~mask[x+k]);
+    }
+    for (; x < FONT_WIDTH; x++) dst[x] = (fg & mask[x]) | (bg & ~mask[x]);
+}
+
+/* Draw screen row 'y'. 'cursor' is the column of the cursor if it is on
+ * this row, otherwise -1. The colors and tiles of the cells are resolved
+ * first, then the pixel rows are written left to right, filling runs of
+ * blank cells with the same background at once. */
+static void render_row(Renderer *r, const VtScreen *vt, int y, int cursor) {
+    const VtGrid *g = vt->grid;
+    size_t i = VT_CELL(vt, 0, y);
+
+    for (int x = 0; x < r->cols; x++) {
+        uint32_t cp = g->cp[i+x];
+        uint16_t attr = g->attr[i+x];
+        uint32_t fgc = g->fg[i+x];
+        /* Bold text in one of the first 8 colors uses the bright one. */
+        if ((attr & VT_ATTR_BOLD) && VT_COLOR_TYPE(fgc) == 1 && (fgc & 255) < 8)
+            fgc += 8;
+        uint32_t fg = color_rgb(fgc, RENDER_DEFAULT_FG);
+        uint32_t bg = color_rgb(g->bg[i+x], RENDER_DEFAULT_BG);
+        if (attr & VT_ATTR_DIM) fg = ((fg >> 1) & 0x7f7f7f) + ((bg >> 1) & 0x7f7f7f);
+        if (attr & VT_ATTR_HIDDEN) fg = bg;
+        if (!(attr & VT_ATTR_REVERSE) != !(x == cursor)) {
+            uint32_t tmp = fg;
+            fg = bg;
+            bg = tmp;
+        }
+        r->cell_fg[x] = fg | 0xff000000;
+        r->cell_bg[x] = bg | 0xff000000;
+
+        uint16_t style = attr & STYLE_MASK;
+        if (attr & VT_ATTR_WIDE_TAIL) cp = ' ';
+        if (cp == ' ' && !(style & (VT_ATTR_UNDERLINE|VT_ATTR_STRIKE)))
+            r->cell_mask[x] = NULL;
+        else
+            r->cell_mask[x] = lookup_tile(r, cp, style)->mask;
+    }
+
+    for (int py = 0; py < FONT_HEIGHT; py++) {
+        uint32_t *dst = (uint32_t *)(r->frame->pixels +
+                        (size_t)(y*FONT_HEIGHT + py) * r->frame->stride);
+        int x = 0;
+        while (x < r->cols) {
+            if (r->cell_mask[x] == NULL) {
+                int end = x+1;
+                while (end < r->cols && r->cell_mask[end] == NULL &&
+                       r->cell_bg[end] == r->cell_bg[x]) end++;
+                fill_pixels(dst + x*FONT_WIDTH, (end-x)*FONT_WIDTH, r->cell_bg[x]);
+                x = end;
+            } else {
+                blit_pixels(dst + x*FONT_WIDTH, r->cell_mask[x] + py*FONT_WIDTH,
+                            r->cell_fg[x], r->cell_bg[x]);
+                x++;
+            }
+        }
+    }
+}
+
+/* Create a renderer for a screen of the specified size. */
+Renderer *renderCreate(int rows, int cols) {
+    Renderer *r = xmalloc(sizeof(*r));
+    r->rows = rows;
+    r->cols = cols;
+    r->frame = frameCreate(cols*FONT_WIDTH, rows*FONT_HEIGHT);
+    r->atlas = xmalloc(sizeof(GlyphTile)*RENDER_ATLAS_SLOTS);
+    r->cell_fg = xmalloc(sizeof(uint32_t)*cols);
+    r->cell_bg = xmalloc(sizeof(uint32_t)*cols);
+    r->cell_mask = xmalloc(sizeof(uint32_t *)*cols);
+    memset(r->atlas, 0, sizeof(GlyphTile)*RENDER_ATLAS_SLOTS);
+    r->valid = 0;
+    r->cursor_y = -1;
+    r->hits = r->misses = 0;
+    return r;
+}
+
+void renderFree(Renderer *r) {
+    frameFree(r->frame);
+    xfree(r->atlas);
+    xfree(r->cell_fg);
+    xfree(r->cell_bg);
+    xfree(r->cell_mask);
+    xfree(r);
+}
+
+/* Bring r->frame up to date with the screen. 'dirty' is a bitmap of the
+ * rows changed since the previous call, in the format of VtScreen.dirty. */
+void renderScreen(Renderer *r, const VtScreen *vt, const uint64_t *dirty) {
+    int cx = vt->cursor_hidden ? -1 : vt->cx;
+    int cy = vt->cursor_hidden ? -1 : vt->cy;
+    for (int y = 0; y < r->rows; y++) {
+        int changed = (dirty[y >> 6] >> (y & 63)) & 1;
+        if (r->valid && !changed && y != cy && y != r->cursor_y) continue;
+        render_row(r, vt, y, y == cy ? cx : -1);
+    }
+    r->valid = 1;
+    r->cursor_y = cy;
+}
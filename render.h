@@ -0,0 +1,33 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <stdint.h>
+
+#include "frame.h"
+#include "vt.h"
+
+#define RENDER_ATLAS_SLOTS 1024     /* Glyph tiles cached, power of two. */
+#define RENDER_DEFAULT_FG 0xcccccc  /* Colors of VT_COLOR_DEFAULT. */
+#define RENDER_DEFAULT_BG 0x1e1e1e
+
+struct GlyphTile;
+
+/* Rasterizes a VtScreen into a frame that persists across calls, so that
+ * only the rows changed since the previous call are drawn again. */
+typedef struct Renderer {
+    int rows, cols;
+    Frame *frame;               /* The rendered screen. */
+    struct GlyphTile *atlas;    /* Glyphs already rasterized. */
+    uint32_t *cell_fg;          /* Colors and masks of the cells of the */
+    uint32_t *cell_bg;          /* row being drawn, NULL masks for */
+    const uint32_t **cell_mask; /* blank cells. */
+    int valid;                  /* False until the first full render. */
+    int cursor_y;               /* Row of the cursor drawn, or -1. */
+    uint64_t hits, misses;      /* Glyph lookups served by the atlas. */
+} Renderer;
+
+Renderer *renderCreate(int rows, int cols);
+void renderFree(Renderer *r);
+void renderScreen(Renderer *r, const VtScreen *vt, const uint64_t *dirty);
+
+#endif
@@ -0,0 +1,255 @@
+/* ============================================================================
+ * Scrollback: the history of a session output, searchable.
+ *
+ * The emulator appends every line that scrolls off the top of the screen.
+ * The text is stored back to back in a single buffer, so that a search is
+ * a memmem() over a few contiguous megabytes instead of a loop over
+ * hundreds of thousands of lines, and the offsets of the line starts are
+ * kept in order in a second ring, where a binary search finds the line of
+ * every match. Both grow on demand up to their max size, then the oldest
+ * lines are dropped to make room.
+ *
+ * Searches and pages also cover the screen, passed by the caller as the
+ * lines that follow the scrollback.
+ * ==========================================================================*/
+
+#if defined(__linux__)
+#define _GNU_SOURCE
+#endif
+
+#include <string.h>
+
+#include "scrollback.h"
+#include "xmalloc.h"
+
+#define SCROLLBACK_MIN_ALLOC 65536  /* First allocation of the text. */
+#define SCROLLBACK_MIN_LINES 1024   /* First allocation of the index. */
+
+/* Create an empty scrollback keeping up to 'max_size' bytes of text, and
+ * up to 'max_lines' lines. */
+Scrollback *scrollbackCreate(size_t max_size, size_t max_lines) {
+    Scrollback *sb = xmalloc(sizeof(*sb));
+    memset(sb, 0, sizeof(*sb));
+    sb->max_size = max_size;
+    sb->max_lines = max_lines;
+    return sb;
+}
+
+void scrollbackFree(Scrollback *sb) {
+    if (!sb) return;
+    xfree(sb->buf);
+    xfree(sb->start);
+    xfree(sb);
+}
+
+/* Offset in the text of line 'n', that must be in the scrollback. */
+static size_t line_start(const Scrollback *sb, uint64_t n) {
+    return sb->start[(sb->head + (size_t)(n - sb->first)) % sb->cap];
+}
+
+/* Return line 'n' of the scrollback, setting '*len'. */
+static const char *line_text(const Scrollback *sb, uint64_t n, size_t *len) {
+    const char *p = sb->buf + line_start(sb, n);
+    *len = (const char *)memchr(p, '\n', sb->buf + sb->size - p) - p;
+    return p;
+}
+
+static void drop_oldest(Scrollback *sb) {
+    sb->first++;
+    sb->head = (sb->head + 1) % sb->cap;
+}
+
+/* Return true if the lines written before the text wrapped are still
+ * there, after 'wpos'. */
+static int wrapped(const Scrollback *sb) {
+    return sb->first < sb->wrap_line;
+}
+
+/* Make room for one more line in the index. */
+static void index_reserve(Scrollback *sb) {
+    size_t count = sb->next - sb->first;
+    if (count == sb->max_lines) drop_oldest(sb);
+    else if (count == sb->cap) {
+        /* Grow the ring, putting the oldest line at the start. */
+        size_t cap = sb->cap ? sb->cap*2 : SCROLLBACK_MIN_LINES;
+        if (cap > sb->max_lines) cap = sb->max_lines;
+        size_t *start = xmalloc(sizeof(size_t)*cap);
+        for (size_t j = 0; j < count; j++)
+            start[j] = sb->start[(sb->head + j) % sb->cap];
+        xfree(sb->start);
+        sb->start = start;
+        sb->cap = cap;
+        sb->head = 0;
+    }
+}
+
+/* Make room for 'need' bytes of text at 'wpos'. */
+static void text_reserve(Scrollback *sb, size_t need) {
+    if (sb->wpos + need > sb->size && sb->size < sb->max_size) {
+        /* Not wrapped yet: the text can grow in place. */
+        size_t size = sb->size*2;
+        if (size < SCROLLBACK_MIN_ALLOC) size = SCROLLBACK_MIN_ALLOC;
+        if (size < sb->wpos + need) size = sb->wpos + need;
+        if (size > sb->max_size) size = sb->max_size;
+        sb->buf = xrealloc(sb->buf, size);
+        sb->size = size;
+    }
+    if (sb->wpos + need > sb->size) {
+        /* Wrap: the lines of the previous lap, after 'wpos', go first. */
+        while (wrapped(sb)) drop_oldest(sb);
+        sb->wrap_end = sb->wpos;
+        sb->wrap_line = sb->next;
+        sb->wpos = 0;
+    }
+    /* Drop the old lines the new one would overwrite. */
+    while (wrapped(sb) && line_start(sb, sb->first) < sb->wpos + need)
+        drop_oldest(sb);
+}
+
+/* Append a line, without its newline. */
+void scrollbackAppend(Scrollback *sb, const char *line, size_t len) {
+    if (len >= sb->max_size) len = sb->max_size-1;
+    index_reserve(sb);
+    text_reserve(sb, len+1);
+    if (sb->first == sb->next) {
+        /* Empty after dropping: start over at the head of the index. */
+        sb->head = 0;
+    }
+    memcpy(sb->buf + sb->wpos, line, len);
+    sb->buf[sb->wpos + len] = '\n';
+    sb->start[(sb->head + (size_t)(sb->next - sb->first)) % sb->cap] = sb->wpos;
+    sb->next++;
+    sb->wpos += len+1;
+}
+
+/* ============================================================================
+ * Search and pages
+ * ==========================================================================*/
+
+/* Lines matching a search: only the last 'SCROLLBACK_GREP_MAX' are kept,
+ * in a ring. */
+typedef struct Matches {
+    uint64_t line[SCROLLBACK_GREP_MAX];
+    uint64_t count;         /* All the matches, also the ones not kept. */
+} Matches;
+
+static void add_match(Matches *m, uint64_t n) {
+    m->line[m->count++ % SCROLLBACK_GREP_MAX] = n;
+}
+
+/* Search the text between 'lo' and 'hi', holding lines 'l0' to 'l1'
+ * excluded, adding every matching line once. */
+static void search_run(const Scrollback *sb, size_t lo, size_t hi,
+                       uint64_t l0, uint64_t l1, const char *pattern,
+                       size_t plen, Matches *m)
+{
+    const char *p = sb->buf + lo, *end = sb->buf + hi;
+    const char *found;
+    while ((found = memmem(p, end-p, pattern, plen)) != NULL) {
+        /* The last line starting at or before the match contains it. */
+        size_t off = found - sb->buf;
+        uint64_t a = l0, b = l1;
+        while (b - a > 1) {
+            uint64_t mid = a + (b-a)/2;
+            if (line_start(sb, mid) <= off) a = mid;
+            else b = mid;
+        }
+        add_match(m, a);
+        p = (const char *)memchr(found, '\n', end-found) + 1;
+    }
+}
+
+/* Return line 'n' of the scrollback followed by the screen. */
+static const char *get_line(const Scrollback *sb, sds *screen, uint64_t n,
+                            size_t *len)
+{
+    if (n < sb->next) return line_text(sb, n, len);
+    sds s = screen[n - sb->next];
+    *len = sdslen(s);
+    return s;
+}
+
+/* Return the lines containing 'pattern', in the scrollback or in the
+ * 'rows' lines of the screen, with the lines around them like grep -C. */
+sds scrollbackGrep(const Scrollback *sb, sds *screen, int rows, const char *pattern) {
+    Matches m;
+    m.count = 0;
+    size_t plen = strlen(pattern);
+    if (sb->first < sb->next) {
+        if (wrapped(sb)) {
+            search_run(sb, line_start(sb, sb->first), sb->wrap_end,
+                       sb->first, sb->wrap_line, pattern, plen, &m);
+            search_run(sb, 0, sb->wpos, sb->wrap_line, sb->next,
+                       pattern, plen, &m);
+        } else {
+            search_run(sb, line_start(sb, sb->first), sb->wpos,
+                       sb->first, sb->next, pattern, plen, &m);
+        }
+    }
+    for (int y = 0; y < rows; y++) {
+        if (memmem(screen[y], sdslen(screen[y]), pattern, plen))
+            add_match(&m, sb->next + y);
+    }
+
+    if (m.count == 0) return sdsnew("No matches.\n");
+    sds out = sdscatprintf(sdsempty(), "%llu matching lines",
+                           (unsigned long long)m.count);
+    int kept = m.count < SCROLLBACK_GREP_MAX ? (int)m.count : SCROLLBACK_GREP_MAX;
+    if ((uint64_t)kept < m.count) out = sdscatprintf(out, ", the last %d", kept);
+    out = sdscat(out, ":\n");
+
+    /* Print the groups of lines around the matches, with the page where
+     * they are for .scroll. Matches are numbered from 1, like editors do. */
+    uint64_t total = sb->next + rows;
+    uint64_t printed = 0;       /* Next line not printed yet. */
+    for (int j = 0; j < kept; j++) {
+        uint64_t n = m.line[(m.count - kept + j) % SCROLLBACK_GREP_MAX];
+        uint64_t from = n > sb->first + SCROLLBACK_GREP_CONTEXT ?
+                        n - SCROLLBACK_GREP_CONTEXT : sb->first;
+        uint64_t to = n + SCROLLBACK_GREP_CONTEXT + 1;
+        if (to > total) to = total;
+        if (from < printed) from = printed;
+        if (from != printed || j == 0) {
+            out = sdscatprintf(out, "-- page %d\n",
+                               rows ? (int)((total - 1 - n) / rows) : 0);
+        }
+        for (uint64_t l = from; l < to; l++) {
+            /* A line of the context may match too. */
+            int match = l == n;
+            for (int k = j+1; k < kept && !match; k++) {
+                match = m.line[(m.count - kept + k) % SCROLLBACK_GREP_MAX] == l;
+            }
+            size_t len;
+            const char *text = get_line(sb, screen, l, &len);
+            out = sdscatprintf(out, "%llu%c", (unsigned long long)l+1,
+                               match ? ':' : '-');
+            out = sdscatlen(out, text, len);
+            out = sdscatlen(out, "\n", 1);
+        }
+        if (to > printed) printed = to;
+    }
+    return out;
+}
+
+/* Return page 'page' of the output, a screenful of lines: 0 is the screen
+ * itself, 1 the lines above it, and so on. Pages past the oldest line show
+ * the oldest one. Sets '*pages' to the number of pages. */
+sds scrollbackPage(const Scrollback *sb, sds *screen, int rows, int page, int *pages) {
+    uint64_t total = sb->next + rows;
+    uint64_t lines = total - sb->first;
+    *pages = rows ? (int)((lines + rows - 1) / rows) : 0;
+    sds out = sdsempty();
+    if (*pages == 0) return out;
+    if (page >= *pages) page = *pages-1;
+    if (page < 0) page = 0;
+
+    uint64_t to = total - (uint64_t)page*rows;
+    uint64_t from = to - sb->first > (uint64_t)rows ? to - rows : sb->first;
+    for (uint64_t l = from; l < to; l++) {
+        size_t len;
+        const char *text = get_line(sb, screen, l, &len);
+        out = sdscatlen(out, text, len);
+        out = sdscatlen(out, "\n", 1);
+    }
+    return out;
+}
@@ -0,0 +1,43 @@
+#ifndef SCROLLBACK_H
+#define SCROLLBACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sds.h"
+
+#define SCROLLBACK_GREP_CONTEXT 2   /* Lines shown around every match. */
+#define SCROLLBACK_GREP_MAX 20      /* Matches shown, the most recent. */
+#define SCROLLBACK_MAX_SIZE (16*1024*1024)  /* Max bytes kept per session. */
+#define SCROLLBACK_MAX_LINES 500000         /* Max lines kept per session. */
+
+/* The lines that scrolled off a screen, oldest first, up to a max size
+ * after which the oldest ones are dropped. The text is kept contiguous in
+ * a ring buffer so searches run over it with memmem(), and an index of the
+ * line start offsets maps the matches back to lines. Lines are numbered
+ * from the start of the session: 'first' grows as lines are dropped. */
+typedef struct Scrollback {
+    char *buf;              /* Text of the lines, each followed by '\n'. */
+    size_t size;            /* Allocated bytes, grown up to 'max_size'. */
+    size_t max_size;
+    size_t wpos;            /* Offset where the next line is written. */
+    size_t wrap_end;        /* End of the lines written before 'buf'
+                               wrapped, that follow 'wpos'. */
+    size_t *start;          /* Offset of every line, a ring of 'cap' items
+                               with the oldest line at 'head'. */
+    size_t cap;
+    size_t max_lines;
+    size_t head;
+    uint64_t first, next;   /* Number of the oldest line, and of the next
+                               line to append. */
+    uint64_t wrap_line;     /* First line written after 'buf' wrapped: the
+                               older ones are after 'wpos'. */
+} Scrollback;
+
+Scrollback *scrollbackCreate(size_t max_size, size_t max_lines);
+void scrollbackFree(Scrollback *sb);
+void scrollbackAppend(Scrollback *sb, const char *line, size_t len);
+sds scrollbackGrep(const Scrollback *sb, sds *screen, int rows, const char *pattern);
+sds scrollbackPage(const Scrollback *sb, sds *screen, int rows, int page, int *pages);
+
+#endif
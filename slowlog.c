@@ -0,0 +1,293 @@
+/* ============================================================================
+ * Slow log.
+ *
+ * Like the Redis SLOWLOG, the last SLOWLOG_LEN requests that took longer
+ * than a threshold are kept together with where their time went, so that
+ * a request that took ten seconds once in a while can be explained after
+ * the fact: was it waiting for the request lock, for the capture, or for
+ * a Telegram call?
+ *
+ * Every request gets a trace when its thread starts. A thread attaches
+ * the trace it is working for, and every duration recorded in stats.c
+ * meanwhile is also added to the trace, summed by histogram name. Jobs
+ * of the screenshot pipeline hold a reference to the trace of the request
+ * that queued them and the stages attach it, so the time of a request
+ * includes the upload of its screenshot. When the last reference is
+ * released the request is logged, if it was slow. The memory allocated
+ * by the attached threads is charged to the request the same way.
+ *
+ * The log can also be saved in the KV store, so that it survives restarts.
+ * ==========================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sqlite3.h>
+
+#include "slowlog.h"
+#include "botlib.h"
+#include "xmalloc.h"
+
+#define SLOWLOG_KEY "slowlog:"
+
+static SlowlogEntry Log[SLOWLOG_LEN];  /* Ring of the slow requests. */
+static int LogLen = 0;                  /* Entries in 'Log'. */
+static int LogNext = 0;                 /* Where the next entry goes. */
+static uint64_t NextId = 1;
+static sqlite3 *LogDb = NULL;           /* Set if the log is saved. */
+static pthread_mutex_t LogLock = PTHREAD_MUTEX_INITIALIZER;
+static _Atomic uint64_t ThresholdUs = SLOWLOG_DEFAULT_MS * 1000;
+
+static _Thread_local SlowlogTrace *Current = NULL;
+
+/* Copy the request text, truncated to fit but never inside an UTF-8
+ * sequence, with control characters turned to spaces so that the request
+ * always takes a single line. */
+static void copy_request(char *dst, const char *src) {
+    size_t len = strlen(src);
+    if (len > SLOWLOG_REQUEST_LEN-1) {
+        len = SLOWLOG_REQUEST_LEN-1;
+        while (len > 0 && ((unsigned char)src[len] & 0xC0) == 0x80) len--;
+    }
+    for (size_t j = 0; j < len; j++)
+        dst[j] = (unsigned char)src[j] < 32 ? ' ' : src[j];
+    dst[len] = '\0';
+}
+
+/* Start the trace of a request received at 'start_us', a statsUstime()
+ * time. The caller owns the only reference. */
+SlowlogTrace *slowlogBegin(const char *request, uint64_t start_us) {
+    SlowlogTrace *t = xmalloc(sizeof(*t));
+    memset(t, 0, sizeof(*t));
+    t->entry.time = time(NULL);
+    copy_request(t->entry.request, request ? request : "");
+    t->start_us = start_us;
+    atomic_init(&t->refcount, 1);
+    pthread_mutex_init(&t->lock, NULL);
+    return t;
+}
+
+/* Take a reference to the trace, for a job that will finish the request
+ * in another thread. Does nothing if 't' is NULL. */
+void slowlogRetain(SlowlogTrace *t) {
+    if (t) atomic_fetch_add(&t->refcount, 1);
+}
+
+/* ============================================================================
+ * Log
+ * ==========================================================================*/
+
+/* Save the entry in the KV store, as a header line, the request line,
+ * then a line per span, and drop the entries the ring no longer holds.
+ * Must be called with LogLock held. */
+static void save_entry(const SlowlogEntry *e) {
+    char key[64];
+    snprintf(key, sizeof(key), SLOWLOG_KEY "%020llu", (unsigned long long)e->id);
+    sds val = sdscatprintf(sdsempty(), "%lld %llu %llu %s\n%s\n",
+                           (long long)e->time, (unsigned long long)e->duration_us,
+                           (unsigned long long)e->call_us,
+                           e->call[0] ? e->call : "-", e->request);
+    for (int j = 0; j < e->numspans; j++) {
+        val = sdscatprintf(val, "%u %llu %s\n", e->spans[j].count,
+                           (unsigned long long)e->spans[j].us, e->spans[j].name);
+    }
+    kvSet(LogDb, key, val, 0);
+    sdsfree(val);
+
+    if (e->id > SLOWLOG_LEN) {
+        snprintf(key, sizeof(key), SLOWLOG_KEY "%020llu",
+                 (unsigned long long)(e->id - SLOWLOG_LEN));
+        sqlQuery(LogDb, "DELETE FROM KeyValue WHERE key LIKE ?s AND key <= ?s",
+                 SLOWLOG_KEY "%", key);
+    }
+}
+
+/* Parse an entry saved by save_entry(). Returns 0 on success, -1 if the
+ * value is not a valid entry. */
+static int parse_entry(const char *val, size_t len, SlowlogEntry *e) {
+    int count;
+    sds *lines = sdssplitlen(val, len, "\n", 1, &count);
+    if (!lines) return -1;
+
+    long long t;
+    unsigned long long duration, call_us, us;
+    char call[STATS_NAME_LEN];
+    memset(e, 0, sizeof(*e));
+    /* The field width is STATS_NAME_LEN-1. */
+    int ok = count >= 2 && sscanf(lines[0], "%lld %llu %llu %63s", &t,
+                                  &duration, &call_us, call) == 4;
+    if (ok) {
+        e->time = t;
+        e->duration_us = duration;
+        e->call_us = call_us;
+        if (strcmp(call, "-") != 0) memcpy(e->call, call, sizeof(call));
+        copy_request(e->request, lines[1]);
+        for (int j = 2; j < count && e->numspans < SLOWLOG_MAX_SPANS; j++) {
+            SlowlogSpan *s = &e->spans[e->numspans];
+            if (sscanf(lines[j], "%u %llu %63[^\n]", &s->count, &us, s->name) == 3) {
+                s->us = us;
+                e->numspans++;
+            }
+        }
+    }
+    sdsfreesplitres(lines, count);
+    return ok ? 0 : -1;
+}
+
+/* Add the entry to the ring, replacing the oldest one when full. Must be
+ * called with LogLock held. */
+static void add_entry(const SlowlogEntry *e) {
+    Log[LogNext] = *e;
+    LogNext = (LogNext + 1) % SLOWLOG_LEN;
+    if (LogLen < SLOWLOG_LEN) LogLen++;
+}
+
+/* Release a reference to the trace. The last one logs the request if it
+ * took at least the threshold, then frees the trace. Does nothing if 't'
+ * is NULL. */
+void slowlogEnd(SlowlogTrace *t) {
+    if (!t || atomic_fetch_sub(&t->refcount, 1) != 1) return;
+    if (Current == t) slowlogAttach(NULL);
+    allocRequestEnd(&t->memory);
+
+    t->entry.duration_us = statsUstime() - t->start_us;
+    if (t->entry.duration_us >= atomic_load(&ThresholdUs)) {
+        pthread_mutex_lock(&LogLock);
+        t->entry.id = NextId++;
+        add_entry(&t->entry);
+        if (LogDb) save_entry(&t->entry);
+        pthread_mutex_unlock(&LogLock);
+    }
+    pthread_mutex_destroy(&t->lock);
+    xfree(t);
+}
+
+/* ============================================================================
+ * Spans
+ * ==========================================================================*/
+
+/* Make 't' the trace the calling thread works for, or detach the thread
+ * from any trace if NULL. */
+void slowlogAttach(SlowlogTrace *t) {
+    Current = t;
+    allocRequestAttach(t ? &t->memory : NULL);
+}
+
+/* Return the trace the calling thread works for, or NULL. */
+SlowlogTrace *slowlogCurrent(void) {
+    return Current;
+}
+
+/* Add a duration to the trace of the calling thread, if any. Called by
+ * statsRecord() for every duration recorded. */
+void slowlogSpan(const char *name, uint64_t us) {
+    SlowlogTrace *t = Current;
+    if (!t) return;
+
+    SlowlogEntry *e = &t->entry;
+    pthread_mutex_lock(&t->lock);
+    int j = 0;
+    while (j < e->numspans && strcmp(e->spans[j].name, name) != 0) j++;
+    if (j == e->numspans && j < SLOWLOG_MAX_SPANS) {
+        snprintf(e->spans[j].name, STATS_NAME_LEN, "%s", name);
+        e->numspans++;
+    }
+    if (j < e->numspans) {
+        e->spans[j].count++;
+        e->spans[j].us += us;
+    }
+
+    size_t plen = strlen(SLOWLOG_CALL_PREFIX);
+    if (strncmp(name, SLOWLOG_CALL_PREFIX, plen) == 0 && us > e->call_us) {
+        snprintf(e->call, STATS_NAME_LEN, "%s", name + plen);
+        e->call_us = us;
+    }
+    pthread_mutex_unlock(&t->lock);
+}
+
+/* ============================================================================
+ * Configuration and reports
+ * ==========================================================================*/
+
+/* Log the requests taking at least 'ms' milliseconds. Zero logs them
+ * all. */
+void slowlogSetThreshold(uint64_t ms) {
+    atomic_store(&ThresholdUs, ms * 1000);
+}
+
+/* Return the threshold, in milliseconds. */
+uint64_t slowlogThreshold(void) {
+    return atomic_load(&ThresholdUs) / 1000;
+}
+
+/* Save the log in the database at 'db_path' from now on, loading the
+ * entries saved by previous runs first. Returns 0 on success, -1 if the
+ * database can't be opened. */
+int slowlogPersist(const char *db_path) {
+    sqlite3 *db;
+    if (sqlite3_open(db_path, &db) != SQLITE_OK) {
+        sqlite3_close(db);
+        return -1;
+    }
+    sqlite3_exec(db, TB_CREATE_KV_STORE, 0, 0, NULL);
+    sqlite3_busy_timeout(db, 1000);
+
+    pthread_mutex_lock(&LogLock);
+    sqlRow row;
+    sqlSelect(db, &row, "SELECT key,value FROM KeyValue WHERE key LIKE ?s "
+                        "ORDER BY key", SLOWLOG_KEY "%");
+    while (sqlNextRow(&row)) {
+        SlowlogEntry e;
+        if (row.col[1].s == NULL ||
+            parse_entry(row.col[1].s, row.col[1].i, &e) != 0) continue;
+        e.id = strtoull(row.col[0].s + strlen(SLOWLOG_KEY), NULL, 10);
+        add_entry(&e);
+        if (e.id >= NextId) NextId = e.id + 1;
+    }
+    LogDb = db;
+    pthread_mutex_unlock(&LogLock);
+    return 0;
+}
+
+/* Return a report of the last 'count' slow requests, the newest first:
+ * the time of every stage, in ms, and the slowest Telegram call. */
+sds slowlogInfo(int count) {
+    pthread_mutex_lock(&LogLock);
+    if (count > LogLen) count = LogLen;
+    sds info = sdsempty();
+    for (int j = 0; j < count; j++) {
+        const SlowlogEntry *e = &Log[(LogNext - 1 - j + SLOWLOG_LEN) % SLOWLOG_LEN];
+        char date[32];
+        struct tm tm;
+        localtime_r(&e->time, &tm);
+        strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", &tm);
+        info = sdscatprintf(info, "#%llu %s, %.1f ms: %s\n",
+                            (unsigned long long)e->id, date,
+                            e->duration_us / 1000.0, e->request);
+        for (int k = 0; k < e->numspans; k++) {
+            const SlowlogSpan *s = &e->spans[k];
+            info = sdscatprintf(info, "%s%s", k ? ", " : "  ", s->name);
+            if (s->count > 1) info = sdscatprintf(info, " %ux", s->count);
+            info = sdscatprintf(info, " %.1f", s->us / 1000.0);
+        }
+        if (e->numspans) info = sdscat(info, " ms\n");
+        if (e->call[0]) {
+            info = sdscatprintf(info, "  Slowest call: %s, %.1f ms\n",
+                                e->call, e->call_us / 1000.0);
+        }
+    }
+    pthread_mutex_unlock(&LogLock);
+    return info;
+}
+
+/* Empty the log, and the saved entries if it is saved. */
+void slowlogReset(void) {
+    pthread_mutex_lock(&LogLock);
+    LogLen = 0;
+    LogNext = 0;
+    if (LogDb) {
+        sqlQuery(LogDb, "DELETE FROM KeyValue WHERE key LIKE ?s",
+                 SLOWLOG_KEY "%");
+    }
+    pthread_mutex_unlock(&LogLock);
+}
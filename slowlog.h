@@ -0,0 +1,60 @@
+#ifndef SLOWLOG_H
+#define SLOWLOG_H
+
+#include <stdint.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "sds.h"
+#include "stats.h"
+#include "alloc.h"
+
+#define SLOWLOG_LEN 128             /* Entries kept, in memory and on disk. */
+#define SLOWLOG_MAX_SPANS 24        /* Different stages kept per entry. */
+#define SLOWLOG_REQUEST_LEN 64      /* Request text kept, with null term. */
+#define SLOWLOG_DEFAULT_MS 5000     /* Default threshold. */
+#define SLOWLOG_CALL_PREFIX "api."  /* Histograms of the Telegram calls. */
+
+/* Time spent in a stage by a request, summed over its 'count' runs. */
+typedef struct SlowlogSpan {
+    char name[STATS_NAME_LEN];
+    unsigned int count;
+    uint64_t us;
+} SlowlogSpan;
+
+/* A request that took longer than the threshold. */
+typedef struct SlowlogEntry {
+    uint64_t id;                /* Increasing, never reused. */
+    time_t time;                /* When the request was received. */
+    uint64_t duration_us;       /* From the update to the last reply. */
+    char request[SLOWLOG_REQUEST_LEN];
+    char call[STATS_NAME_LEN];  /* Slowest single Telegram call. */
+    uint64_t call_us;
+    int numspans;
+    SlowlogSpan spans[SLOWLOG_MAX_SPANS]; /* In order of first run. */
+} SlowlogEntry;
+
+/* The entry of a request being served. It can be shared by the threads
+ * working for the request, and is logged when the last one releases it. */
+typedef struct SlowlogTrace {
+    SlowlogEntry entry;
+    uint64_t start_us;
+    _Atomic int refcount;
+    pthread_mutex_t lock;       /* Protects 'entry'. */
+    AllocRequest memory;        /* Memory held, with --memory-accounting. */
+} SlowlogTrace;
+
+SlowlogTrace *slowlogBegin(const char *request, uint64_t start_us);
+void slowlogRetain(SlowlogTrace *t);
+void slowlogEnd(SlowlogTrace *t);
+void slowlogAttach(SlowlogTrace *t);
+SlowlogTrace *slowlogCurrent(void);
+void slowlogSpan(const char *name, uint64_t us);
+void slowlogSetThreshold(uint64_t ms);
+uint64_t slowlogThreshold(void);
+int slowlogPersist(const char *db_path);
+sds slowlogInfo(int count);
+void slowlogReset(void);
+
+#endif
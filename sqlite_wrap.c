@@ -10,6 +10,7 @@
 #include "sqlite_wrap.h"
 #include "sds.h"
 #include "botlib.h"
+#include "stats.h"
 
 #define SHOW_QUERY_ERRORS 1
 
@@ -37,6 +38,7 @@
  * SQLITE_ROW, since in such case row->stmt is set to NULL.
  */
 int sqlGenericQuery(sqlite3 *dbhandle, sqlRow *row, const char *sql, va_list ap) {
+    uint64_t start = statsUstime();
     int rc = SQLITE_ERROR;
     sqlite3_stmt *stmt = NULL;
     sds query = sdsempty();
@@ -113,6 +115,7 @@ int sqlGenericQuery(sqlite3 *dbhandle, sqlRow *row, const char *sql, va_list ap)
 error:
     if (stmt) sqlite3_finalize(stmt);
     sdsfree(query);
+    statsRecordSince("sqlite",start);
     return rc;
 }
 
@@ -0,0 +1,220 @@
+/* ============================================================================
+ * Latency histograms and counters.
+ *
+ * Every histogram counts durations in buckets whose size doubles every
+ * STATS_SUB buckets: durations under 2*STATS_SUB us have a bucket each,
+ * then every power of two is split in STATS_SUB buckets. A bucket is
+ * found with a couple of shifts, percentiles are within about 6% of the
+ * real value whatever the scale, and a histogram covering microseconds to
+ * minutes is a couple of KB.
+ *
+ * Threads record durations all the time, from the request threads to the
+ * pipeline stages, so every histogram has STATS_SHARDS copies and every
+ * thread updates its own, with relaxed atomic adds: threads never wait for
+ * each other, and only share a cache line when there are more threads
+ * than shards. Readers sum the shards.
+ *
+ * Histograms and counters are found by name without taking locks: they
+ * are only appended to their registry, never removed, and published by
+ * incrementing its count after they are initialized.
+ * ==========================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "stats.h"
+#include "slowlog.h"
+#include "trace.h"
+#include "xmalloc.h"
+
+/* Named items, each starting with its name. */
+typedef struct Registry {
+    void *items[STATS_MAX_ITEMS];
+    _Atomic int count;
+} Registry;
+
+static Registry Hists, Counters;
+static pthread_mutex_t CreateLock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t StartUs = 0;        /* When the first item was made. */
+
+static _Atomic int NextShard = 0;
+static _Thread_local int Shard = -1; /* Shard of the thread, -1 if unset. */
+
+/* Return the monotonic time in microseconds. */
+uint64_t statsUstime(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void *registry_find(Registry *r, int count, const char *name) {
+    for (int j = 0; j < count; j++)
+        if (strcmp(r->items[j], name) == 0) return r->items[j];
+    return NULL;
+}
+
+/* Return the item with the specified name, creating it zeroed if needed.
+ * Returns NULL if the registry is full. */
+static void *registry_get(Registry *r, const char *name, size_t size) {
+    int n = atomic_load_explicit(&r->count, memory_order_acquire);
+    void *item = registry_find(r, n, name);
+    if (item) return item;
+
+    pthread_mutex_lock(&CreateLock);
+    n = atomic_load_explicit(&r->count, memory_order_relaxed);
+    item = registry_find(r, n, name);
+    if (!item && n < STATS_MAX_ITEMS) {
+        /* The size must be a multiple of the alignment. */
+        size = (size + 63) / 64 * 64;
+        item = xalignedalloc(64, size);
+        memset(item, 0, size);
+        snprintf(item, STATS_NAME_LEN, "%s", name);
+        if (StartUs == 0) StartUs = statsUstime();
+        r->items[n] = item;
+        atomic_store_explicit(&r->count, n+1, memory_order_release);
+    }
+    pthread_mutex_unlock(&CreateLock);
+    return item;
+}
+
+/* ============================================================================
+ * Histograms
+ * ==========================================================================*/
+
+/* Return the histogram with the specified name, creating it if needed.
+ * Returns NULL if there are too many histograms. */
+StatsHist *statsGet(const char *name) {
+    return registry_get(&Hists, name, sizeof(StatsHist));
+}
+
+/* Return the bucket of a duration. */
+static int bucket_index(uint64_t us) {
+    if (us >= (1ULL << STATS_MAX_BITS)) us = (1ULL << STATS_MAX_BITS) - 1;
+    int msb = 63;
+    while (msb > 0 && !(us >> msb)) msb--;
+    int shift = msb > STATS_SUB_BITS ? msb - STATS_SUB_BITS : 0;
+    return shift * STATS_SUB + (int)(us >> shift);
+}
+
+/* Return the shortest duration counted by a bucket. */
+static uint64_t bucket_min(int index) {
+    if (index < 2*STATS_SUB) return index;
+    int shift = index / STATS_SUB - 1;
+    return (uint64_t)(index - shift * STATS_SUB) << shift;
+}
+
+/* Return the longest duration counted by a bucket. */
+uint64_t statsBucketMax(int index) {
+    return bucket_min(index+1) - 1;
+}
+
+/* Return the middle of the durations counted by a bucket. */
+static double bucket_value(int index) {
+    return (bucket_min(index) + statsBucketMax(index)) / 2.0;
+}
+
+/* Count a duration, in microseconds. It is also added to the slow log
+ * trace of the thread, if any, and to the trace file. */
+void statsRecord(StatsHist *h, uint64_t us) {
+    if (!h) return;
+    slowlogSpan(h->name, us);
+    traceRecord(h->name, us);
+    if (Shard == -1) Shard = atomic_fetch_add(&NextShard, 1) % STATS_SHARDS;
+    StatsShard *s = &h->shards[Shard];
+    atomic_fetch_add_explicit(&s->buckets[bucket_index(us)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&s->sum, us, memory_order_relaxed);
+}
+
+/* Count the time elapsed since 'start', a statsUstime() time, in the
+ * histogram with the specified name. */
+void statsRecordSince(const char *name, uint64_t start) {
+    statsRecord(statsGet(name), statsUstime() - start);
+}
+
+/* Return the histograms in the order they were created, setting
+ * '*count'. */
+StatsHist **statsList(int *count) {
+    *count = atomic_load_explicit(&Hists.count, memory_order_acquire);
+    return (StatsHist **)Hists.items;
+}
+
+/* Sum the shards of the histogram. Durations recorded meanwhile may be
+ * counted or not, but the count is always the sum of the buckets. */
+void statsSnapshot(StatsHist *h, StatsSnapshot *snap) {
+    memset(snap, 0, sizeof(*snap));
+    for (int k = 0; k < STATS_SHARDS; k++) {
+        StatsShard *s = &h->shards[k];
+        for (int b = 0; b < STATS_BUCKETS; b++) {
+            uint64_t c = atomic_load_explicit(&s->buckets[b], memory_order_relaxed);
+            snap->buckets[b] += c;
+            snap->count += c;
+        }
+        snap->sum += atomic_load_explicit(&s->sum, memory_order_relaxed);
+    }
+}
+
+/* Return the duration below which 'q' of the durations of the snapshot
+ * are. */
+static double percentile(const StatsSnapshot *snap, double q) {
+    uint64_t rank = (uint64_t)(q * snap->count + 0.5), seen = 0;
+    if (rank == 0) rank = 1;
+    for (int j = 0; j < STATS_BUCKETS; j++) {
+        seen += snap->buckets[j];
+        if (seen >= rank) return bucket_value(j);
+    }
+    return bucket_value(STATS_BUCKETS-1);
+}
+
+/* Return a report of every histogram that counted something, in the
+ * order they were created: count, rate, percentiles and max, in ms. */
+sds statsInfo(void) {
+    int n;
+    StatsHist **hists = statsList(&n);
+    double minutes = (statsUstime() - StartUs) / 60e6;
+    sds info = sdsempty();
+    StatsSnapshot snap;
+    for (int j = 0; j < n; j++) {
+        statsSnapshot(hists[j], &snap);
+        if (snap.count == 0) continue;
+        info = sdscatprintf(info,
+            "%s: %llu, %.1f/min, avg %.1f, p50 %.1f, p90 %.1f, p99 %.1f, "
+            "max %.1f ms\n", hists[j]->name, (unsigned long long)snap.count,
+            minutes > 0 ? snap.count / minutes : 0.0,
+            (double)snap.sum / snap.count / 1000,
+            percentile(&snap, 0.5) / 1000,
+            percentile(&snap, 0.9) / 1000,
+            percentile(&snap, 0.99) / 1000,
+            percentile(&snap, 1) / 1000);
+    }
+    return info;
+}
+
+/* ============================================================================
+ * Counters
+ * ==========================================================================*/
+
+/* Return the counter with the specified name, creating it if needed.
+ * Returns NULL if there are too many counters. */
+StatsCounter *statsCounter(const char *name) {
+    return registry_get(&Counters, name, sizeof(StatsCounter));
+}
+
+/* Add 'n' to the counter, or to the gauge, where it can be negative. */
+void statsAdd(StatsCounter *c, int64_t n) {
+    if (c) atomic_fetch_add_explicit(&c->value, n, memory_order_relaxed);
+}
+
+/* Add 'n' to the counter with the specified name. */
+void statsIncr(const char *name, int64_t n) {
+    statsAdd(statsCounter(name), n);
+}
+
+/* Return the counters in the order they were created, setting
+ * '*count'. */
+StatsCounter **statsCounterList(int *count) {
+    *count = atomic_load_explicit(&Counters.count, memory_order_acquire);
+    return (StatsCounter **)Counters.items;
+}
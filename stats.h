@@ -0,0 +1,60 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "sds.h"
+
+#define STATS_SUB_BITS 3        /* Buckets per power of two, as bits. */
+#define STATS_SUB (1 << STATS_SUB_BITS)
+#define STATS_MAX_BITS 28       /* Durations up to 2^28 us, about 4 min. */
+#define STATS_BUCKETS ((STATS_MAX_BITS - STATS_SUB_BITS + 1) * STATS_SUB)
+#define STATS_SHARDS 8          /* Copies of every histogram. */
+#define STATS_MAX_ITEMS 128     /* Max histograms, and max counters. */
+#define STATS_NAME_LEN 64       /* Max name length, with the null term. */
+
+/* The part of a histogram updated by a group of threads. Aligned so that
+ * shards never share a cache line. */
+typedef struct StatsShard {
+    _Alignas(64) _Atomic uint64_t buckets[STATS_BUCKETS];
+    _Atomic uint64_t sum;       /* Sum of the durations, in us. */
+} StatsShard;
+
+/* A latency histogram with buckets of exponentially growing size, so
+ * that every duration is stored with about the same relative precision,
+ * like HdrHistogram does. */
+typedef struct StatsHist {
+    char name[STATS_NAME_LEN];
+    StatsShard shards[STATS_SHARDS];
+} StatsHist;
+
+/* The histogram summed over its shards, see statsSnapshot(). */
+typedef struct StatsSnapshot {
+    uint64_t buckets[STATS_BUCKETS];
+    uint64_t count;
+    uint64_t sum;
+} StatsSnapshot;
+
+/* A counter if its name ends with _total, like in Prometheus, otherwise
+ * a gauge that can also go down. The name can carry labels, like in
+ * 'api_calls_total{method="getMe"}'. */
+typedef struct StatsCounter {
+    char name[STATS_NAME_LEN];
+    _Atomic int64_t value;
+} StatsCounter;
+
+uint64_t statsUstime(void);
+StatsHist *statsGet(const char *name);
+void statsRecord(StatsHist *h, uint64_t us);
+void statsRecordSince(const char *name, uint64_t start);
+StatsHist **statsList(int *count);
+void statsSnapshot(StatsHist *h, StatsSnapshot *snap);
+uint64_t statsBucketMax(int index);
+sds statsInfo(void);
+StatsCounter *statsCounter(const char *name);
+void statsAdd(StatsCounter *c, int64_t n);
+void statsIncr(const char *name, int64_t n);
+StatsCounter **statsCounterList(int *count);
+
+#endif
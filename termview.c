@@ -0,0 +1,160 @@
+/* ============================================================================
+ * Emulated terminal views.
+ *
+ * Backends that receive the raw output of their sessions, like the pty and
+ * tmux ones, keep the screen with the terminal emulator (vt.c), and derive
+ * both the text snapshots and the screenshots (render.c) from it. Only the
+ * rows changed since the last call are converted again. The rows that
+ * scroll off the screen are kept in a scrollback (scrollback.c), searched
+ * and paged together with the screen.
+ * ==========================================================================*/
+
+#include <string.h>
+
+#include "termview.h"
+#include "xmalloc.h"
+
+#define TERMVIEW_OUTPUT_MAX (1024*1024)         /* Max followed output not
+                                                   collected yet. */
+
+/* Create the view of a screen of the specified size. */
+TermView *termViewCreate(int rows, int cols) {
+    int words = (rows+63)/64;
+    TermView *tv = xmalloc(sizeof(*tv));
+    tv->vt = vtCreate(rows, cols);
+    tv->render = renderCreate(rows, cols);
+    tv->text = xmalloc(sizeof(sds)*rows);
+    for (int y = 0; y < rows; y++) tv->text[y] = sdsempty();
+    tv->text_dirty = xmalloc(sizeof(uint64_t)*words);
+    tv->render_dirty = xmalloc(sizeof(uint64_t)*words);
+    memset(tv->text_dirty, 0xff, sizeof(uint64_t)*words);
+    memset(tv->render_dirty, 0xff, sizeof(uint64_t)*words);
+    tv->history = scrollbackCreate(SCROLLBACK_MAX_SIZE, SCROLLBACK_MAX_LINES);
+    tv->vt->scrollback = tv->history;
+    tv->output = NULL;
+    return tv;
+}
+
+void termViewFree(TermView *tv) {
+    if (!tv) return;
+    for (int y = 0; y < tv->vt->rows; y++) sdsfree(tv->text[y]);
+    xfree(tv->text);
+    xfree(tv->text_dirty);
+    xfree(tv->render_dirty);
+    renderFree(tv->render);
+    vtFree(tv->vt);
+    scrollbackFree(tv->history);
+    sdsfree(tv->output);
+    xfree(tv);
+}
+
+/* Feed output of the session to the terminal, and to the followed output
+ * if enabled. */
+void termViewWrite(TermView *tv, const char *buf, size_t len) {
+    vtWrite(tv->vt, buf, len);
+    if (!tv->output) return;
+    tv->output = ansiStrip(&tv->strip, tv->output, buf, len);
+    /* Nobody is collecting it: keep only the most recent part. */
+    if (sdslen(tv->output) > TERMVIEW_OUTPUT_MAX)
+        sdsrange(tv->output, -TERMVIEW_OUTPUT_MAX/2, -1);
+}
+
+/* Start or stop keeping the output as plain text for termViewOutput(). */
+void termViewFollow(TermView *tv, int on) {
+    if (on && !tv->output) {
+        tv->output = sdsempty();
+        memset(&tv->strip, 0, sizeof(tv->strip));
+    } else if (!on) {
+        sdsfree(tv->output);
+        tv->output = NULL;
+    }
+}
+
+/* Return the output since the last call as plain text, or NULL if the
+ * view is not followed. */
+sds termViewOutput(TermView *tv) {
+    if (!tv->output) return NULL;
+    sds text = tv->output;
+    tv->output = sdsempty();
+    return text;
+}
+
+/* Move the rows changed in the terminal to the dirty rows of the text and
+ * of the frame. */
+static void collect_dirty(TermView *tv) {
+    for (int j = 0; j < (tv->vt->rows+63)/64; j++) {
+        tv->text_dirty[j] |= tv->vt->dirty[j];
+        tv->render_dirty[j] |= tv->vt->dirty[j];
+    }
+    vtClearDirty(tv->vt);
+}
+
+/* Convert the rows changed since the last call to text. */
+static void update_text(TermView *tv) {
+    VtScreen *vt = tv->vt;
+    char *buf = xmalloc((size_t)vt->cols*4+1);
+    collect_dirty(tv);
+    for (int y = 0; y < vt->rows; y++) {
+        if ((tv->text_dirty[y >> 6] >> (y & 63)) & 1) {
+            size_t len = vtRowText(vt, y, buf);
+            tv->text[y] = sdscpylen(tv->text[y], buf, len);
+        }
+    }
+    memset(tv->text_dirty, 0, sizeof(uint64_t)*((vt->rows+63)/64));
+    xfree(buf);
+}
+
+/* Return the text of the screen, a line per row. */
+sds termViewText(TermView *tv) {
+    update_text(tv);
+    sds text = sdsempty();
+    for (int y = 0; y < tv->vt->rows; y++) {
+        text = sdscatsds(text, tv->text[y]);
+        text = sdscatlen(text, "\n", 1);
+    }
+    return text;
+}
+
+/* Return the lines of the scrollback and of the screen containing
+ * 'pattern', with some context. */
+sds termViewGrep(TermView *tv, const char *pattern) {
+    update_text(tv);
+    return scrollbackGrep(tv->history, tv->text, tv->vt->rows, pattern);
+}
+
+/* Return a page of the scrollback, see scrollbackPage(). */
+sds termViewPage(TermView *tv, int page, int *pages) {
+    update_text(tv);
+    return scrollbackPage(tv->history, tv->text, tv->vt->rows, page, pages);
+}
+
+/* Render the screen and return a copy of it, or of 'region' (x, y, width,
+ * height in percent of the screen size) if not NULL. Returns NULL if the
+ * region is empty. */
+Frame *termViewCapture(TermView *tv, const double *region) {
+    collect_dirty(tv);
+    renderScreen(tv->render, tv->vt, tv->render_dirty);
+    memset(tv->render_dirty, 0, sizeof(uint64_t)*((tv->vt->rows+63)/64));
+
+    const Frame *src = tv->render->frame;
+    int x = 0, y = 0, width = src->width, height = src->height;
+    if (region) {
+        x = src->width * region[0] / 100;
+        y = src->height * region[1] / 100;
+        width = src->width * region[2] / 100;
+        height = src->height * region[3] / 100;
+        if (x < 0) x = 0;
+        if (y < 0) y = 0;
+        if (x + width > src->width) width = src->width - x;
+        if (y + height > src->height) height = src->height - y;
+    }
+    if (width <= 0 || height <= 0) return NULL;
+
+    Frame *f = frameCreate(width, height);
+    for (int j = 0; j < height; j++) {
+        memcpy(f->pixels + (size_t)j*f->stride,
+               src->pixels + (size_t)(y+j)*src->stride + (size_t)x*4,
+               (size_t)width*4);
+    }
+    return f;
+}
@@ -0,0 +1,40 @@
+#ifndef TERMVIEW_H
+#define TERMVIEW_H
+
+#include <stdint.h>
+
+#include "sds.h"
+#include "frame.h"
+#include "vt.h"
+#include "render.h"
+#include "scrollback.h"
+#include "ansi.h"
+
+/* The screen of a session whose output the bot emulates itself, with the
+ * text and the screenshot derived from it. Text and screenshots are
+ * updated at different times, so each keeps its own copy of the rows
+ * changed since. Not thread safe: the backend serializes the calls. */
+typedef struct TermView {
+    VtScreen *vt;               /* Fed by termViewWrite(). */
+    Renderer *render;
+    sds *text;                  /* Text of every row, updated only for the
+                                   dirty rows. */
+    uint64_t *text_dirty;       /* Rows changed since the text and the */
+    uint64_t *render_dirty;     /* frame were updated. */
+    Scrollback *history;        /* Rows scrolled off the screen. */
+    sds output;                 /* Output as plain text since the last
+                                   termViewOutput(), NULL if not followed. */
+    AnsiStrip strip;
+} TermView;
+
+TermView *termViewCreate(int rows, int cols);
+void termViewFree(TermView *tv);
+void termViewWrite(TermView *tv, const char *buf, size_t len);
+sds termViewText(TermView *tv);
+Frame *termViewCapture(TermView *tv, const double *region);
+sds termViewGrep(TermView *tv, const char *pattern);
+sds termViewPage(TermView *tv, int page, int *pages);
+void termViewFollow(TermView *tv, int on);
+sds termViewOutput(TermView *tv);
+
+#endif
@@ -0,0 +1,153 @@
+/* ============================================================================
+ * Trace events.
+ *
+ * With --trace <file> every duration timed for the stats (update parsing,
+ * dispatch, waiting for the request lock, Telegram calls, pipeline stages,
+ * sleeps) is also written to the file as a Chrome trace event, together
+ * with the thread that spent it, so that the polling loop, the request
+ * threads and the pipeline can be seen on a timeline in Perfetto or
+ * chrome://tracing, with their overlaps and who waits for whom.
+ *
+ * Tracing must not change the timing it shows, so threads never wait for
+ * the file: every thread appends its events to its own ring buffer, with
+ * no locks, and a background thread writes them out every TRACE_FLUSH_MS.
+ * When a buffer is full its events are dropped, and counted. The file uses
+ * the JSON array format, where the closing bracket is optional, so it can
+ * be loaded at any time, even after the bot was killed.
+ * ==========================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "trace.h"
+#include "stats.h"
+#include "xmalloc.h"
+
+static FILE *TraceFile = NULL;
+static _Atomic int Enabled = 0;
+static TraceBuffer *_Atomic Buffers = NULL;    /* Every buffer ever made. */
+static _Atomic uint32_t NextTid = 1;
+static pthread_key_t BufferKey;                 /* To know when threads exit. */
+static StatsCounter *Dropped = NULL;
+
+static _Thread_local TraceBuffer *Buffer = NULL;
+static _Thread_local uint32_t Tid = 0;
+
+/* Called when a thread exits: its buffer is free for another thread. The
+ * events not flushed yet are flushed as usual. */
+static void release_buffer(void *arg) {
+    TraceBuffer *b = arg;
+    atomic_store_explicit(&b->owned, 0, memory_order_release);
+}
+
+/* Return the buffer of the calling thread. The first time, take a buffer
+ * left by a thread that exited, or make a new one. */
+static TraceBuffer *thread_buffer(void) {
+    if (Buffer) return Buffer;
+
+    TraceBuffer *b = atomic_load_explicit(&Buffers, memory_order_acquire);
+    for (; b; b = b->next) {
+        int expected = 0;
+        if (atomic_compare_exchange_strong_explicit(&b->owned, &expected, 1,
+                memory_order_acquire, memory_order_relaxed)) break;
+    }
+    if (!b) {
+        b = xmalloc(sizeof(*b));
+        memset(b, 0, sizeof(*b));
+        atomic_init(&b->owned, 1);
+        b->next = atomic_load(&Buffers);
+        while (!atomic_compare_exchange_weak(&Buffers, &b->next, b));
+    }
+    pthread_setspecific(BufferKey, b);
+    Tid = atomic_fetch_add(&NextTid, 1);
+    Buffer = b;
+    return b;
+}
+
+/* Append an event to the buffer of the calling thread. */
+static void add_event(const char *name, uint64_t ts, uint64_t dur) {
+    TraceBuffer *b = thread_buffer();
+    uint64_t head = atomic_load_explicit(&b->head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&b->tail, memory_order_acquire) == TRACE_BUFFER_LEN) {
+        statsAdd(Dropped, 1);
+        return;
+    }
+    TraceEvent *e = &b->events[head % TRACE_BUFFER_LEN];
+    e->name = name;
+    e->ts = ts;
+    e->dur = dur;
+    e->tid = Tid;
+    atomic_store_explicit(&b->head, head+1, memory_order_release);
+}
+
+/* Record a span of 'us' microseconds ending now. Does nothing if tracing
+ * is off. Called by statsRecord() for every duration recorded. */
+void traceRecord(const char *name, uint64_t us) {
+    if (!atomic_load_explicit(&Enabled, memory_order_relaxed)) return;
+    add_event(name, statsUstime() - us, us);
+}
+
+/* Record a span from 'start', a statsUstime() time, to now. For durations
+ * that are only interesting on the timeline. */
+void traceRecordSince(const char *name, uint64_t start) {
+    if (!atomic_load_explicit(&Enabled, memory_order_relaxed)) return;
+    add_event(name, start, statsUstime() - start);
+}
+
+/* Name the calling thread on the timeline. */
+void traceThreadName(const char *name) {
+    if (!atomic_load_explicit(&Enabled, memory_order_relaxed)) return;
+    add_event(name, 0, TRACE_THREAD_NAME);
+}
+
+static void write_event(const TraceEvent *e, int pid) {
+    if (e->dur == TRACE_THREAD_NAME) {
+        fprintf(TraceFile, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,"
+                "\"tid\":%u,\"args\":{\"name\":\"%s\"}},\n", pid, e->tid, e->name);
+    } else {
+        fprintf(TraceFile, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%u,"
+                "\"ts\":%llu,\"dur\":%llu},\n", e->name, pid, e->tid,
+                (unsigned long long)e->ts, (unsigned long long)e->dur);
+    }
+}
+
+static void *flush_main(void *arg) {
+    (void)arg;
+    int pid = getpid();
+    while (1) {
+        usleep(TRACE_FLUSH_MS * 1000);
+        TraceBuffer *b = atomic_load_explicit(&Buffers, memory_order_acquire);
+        for (; b; b = b->next) {
+            uint64_t tail = atomic_load_explicit(&b->tail, memory_order_relaxed);
+            uint64_t head = atomic_load_explicit(&b->head, memory_order_acquire);
+            for (; tail < head; tail++)
+                write_event(&b->events[tail % TRACE_BUFFER_LEN], pid);
+            atomic_store_explicit(&b->tail, tail, memory_order_release);
+        }
+        fflush(TraceFile);
+    }
+    return NULL;
+}
+
+/* Start writing trace events to the file at 'path'. Returns 0 on success,
+ * -1 on error. */
+int traceStart(const char *path) {
+    TraceFile = fopen(path, "w");
+    if (!TraceFile) return -1;
+    fputs("[\n", TraceFile);
+    pthread_key_create(&BufferKey, release_buffer);
+    Dropped = statsCounter("trace_dropped_total");
+
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, flush_main, NULL) != 0) {
+        fclose(TraceFile);
+        TraceFile = NULL;
+        return -1;
+    }
+    pthread_detach(tid);
+    atomic_store(&Enabled, 1);
+    return 0;
+}
@@ -0,0 +1,35 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+#define TRACE_BUFFER_LEN 4096       /* Events buffered per thread. */
+#define TRACE_FLUSH_MS 250          /* Interval of the background flush. */
+#define TRACE_THREAD_NAME UINT64_MAX
+
+/* A completed span, or a thread name if 'dur' is TRACE_THREAD_NAME. */
+typedef struct TraceEvent {
+    const char *name;           /* Static string, never freed. */
+    uint64_t ts;                /* Start, statsUstime() time. */
+    uint64_t dur;
+    uint32_t tid;
+} TraceEvent;
+
+/* Events of a thread, written by the thread and read by the flusher
+ * without locks. A buffer is used by one thread at a time, and passed to
+ * a new thread when its owner exits. */
+typedef struct TraceBuffer {
+    TraceEvent events[TRACE_BUFFER_LEN];
+    _Atomic uint64_t head;      /* Events written, only the owner writes. */
+    _Atomic uint64_t tail;      /* Events flushed, only the flusher writes. */
+    _Atomic int owned;          /* True while a thread writes to it. */
+    struct TraceBuffer *next;   /* Next buffer in the list of all of them. */
+} TraceBuffer;
+
+int traceStart(const char *path);
+void traceRecord(const char *name, uint64_t us);
+void traceRecordSince(const char *name, uint64_t start);
+void traceThreadName(const char *name);
+
+#endif
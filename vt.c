@@ -0,0 +1,770 @@
+/* ============================================================================
+ * Terminal emulator: a VT100/xterm escape sequence parser over a cell grid.
+ *
+ * Sessions owned by the bot have no terminal application drawing them,
+ * so we keep the screen ourselves. The parser implements what shells,
+ * compilers and full screen programs commonly use with TERM=xterm-256color:
+ * cursor movement, erasing, scrolling regions, insert and delete, colors
+ * and the alternate screen. Everything else is parsed and ignored.
+ *
+ * Rows changed by the output are marked in a bitmap, so that consumers
+ * only need to look at the rows modified since they last cleared it.
+ * ==========================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vt.h"
+#include "xmalloc.h"
+
+/* Parser states. */
+#define VT_GROUND 0
+#define VT_ESC 1            /* After ESC. */
+#define VT_ESC_INTER 2      /* After ESC and an intermediate byte. */
+#define VT_CSI 3            /* Control sequence parameters. */
+#define VT_OSC 4            /* Operating system command string. */
+#define VT_OSC_ESC 5        /* ESC inside OSC, maybe the terminator. */
+#define VT_STRING 6         /* DCS, SOS, PM or APC string, ignored. */
+#define VT_STRING_ESC 7
+
+#define VT_REPLACEMENT 0xFFFD
+
+/* Return true if 'c' is a Unicode scalar value: not a surrogate, and not
+ * past U+10FFFF. */
+static int is_scalar(uint32_t c) {
+    return c <= 0x10ffff && (c < 0xd800 || c > 0xdfff);
+}
+
+/* DEC special graphics, for the characters from 0x60 to 0x7e. */
+static const uint16_t LineDrawing[31] = {
+    0x25c6, 0x2592, 0x2409, 0x240c, 0x240d, 0x240a, 0x00b0, 0x00b1,
+    0x2424, 0x240b, 0x2518, 0x2510, 0x250c, 0x2514, 0x253c, 0x23ba,
+    0x23bb, 0x2500, 0x23bc, 0x23bd, 0x251c, 0x2524, 0x2534, 0x252c,
+    0x2502, 0x2264, 0x2265, 0x03c0, 0x2260, 0x00a3, 0x00b7
+};
+
+/* Return the number of cells taken by the character: 0 for combining
+ * marks, that we drop, 2 for East Asian wide characters and emoji. */
+static int char_width(uint32_t c) {
+    if (c < 0x300) return 1;
+    if (c <= 0x36f || (c >= 0x1ab0 && c <= 0x1aff) ||
+        (c >= 0x1dc0 && c <= 0x1dff) || (c >= 0x200b && c <= 0x200f) ||
+        (c >= 0x20d0 && c <= 0x20ff) || (c >= 0xfe00 && c <= 0xfe0f))
+        return 0;
+    if ((c >= 0x1100 && c <= 0x115f) ||
+        (c >= 0x2e80 && c <= 0xa4cf && c != 0x303f) ||
+        (c >= 0xac00 && c <= 0xd7a3) || (c >= 0xf900 && c <= 0xfaff) ||
+        (c >= 0xfe30 && c <= 0xfe4f) || (c >= 0xff00 && c <= 0xff60) ||
+        (c >= 0xffe0 && c <= 0xffe6) || (c >= 0x1f300 && c <= 0x1f64f) ||
+        (c >= 0x1f900 && c <= 0x1f9ff) || (c >= 0x20000 && c <= 0x3fffd))
+        return 2;
+    return 1;
+}
+
+/* ============================================================================
+ * Grid operations
+ * ==========================================================================*/
+
+static void mark_dirty(VtScreen *vt, int y) {
+    vt->dirty[y >> 6] |= 1ULL << (y & 63);
+}
+
+static void mark_all_dirty(VtScreen *vt) {
+    for (int y = 0; y < vt->rows; y++) mark_dirty(vt, y);
+}
+
+/* Erase the cells from column x0 to x1 (excluded) of row 'y'. Erased
+ * cells take the background of the pen, like xterm does. */
+static void erase_cells(VtScreen *vt, int y, int x0, int x1) {
+    VtGrid *g = vt->grid;
+    size_t i = VT_CELL(vt, 0, y);
+    for (int x = x0; x < x1; x++) {
+        g->cp[i+x] = ' ';
+        g->attr[i+x] = 0;
+        g->fg[i+x] = VT_COLOR_DEFAULT;
+        g->bg[i+x] = vt->pen.bg;
+    }
+    mark_dirty(vt, y);
+}
+
+static void erase_rows(VtScreen *vt, int y0, int y1) {
+    for (int y = y0; y < y1; y++) erase_cells(vt, y, 0, vt->cols);
+}
+
+/* Move 'n' cells of row 'y' from column 'src' to column 'dst'. */
+static void move_cells(VtScreen *vt, int y, int dst, int src, int n) {
+    VtGrid *g = vt->grid;
+    size_t i = VT_CELL(vt, 0, y);
+    memmove(g->cp+i+dst, g->cp+i+src, n*sizeof(*g->cp));
+    memmove(g->attr+i+dst, g->attr+i+src, n*sizeof(*g->attr));
+    memmove(g->fg+i+dst, g->fg+i+src, n*sizeof(*g->fg));
+    memmove(g->bg+i+dst, g->bg+i+src, n*sizeof(*g->bg));
+    mark_dirty(vt, y);
+}
+
+/* Scroll rows 'top' to 'bottom' up by 'n', clearing the rows that enter
+ * at the bottom. Only the row map is rotated, no cell moves. The rows
+ * leaving the top of the main screen are saved in the scrollback. */
+static void scroll_up(VtScreen *vt, int top, int bottom, int n) {
+    int height = bottom - top + 1;
+    if (n > height) n = height;
+    if (vt->scrollback && top == 0 && vt->grid == &vt->main) {
+        char buf[vt->cols*4+1];
+        for (int y = 0; y < n; y++) {
+            size_t len = vtRowText(vt, y, buf);
+            scrollbackAppend(vt->scrollback, buf, len);
+        }
+    }
+    int *lines = vt->grid->lines;
+    int saved[n];
+    memcpy(saved, lines+top, n*sizeof(int));
+    memmove(lines+top, lines+top+n, (height-n)*sizeof(int));
+    memcpy(lines+bottom-n+1, saved, n*sizeof(int));
+    erase_rows(vt, bottom-n+1, bottom+1);
+    for (int y = top; y <= bottom; y++) mark_dirty(vt, y);
+}
+
+/* Scroll rows 'top' to 'bottom' down by 'n', clearing the rows that
+ * enter at the top. */
+static void scroll_down(VtScreen *vt, int top, int bottom, int n) {
+    int height = bottom - top + 1;
+    if (n > height) n = height;
+    int *lines = vt->grid->lines;
+    int saved[n];
+    memcpy(saved, lines+bottom-n+1, n*sizeof(int));
+    memmove(lines+top+n, lines+top, (height-n)*sizeof(int));
+    memcpy(lines+top, saved, n*sizeof(int));
+    erase_rows(vt, top, top+n);
+    for (int y = top; y <= bottom; y++) mark_dirty(vt, y);
+}
+
+static void linefeed(VtScreen *vt) {
+    if (vt->cy == vt->bottom) scroll_up(vt, vt->top, vt->bottom, 1);
+    else if (vt->cy < vt->rows-1) vt->cy++;
+}
+
+static void reverse_index(VtScreen *vt) {
+    if (vt->cy == vt->top) scroll_down(vt, vt->top, vt->bottom, 1);
+    else if (vt->cy > 0) vt->cy--;
+}
+
+/* Move the cursor, clamping it to the screen. */
+static void move_cursor(VtScreen *vt, int x, int y) {
+    vt->cx = x < 0 ? 0 : (x >= vt->cols ? vt->cols-1 : x);
+    vt->cy = y < 0 ? 0 : (y >= vt->rows ? vt->rows-1 : y);
+    vt->wrap_pending = 0;
+}
+
+/* Before overwriting 'n' cells at the cursor, erase the other half of the
+ * wide characters they split. */
+static void split_wide(VtScreen *vt, int n) {
+    VtGrid *g = vt->grid;
+    size_t i = VT_CELL(vt, 0, vt->cy);
+    int x0 = vt->cx, x1 = vt->cx + n - 1;
+    if ((g->attr[i+x0] & VT_ATTR_WIDE_TAIL) && x0 > 0)
+        erase_cells(vt, vt->cy, x0-1, x0);
+    if ((g->attr[i+x1] & VT_ATTR_WIDE) && x1+1 < vt->cols)
+        erase_cells(vt, vt->cy, x1+1, x1+2);
+}
+
+/* Write a run of printable ASCII characters: the common case, so cells
+ * are filled a row at a time. */
+static void put_ascii(VtScreen *vt, const unsigned char *s, size_t n) {
+    VtGrid *g = vt->grid;
+    while (n) {
+        if (vt->wrap_pending) {
+            vt->cx = 0;
+            vt->wrap_pending = 0;
+            linefeed(vt);
+        }
+        size_t room = vt->cols - vt->cx;
+        int k = n < room ? n : room;
+        split_wide(vt, k);
+        size_t i = VT_CELL(vt, vt->cx, vt->cy);
+        for (int x = 0; x < k; x++) {
+            g->cp[i+x] = s[x];
+            g->attr[i+x] = vt->pen.attr;
+            g->fg[i+x] = vt->pen.fg;
+            g->bg[i+x] = vt->pen.bg;
+        }
+        mark_dirty(vt, vt->cy);
+        vt->last_cp = s[k-1];
+        s += k;
+        n -= k;
+        vt->cx += k;
+        if (vt->cx >= vt->cols) {
+            vt->cx = vt->cols-1;
+            vt->wrap_pending = vt->autowrap;
+        }
+    }
+}
+
+/* Write any character at the cursor. */
+static void put_char(VtScreen *vt, uint32_t c) {
+    if (vt->line_drawing && c >= 0x60 && c <= 0x7e) c = LineDrawing[c-0x60];
+    int width = char_width(c);
+    if (width == 0) return;
+    if (width == 2 && vt->cols < 2) {
+        /* A wide character can never fit a single column screen. */
+        c = VT_REPLACEMENT;
+        width = 1;
+    }
+
+    if (vt->wrap_pending) {
+        vt->cx = 0;
+        vt->wrap_pending = 0;
+        linefeed(vt);
+    }
+    if (width == 2 && vt->cx == vt->cols-1) {
+        /* No room for a wide character on this line. */
+        erase_cells(vt, vt->cy, vt->cx, vt->cols);
+        if (!vt->autowrap) return;
+        vt->cx = 0;
+        linefeed(vt);
+    }
+
+    VtGrid *g = vt->grid;
+    split_wide(vt, width);
+    size_t i = VT_CELL(vt, vt->cx, vt->cy);
+    g->cp[i] = c;
+    g->attr[i] = vt->pen.attr | (width == 2 ? VT_ATTR_WIDE : 0);
+    g->fg[i] = vt->pen.fg;
+    g->bg[i] = vt->pen.bg;
+    if (width == 2) {
+        g->cp[i+1] = ' ';
+        g->attr[i+1] = vt->pen.attr | VT_ATTR_WIDE_TAIL;
+        g->fg[i+1] = vt->pen.fg;
+        g->bg[i+1] = vt->pen.bg;
+    }
+    mark_dirty(vt, vt->cy);
+    vt->last_cp = c;
+    vt->cx += width;
+    if (vt->cx >= vt->cols) {
+        vt->cx = vt->cols-1;
+        vt->wrap_pending = vt->autowrap;
+    }
+}
+
+static void save_cursor(VtScreen *vt) {
+    vt->saved_cx = vt->cx;
+    vt->saved_cy = vt->cy;
+    vt->saved_pen = vt->pen;
+}
+
+static void restore_cursor(VtScreen *vt) {
+    vt->pen = vt->saved_pen;
+    move_cursor(vt, vt->saved_cx, vt->saved_cy);
+}
+
+/* Switch between the normal and the alternate screen. */
+static void use_alt_screen(VtScreen *vt, int alt) {
+    VtGrid *g = alt ? &vt->alt : &vt->main;
+    if (vt->grid == g) return;
+    vt->grid = g;
+    if (alt) erase_rows(vt, 0, vt->rows);
+    mark_all_dirty(vt);
+}
+
+static void reset(VtScreen *vt) {
+    memset(&vt->pen, 0, sizeof(vt->pen));
+    vt->grid = &vt->alt;
+    erase_rows(vt, 0, vt->rows);
+    vt->grid = &vt->main;
+    erase_rows(vt, 0, vt->rows);
+    vt->cx = vt->cy = 0;
+    vt->wrap_pending = 0;
+    vt->cursor_hidden = 0;
+    vt->autowrap = 1;
+    vt->top = 0;
+    vt->bottom = vt->rows-1;
+    vt->line_drawing = 0;
+    save_cursor(vt);
+    for (int x = 0; x < vt->cols; x++) vt->tabs[x] = x % 8 == 0;
+    vt->state = VT_GROUND;
+    vt->utf8_left = 0;
+    vt->title[0] = '\0';
+}
+
+/* Queue an answer to a query of the program. */
+static void reply(VtScreen *vt, const char *s) {
+    size_t len = strlen(s);
+    if (vt->replylen + len > VT_REPLY_MAX) return;
+    memcpy(vt->reply + vt->replylen, s, len);
+    vt->replylen += len;
+}
+
+/* ============================================================================
+ * Control sequences
+ * ==========================================================================*/
+
+/* Return parameter 'i', or 'def' if missing or zero. */
+static int param(VtScreen *vt, int i, int def) {
+    return i < vt->nparams && vt->params[i] ? vt->params[i] : def;
+}
+
+/* Return the color starting at parameter '*i' after 38 or 48, advancing
+ * '*i' past it. */
+static uint32_t extended_color(VtScreen *vt, int *i) {
+    int j = *i;
+    if (j+2 < vt->nparams && vt->params[j+1] == 5) {
+        *i = j+2;
+        return VT_COLOR_INDEX(vt->params[j+2] & 255);
+    }
+    if (j+4 < vt->nparams && vt->params[j+1] == 2) {
+        *i = j+4;
+        return VT_COLOR_RGB(vt->params[j+2] & 255, vt->params[j+3] & 255,
+                            vt->params[j+4] & 255);
+    }
+    *i = vt->nparams;
+    return VT_COLOR_DEFAULT;
+}
+
+/* Select graphic rendition: set the attributes and colors of the pen. */
+static void sgr(VtScreen *vt) {
+    VtPen *pen = &vt->pen;
+    if (vt->nparams == 0) {
+        memset(pen, 0, sizeof(*pen));
+        return;
+    }
+    for (int i = 0; i < vt->nparams; i++) {
+        int p = vt->params[i];
+        if (p == 0) memset(pen, 0, sizeof(*pen));
+        else if (p == 1) pen->attr |= VT_ATTR_BOLD;
+        else if (p == 2) pen->attr |= VT_ATTR_DIM;
+        else if (p == 3) pen->attr |= VT_ATTR_ITALIC;
+        else if (p == 4) pen->attr |= VT_ATTR_UNDERLINE;
+        else if (p == 5 || p == 6) pen->attr |= VT_ATTR_BLINK;
+        else if (p == 7) pen->attr |= VT_ATTR_REVERSE;
+        else if (p == 8) pen->attr |= VT_ATTR_HIDDEN;
+        else if (p == 9) pen->attr |= VT_ATTR_STRIKE;
+        else if (p == 21 || p == 22) pen->attr &= ~(VT_ATTR_BOLD|VT_ATTR_DIM);
+        else if (p == 23) pen->attr &= ~VT_ATTR_ITALIC;
+        else if (p == 24) pen->attr &= ~VT_ATTR_UNDERLINE;
+        else if (p == 25) pen->attr &= ~VT_ATTR_BLINK;
+        else if (p == 27) pen->attr &= ~VT_ATTR_REVERSE;
+        else if (p == 28) pen->attr &= ~VT_ATTR_HIDDEN;
+        else if (p == 29) pen->attr &= ~VT_ATTR_STRIKE;
+        else if (p >= 30 && p <= 37) pen->fg = VT_COLOR_INDEX(p-30);
+        else if (p == 38) pen->fg = extended_color(vt, &i);
+        else if (p == 39) pen->fg = VT_COLOR_DEFAULT;
+        else if (p >= 40 && p <= 47) pen->bg = VT_COLOR_INDEX(p-40);
+        else if (p == 48) pen->bg = extended_color(vt, &i);
+        else if (p == 49) pen->bg = VT_COLOR_DEFAULT;
+        else if (p >= 90 && p <= 97) pen->fg = VT_COLOR_INDEX(p-90+8);
+        else if (p >= 100 && p <= 107) pen->bg = VT_COLOR_INDEX(p-100+8);
+    }
+}
+
+/* Set or reset the modes of a CSI h or l sequence. */
+static void set_modes(VtScreen *vt, int on) {
+    if (vt->private != '?') return;
+    for (int i = 0; i < vt->nparams; i++) {
+        switch (vt->params[i]) {
+        case 7: vt->autowrap = on; break;
+        case 25: vt->cursor_hidden = !on; break;
+        case 47:
+        case 1047: use_alt_screen(vt, on); break;
+        case 1048: if (on) save_cursor(vt); else restore_cursor(vt); break;
+        case 1049:
+            if (on) save_cursor(vt);
+            use_alt_screen(vt, on);
+            if (!on) restore_cursor(vt);
+            break;
+        }
+    }
+}
+
+static void csi_dispatch(VtScreen *vt, unsigned char final) {
+    int n = param(vt, 0, 1);
+    char buf[32];
+
+    /* Sequences with intermediates, like DECSCUSR, don't change the
+     * screen. */
+    if (vt->intermediate) return;
+
+    switch (final) {
+    case '@':       /* ICH: insert blank characters. */
+        if (n > vt->cols - vt->cx) n = vt->cols - vt->cx;
+        move_cells(vt, vt->cy, vt->cx+n, vt->cx, vt->cols - vt->cx - n);
+        erase_cells(vt, vt->cy, vt->cx, vt->cx+n);
+        break;
+    case 'A': move_cursor(vt, vt->cx, vt->cy - n); break;
+    case 'B': move_cursor(vt, vt->cx, vt->cy + n); break;
+    case 'C': move_cursor(vt, vt->cx + n, vt->cy); break;
+    case 'D': move_cursor(vt, vt->cx - n, vt->cy); break;
+    case 'E': move_cursor(vt, 0, vt->cy + n); break;
+    case 'F': move_cursor(vt, 0, vt->cy - n); break;
+    case 'G':
+    case '`': move_cursor(vt, n-1, vt->cy); break;
+    case 'H':
+    case 'f': move_cursor(vt, param(vt, 1, 1) - 1, n-1); break;
+    case 'I':       /* CHT: forward tabs. */
+        while (n-- > 0) {
+            int x = vt->cx + 1;
+            while (x < vt->cols-1 && !vt->tabs[x]) x++;
+            move_cursor(vt, x, vt->cy);
+        }
+        break;
+    case 'Z':       /* CBT: backward tabs. */
+        while (n-- > 0) {
+            int x = vt->cx - 1;
+            while (x > 0 && !vt->tabs[x]) x--;
+            move_cursor(vt, x, vt->cy);
+        }
+        break;
+    case 'J':       /* ED: erase in display. */
+        switch (param(vt, 0, 0)) {
+        case 0:
+            erase_cells(vt, vt->cy, vt->cx, vt->cols);
+            erase_rows(vt, vt->cy+1, vt->rows);
+            break;
+        case 1:
+            erase_rows(vt, 0, vt->cy);
+            erase_cells(vt, vt->cy, 0, vt->cx+1);
+            break;
+        default: erase_rows(vt, 0, vt->rows); break;
+        }
+        break;
+    case 'K':       /* EL: erase in line. */
+        switch (param(vt, 0, 0)) {
+        case 0: erase_cells(vt, vt->cy, vt->cx, vt->cols); break;
+        case 1: erase_cells(vt, vt->cy, 0, vt->cx+1); break;
+        default: erase_cells(vt, vt->cy, 0, vt->cols); break;
+        }
+        break;
+    case 'L':       /* IL: insert lines. */
+        if (vt->cy >= vt->top && vt->cy <= vt->bottom) {
+            scroll_down(vt, vt->cy, vt->bottom, n);
+            vt->cx = 0;
+        }
+        break;
+    case 'M':       /* DL: delete lines. */
+        if (vt->cy >= vt->top && vt->cy <= vt->bottom) {
+            scroll_up(vt, vt->cy, vt->bottom, n);
+            vt->cx = 0;
+        }
+        break;
+    case 'P':       /* DCH: delete characters. */
+        if (n > vt->cols - vt->cx) n = vt->cols - vt->cx;
+        move_cells(vt, vt->cy, vt->cx, vt->cx+n, vt->cols - vt->cx - n);
+        erase_cells(vt, vt->cy, vt->cols-n, vt->cols);
+        break;
+    case 'S': scroll_up(vt, vt->top, vt->bottom, n); break;
+    case 'T': scroll_down(vt, vt->top, vt->bottom, n); break;
+    case 'X':       /* ECH: erase characters. */
+        erase_cells(vt, vt->cy, vt->cx,
+                    vt->cx + n < vt->cols ? vt->cx + n : vt->cols);
+        break;
+    case 'b':       /* REP: repeat the last character. */
+        while (n-- > 0 && vt->last_cp) put_char(vt, vt->last_cp);
+        break;
+    case 'c':       /* DA: identify as a VT102, like xterm -ti vt102. */
+        if (vt->private == 0) reply(vt, "\033[?6c");
+        else if (vt->private == '>') reply(vt, "\033[>0;0;0c");
+        break;
+    case 'd': move_cursor(vt, vt->cx, n-1); break;
+    case 'g':       /* TBC: clear tab stops. */
+        if (param(vt, 0, 0) == 0) vt->tabs[vt->cx] = 0;
+        else if (param(vt, 0, 0) == 3) memset(vt->tabs, 0, vt->cols);
+        break;
+    case 'h': set_modes(vt, 1); break;
+    case 'l': set_modes(vt, 0); break;
+    case 'm': if (vt->private == 0) sgr(vt); break;
+    case 'n':       /* DSR: status and cursor position reports. */
+        if (vt->private) break;
+        if (param(vt, 0, 0) == 5) {
+            reply(vt, "\033[0n");
+        } else if (param(vt, 0, 0) == 6) {
+            snprintf(buf, sizeof(buf), "\033[%d;%dR", vt->cy+1, vt->cx+1);
+            reply(vt, buf);
+        }
+        break;
+    case 'r': {     /* DECSTBM: set the scrolling region. */
+        if (vt->private) break;
+        int top = param(vt, 0, 1) - 1, bottom = param(vt, 1, vt->rows) - 1;
+        if (bottom >= vt->rows) bottom = vt->rows-1;
+        if (top < bottom) {
+            vt->top = top;
+            vt->bottom = bottom;
+            move_cursor(vt, 0, 0);
+        }
+        break;
+    }
+    case 's': if (vt->private == 0) save_cursor(vt); break;
+    case 'u': if (vt->private == 0) restore_cursor(vt); break;
+    }
+}
+
+static void esc_dispatch(VtScreen *vt, unsigned char final) {
+    if (vt->intermediate == '(') {
+        vt->line_drawing = final == '0';
+        return;
+    }
+    if (vt->intermediate) return;
+
+    switch (final) {
+    case '7': save_cursor(vt); break;
+    case '8': restore_cursor(vt); break;
+    case 'D': linefeed(vt); break;
+    case 'E': vt->cx = 0; linefeed(vt); break;
+    case 'H': vt->tabs[vt->cx] = 1; break;
+    case 'M': reverse_index(vt); break;
+    case 'c': reset(vt); break;
+    }
+}
+
+/* Handle a complete OSC string: we only care about the title. */
+static void osc_dispatch(VtScreen *vt) {
+    vt->osc[vt->osclen] = '\0';
+    if ((vt->osc[0] == '0' || vt->osc[0] == '2') && vt->osc[1] == ';')
+        memcpy(vt->title, vt->osc+2, vt->osclen-1);
+}
+
+/* Execute a C0 control character. */
+static void control(VtScreen *vt, unsigned char c) {
+    switch (c) {
+    case '\b':
+        if (vt->cx > 0) vt->cx--;
+        vt->wrap_pending = 0;
+        break;
+    case '\t': {
+        int x = vt->cx + 1;
+        while (x < vt->cols-1 && !vt->tabs[x]) x++;
+        move_cursor(vt, x, vt->cy);
+        break;
+    }
+    case '\n':
+    case '\v':
+    case '\f':
+        linefeed(vt);
+        vt->wrap_pending = 0;
+        break;
+    case '\r':
+        vt->cx = 0;
+        vt->wrap_pending = 0;
+        break;
+    case 0x18:      /* CAN and SUB abort sequences. */
+    case 0x1a:
+        vt->state = VT_GROUND;
+        break;
+    case 0x1b:
+        vt->state = VT_ESC;
+        vt->intermediate = 0;
+        break;
+    }
+}
+
+/* ============================================================================
+ * Public API
+ * ==========================================================================*/
+
+static void grid_init(VtGrid *g, int rows, int cols) {
+    size_t cells = (size_t)rows*cols;
+    g->lines = xmalloc(sizeof(int)*rows);
+    for (int y = 0; y < rows; y++) g->lines[y] = y;
+    g->cp = xmalloc(sizeof(*g->cp)*cells);
+    g->attr = xmalloc(sizeof(*g->attr)*cells);
+    g->fg = xmalloc(sizeof(*g->fg)*cells);
+    g->bg = xmalloc(sizeof(*g->bg)*cells);
+}
+
+static void grid_free(VtGrid *g) {
+    xfree(g->lines);
+    xfree(g->cp);
+    xfree(g->attr);
+    xfree(g->fg);
+    xfree(g->bg);
+}
+
+/* Create a screen of the specified size, blank and with the cursor at
+ * the top left corner. */
+VtScreen *vtCreate(int rows, int cols) {
+    VtScreen *vt = xmalloc(sizeof(*vt));
+    memset(vt, 0, sizeof(*vt));
+    vt->rows = rows;
+    vt->cols = cols;
+    grid_init(&vt->main, rows, cols);
+    grid_init(&vt->alt, rows, cols);
+    vt->dirty = xmalloc(sizeof(uint64_t)*((rows+63)/64));
+    vt->tabs = xmalloc(cols);
+    reset(vt);
+    return vt;
+}
+
+void vtFree(VtScreen *vt) {
+    grid_free(&vt->main);
+    grid_free(&vt->alt);
+    xfree(vt->dirty);
+    xfree(vt->tabs);
+    xfree(vt);
+}
+
+/* Feed program output to the terminal. Sequences and UTF-8 characters can
+ * be split across calls. Answers to queries are appended to vt->reply. */
+void vtWrite(VtScreen *vt, const char *buf, size_t len) {
+    const unsigned char *p = (const unsigned char *)buf;
+    for (size_t j = 0; j < len; j++) {
+        unsigned char c = p[j];
+
+        if (vt->state == VT_GROUND) {
+            if (c >= 0x20 && c < 0x7f && !vt->utf8_left) {
+                size_t n = 1;
+                while (j+n < len && p[j+n] >= 0x20 && p[j+n] < 0x7f) n++;
+                if (vt->line_drawing) {
+                    for (size_t k = 0; k < n; k++) put_char(vt, p[j+k]);
+                } else {
+                    put_ascii(vt, p+j, n);
+                }
+                j += n-1;
+                continue;
+            }
+            if (c >= 0x80) {
+                if (c >= 0xc0) {
+                    if (vt->utf8_left) put_char(vt, VT_REPLACEMENT);
+                    if (c >= 0xf8) {
+                        /* Not a lead byte of any length. */
+                        vt->utf8_left = 0;
+                        put_char(vt, VT_REPLACEMENT);
+                        continue;
+                    }
+                    vt->utf8_left = c >= 0xf0 ? 3 : (c >= 0xe0 ? 2 : 1);
+                    vt->utf8_len = vt->utf8_left+1;
+                    vt->utf8 = c & (0x3f >> vt->utf8_left);
+                } else if (vt->utf8_left) {
+                    vt->utf8 = (vt->utf8 << 6) | (c & 0x3f);
+                    if (--vt->utf8_left == 0) {
+                        /* Only the shortest encoding is valid: an
+                         * overlong one could hide a control character. */
+                        static const uint32_t min[] = {0, 0, 0x80, 0x800, 0x10000};
+                        uint32_t cp = vt->utf8;
+                        if (cp < min[vt->utf8_len] || !is_scalar(cp))
+                            cp = VT_REPLACEMENT;
+                        put_char(vt, cp);
+                    }
+                } else {
+                    put_char(vt, VT_REPLACEMENT);
+                }
+                continue;
+            }
+            if (vt->utf8_left) {
+                /* Truncated sequence. */
+                vt->utf8_left = 0;
+                put_char(vt, VT_REPLACEMENT);
+                if (c >= 0x20 && c < 0x7f) {
+                    put_char(vt, c);
+                    continue;
+                }
+            }
+        }
+
+        /* OSC and other strings end with BEL or ST (ESC \). */
+        if (vt->state == VT_OSC || vt->state == VT_STRING) {
+            if (c == 0x07 || c == 0x1b || c == 0x18 || c == 0x1a) {
+                if (vt->state == VT_OSC && c == 0x07) osc_dispatch(vt);
+                if (c == 0x1b) vt->state++;     /* To the _ESC state. */
+                else vt->state = VT_GROUND;
+            } else if (vt->state == VT_OSC && vt->osclen < VT_TITLE_MAX-1) {
+                vt->osc[vt->osclen++] = c;
+            }
+            continue;
+        }
+        if (vt->state == VT_OSC_ESC || vt->state == VT_STRING_ESC) {
+            if (vt->state == VT_OSC_ESC) osc_dispatch(vt);
+            vt->state = VT_GROUND;
+            if (c == '\\') continue;
+            /* Not ST: the ESC started a new sequence. */
+            vt->state = VT_ESC;
+            vt->intermediate = 0;
+        }
+
+        if (c < 0x20) {
+            control(vt, c);
+            continue;
+        }
+        if (c == 0x7f || c >= 0x80) continue;
+
+        switch (vt->state) {
+        case VT_ESC:
+            if (c == '[') {
+                vt->state = VT_CSI;
+                vt->nparams = 0;
+                vt->private = 0;
+                vt->intermediate = 0;
+                memset(vt->params, 0, sizeof(vt->params));
+            } else if (c == ']') {
+                vt->state = VT_OSC;
+                vt->osclen = 0;
+            } else if (c == 'P' || c == 'X' || c == '^' || c == '_') {
+                vt->state = VT_STRING;
+            } else if (c >= 0x20 && c <= 0x2f) {
+                vt->intermediate = c;
+                vt->state = VT_ESC_INTER;
+            } else {
+                esc_dispatch(vt, c);
+                vt->state = VT_GROUND;
+            }
+            break;
+        case VT_ESC_INTER:
+            if (c >= 0x30) {
+                esc_dispatch(vt, c);
+                vt->state = VT_GROUND;
+            }
+            break;
+        case VT_CSI:
+            if (c >= '0' && c <= '9') {
+                if (vt->nparams == 0) vt->nparams = 1;
+                int *v = &vt->params[vt->nparams-1];
+                if (*v < 10000) *v = *v*10 + (c-'0');
+            } else if (c == ';' || c == ':') {
+                if (vt->nparams == 0) vt->nparams = 1;
+                if (vt->nparams < VT_MAX_PARAMS) vt->nparams++;
+            } else if (c >= 0x3c && c <= 0x3f) {
+                vt->private = c;
+            } else if (c >= 0x20 && c <= 0x2f) {
+                vt->intermediate = c;
+            } else if (c >= 0x40) {
+                csi_dispatch(vt, c);
+                vt->state = VT_GROUND;
+            }
+            break;
+        }
+    }
+}
+
+void vtClearDirty(VtScreen *vt) {
+    memset(vt->dirty, 0, sizeof(uint64_t)*((vt->rows+63)/64));
+}
+
+/* Write the text of screen row 'row' in 'buf' as UTF-8, without trailing
+ * spaces, and null terminated. 'buf' must have room for 4 bytes per
+ * column plus one. Returns the length of the text. */
+size_t vtRowText(const VtScreen *vt, int row, char *buf) {
+    const VtGrid *g = vt->grid;
+    const uint32_t *cp = g->cp + VT_CELL(vt, 0, row);
+    const uint16_t *attr = g->attr + VT_CELL(vt, 0, row);
+    size_t len = 0, end = 0;
+    for (int x = 0; x < vt->cols; x++) {
+        uint32_t c = cp[x];
+        if (attr[x] & VT_ATTR_WIDE_TAIL) continue;
+        if (!is_scalar(c)) c = VT_REPLACEMENT;
+        if (c < 0x80) {
+            buf[len++] = c;
+        } else if (c < 0x800) {
+            buf[len++] = 0xc0 | (c >> 6);
+            buf[len++] = 0x80 | (c & 0x3f);
+        } else if (c < 0x10000) {
+            buf[len++] = 0xe0 | (c >> 12);
+            buf[len++] = 0x80 | ((c >> 6) & 0x3f);
+            buf[len++] = 0x80 | (c & 0x3f);
+        } else {
+            buf[len++] = 0xf0 | (c >> 18);
+            buf[len++] = 0x80 | ((c >> 12) & 0x3f);
+            buf[len++] = 0x80 | ((c >> 6) & 0x3f);
+            buf[len++] = 0x80 | (c & 0x3f);
+        }
+        if (c != ' ') end = len;
+    }
+    buf[end] = '\0';
+    return end;
+}
@@ -0,0 +1,96 @@
+#ifndef VT_H
+#define VT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "scrollback.h"
+
+/* Cell attributes. */
+#define VT_ATTR_BOLD        (1<<0)
+#define VT_ATTR_DIM         (1<<1)
+#define VT_ATTR_ITALIC      (1<<2)
+#define VT_ATTR_UNDERLINE   (1<<3)
+#define VT_ATTR_BLINK       (1<<4)
+#define VT_ATTR_REVERSE     (1<<5)
+#define VT_ATTR_HIDDEN      (1<<6)
+#define VT_ATTR_STRIKE      (1<<7)
+#define VT_ATTR_WIDE        (1<<8)  /* First cell of a double width char. */
+#define VT_ATTR_WIDE_TAIL   (1<<9)  /* Second cell of a double width char. */
+
+/* Cell colors: the default color of the terminal, one of the 256 palette
+ * colors, or a 24 bit RGB color. */
+#define VT_COLOR_DEFAULT    0
+#define VT_COLOR_INDEX(n)   (0x1000000 | (n))
+#define VT_COLOR_RGB(r,g,b) (0x2000000 | ((r)<<16) | ((g)<<8) | (b))
+#define VT_COLOR_TYPE(c)    ((c) >> 24)  /* 0 default, 1 index, 2 RGB. */
+
+#define VT_MAX_PARAMS 16
+#define VT_TITLE_MAX 256
+#define VT_REPLY_MAX 256
+
+/* A screen buffer. Cells are stored as struct of arrays: scanning the
+ * codepoints of a row, as text snapshots do, touches only those. */
+typedef struct VtGrid {
+    int *lines;             /* Grid row of every screen row: scrolling
+                               rotates these instead of moving cells. */
+    uint32_t *cp;           /* Codepoints, ' ' for empty cells. */
+    uint16_t *attr;         /* VT_ATTR_* flags. */
+    uint32_t *fg;           /* VT_COLOR_* foreground. */
+    uint32_t *bg;           /* VT_COLOR_* background. */
+} VtGrid;
+
+/* The state of the current pen: attributes of the cells written next. */
+typedef struct VtPen {
+    uint16_t attr;
+    uint32_t fg, bg;
+} VtPen;
+
+typedef struct VtScreen {
+    int rows, cols;
+    VtGrid main, alt;       /* Normal and alternate screen buffers. */
+    VtGrid *grid;           /* Buffer currently displayed. */
+    uint64_t *dirty;        /* Bitmap of the rows changed since the last
+                               vtClearDirty(). */
+    int cx, cy;             /* Cursor position. */
+    int wrap_pending;       /* Cursor past the last column. */
+    int cursor_hidden;
+    int autowrap;
+    int top, bottom;        /* Scrolling region, inclusive. */
+    int line_drawing;       /* DEC special graphics selected in G0. */
+    VtPen pen;
+    int saved_cx, saved_cy; /* Saved by DECSC. */
+    VtPen saved_pen;
+    uint32_t last_cp;       /* Last character written, for REP. */
+    uint8_t *tabs;          /* Tab stop at every column with 1. */
+    Scrollback *scrollback; /* Gets the rows scrolled off the top of the
+                               main screen, if not NULL. */
+
+    /* Parser state. */
+    int state;
+    int params[VT_MAX_PARAMS];
+    int nparams;
+    char private;           /* CSI private marker like '?', or 0. */
+    char intermediate;      /* Intermediate byte, or 0. */
+    uint32_t utf8;          /* UTF-8 sequence being decoded. */
+    int utf8_left;          /* Continuation bytes still expected. */
+    int utf8_len;           /* Length of the whole sequence. */
+    char osc[VT_TITLE_MAX]; /* OSC string being collected. */
+    size_t osclen;
+
+    char title[VT_TITLE_MAX]; /* Title set by OSC 0 or 2. */
+    char reply[VT_REPLY_MAX]; /* Answers to terminal queries, to be written
+                                 back to the program by the caller. */
+    size_t replylen;
+} VtScreen;
+
+/* Index of the cell at column 'x' of screen row 'y' in the grid arrays. */
+#define VT_CELL(vt,x,y) ((size_t)(vt)->grid->lines[(y)]*(vt)->cols + (x))
+
+VtScreen *vtCreate(int rows, int cols);
+void vtFree(VtScreen *vt);
+void vtWrite(VtScreen *vt, const char *buf, size_t len);
+void vtClearDirty(VtScreen *vt);
+size_t vtRowText(const VtScreen *vt, int row, char *buf);
+
+#endif
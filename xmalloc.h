@@ -2,5 +2,7 @@
 #define XMALLOC_H
 void *xmalloc(size_t size);
 void *xrealloc(void *ptr, size_t size);
+void *xalignedalloc(size_t alignment, size_t size);
+void xcharge(void *ptr, const char *subsystem);
 void xfree(void *ptr);
 #endif